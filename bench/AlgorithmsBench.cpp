@@ -0,0 +1,457 @@
+#include "Bench.hpp"
+
+#include <tobi/Algorithms.hpp>
+#include <tobi/Array.hpp>
+#include <tobi/Capabilities.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/Quantize.hpp>
+#include <tobi/Readback.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tobi::bench {
+
+namespace {
+
+constexpr auto usage =
+    wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst;
+
+auto createBuffer(wgpu::Device const& device, uint64_t size) -> gpu::BufferSlice {
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = std::max<uint64_t>(size, 4);
+    descriptor.usage = usage;
+    return {device.CreateBuffer(&descriptor), 0, descriptor.size};
+}
+
+template <typename T>
+auto upload(wgpu::Device const& device, gpu::BufferSlice const& slice, std::vector<T> const& data)
+    -> void {
+    device.GetQueue().WriteBuffer(slice.buffer, slice.offset, data.data(), data.size() * sizeof(T));
+}
+
+template <typename T>
+auto download(Context& context, gpu::BufferSlice const& slice, std::size_t count)
+    -> std::vector<T> {
+    auto pending = gpu::readback(*context.pump, slice.buffer, slice.offset, count * sizeof(T));
+    auto const bytes = gpu::wait(*context.pump, pending);
+    auto result = std::vector<T>(count);
+    std::memcpy(result.data(), bytes.data(), bytes.size());
+    return result;
+}
+
+template <typename T>
+auto randomData(std::size_t count, T lo, T hi) -> std::vector<T> {
+    auto engine = std::mt19937{42};
+    auto data = std::vector<T>(count);
+    if constexpr (std::is_floating_point_v<T>) {
+        auto dist = std::uniform_real_distribution<T>{lo, hi};
+        std::generate(data.begin(), data.end(), [&] { return dist(engine); });
+    } else {
+        auto dist = std::uniform_int_distribution<T>{lo, hi};
+        std::generate(data.begin(), data.end(), [&] { return dist(engine); });
+    }
+    return data;
+}
+
+auto check(Context& context, bool ok, std::string_view name, uint64_t size) -> void {
+    if (not ok) {
+        context.report->fail(
+            fmt::format("{} at {} bytes does not match the CPU result", name, size));
+    }
+}
+
+// Integer sums must match exactly. Float sums depend on the order of the additions, so they are
+// compared to an exact sum with a tolerance relative to the sum of magnitudes.
+template <typename T>
+auto matches(T actual, double expected, double magnitude) -> bool {
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::abs(actual - expected) <= 1e-5 * magnitude + 1e-3;
+    } else {
+        return static_cast<double>(actual) == expected;
+    }
+}
+
+// Small values, so integer sums cannot overflow at the largest size and stay exact.
+template <typename T>
+auto sumData(std::size_t count) -> std::vector<T> {
+    if constexpr (std::is_unsigned_v<T>) {
+        return randomData<T>(count, 0, 15);
+    } else {
+        return randomData<T>(count, -15, 15);
+    }
+}
+
+template <typename T>
+auto benchReduce(Context& context,
+                 gpu::Algorithms& algorithms,
+                 gpu::ScalarType type,
+                 std::string const& name) -> void {
+    if (not context.enabled(name)) {
+        return;
+    }
+
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(T));
+        auto const data = sumData<T>(count);
+        auto input = createBuffer(context.device, size);
+        auto output = createBuffer(context.device, 4);
+        upload(context.device, input, data);
+
+        algorithms.reduce(type, input, count, output);
+        auto expected = 0.0;
+        auto magnitude = 0.0;
+        for (auto const value : data) {
+            expected += static_cast<double>(value);
+            magnitude += std::abs(static_cast<double>(value));
+        }
+        check(context, matches(download<T>(context, output, 1)[0], expected, magnitude), name,
+              size);
+
+        auto samples = measure(context.iterations(size), [&] {
+            algorithms.reduce(type, input, count, output);
+            gpu::waitForQueue(context.device);
+        });
+        context.report->add(
+            {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+    }
+}
+
+template <typename T>
+auto benchScan(Context& context,
+               gpu::Algorithms& algorithms,
+               gpu::ScalarType type,
+               std::string const& name) -> void {
+    if (not context.enabled(name)) {
+        return;
+    }
+
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(T));
+        auto const data = sumData<T>(count);
+        auto input = createBuffer(context.device, size);
+        auto output = createBuffer(context.device, size);
+        upload(context.device, input, data);
+
+        algorithms.exclusiveScan(type, input, output, count);
+        auto const result = download<T>(context, output, count);
+        auto ok = true;
+        auto expected = 0.0;
+        auto magnitude = 0.0;
+        for (auto i = std::size_t{0}; i < count and ok; ++i) {
+            ok = matches(result[i], expected, magnitude);
+            expected += static_cast<double>(data[i]);
+            magnitude += std::abs(static_cast<double>(data[i]));
+        }
+        check(context, ok, name, size);
+
+        auto samples = measure(context.iterations(size), [&] {
+            algorithms.exclusiveScan(type, input, output, count);
+            gpu::waitForQueue(context.device);
+        });
+        context.report->add(
+            {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+    }
+}
+
+// Sorts keys with their index as payload and compares both against std::stable_sort, which
+// also verifies stability. Every iteration restores the unsorted keys with a buffer copy first.
+template <typename T>
+auto benchSort(Context& context,
+               gpu::Algorithms& algorithms,
+               gpu::ScalarType type,
+               std::string const& name,
+               T lo,
+               T hi) -> void {
+    if (not context.enabled(name)) {
+        return;
+    }
+
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(T));
+        auto const data = randomData<T>(count, lo, hi);
+        auto source = createBuffer(context.device, size);
+        auto keys = createBuffer(context.device, size);
+        auto values = createBuffer(context.device, size);
+        upload(context.device, source, data);
+
+        auto indices = std::vector<uint32_t>(count);
+        std::iota(indices.begin(), indices.end(), 0U);
+        auto run = [&] {
+            auto encoder = context.device.CreateCommandEncoder();
+            encoder.CopyBufferToBuffer(source.buffer, 0, keys.buffer, 0, size);
+            auto commands = encoder.Finish();
+            context.device.GetQueue().Submit(1, &commands);
+            algorithms.sort(type, keys, count, &values);
+        };
+
+        upload(context.device, values, indices);
+        run();
+        std::stable_sort(indices.begin(), indices.end(),
+                         [&](auto a, auto b) { return data[a] < data[b]; });
+        auto expected = std::vector<T>(count);
+        std::transform(indices.begin(), indices.end(), expected.begin(),
+                       [&](auto i) { return data[i]; });
+        check(context,
+              download<T>(context, keys, count) == expected and
+                  download<uint32_t>(context, values, count) == indices,
+              name, size);
+
+        auto samples = measure(context.iterations(size), [&] {
+            run();
+            gpu::waitForQueue(context.device);
+        });
+        context.report->add(
+            {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+    }
+}
+
+// Median seconds of the f32 case per size, the baseline the narrow formats are compared to.
+auto speedup(std::vector<double> const& samples, double& baseline) -> double {
+    auto const median = summarize(samples).p50;
+    if (baseline == 0.0) {
+        baseline = median;
+    }
+    return median > 0.0 ? baseline / median : 0.0;
+}
+
+// CPU packing, then x * 2 + 1 and a sum on the GPU straight from every storage format. Results
+// are checked against the unpacked input; each GPU case prints the bytes moved per element and
+// its speedup over f32 at the same size.
+auto benchPacked(Context& context, gpu::Algorithms& algorithms) -> void {
+    using gpu::StorageFormat;
+    static constexpr auto formats = {
+        StorageFormat::F32,
+        StorageFormat::F16,
+        StorageFormat::I8,
+        StorageFormat::U16,
+    };
+    auto const half = gpu::capabilities(context.device).has(wgpu::FeatureName::ShaderF16);
+
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(float));
+        auto const data = randomData<float>(count, -1.0F, 1.0F);
+        auto mapBaseline = 0.0;
+        auto reduceBaseline = 0.0;
+
+        for (auto const format : formats) {
+            auto const suffix = std::string{gpu::toString(format)};
+            auto const bytes = gpu::packedSize(format, count);
+            auto const q = gpu::fitQuantization(format, data);
+            auto packed = std::vector<std::byte>(bytes);
+            auto unpacked = std::vector<float>(count);
+
+            if (context.enabled("quantize/pack-" + suffix)) {
+                auto samples = measure(context.iterations(size),
+                                       [&] { gpu::pack(format, q, data, packed); });
+                context.report->add({"quantize/pack-" + suffix, size, std::move(samples),
+                                     static_cast<double>(count), "Gelem/s"});
+            }
+            gpu::pack(format, q, data, packed);
+            if (context.enabled("quantize/unpack-" + suffix)) {
+                auto samples = measure(context.iterations(size),
+                                       [&] { gpu::unpack(format, q, packed, unpacked); });
+                context.report->add({"quantize/unpack-" + suffix, size, std::move(samples),
+                                     static_cast<double>(count), "Gelem/s"});
+            }
+            gpu::unpack(format, q, packed, unpacked);
+
+            auto input = createBuffer(context.device, bytes);
+            auto output = createBuffer(context.device, bytes);
+            auto sum = createBuffer(context.device, 4);
+            upload(context.device, input, packed);
+            auto const in = gpu::PackedSlice{input, format, q};
+            auto const out = gpu::PackedSlice{
+                output, format, {.scale = q.scale * 2.0F, .offset = q.offset * 2.0F + 1.0F}};
+            auto tolerance = 2.5F * out.quantization.scale;
+            if (format == StorageFormat::F32 or format == StorageFormat::F16) {
+                tolerance = format == StorageFormat::F32 ? 1e-5F : 4e-3F;
+            }
+
+            for (auto const precision : {gpu::Precision::F32, gpu::Precision::F16}) {
+                auto const f16 = precision == gpu::Precision::F16;
+                auto const name = "packed/map-" + suffix + (f16 ? "-f16" : "");
+                if ((f16 and not half) or not context.enabled(name)) {
+                    continue;
+                }
+
+                algorithms.map("x * 2.0 + 1.0", in, out, count, precision);
+                auto result = std::vector<float>(count);
+                auto const mapped = download<std::byte>(context, output, bytes);
+                gpu::unpack(format, out.quantization, mapped, result);
+                auto ok = true;
+                for (auto i = std::size_t{0}; i < count; ++i) {
+                    ok = ok and std::abs(result[i] - (unpacked[i] * 2.0F + 1.0F)) <= tolerance;
+                }
+                check(context, ok, name, size);
+
+                auto samples = measure(context.iterations(size * 2), [&] {
+                    algorithms.map("x * 2.0 + 1.0", in, out, count, precision);
+                    gpu::waitForQueue(context.device);
+                });
+                if (not f16) {
+                    fmt::println("{} {} B: {} bytes per element, {:.2f}x f32", name, size,
+                                 2 * gpu::elementSize(format), speedup(samples, mapBaseline));
+                }
+                context.report->add(
+                    {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+            }
+
+            auto const name = "packed/reduce-" + suffix;
+            if (not context.enabled(name)) {
+                continue;
+            }
+            algorithms.reduce(in, count, sum);
+            auto expected = 0.0;
+            auto magnitude = 0.0;
+            for (auto const value : unpacked) {
+                expected += value;
+                magnitude += std::abs(value);
+            }
+            auto const total = download<float>(context, sum, 1)[0];
+            check(context, std::abs(total - expected) <= 1e-5 * magnitude + 1e-3, name, size);
+
+            auto samples = measure(context.iterations(size), [&] {
+                algorithms.reduce(in, count, sum);
+                gpu::waitForQueue(context.device);
+            });
+            fmt::println("{} {} B: {} bytes per element, {:.2f}x f32", name, size,
+                         gpu::elementSize(format), speedup(samples, reduceBaseline));
+            context.report->add(
+                {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+        }
+    }
+}
+
+auto close(std::vector<float> const& actual, std::vector<float> const& expected) -> bool {
+    if (actual.size() != expected.size()) {
+        return false;
+    }
+    for (auto i = std::size_t{0}; i < actual.size(); ++i) {
+        // Negated so that NaN fails.
+        auto const tolerance = 1e-4F * std::max(1.0F, std::abs(expected[i]));
+        if (not(std::abs(actual[i] - expected[i]) <= tolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The same expressions evaluated as one generated kernel and with every operation evaluated on
+// its own, the way separate hand-written shaders would run them.
+auto benchFusion(Context& context) -> void {
+    if (not context.enabled("array/")) {
+        return;
+    }
+
+    auto engine = gpu::ArrayEngine{context.device, context.pipelines};
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(float));
+        auto const x = randomData<float>(count, -1.0F, 1.0F);
+        auto const y = randomData<float>(count, 0.0F, 2.0F);
+        auto const a = engine.upload(x);
+        auto const b = engine.upload(y);
+
+        // sqrt(a^2 + b^2) * 0.5 + b, six operations.
+        auto expected = std::vector<float>(count);
+        for (auto i = std::size_t{0}; i < count; ++i) {
+            expected[i] = std::sqrt(x[i] * x[i] + y[i] * y[i]) * 0.5F + y[i];
+        }
+        auto fused = [&] { return engine.evaluate(sqrt(a * a + b * b) * 0.5F + b); };
+        auto unfused = [&] {
+            auto t = engine.evaluate(a * a);
+            t = engine.evaluate(t + engine.evaluate(b * b));
+            t = engine.evaluate(sqrt(t));
+            t = engine.evaluate(t * 0.5F);
+            return engine.evaluate(t + b);
+        };
+        check(context, close(engine.read(*context.pump, fused()), expected), "array/fused-map",
+              size);
+        check(context, close(engine.read(*context.pump, unfused()), expected),
+              "array/unfused-map", size);
+
+        for (auto const& [name, fn] : {std::pair{"array/fused-map", std::function{fused}},
+                                       std::pair{"array/unfused-map", std::function{unfused}}}) {
+            auto samples = measure(context.iterations(size * 3), [&] {
+                auto const result = fn();
+                gpu::waitForQueue(context.device);
+            });
+            context.report->add(
+                {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+        }
+
+        // Mean absolute deviation: two reductions, the inner one broadcast into the outer.
+        auto mean = 0.0;
+        for (auto const value : x) {
+            mean += value;
+        }
+        mean /= count;
+        auto deviation = 0.0;
+        for (auto const value : x) {
+            deviation += std::abs(value - mean);
+        }
+        auto const expectedDeviation = std::vector<float>{static_cast<float>(deviation / count)};
+        auto const n = static_cast<float>(count);
+        auto fusedReduce = [&] { return engine.evaluate(sum(abs(a - sum(a) / n)) / n); };
+        auto unfusedReduce = [&] {
+            auto t = engine.evaluate(engine.evaluate(sum(a)) / n);
+            t = engine.evaluate(a - t);
+            t = engine.evaluate(abs(t));
+            return engine.evaluate(engine.evaluate(sum(t)) / n);
+        };
+        check(context, close(engine.read(*context.pump, fusedReduce()), expectedDeviation),
+              "array/fused-reduce", size);
+        check(context, close(engine.read(*context.pump, unfusedReduce()), expectedDeviation),
+              "array/unfused-reduce", size);
+
+        for (auto const& [name, fn] :
+             {std::pair{"array/fused-reduce", std::function{fusedReduce}},
+              std::pair{"array/unfused-reduce", std::function{unfusedReduce}}}) {
+            auto samples = measure(context.iterations(size), [&] {
+                auto const result = fn();
+                gpu::waitForQueue(context.device);
+            });
+            context.report->add(
+                {name, size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+        }
+    }
+
+    auto const stats = engine.stats();
+    fmt::println("array: {} kernels compiled, {} cache hits, {} dispatches", stats.kernelsCompiled,
+                 stats.cacheHits, stats.dispatches);
+}
+
+}  // namespace
+
+auto runAlgorithmsSuite(Context& context) -> void {
+    auto algorithms = gpu::Algorithms{context.device, context.pipelines};
+    using gpu::ScalarType;
+    benchReduce<uint32_t>(context, algorithms, ScalarType::U32, "algorithms/reduce-u32");
+    benchReduce<int32_t>(context, algorithms, ScalarType::I32, "algorithms/reduce-i32");
+    benchReduce<float>(context, algorithms, ScalarType::F32, "algorithms/reduce-f32");
+    benchScan<uint32_t>(context, algorithms, ScalarType::U32, "algorithms/scan-u32");
+    benchScan<int32_t>(context, algorithms, ScalarType::I32, "algorithms/scan-i32");
+    benchScan<float>(context, algorithms, ScalarType::F32, "algorithms/scan-f32");
+    benchSort<uint32_t>(context, algorithms, gpu::ScalarType::U32, "algorithms/sort-u32", 0,
+                        0xffffffffU);
+    benchSort<int32_t>(context, algorithms, gpu::ScalarType::I32, "algorithms/sort-i32",
+                       std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+    benchSort<float>(context, algorithms, gpu::ScalarType::F32, "algorithms/sort-f32", -1e6F,
+                     1e6F);
+    benchPacked(context, algorithms);
+    benchFusion(context);
+}
+
+}  // namespace tobi::bench
@@ -0,0 +1,542 @@
+#include "Bench.hpp"
+
+#include <tobi/AudioDevice.hpp>
+#include <tobi/AudioGraph.hpp>
+#include <tobi/AudioNodes.hpp>
+#include <tobi/Fft.hpp>
+#include <tobi/ClapHost.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/GpuSynth.hpp>
+#include <tobi/OfflineRenderer.hpp>
+#include <tobi/SpscQueue.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <numbers>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Counts heap allocations made by threads that opted in, to prove the audio path never
+// allocates.
+thread_local bool countAllocations = false;
+std::atomic<uint64_t> allocations{0};
+
+}  // namespace
+
+auto operator new(std::size_t size) -> void* {
+    if (countAllocations) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (auto* p = std::malloc(std::max<std::size_t>(size, 1)); p != nullptr) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+auto operator delete(void* p) noexcept -> void {
+    std::free(p);
+}
+
+auto operator delete(void* p, std::size_t /*size*/) noexcept -> void {
+    std::free(p);
+}
+
+namespace tobi::bench {
+
+namespace {
+
+// Producer and consumer hammer the queue from two threads, the consumer checks that every
+// value arrives exactly once and in order.
+auto benchSpsc(Context& context) -> void {
+    if (not context.enabled("audio/spsc-stress")) {
+        return;
+    }
+
+    static constexpr auto count = uint64_t{1} << 22U;
+    auto failed = false;
+    auto samples = measure(std::min(context.options.iterations, 10), [&] {
+        auto queue = std::make_unique<SpscQueue<uint64_t, 1024>>();
+        auto producer = std::thread{[&] {
+            for (auto i = uint64_t{0}; i < count; ++i) {
+                while (not queue->push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        }};
+
+        auto expected = uint64_t{0};
+        while (expected < count) {
+            if (auto value = queue->pop()) {
+                failed = failed or *value != expected;
+                ++expected;
+            }
+        }
+        producer.join();
+        failed = failed or queue->pop().has_value();
+    });
+
+    if (failed) {
+        context.report->fail("audio/spsc-stress lost or reordered elements");
+    }
+    context.report->add(
+        {"audio/spsc-stress", 0, std::move(samples), static_cast<double>(count), "Mops/s"});
+}
+
+// A UI thread floods the command queue and drains meters while the audio thread renders. The
+// audio thread must not allocate and its output must stay bounded.
+auto benchCallback(Context& context) -> void {
+    if (not context.enabled("audio/callback")) {
+        return;
+    }
+
+    static constexpr auto blockSize = uint32_t{256};
+    static constexpr auto blocks = 4096;
+
+    auto audio = std::make_unique<AudioDevice>();
+    auto output = std::vector<float>(blockSize * AudioDevice::channels);
+    auto bounded = true;
+
+    allocations = 0;
+    auto samples = measure(std::min(context.options.iterations, 10), [&] {
+        auto stop = std::atomic<bool>{false};
+        auto ui = std::thread{[&] {
+            auto i = 0;
+            while (not stop) {
+                (void)audio->setFrequency(static_cast<float>(100 + i % 1000));
+                (void)audio->setAmplitude(static_cast<float>(i % 100) / 100.0F);
+                (void)audio->setMuted(i % 7 == 0);
+                (void)audio->pollMeters();
+                ++i;
+            }
+        }};
+
+        countAllocations = true;
+        for (auto b = 0; b < blocks; ++b) {
+            audio->render(output.data(), blockSize);
+            bounded = bounded and std::all_of(output.begin(), output.end(), [](float s) {
+                          return std::isfinite(s) and std::abs(s) <= 1.0F;
+                      });
+        }
+        countAllocations = false;
+
+        stop = true;
+        ui.join();
+    });
+
+    if (allocations > 0) {
+        context.report->fail(
+            fmt::format("audio/callback allocated {} times", allocations.load()));
+    }
+    if (not bounded) {
+        context.report->fail("audio/callback produced samples outside [-1, 1]");
+    }
+    context.report->add({"audio/callback", blockSize, std::move(samples),
+                         static_cast<double>(blocks) * blockSize, "Mframes/s"});
+}
+
+// The device on miniaudio's null backend for a second, so it runs without a sound card. The
+// samples are the callback times recorded by the device's own instrumentation, at histogram
+// bucket resolution.
+auto benchNullDevice(Context& context) -> void {
+    if (not context.enabled("audio/null-device")) {
+        return;
+    }
+
+    static constexpr auto period = uint32_t{256};
+
+    auto audio = std::make_unique<AudioDevice>(AudioDeviceOptions{AudioBackend::Null, period});
+    audio->initialized();
+    std::this_thread::sleep_for(std::chrono::seconds{1});
+
+    auto const stats = audio->callbackStats();
+    auto const& histogram = audio->callbackTime();
+    auto const counts = histogram.counts();
+    auto samples = std::vector<double>{};
+    for (auto i = std::size_t{0}; i < counts.size(); ++i) {
+        samples.insert(samples.end(), static_cast<std::size_t>(counts[i]),
+                       histogram.bucketUpperEdge(i) * 1e-6);
+    }
+    audio.reset();
+
+    if (stats.callbacks == 0) {
+        context.report->fail("audio/null-device never ran its callback");
+        return;
+    }
+    fmt::println("audio/null-device: {} callbacks, {} deadline misses, {} xruns", stats.callbacks,
+                 stats.deadlineMisses, stats.xruns);
+    auto const frames = stats.budget * AudioDevice::sampleRate * 1e-6;
+    context.report->add({"audio/null-device", period, std::move(samples), frames, "Mframes/s"});
+}
+
+// Samples of a float WAV file as AudioFileWriter writes it, empty if the format does not match
+// the device's.
+auto readWav(std::filesystem::path const& path) -> std::vector<float> {
+    auto file = std::ifstream{path, std::ios::binary};
+    auto const id = [&] {
+        auto bytes = std::array<char, 4>{};
+        file.read(bytes.data(), bytes.size());
+        return std::string{bytes.data(), bytes.size()};
+    };
+    auto const u16 = [&] {
+        auto bytes = std::array<unsigned char, 2>{};
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        return uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8U;
+    };
+    auto const u32 = [&] { return u16() | u16() << 16U; };
+
+    auto const riff = id();
+    (void)u32();
+    if (riff != "RIFF" or id() != "WAVE") {
+        return {};
+    }
+
+    auto format = false;
+    while (file) {
+        auto const chunk = id();
+        auto const size = u32();
+        if (chunk == "fmt " and size >= 16) {
+            auto const type = u16();
+            auto const channels = u16();
+            auto const sampleRate = u32();
+            format = type == 3 and channels == AudioDevice::channels and
+                     sampleRate == AudioDevice::sampleRate;
+            file.seekg(size - 8, std::ios::cur);
+        } else if (chunk == "data" and format) {
+            auto samples = std::vector<float>(size / sizeof(float));
+            file.read(reinterpret_cast<char*>(samples.data()), size);
+            return file ? samples : std::vector<float>{};
+        } else {
+            file.seekg(size, std::ios::cur);
+        }
+    }
+    return {};
+}
+
+// The job rendered on the calling thread, in the same blocks renderOffline() uses.
+auto renderSerial(OfflineJob const& job, uint64_t frames) -> std::vector<float> {
+    auto device = job.device();
+    auto output = std::vector<float>(frames * AudioDevice::channels);
+    for (auto frame = uint64_t{0}; frame < frames; frame += offlineBlockFrames) {
+        auto const block = std::min<uint64_t>(offlineBlockFrames, frames - frame);
+        device->render(output.data() + frame * AudioDevice::channels,
+                       static_cast<uint32_t>(block));
+    }
+    return output;
+}
+
+// Independent offline renders to WAV files, one per thread. Work is the seconds of audio across
+// all jobs, so the throughput reads as the combined real-time factor.
+auto benchOffline(Context& context) -> void {
+    if (not context.enabled("audio/offline")) {
+        return;
+    }
+
+    static constexpr auto seconds = 5.0;
+    auto const count = std::max<std::size_t>(ThreadPool::defaultWorkers() + 1, 2);
+    auto const directory = std::filesystem::temp_directory_path() / "tobi-bench-offline";
+    std::filesystem::create_directories(directory);
+
+    auto jobs = std::vector<OfflineJob>(count);
+    for (auto i = std::size_t{0}; i < count; ++i) {
+        jobs[i].path = directory / fmt::format("job{}.wav", i);
+        jobs[i].seconds = seconds;
+        jobs[i].device = [i] {
+            auto device = std::make_unique<AudioDevice>();
+            (void)device->setFrequency(110.0F * static_cast<float>(i + 1));
+            return device;
+        };
+    }
+
+    auto results = std::vector<OfflineResult>{};
+    auto samples = measure(std::min(context.options.iterations, 3),
+                           [&] { results = renderOffline(jobs); });
+
+    // Every file must hold exactly what the device renders serially, and not silence: each job
+    // plays at a frequency of its own, so a swapped or duplicated job differs as well.
+    for (auto i = std::size_t{0}; i < count; ++i) {
+        auto const written = readWav(jobs[i].path);
+        auto const expected = renderSerial(jobs[i], results[i].frames);
+        auto const silent =
+            std::all_of(written.begin(), written.end(), [](float s) { return s == 0.0F; });
+        if (written != expected or silent) {
+            context.report->fail(fmt::format("audio/offline {} differs from the serial render",
+                                             jobs[i].path.string()));
+        }
+    }
+    std::filesystem::remove_all(directory);
+
+    context.report->add({"audio/offline", count, std::move(samples),
+                         seconds * static_cast<double>(count), "x realtime"});
+}
+
+// The GPU synth on the bench device, SwiftShader with --swiftshader. The first block is
+// compared against additive synthesis and direct convolution in double precision, then a
+// simulated device clock pulls one audio block per block duration for a few seconds. Samples
+// are the readback round trips, at histogram bucket resolution.
+auto benchGpuSynth(Context& context) -> void {
+    if (not context.enabled("audio/gpu-synth")) {
+        return;
+    }
+    if (not gpu::isThreadSafe(context.device)) {
+        fmt::println("audio/gpu-synth: skipped, the device is not thread-safe");
+        return;
+    }
+
+    static constexpr auto sampleRate = 48000.0;
+    static constexpr auto seconds = 3.0;
+    static constexpr auto tolerance = 5e-3;
+
+    auto options = audio::GpuSynthOptions{};
+    options.voices = 16;
+    options.harmonics = 8;
+    options.impulse = audio::GpuSynth::syntheticImpulse(0.1, sampleRate);
+    auto const impulse = options.impulse;
+    auto synth = std::make_unique<audio::GpuSynth>(context.device, options);
+
+    auto frequencies = std::vector<double>(options.voices);
+    auto const amplitude = 0.5F / static_cast<float>(options.voices);
+    for (auto v = uint32_t{0}; v < options.voices; ++v) {
+        frequencies[v] = 110.0 * std::exp2(v / 12.0);
+        synth->setVoice(v, static_cast<float>(frequencies[v]), amplitude);
+    }
+    synth->prepare(sampleRate);
+
+    // Generous, SwiftShader and loaded machines take a while for the first round trip.
+    static constexpr auto firstBlockTimeout = std::chrono::seconds{10};
+    auto const deadline = std::chrono::steady_clock::now() + firstBlockTimeout;
+    while (not synth->ready() and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    auto bus = std::make_unique<audio::AudioBus>();
+    auto const outputs = std::span<audio::AudioBus>{bus.get(), 1};
+    auto frame = uint64_t{0};
+    auto const pull = [&] {
+        synth->process({sampleRate, frame}, {}, outputs);
+        frame += audio::blockSize;
+    };
+
+    auto dry = std::vector<double>(options.blockFrames);
+    for (auto n = std::size_t{0}; n < dry.size(); ++n) {
+        for (auto const frequency : frequencies) {
+            for (auto h = 1; h <= static_cast<int>(options.harmonics); ++h) {
+                auto const phase = 2.0 * std::numbers::pi * h * frequency * n / sampleRate;
+                dry[n] += amplitude * std::sin(phase) / h;
+            }
+        }
+    }
+    auto error = 0.0;
+    for (auto b = std::size_t{0}; b < options.blockFrames / audio::blockSize; ++b) {
+        pull();
+        for (auto i = std::size_t{0}; i < audio::blockSize; ++i) {
+            auto const n = b * audio::blockSize + i;
+            for (auto ch = std::size_t{0}; ch < audio::channels; ++ch) {
+                auto wet = 0.0;
+                for (auto k = std::size_t{0}; k <= n and k < impulse[ch].size(); ++k) {
+                    wet += dry[n - k] * impulse[ch][k];
+                }
+                auto const expected = dry[n] + options.wet * wet;
+                error = std::max(error, std::abs(bus->channel[ch][i] - expected));
+            }
+        }
+    }
+    if (synth->stats().gpuBlocks != 1) {
+        context.report->fail(fmt::format("audio/gpu-synth first block was not ready after {} s",
+                                         firstBlockTimeout.count()));
+    } else if (error > tolerance) {
+        context.report->fail(
+            fmt::format("audio/gpu-synth differs from the reference by {}", error));
+    }
+
+    auto const blockDuration = std::chrono::duration<double>(audio::blockSize / sampleRate);
+    auto const start = std::chrono::steady_clock::now();
+    for (auto b = 0; b < static_cast<int>(seconds * sampleRate / audio::blockSize); ++b) {
+        std::this_thread::sleep_until(
+            start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        blockDuration * b));
+        pull();
+    }
+
+    auto const stats = synth->stats();
+    auto const& roundTrip = synth->roundTrip();
+    auto const counts = roundTrip.counts();
+    auto samples = std::vector<double>{};
+    for (auto i = std::size_t{0}; i < counts.size(); ++i) {
+        samples.insert(samples.end(), static_cast<std::size_t>(counts[i]),
+                       roundTrip.bucketUpperEdge(i) * 1e-3);
+    }
+    fmt::println("audio/gpu-synth: {:.1f} ms ahead, {} GPU blocks, {} CPU fallbacks, {} missed",
+                 synth->latency(), stats.gpuBlocks, stats.fallbackBlocks, stats.missedBlocks);
+    synth.reset();
+
+    if (samples.empty()) {
+        context.report->fail("audio/gpu-synth no readback completed");
+        return;
+    }
+    context.report->add({"audio/gpu-synth", impulse[0].size(), std::move(samples),
+                         static_cast<double>(options.blockFrames), "Mframes/s"});
+}
+
+// Synth voices (saw, low-pass, gain) into a mixer and a stereo delay, rendered offline on one
+// thread. Work is the number of voices times the seconds of audio rendered, so the throughput
+// reads as voices one core sustains in real time at 48 kHz stereo.
+auto benchVoices(Context& context) -> void {
+    if (not context.enabled("audio/voices")) {
+        return;
+    }
+
+    static constexpr auto voices = std::size_t{64};
+    static constexpr auto sampleRate = 48000;
+    static constexpr auto seconds = 1.0;
+
+    auto graph = std::make_unique<audio::Graph>();
+    auto& mixer = graph->add<audio::Mixer>(voices);
+    for (auto v = std::size_t{0}; v < voices; ++v) {
+        auto const hz = 55.0F * std::exp2(static_cast<float>(v % 36) / 12.0F);
+        auto& osc = graph->add<audio::Oscillator>(audio::Oscillator::Waveform::Saw, hz);
+        auto& filter = graph->add<audio::BiquadFilter>(audio::BiquadFilter::Type::LowPass,
+                                                        400.0F + 50.0F * static_cast<float>(v));
+        auto& gain = graph->add<audio::Gain>(1.0F / voices);
+        graph->connect(osc, filter);
+        graph->connect(filter, gain);
+        graph->connect(gain, mixer, v);
+    }
+    auto& delay = graph->add<audio::Delay>();
+    graph->connect(mixer, delay);
+    graph->setOutput(delay);
+    graph->prepare(sampleRate);
+
+    auto const frames = static_cast<uint32_t>(sampleRate * seconds);
+    auto output = std::vector<float>(std::size_t{frames} * audio::channels);
+    auto samples = measure(std::min(context.options.iterations, 10), [&] {
+        graph->process(output.data(), frames);
+    });
+
+    if (not std::all_of(output.begin(), output.end(), [](float s) { return std::isfinite(s); })) {
+        context.report->fail("audio/voices produced non-finite samples");
+    }
+    context.report->add({"audio/voices", voices, std::move(samples),
+                         static_cast<double>(voices) * seconds, "voices/core"});
+}
+
+// Chains of two test plugins each, rendered once with every chain and every thread-pool request
+// on the calling thread and once on a ThreadPool. Both runs must produce the same bits. Work is
+// the seconds of audio rendered, so the throughput reads as the real-time factor.
+auto benchClapChains(Context& context) -> void {
+    if (not context.enabled("clap/chains")) {
+        return;
+    }
+
+    static constexpr auto chains = std::size_t{16};
+    static constexpr auto sampleRate = 48000;
+    static constexpr auto seconds = 0.5;
+    static constexpr auto ids = std::array{"tobi.bench.additive-110", "tobi.bench.additive-165",
+                                           "tobi.bench.additive-220", "tobi.bench.additive-330"};
+
+    auto const frames = static_cast<uint32_t>(sampleRate * seconds);
+    auto outputs = std::array<std::vector<float>, 2>{};
+    auto const workers = std::array{uint32_t{0}, ThreadPool::defaultWorkers()};
+
+    for (auto run = std::size_t{0}; run < workers.size(); ++run) {
+        auto graph = std::make_unique<audio::Graph>();
+        auto& host = graph->add<ClapHost>(workers[run]);
+        for (auto c = std::size_t{0}; c < chains; ++c) {
+            auto const chain = host.addChain();
+            host.add(chain, ClapPlugin::create(testPluginEntry(), ids[c % ids.size()]));
+            host.add(chain, ClapPlugin::create(testPluginEntry(), ids[(c + 1) % ids.size()]));
+        }
+        graph->setOutput(host);
+        graph->prepare(sampleRate);
+
+        auto& output = outputs[run];
+        output.resize(std::size_t{frames} * audio::channels);
+        auto samples = measure(std::min(context.options.iterations, 5), [&] {
+            graph->process(output.data(), frames);
+        });
+
+        auto const name = fmt::format("clap/chains-{}w", workers[run]);
+        context.report->add({name, chains, std::move(samples), seconds, "x realtime"});
+    }
+
+    if (std::memcmp(outputs[0].data(), outputs[1].data(), outputs[0].size() * sizeof(float)) !=
+        0) {
+        context.report->fail("clap/chains parallel output differs from serial output");
+    }
+}
+
+// The analyzer's FFT at every size it offers, checked against a DFT in double precision first.
+// Work is the transform size, so the throughput reads as points per second.
+auto benchFft(Context& context) -> void {
+    if (not context.enabled("audio/fft")) {
+        return;
+    }
+
+    auto random = std::mt19937{7};
+    auto distribution = std::uniform_real_distribution<float>{-1.0F, 1.0F};
+
+    for (auto size = std::size_t{256}; size <= AudioSnapshot::frames; size *= 2) {
+        auto const fft = audio::Fft{size};
+        auto input = std::vector<float>(size);
+        std::generate(input.begin(), input.end(), [&] { return distribution(random); });
+
+        auto re = input;
+        auto im = std::vector<float>(size, 0.0F);
+        fft.forward(re.data(), im.data());
+
+        auto error = 0.0;
+        for (auto k = std::size_t{0}; k < size; k += size / 64) {
+            auto sumRe = 0.0;
+            auto sumIm = 0.0;
+            for (auto n = std::size_t{0}; n < size; ++n) {
+                auto const angle = -2.0 * std::numbers::pi * static_cast<double>(k * n % size) /
+                                   static_cast<double>(size);
+                sumRe += input[n] * std::cos(angle);
+                sumIm += input[n] * std::sin(angle);
+            }
+            error = std::max(error, std::hypot(sumRe - re[k], sumIm - im[k]));
+        }
+        // Rounding grows with log2(size) and the magnitude of the bins, about sqrt(size) here.
+        if (error > 1e-5 * std::sqrt(static_cast<double>(size)) * std::log2(size)) {
+            context.report->fail(
+                fmt::format("audio/fft size {} differs from the DFT by {}", size, error));
+            continue;
+        }
+
+        auto samples = measure(context.options.iterations * 20, [&] {
+            std::copy(input.begin(), input.end(), re.begin());
+            std::fill(im.begin(), im.end(), 0.0F);
+            fft.forward(re.data(), im.data());
+        });
+        context.report->add({"audio/fft", size, std::move(samples), static_cast<double>(size),
+                             "Melem/s"});
+    }
+}
+
+}  // namespace
+
+auto runAudioSuite(Context& context) -> void {
+    benchSpsc(context);
+    benchCallback(context);
+    benchNullDevice(context);
+    benchOffline(context);
+    benchVoices(context);
+    benchFft(context);
+    benchGpuSynth(context);
+    benchClapChains(context);
+}
+
+}  // namespace tobi::bench
@@ -0,0 +1,130 @@
+#include "Bench.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace tobi::bench {
+
+namespace {
+
+auto percentile(std::vector<double> const& sorted, double p) -> double {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto const index = static_cast<std::size_t>(std::ceil(p * (sorted.size() - 1)));
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+auto formatSize(uint64_t size) -> std::string {
+    if (size >= 1024 * 1024 and size % (1024 * 1024) == 0) {
+        return fmt::format("{} MB", size / (1024 * 1024));
+    }
+    if (size >= 1024 and size % 1024 == 0) {
+        return fmt::format("{} KB", size / 1024);
+    }
+    return fmt::format("{}", size);
+}
+
+}  // namespace
+
+auto summarize(std::vector<double> samples) -> Summary {
+    std::sort(samples.begin(), samples.end());
+    if (samples.empty()) {
+        return {};
+    }
+    return {
+        samples.front(),
+        percentile(samples, 0.50),
+        percentile(samples, 0.90),
+        percentile(samples, 0.99),
+        samples.back(),
+    };
+}
+
+auto throughput(Result const& result, double seconds) -> double {
+    if (seconds <= 0.0) {
+        return 0.0;
+    }
+
+    auto scale = 1.0;
+    if (result.unit.starts_with("G")) {
+        scale = 1e9;
+    } else if (result.unit.starts_with("M")) {
+        scale = 1e6;
+    } else if (result.unit.starts_with("k")) {
+        scale = 1e3;
+    }
+    return result.work / seconds / scale;
+}
+
+auto Report::add(Result result) -> void {
+    _results.push_back(std::move(result));
+}
+
+auto Report::fail(std::string message) -> void {
+    fmt::println("FAILED: {}", message);
+    _failures.push_back(std::move(message));
+}
+
+auto Report::failures() const -> std::vector<std::string> const& {
+    return _failures;
+}
+
+auto Report::print() const -> void {
+    fmt::println("{:<32} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>14}", "benchmark", "size",
+                 "min us", "p50 us", "p90 us", "p99 us", "max us", "p50 rate");
+    for (auto const& result : _results) {
+        auto const s = summarize(result.samples);
+        auto const rate = result.unit.empty()
+                              ? std::string{"-"}
+                              : fmt::format("{:.3f} {}", throughput(result, s.p50), result.unit);
+        fmt::println("{:<32} {:>8} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>14}",
+                     result.name, formatSize(result.size), s.min * 1e6, s.p50 * 1e6, s.p90 * 1e6,
+                     s.p99 * 1e6, s.max * 1e6, rate);
+    }
+}
+
+auto Report::toJson(std::string_view device) const -> std::string {
+    auto json = fmt::format(R"({{"device":{},"results":[)", device);
+    for (auto i = std::size_t{0}; i < _results.size(); ++i) {
+        auto const& result = _results[i];
+        auto const s = summarize(result.samples);
+        json += fmt::format(
+            R"({}{{"name":"{}","size":{},"iterations":{},"min_us":{:.3f},"p50_us":{:.3f},)"
+            R"("p90_us":{:.3f},"p99_us":{:.3f},"max_us":{:.3f},"throughput":{:.6f},"unit":"{}"}})",
+            i == 0 ? "" : ",", result.name, result.size, result.samples.size(), s.min * 1e6,
+            s.p50 * 1e6, s.p90 * 1e6, s.p99 * 1e6, s.max * 1e6, throughput(result, s.p50),
+            result.unit);
+    }
+    json += "]}\n";
+    return json;
+}
+
+auto Context::enabled(std::string_view name) const -> bool {
+    return options.filter.empty() or name.find(options.filter) != std::string_view::npos;
+}
+
+auto Context::sizes() const -> std::vector<uint64_t> {
+    auto maxSize = options.maxSize;
+    auto limits = wgpu::SupportedLimits{};
+    if (device and device.GetLimits(&limits)) {
+        maxSize = std::min({maxSize, limits.limits.maxBufferSize,
+                            limits.limits.maxStorageBufferBindingSize});
+    }
+
+    auto sizes = std::vector<uint64_t>{};
+    for (auto size = options.minSize; size <= maxSize; size *= 4) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+auto Context::iterations(uint64_t size) const -> int {
+    static constexpr auto bytesPerCase = uint64_t{2} * 1024 * 1024 * 1024;
+    auto const fit = static_cast<int>(std::min<uint64_t>(bytesPerCase / size, 1 << 20));
+    return std::clamp(fit, std::min(5, options.iterations), options.iterations);
+}
+
+}  // namespace tobi::bench
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct clap_plugin_entry;
+
+namespace tobi::gpu {
+struct EventPump;
+struct PipelineCache;
+}
+
+namespace tobi::bench {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string filter{};
+    std::string jsonPath{};
+    uint64_t minSize{4 * 1024};
+    uint64_t maxSize{256 * 1024 * 1024};
+    int iterations{50};
+    bool swiftshader{false};
+    wgpu::BackendType backend{wgpu::BackendType::Undefined};
+};
+
+struct Summary {
+    double min{0.0};
+    double p50{0.0};
+    double p90{0.0};
+    double p99{0.0};
+    double max{0.0};
+};
+
+// One benchmark case. Samples are seconds per iteration, work is the amount processed by one
+// iteration in unit, e.g. bytes for "GB/s" or elements for "Gelem/s".
+struct Result {
+    std::string name{};
+    uint64_t size{0};
+    std::vector<double> samples{};
+    double work{0.0};
+    std::string unit{};
+};
+
+[[nodiscard]] auto summarize(std::vector<double> samples) -> Summary;
+
+// Scales work / seconds into the magnitude the unit prefix implies.
+[[nodiscard]] auto throughput(Result const& result, double seconds) -> double;
+
+struct Report {
+    auto add(Result result) -> void;
+
+    // Records a failed correctness check and prints it. main() exits with a failure status if
+    // any check failed, so the bench doubles as a regression test.
+    auto fail(std::string message) -> void;
+    [[nodiscard]] auto failures() const -> std::vector<std::string> const&;
+
+    auto print() const -> void;
+    // Device is a JSON object describing where the results were measured.
+    [[nodiscard]] auto toJson(std::string_view device) const -> std::string;
+
+  private:
+    std::vector<Result> _results{};
+    std::vector<std::string> _failures{};
+};
+
+struct Context {
+    Options options{};
+    wgpu::Instance instance{};
+    wgpu::Device device{};
+    gpu::EventPump* pump{nullptr};
+    gpu::PipelineCache* pipelines{nullptr};  // shared by the Algorithms and ArrayEngine cases
+    Report* report{nullptr};
+
+    [[nodiscard]] auto enabled(std::string_view name) const -> bool;
+
+    // Sizes from options.minSize to options.maxSize in steps of four, clamped to the device.
+    [[nodiscard]] auto sizes() const -> std::vector<uint64_t>;
+
+    // Fewer iterations for large sizes, so every case takes roughly the same time.
+    [[nodiscard]] auto iterations(uint64_t size) const -> int;
+};
+
+// Runs fn once to warm up, then the given number of times.
+template <typename Fn>
+[[nodiscard]] auto measure(int iterations, Fn&& fn) -> std::vector<double> {
+    fn();
+
+    auto samples = std::vector<double>{};
+    samples.reserve(static_cast<std::size_t>(iterations));
+    for (auto i = 0; i < iterations; ++i) {
+        auto const start = Clock::now();
+        fn();
+        samples.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return samples;
+}
+
+auto runGpuSuite(Context& context) -> void;
+auto runAlgorithmsSuite(Context& context) -> void;
+auto runAudioSuite(Context& context) -> void;
+
+// Statically linked CLAP plugins for the host benchmarks, see TestPlugin.cpp.
+[[nodiscard]] auto testPluginEntry() -> clap_plugin_entry const&;
+
+}  // namespace tobi::bench
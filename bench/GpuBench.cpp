@@ -0,0 +1,599 @@
+#include "Bench.hpp"
+
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/BufferPool.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/Graph.hpp>
+#include <tobi/Layout.hpp>
+#include <tobi/ParallelRecorder.hpp>
+#include <tobi/PipelineCache.hpp>
+#include <tobi/Readback.hpp>
+#include <tobi/StreamExecutor.hpp>
+#include <tobi/ThreadPool.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace tobi::bench {
+
+namespace {
+
+constexpr auto const* AddShader = R"(
+    @group(0) @binding(0) var<storage, read> lhs: array<f32>;
+    @group(0) @binding(1) var<storage, read> rhs: array<f32>;
+    @group(0) @binding(2) var<storage, read_write> out: array<f32>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(global_invocation_id) id: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index : u32 = id.x + id.y * groups.x * {{workgroup_size}}u;
+        if (index >= arrayLength(&out)) {
+            return;
+        }
+        out[index] = lhs[index] + rhs[index];
+    }
+)";
+
+constexpr auto const* EmptyShader = R"(
+    @group(0) @binding(0) var<storage, read_write> out: array<u32>;
+
+    @compute @workgroup_size(1)
+    fn main() {
+        out[0] = out[0] + 1u;
+    }
+)";
+
+constexpr auto const* ScaleShader = R"(
+    @group(0) @binding(0) var<storage, read> input: array<f32>;
+    @group(0) @binding(1) var<storage, read_write> output: array<f32>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(global_invocation_id) id: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index : u32 = id.x + id.y * groups.x * {{workgroup_size}}u;
+        if (index >= arrayLength(&output)) {
+            return;
+        }
+        output[index] = input[index] * 2.0 + 1.0;
+    }
+)";
+
+constexpr auto const* CounterShader = R"(
+    @compute @workgroup_size(1)
+    fn main() {
+        out[0] = out[0] + 1u;
+    }
+)";
+
+struct CounterBindings : gpu::Layout<gpu::Dynamic<gpu::ReadWrite<"out", uint32_t>>> {};
+
+auto createBuffer(wgpu::Device const& device, uint64_t size, wgpu::BufferUsage usage)
+    -> wgpu::Buffer {
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = size;
+    descriptor.usage = usage;
+    return device.CreateBuffer(&descriptor);
+}
+
+auto submit(wgpu::Device const& device, wgpu::CommandEncoder const& encoder) -> void {
+    auto commands = encoder.Finish();
+    device.GetQueue().Submit(1, &commands);
+}
+
+auto benchUpload(Context& context) -> void {
+    auto const& device = context.device;
+    auto queue = device.GetQueue();
+    auto const usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst;
+
+    for (auto const size : context.sizes()) {
+        auto const data = std::vector<std::byte>(size, std::byte{1});
+        auto buffer = createBuffer(device, size, usage);
+
+        if (context.enabled("upload/write-buffer")) {
+            auto samples = measure(context.iterations(size), [&] {
+                queue.WriteBuffer(buffer, 0, data.data(), size);
+                gpu::waitForQueue(device);
+            });
+            context.report->add({"upload/write-buffer", size, std::move(samples),
+                                 static_cast<double>(size), "GB/s"});
+        }
+
+        if (context.enabled("upload/staging-ring")) {
+            auto staging = gpu::StagingRing{device};
+            auto samples = measure(context.iterations(size), [&] {
+                auto encoder = device.CreateCommandEncoder();
+                staging.upload(encoder, buffer, 0, data.data(), size);
+                staging.finish();
+                submit(device, encoder);
+                staging.recycle();
+                gpu::waitForQueue(device);
+            });
+            context.report->add({"upload/staging-ring", size, std::move(samples),
+                                 static_cast<double>(size), "GB/s"});
+        }
+    }
+}
+
+auto benchDispatch(Context& context) -> void {
+    if (not context.enabled("dispatch/")) {
+        return;
+    }
+
+    auto const& device = context.device;
+    auto buffer = createBuffer(device, 256, wgpu::BufferUsage::Storage);
+    auto kernel = gpu::Kernel{device, EmptyShader, "main", {1}};
+    auto const bindings = kernel.createBindings({{.binding = 0, .buffer = buffer}});
+
+    auto record = [&] {
+        auto encoder = device.CreateCommandEncoder();
+        auto pass = encoder.BeginComputePass();
+        kernel.dispatch(pass, bindings, 1);
+        pass.End();
+        return encoder.Finish();
+    };
+
+    auto queue = device.GetQueue();
+    auto const iterations = context.options.iterations * 4;
+
+    // Round trip of a single submit, including the wait for completion.
+    auto roundTrip = measure(iterations, [&] {
+        auto commands = record();
+        queue.Submit(1, &commands);
+        gpu::waitForQueue(device);
+    });
+    context.report->add({"dispatch/round-trip", 0, std::move(roundTrip), 1.0, "k/s"});
+
+    // Back-to-back submits, the CPU cost per submit once the queue is kept busy.
+    static constexpr auto batch = 64;
+    auto batched = measure(context.options.iterations, [&] {
+        for (auto i = 0; i < batch; ++i) {
+            auto commands = record();
+            queue.Submit(1, &commands);
+        }
+        gpu::waitForQueue(device);
+    });
+    for (auto& sample : batched) {
+        sample /= batch;
+    }
+    context.report->add({"dispatch/per-submit", 0, std::move(batched), 1.0, "k/s"});
+}
+
+// Creating a kernel with four workgroup size variants, compiled every time and taken from a
+// PipelineCache warmed up with the kernel's manifest. The warm case must not miss the cache.
+auto benchPipelineCache(Context& context) -> void {
+    if (not context.enabled("pipeline-cache/")) {
+        return;
+    }
+
+    auto const& device = context.device;
+    auto const iterations = std::min(context.options.iterations, 5);
+    auto uncached = measure(iterations, [&] {
+        auto const kernel = gpu::Kernel{device, ScaleShader};
+    });
+    context.report->add({"pipeline-cache/uncached", 0, std::move(uncached), 1.0, "k/s"});
+
+    auto cache = gpu::PipelineCache{device};
+    auto const candidates = std::vector<uint32_t>{32, 64, 128, 256};
+    auto const manifest = gpu::Kernel::manifest(device, ScaleShader, "main", candidates);
+    cache.warmup(manifest);
+    auto const warmed = cache.stats();
+    if (warmed.stores != manifest.size()) {
+        context.report->fail(fmt::format("pipeline-cache/warm-up compiled {} of {} pipelines",
+                                         warmed.stores, manifest.size()));
+    }
+
+    auto warm = measure(iterations, [&] {
+        auto const kernel = gpu::Kernel{device, ScaleShader, "main", candidates, {}, &cache};
+    });
+    context.report->add({"pipeline-cache/warm", 0, std::move(warm), 1.0, "k/s"});
+
+    auto const stats = cache.stats();
+    if (stats.misses != warmed.misses or stats.hits == warmed.hits) {
+        context.report->fail(fmt::format("pipeline-cache/warm missed the cache {} times",
+                                         stats.misses - warmed.misses));
+    }
+}
+
+// CPU cost of getting the bind group for one dispatch over one of many sub-allocations of a
+// buffer: created every time, looked up in the cache, or one cached group with dynamic offsets.
+auto benchBindGroups(Context& context) -> void {
+    if (not context.enabled("bind-group/")) {
+        return;
+    }
+
+    static constexpr auto slices = 64;
+    static constexpr uint64_t sliceSize = gpu::BufferPool::minSlotSize;
+
+    auto const& device = context.device;
+    auto buffer = createBuffer(device, slices * sliceSize, wgpu::BufferUsage::Storage);
+    auto const entry = [&](int i) {
+        return wgpu::BindGroupEntry{
+            .binding = 0, .buffer = buffer, .offset = i * sliceSize, .size = sliceSize};
+    };
+
+    auto kernel = gpu::Kernel{device, EmptyShader, "main", {1}};
+    auto const layout = kernel.pipeline(1).GetBindGroupLayout(0);
+
+    auto layouts = gpu::LayoutCache{device};
+    auto const dynamicLayout = layouts.bindGroupLayout<CounterBindings>();
+    auto dynamicKernel = gpu::Kernel{device, CounterBindings::wgsl() + CounterShader, "main",
+                                     {1}, layouts.pipelineLayout<CounterBindings>()};
+
+    auto const perGroup = [](std::vector<double> samples) {
+        for (auto& sample : samples) {
+            sample /= slices;
+        }
+        return samples;
+    };
+
+    if (context.enabled("bind-group/create")) {
+        auto samples = measure(context.options.iterations, [&] {
+            for (auto i = 0; i < slices; ++i) {
+                auto const e = entry(i);
+                auto descriptor = wgpu::BindGroupDescriptor{};
+                descriptor.layout = layout;
+                descriptor.entryCount = 1;
+                descriptor.entries = &e;
+                (void)device.CreateBindGroup(&descriptor);
+            }
+        });
+        context.report->add({"bind-group/create", 0, perGroup(std::move(samples)), 1.0, "k/s"});
+    }
+
+    if (context.enabled("bind-group/cached")) {
+        auto cache = gpu::BindGroupCache{device};
+        auto samples = measure(context.options.iterations, [&] {
+            for (auto i = 0; i < slices; ++i) {
+                auto const e = entry(i);
+                (void)cache.get(layout, {&e, 1});
+            }
+        });
+        context.report->add({"bind-group/cached", 0, perGroup(std::move(samples)), 1.0, "k/s"});
+
+        auto const stats = cache.stats();
+        if (stats.misses != slices) {
+            context.report->fail(fmt::format("bind-group/cached created {} groups for {} bindings",
+                                             stats.misses, slices));
+        }
+        fmt::println("bind-group/cached: hit rate {:.1f}%", stats.hitRate() * 100.0);
+    }
+
+    if (context.enabled("bind-group/dynamic")) {
+        auto cache = gpu::BindGroupCache{device};
+        auto queue = device.GetQueue();
+        auto samples = measure(context.options.iterations, [&] {
+            auto encoder = device.CreateCommandEncoder();
+            auto pass = encoder.BeginComputePass();
+            for (auto i = 0; i < slices; ++i) {
+                auto const slice = gpu::BufferSlice{buffer, i * sliceSize, sliceSize};
+                auto const group = cache.dynamic(dynamicLayout, {&slice, 1});
+                auto const bindings = dynamicKernel.createBindings(group.group, group.offsets);
+                dynamicKernel.dispatch(pass, bindings, 1);
+            }
+            pass.End();
+            auto commands = encoder.Finish();
+            queue.Submit(1, &commands);
+        });
+        gpu::waitForQueue(device);
+        context.report->add({"bind-group/dynamic", 0, perGroup(std::move(samples)), 1.0, "k/s"});
+
+        if (cache.size() != 1) {
+            context.report->fail(
+                fmt::format("bind-group/dynamic created {} groups for one buffer", cache.size()));
+        }
+    }
+}
+
+// A chain of small kernels through intermediate buffers: one encoder and submit per kernel with a
+// buffer per step, and as a graph with one pass, one submit and aliased transients. The input is
+// zero and every kernel computes x * 2 + 1, so the output is 2^steps - 1.
+auto benchGraph(Context& context) -> void {
+    if (not context.enabled("graph/")) {
+        return;
+    }
+
+    static constexpr auto steps = 16;
+    static constexpr uint32_t count = 4096;
+    static constexpr uint64_t size = count * sizeof(float);
+
+    auto const& device = context.device;
+    auto queue = device.GetQueue();
+    auto const usage =
+        wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst;
+    auto input = createBuffer(device, size, usage);
+    auto output = createBuffer(device, size, usage);
+    auto const zeros = std::vector<float>(count, 0.0F);
+    queue.WriteBuffer(input, 0, zeros.data(), size);
+    auto kernel = gpu::Kernel{device, ScaleShader};
+
+    auto const verify = [&](std::string_view name) {
+        auto pending = gpu::readback(*context.pump, output, 0, size);
+        auto const bytes = gpu::wait(*context.pump, pending);
+        auto result = std::vector<float>(count);
+        std::memcpy(result.data(), bytes.data(), size);
+        auto const expected = static_cast<float>((1U << steps) - 1);
+        if (std::any_of(result.begin(), result.end(), [&](float v) { return v != expected; })) {
+            context.report->fail(fmt::format("{} does not compute the chain", name));
+        }
+    };
+
+    if (context.enabled("graph/submit-each")) {
+        auto buffers = std::vector<wgpu::Buffer>{input};
+        auto bindings = std::vector<gpu::Kernel::Bindings>{};
+        for (auto i = 0; i < steps; ++i) {
+            auto next = i + 1 == steps ? output : createBuffer(device, size, usage);
+            bindings.push_back(kernel.createBindings({
+                {.binding = 0, .buffer = buffers.back(), .offset = 0, .size = size},
+                {.binding = 1, .buffer = next, .offset = 0, .size = size},
+            }));
+            buffers.push_back(next);
+        }
+
+        auto samples = measure(context.options.iterations, [&] {
+            for (auto const& b : bindings) {
+                auto encoder = device.CreateCommandEncoder();
+                auto pass = encoder.BeginComputePass();
+                kernel.dispatch(pass, b, count);
+                pass.End();
+                submit(device, encoder);
+            }
+            gpu::waitForQueue(device);
+        });
+        context.report->add({"graph/submit-each", size, std::move(samples), steps, "k/s"});
+        verify("graph/submit-each");
+    }
+
+    if (context.enabled("graph/one-submit")) {
+        auto graph = gpu::Graph{device};
+        auto previous = graph.external({input, 0, size});
+        for (auto i = 1; i < steps; ++i) {
+            auto const next = graph.transient(size);
+            graph.dispatch(kernel, {graph.read(previous), graph.write(next)}, count);
+            previous = next;
+        }
+        auto const last = graph.external({output, 0, size});
+        graph.dispatch(kernel, {graph.read(previous), graph.write(last)}, count);
+
+        auto samples = measure(context.options.iterations, [&] {
+            graph.execute();
+            gpu::waitForQueue(device);
+        });
+        context.report->add({"graph/one-submit", size, std::move(samples), steps, "k/s"});
+        verify("graph/one-submit");
+
+        auto const stats = graph.stats();
+        fmt::println("graph/one-submit: {} passes, {} transient buffers, {} of {} bytes saved",
+                     stats.passes, stats.transientBuffers, stats.transientBytesSaved(),
+                     stats.transientBytesRequested);
+        if (stats.passes != 1 or stats.transientBuffers != 2 or
+            stats.submits != stats.executions) {
+            context.report->fail("graph/one-submit did not batch the chain");
+        }
+    }
+}
+
+// Recording throughput of many small jobs, each building its bind group in the thread's scratch
+// arena and dispatching a few times, on 1, 2, 4, ... threads. Every frame is one Submit.
+auto benchRecording(Context& context) -> void {
+    if (not context.enabled("record/")) {
+        return;
+    }
+
+    static constexpr uint32_t jobs = 256;
+    static constexpr auto dispatchesPerJob = 8;
+    static constexpr uint64_t bufferSize = 256;
+
+    auto const& device = context.device;
+    auto const usage =
+        wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst;
+    auto buffer = createBuffer(device, bufferSize, usage);
+    auto kernel = gpu::Kernel{device, EmptyShader, "main", {1}};
+    auto const& pipeline = kernel.pipeline(1);
+    auto const layout = pipeline.GetBindGroupLayout(0);
+
+    auto const job = [&](uint32_t, wgpu::CommandEncoder const& encoder, ScratchArena& arena) {
+        auto entries = arena.make<wgpu::BindGroupEntry>(1);
+        entries[0].binding = 0;
+        entries[0].buffer = buffer;
+        entries[0].size = bufferSize;
+        auto& descriptor = arena.make<wgpu::BindGroupDescriptor>(1)[0];
+        descriptor.layout = layout;
+        descriptor.entryCount = entries.size();
+        descriptor.entries = entries.data();
+        auto const group = device.CreateBindGroup(&descriptor);
+
+        auto pass = encoder.BeginComputePass();
+        pass.SetPipeline(pipeline);
+        pass.SetBindGroup(0, group);
+        for (auto i = 0; i < dispatchesPerJob; ++i) {
+            pass.DispatchWorkgroups(1);
+        }
+        pass.End();
+    };
+
+    auto threads = std::vector<uint32_t>{};
+    for (auto n = 1U; n <= ThreadPool::defaultWorkers() + 1; n *= 2) {
+        threads.push_back(n);
+    }
+    if (threads.back() != ThreadPool::defaultWorkers() + 1) {
+        threads.push_back(ThreadPool::defaultWorkers() + 1);
+    }
+
+    for (auto const n : threads) {
+        auto const name = fmt::format("record/threads-{}", n);
+        if (not context.enabled(name)) {
+            continue;
+        }
+
+        auto pool = ThreadPool{n - 1};
+        auto recorder = gpu::ParallelRecorder{device, pool};
+        auto samples = measure(context.options.iterations, [&] { recorder.submit(jobs, job); });
+        gpu::waitForQueue(device);
+        context.report->add({name, 0, std::move(samples), jobs, "k/s"});
+
+        auto const stats = recorder.stats();
+        if (stats.submits != stats.frames or stats.jobs != stats.frames * jobs) {
+            context.report->fail(fmt::format("{} did not submit every frame at once", name));
+        }
+    }
+
+    // Job j copies the value left by its predecessor into trace[j], then leaves j behind, so
+    // trace[j] == j - 1 only if the command buffers ran in job order.
+    if (context.enabled("record/order")) {
+        auto const size = uint64_t{jobs} * sizeof(uint32_t);
+        auto values = std::vector<uint32_t>(jobs);
+        std::iota(values.begin(), values.end(), 0U);
+        auto const last = std::vector<uint32_t>{~0U};
+        auto source = createBuffer(device, size, usage);
+        auto trace = createBuffer(device, size, usage);
+        auto carry = createBuffer(device, sizeof(uint32_t), usage);
+        device.GetQueue().WriteBuffer(source, 0, values.data(), size);
+        device.GetQueue().WriteBuffer(carry, 0, last.data(), sizeof(uint32_t));
+
+        auto pool = ThreadPool{};
+        auto recorder = gpu::ParallelRecorder{device, pool};
+        recorder.submit(jobs, [&](uint32_t j, wgpu::CommandEncoder const& encoder, ScratchArena&) {
+            encoder.CopyBufferToBuffer(carry, 0, trace, j * sizeof(uint32_t), sizeof(uint32_t));
+            encoder.CopyBufferToBuffer(source, j * sizeof(uint32_t), carry, 0, sizeof(uint32_t));
+        });
+
+        auto pending = gpu::readback(*context.pump, trace, 0, size);
+        auto const bytes = gpu::wait(*context.pump, pending);
+        auto result = std::vector<uint32_t>(jobs);
+        std::memcpy(result.data(), bytes.data(), size);
+        for (auto j = uint32_t{0}; j < jobs; ++j) {
+            if (result[j] != j - 1) {
+                context.report->fail(
+                    fmt::format("record/order job {} ran after job {}", j, result[j]));
+                break;
+            }
+        }
+    }
+}
+
+auto benchKernel(Context& context) -> void {
+    if (not context.enabled("kernel/add")) {
+        return;
+    }
+
+    auto const& device = context.device;
+    auto const usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst;
+    auto kernel = gpu::Kernel{device, AddShader};
+
+    for (auto const size : context.sizes()) {
+        auto const count = static_cast<uint32_t>(size / sizeof(float));
+        auto lhs = createBuffer(device, size, usage);
+        auto rhs = createBuffer(device, size, usage);
+        auto out = createBuffer(device, size, usage);
+        auto const bindings = kernel.createBindings({
+            {.binding = 0, .buffer = lhs, .size = size},
+            {.binding = 1, .buffer = rhs, .size = size},
+            {.binding = 2, .buffer = out, .size = size},
+        });
+        kernel.tune(bindings, count);
+
+        // Several dispatches per submit hide the submit overhead measured above.
+        static constexpr auto dispatches = 8;
+        auto samples = measure(context.iterations(size * 3), [&] {
+            auto encoder = device.CreateCommandEncoder();
+            auto pass = encoder.BeginComputePass();
+            for (auto i = 0; i < dispatches; ++i) {
+                kernel.dispatch(pass, bindings, count);
+            }
+            pass.End();
+            submit(device, encoder);
+            gpu::waitForQueue(device);
+        });
+        for (auto& sample : samples) {
+            sample /= dispatches;
+        }
+        context.report->add(
+            {"kernel/add", size, std::move(samples), static_cast<double>(count), "Gelem/s"});
+    }
+}
+
+auto benchReadback(Context& context) -> void {
+    if (not context.enabled("readback/")) {
+        return;
+    }
+
+    auto const& device = context.device;
+    auto const usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc;
+    for (auto const size : context.sizes()) {
+        auto buffer = createBuffer(device, size, usage);
+        auto samples = measure(context.iterations(size), [&] {
+            auto result = gpu::readback(*context.pump, buffer, 0, size);
+            auto const data = gpu::wait(*context.pump, result);
+        });
+        context.report->add(
+            {"readback/latency", size, std::move(samples), static_cast<double>(size), "GB/s"});
+    }
+}
+
+// A dataset several times larger than one chunk through the streaming executor, in memory so
+// the disk stays out of the measurement. Work is the input size, stages are printed separately.
+auto benchStream(Context& context) -> void {
+    if (not context.enabled("stream/")) {
+        return;
+    }
+    if (not gpu::isThreadSafe(context.device)) {
+        fmt::println("stream/: skipped, the device is not thread-safe");
+        return;
+    }
+
+    auto const total = std::max<uint64_t>(context.options.maxSize, 16 * 1024 * 1024) / 4 * 4;
+    auto input = std::vector<float>(total / sizeof(float));
+    for (auto i = std::size_t{0}; i < input.size(); ++i) {
+        input[i] = static_cast<float>(i % 1024);
+    }
+    auto output = std::vector<float>(input.size());
+    auto const in = std::as_bytes(std::span{input});
+    auto const out = std::as_writable_bytes(std::span{output});
+
+    for (auto const chunk : {uint64_t{4} << 20U, uint64_t{16} << 20U, uint64_t{64} << 20U}) {
+        if (chunk * 2 > total) {
+            continue;
+        }
+        auto executor =
+            gpu::StreamExecutor{*context.pump, ScaleShader, {.maxChunkBytes = chunk}};
+        auto stats = gpu::StreamStats{};
+        auto samples = measure(std::min(context.options.iterations, 5),
+                               [&] { stats = executor.run(in, out); });
+
+        for (auto i = std::size_t{0}; i < input.size(); i += 4093) {
+            if (output[i] != input[i] * 2.0F + 1.0F) {
+                context.report->fail(
+                    fmt::format("stream/chunk-{} element {} is {}", chunk, i, output[i]));
+                break;
+            }
+        }
+        fmt::println("stream/chunk {} MB: host write {:.2f}, copy in {:.2f}, compute {:.2f}, "
+                     "copy out {:.2f}, host read {:.2f} GB/s",
+                     executor.chunkBytes() >> 20U, stats.hostWrite.rate(), stats.copyIn.rate(),
+                     stats.compute.rate(), stats.copyOut.rate(), stats.hostRead.rate());
+        context.report->add({"stream/chunk", executor.chunkBytes(), std::move(samples),
+                             static_cast<double>(total), "GB/s"});
+    }
+}
+
+}  // namespace
+
+auto runGpuSuite(Context& context) -> void {
+    benchUpload(context);
+    benchDispatch(context);
+    benchPipelineCache(context);
+    benchBindGroups(context);
+    benchGraph(context);
+    benchRecording(context);
+    benchKernel(context);
+    benchReadback(context);
+    benchStream(context);
+}
+
+}  // namespace tobi::bench
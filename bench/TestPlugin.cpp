@@ -0,0 +1,207 @@
+#include "Bench.hpp"
+
+#include <clap/clap.h>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <string_view>
+#include <vector>
+
+namespace tobi::bench {
+
+namespace {
+
+// Additive oscillator added on top of its input. The harmonics are split into tasks that go
+// through the host's thread-pool extension; each task writes its own buffer and the buffers are
+// summed in task order, so the output is bit-identical however the host schedules them.
+constexpr auto harmonics = uint32_t{16};
+constexpr auto tasks = uint32_t{8};
+
+struct Additive {
+    clap_plugin_t plugin{};
+    clap_host_t const* host{nullptr};
+    clap_host_thread_pool_t const* hostPool{nullptr};
+    double frequency{0.0};
+    double sampleRate{0.0};
+    int64_t steadyTime{0};
+    uint32_t frames{0};
+    std::array<std::vector<float>, tasks> partials{};
+};
+
+auto self(clap_plugin_t const* plugin) -> Additive& {
+    return *static_cast<Additive*>(plugin->plugin_data);
+}
+
+auto runTask(Additive& additive, uint32_t task) -> void {
+    static constexpr auto perTask = harmonics / tasks;
+    auto& partial = additive.partials[task];
+    for (auto i = uint32_t{0}; i < additive.frames; ++i) {
+        auto const t = static_cast<double>(additive.steadyTime + i) / additive.sampleRate;
+        auto sum = 0.0;
+        for (auto h = task * perTask + 1; h <= (task + 1) * perTask; ++h) {
+            sum += std::sin(2.0 * std::numbers::pi * additive.frequency * h * t) / h;
+        }
+        partial[i] = static_cast<float>(0.05 * sum);
+    }
+}
+
+constexpr auto threadPoolExtension = clap_plugin_thread_pool_t{
+    [](clap_plugin_t const* plugin, uint32_t task) { runTask(self(plugin), task); },
+};
+
+constexpr auto audioPortsExtension = clap_plugin_audio_ports_t{
+    [](clap_plugin_t const* /*plugin*/, bool /*isInput*/) -> uint32_t { return 1; },
+    [](clap_plugin_t const* /*plugin*/, uint32_t index, bool isInput,
+       clap_audio_port_info_t* info) -> bool {
+        if (index != 0) {
+            return false;
+        }
+        *info = clap_audio_port_info_t{};
+        info->id = 0;
+        std::strncpy(info->name, isInput ? "in" : "out", sizeof(info->name) - 1);
+        info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+        info->channel_count = 2;
+        info->port_type = CLAP_PORT_STEREO;
+        info->in_place_pair = CLAP_INVALID_ID;
+        return true;
+    },
+};
+
+auto process(clap_plugin_t const* plugin, clap_process_t const* process) -> clap_process_status {
+    auto& additive = self(plugin);
+    additive.steadyTime = process->steady_time;
+    additive.frames = process->frames_count;
+
+    if (additive.hostPool == nullptr or
+        not additive.hostPool->request_exec(additive.host, tasks)) {
+        for (auto task = uint32_t{0}; task < tasks; ++task) {
+            runTask(additive, task);
+        }
+    }
+
+    auto* const* out = process->audio_outputs[0].data32;
+    auto const* const* in =
+        process->audio_inputs_count > 0 ? process->audio_inputs[0].data32 : nullptr;
+    for (auto i = uint32_t{0}; i < additive.frames; ++i) {
+        auto sum = 0.0F;
+        for (auto const& partial : additive.partials) {
+            sum += partial[i];
+        }
+        for (auto ch = 0; ch < 2; ++ch) {
+            out[ch][i] = (in != nullptr ? in[ch][i] : 0.0F) + sum;
+        }
+    }
+    return CLAP_PROCESS_CONTINUE;
+}
+
+constexpr auto features =
+    std::array<char const*, 2>{CLAP_PLUGIN_FEATURE_AUDIO_EFFECT, nullptr};
+
+constexpr auto frequencies = std::array{110.0, 165.0, 220.0, 330.0};
+
+auto makeDescriptors() -> std::array<clap_plugin_descriptor_t, frequencies.size()> {
+    static constexpr auto ids = std::array{"tobi.bench.additive-110", "tobi.bench.additive-165",
+                                           "tobi.bench.additive-220", "tobi.bench.additive-330"};
+    auto descriptors = std::array<clap_plugin_descriptor_t, frequencies.size()>{};
+    for (auto i = std::size_t{0}; i < descriptors.size(); ++i) {
+        auto& descriptor = descriptors[i];
+        descriptor.clap_version = CLAP_VERSION_INIT;
+        descriptor.id = ids[i];
+        descriptor.name = ids[i];
+        descriptor.vendor = "tobi";
+        descriptor.url = "";
+        descriptor.manual_url = "";
+        descriptor.support_url = "";
+        descriptor.version = "0.1.0";
+        descriptor.description = "Additive oscillator using the thread-pool extension";
+        descriptor.features = features.data();
+    }
+    return descriptors;
+}
+
+auto descriptors() -> std::array<clap_plugin_descriptor_t, frequencies.size()> const& {
+    static auto const instance = makeDescriptors();
+    return instance;
+}
+
+auto createPlugin(clap_plugin_factory_t const* /*factory*/,
+                  clap_host_t const* host,
+                  char const* id) -> clap_plugin_t const* {
+    for (auto i = std::size_t{0}; i < descriptors().size(); ++i) {
+        if (std::string_view{descriptors()[i].id} != id) {
+            continue;
+        }
+
+        auto* additive = new Additive{};
+        additive->host = host;
+        additive->frequency = frequencies[i];
+
+        auto& plugin = additive->plugin;
+        plugin.desc = &descriptors()[i];
+        plugin.plugin_data = additive;
+        plugin.init = [](clap_plugin_t const* p) -> bool {
+            auto& a = self(p);
+            a.hostPool = static_cast<clap_host_thread_pool_t const*>(
+                a.host->get_extension(a.host, CLAP_EXT_THREAD_POOL));
+            return true;
+        };
+        plugin.destroy = [](clap_plugin_t const* p) { delete &self(p); };
+        plugin.activate = [](clap_plugin_t const* p, double sampleRate, uint32_t /*minFrames*/,
+                             uint32_t maxFrames) -> bool {
+            auto& a = self(p);
+            a.sampleRate = sampleRate;
+            for (auto& partial : a.partials) {
+                partial.assign(maxFrames, 0.0F);
+            }
+            return true;
+        };
+        plugin.deactivate = [](clap_plugin_t const* /*p*/) {};
+        plugin.start_processing = [](clap_plugin_t const* /*p*/) -> bool { return true; };
+        plugin.stop_processing = [](clap_plugin_t const* /*p*/) {};
+        plugin.reset = [](clap_plugin_t const* /*p*/) {};
+        plugin.process = process;
+        plugin.get_extension = [](clap_plugin_t const* /*p*/,
+                                  char const* extension) -> void const* {
+            if (std::strcmp(extension, CLAP_EXT_THREAD_POOL) == 0) {
+                return &threadPoolExtension;
+            }
+            if (std::strcmp(extension, CLAP_EXT_AUDIO_PORTS) == 0) {
+                return &audioPortsExtension;
+            }
+            return nullptr;
+        };
+        plugin.on_main_thread = [](clap_plugin_t const* /*p*/) {};
+        return &plugin;
+    }
+    return nullptr;
+}
+
+constexpr auto factory = clap_plugin_factory_t{
+    [](clap_plugin_factory_t const* /*factory*/) -> uint32_t {
+        return static_cast<uint32_t>(frequencies.size());
+    },
+    [](clap_plugin_factory_t const* /*factory*/,
+       uint32_t index) -> clap_plugin_descriptor_t const* {
+        return index < descriptors().size() ? &descriptors()[index] : nullptr;
+    },
+    createPlugin,
+};
+
+constexpr auto entry = clap_plugin_entry_t{
+    CLAP_VERSION_INIT,
+    [](char const* /*path*/) -> bool { return true; },
+    [] {},
+    [](char const* id) -> void const* {
+        return std::strcmp(id, CLAP_PLUGIN_FACTORY_ID) == 0 ? &factory : nullptr;
+    },
+};
+
+}  // namespace
+
+auto testPluginEntry() -> clap_plugin_entry const& {
+    return entry;
+}
+
+}  // namespace tobi::bench
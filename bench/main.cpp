@@ -0,0 +1,102 @@
+#include "Bench.hpp"
+
+#include <tobi/Capabilities.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/PipelineCache.hpp>
+#include <tobi/Readback.hpp>
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string_view>
+
+namespace {
+
+auto usage() -> void {
+    fmt::println("usage: bench [--filter <substring>] [--json <path>] [--iterations <n>]");
+    fmt::println("             [--min-size <bytes>] [--max-size <bytes>] [--swiftshader]");
+    fmt::println("             [--backend d3d12|metal|vulkan|d3d11|opengl|opengles]");
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> int {
+    auto options = tobi::bench::Options{};
+    for (auto i = 1; i < argc; ++i) {
+        auto const arg = std::string_view{argv[i]};
+        auto const hasValue = i + 1 < argc;
+        if (arg == "--filter" and hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--json" and hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--iterations" and hasValue) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--min-size" and hasValue) {
+            options.minSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-size" and hasValue) {
+            options.maxSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--swiftshader") {
+            options.swiftshader = true;
+        } else if (arg == "--backend" and hasValue and tobi::gpu::parseBackend(argv[i + 1])) {
+            options.backend = *tobi::gpu::parseBackend(argv[++i]);
+        } else {
+            usage();
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.minSize < 4 or options.minSize % 4 != 0 or options.iterations < 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    auto instance = wgpu::CreateInstance(nullptr);
+    auto deviceOptions = tobi::gpu::DeviceOptions{};
+    deviceOptions.forceFallbackAdapter = options.swiftshader;
+    deviceOptions.backend = options.backend;
+    auto device = tobi::gpu::getDefaultDevice(instance, deviceOptions);
+    if (not device) {
+        return EXIT_FAILURE;
+    }
+    device.SetUncapturedErrorCallback(tobi::gpu::errorCallback, nullptr);
+
+    auto const capabilities = tobi::gpu::capabilities(device);
+    fmt::println("Adapter: {} ({}, {})", capabilities.name,
+                 tobi::gpu::toString(capabilities.backend),
+                 tobi::gpu::toString(capabilities.adapterType));
+
+    auto pump = tobi::gpu::EventPump{device};
+    auto pipelines = tobi::gpu::PipelineCache{device};
+    auto report = tobi::bench::Report{};
+    auto context = tobi::bench::Context{
+        .options = options,
+        .instance = instance,
+        .device = device,
+        .pump = &pump,
+        .pipelines = &pipelines,
+        .report = &report,
+    };
+
+    tobi::bench::runGpuSuite(context);
+    tobi::bench::runAlgorithmsSuite(context);
+    tobi::bench::runAudioSuite(context);
+
+    auto const pipelineStats = pipelines.stats();
+    fmt::println("Pipelines: {} compiled, {} cache hits", pipelineStats.misses, pipelineStats.hits);
+
+    report.print();
+    if (not options.jsonPath.empty()) {
+        auto file = std::ofstream{options.jsonPath};
+        file << report.toJson(capabilities.toJson());
+    }
+
+    if (auto const& failures = report.failures(); not failures.empty()) {
+        fmt::println("{} checks FAILED:", failures.size());
+        for (auto const& failure : failures) {
+            fmt::println("  {}", failure);
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
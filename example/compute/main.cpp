@@ -1,134 +1,164 @@
+#include <tobi/Array.hpp>
+#include <tobi/BufferPool.hpp>
 #include <tobi/GPU.hpp>
+#include <tobi/Graph.hpp>
+#include <tobi/Layout.hpp>
+#include <tobi/PipelineCache.hpp>
+#include <tobi/Readback.hpp>
+#include <tobi/StreamExecutor.hpp>
 
 #include <fmt/format.h>
 #include <fmt/os.h>
 
-#if defined(__EMSCRIPTEN__)
-#include <emscripten.h>
-#endif
-
-#include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <string_view>
 
-static constexpr auto const* ShaderCode = R"(
-    @group(0) @binding(0) var<storage, read> lhs: array<f32>;
-    @group(0) @binding(1) var<storage, read> rhs: array<f32>;
-    @group(0) @binding(2) var<storage, read_write> out: array<f32>;
+struct AddBindings : tobi::gpu::Layout<tobi::gpu::ReadOnly<"lhs", float>,
+                                       tobi::gpu::ReadOnly<"rhs", float>,
+                                       tobi::gpu::ReadWrite<"out", float>> {};
 
-    @compute @workgroup_size(1)
-    fn main(@builtin(global_invocation_id) id: vec3<u32>) {
-        let index : u32 = id.x;
+static constexpr auto const* ShaderCode = R"(
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(global_invocation_id) id: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index : u32 = id.x + id.y * groups.x * {{workgroup_size}}u;
+        if (index >= arrayLength(&out)) {
+            return;
+        }
         out[index] = lhs[index] + rhs[index];
     }
 )";
 
-auto main(int, char**) -> int {
+static constexpr auto const* StreamShaderCode = R"(
+    @group(0) @binding(0) var<storage, read> input: array<f32>;
+    @group(0) @binding(1) var<storage, read_write> output: array<f32>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(global_invocation_id) id: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index : u32 = id.x + id.y * groups.x * {{workgroup_size}}u;
+        if (index >= arrayLength(&output)) {
+            return;
+        }
+        output[index] = sqrt(abs(input[index]));
+    }
+)";
+
+// Streams a file of raw float32 values through the GPU, however large, into another file.
+static auto stream(tobi::gpu::EventPump& pump, char const* input, char const* output) -> int {
+    auto executor = tobi::gpu::StreamExecutor{pump, StreamShaderCode};
+    auto const stats = executor.run(input, output);
+
+    auto const stage = [](char const* name, tobi::gpu::StreamStage const& s) {
+        fmt::println("{:>10}: {:8.3f} s busy, {:6.2f} GB/s", name, s.seconds, s.rate());
+    };
+    fmt::println("{} chunks of {} MB in {:.3f} s, {:.2f} GB/s", stats.chunks,
+                 stats.chunkBytes >> 20U, stats.wallSeconds, stats.throughput());
+    stage("host write", stats.hostWrite);
+    stage("copy in", stats.copyIn);
+    stage("compute", stats.compute);
+    stage("copy out", stats.copyOut);
+    stage("host read", stats.hostRead);
+    return EXIT_SUCCESS;
+}
+
+auto main(int argc, char** argv) -> int {
+    auto const streaming = argc == 4 and std::string_view{argv[1]} == "--stream";
+    if (argc != 1 and not streaming) {
+        fmt::println("usage: compute [--stream <input.f32> <output.f32>]");
+        return EXIT_FAILURE;
+    }
+
     auto instance = wgpu::CreateInstance(nullptr);
-    auto device = tobi::gpu::getDefaultDevice(instance);
+    auto cache = tobi::gpu::BlobCache{"shader-cache"};
+    auto device = tobi::gpu::getDefaultDevice(instance, {.cache = &cache});
     if (not device) {
         return EXIT_FAILURE;
     }
 
     device.SetUncapturedErrorCallback(tobi::gpu::errorCallback, nullptr);
 
+    if (streaming) {
+        auto pump = tobi::gpu::EventPump{device};
+        return stream(pump, argv[2], argv[3]);
+    }
+
     wgpu::Queue queue = device.GetQueue();
 
     // Create buffers
-    const size_t dataSizeInBytes = 1024 * sizeof(float);
-    auto dataLHS = std::vector<float>(1024, 1.0f);
-    auto dataRHS = std::vector<float>(1024, 2.0f);
-    auto dataOut = std::vector<float>(1024, 0.0f);
-
-    auto buffer = wgpu::BufferDescriptor{};
-    buffer.size = dataSizeInBytes;
-    buffer.usage =
-        wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc;
-
-    auto lhs = device.CreateBuffer(&buffer);
-    auto rhs = device.CreateBuffer(&buffer);
-    auto out = device.CreateBuffer(&buffer);
+    const uint32_t elementCount = 1024;
+    const size_t dataSizeInBytes = elementCount * sizeof(float);
+    auto dataLHS = std::vector<float>(elementCount, 1.0f);
+    auto dataRHS = std::vector<float>(elementCount, 2.0f);
+    auto dataOut = std::vector<float>(elementCount, 0.0f);
 
-    queue.WriteBuffer(lhs, 0, dataLHS.data(), dataSizeInBytes);
-    queue.WriteBuffer(rhs, 0, dataRHS.data(), dataSizeInBytes);
+    auto pump = tobi::gpu::EventPump{device};
+    auto pool = tobi::gpu::BufferPool{device};
+    auto staging = tobi::gpu::StagingRing{device};
 
-    auto shaderModule = tobi::gpu::createShaderModule(device, ShaderCode);
+    auto const usage =
+        wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc;
 
-    // Create the pipeline
-    wgpu::ComputePipelineDescriptor pipelineDesc;
-    pipelineDesc.compute.module = shaderModule;
-    pipelineDesc.compute.entryPoint = "main";
-    wgpu::ComputePipeline pipeline = device.CreateComputePipeline(&pipelineDesc);
+    auto lhs = pool.allocate(dataSizeInBytes, usage);
+    auto rhs = pool.allocate(dataSizeInBytes, usage);
+    // Bound as writable storage, so it must not share a buffer with lhs and rhs
+    auto out = pool.allocate(dataSizeInBytes, usage, tobi::gpu::BufferPool::Placement::Dedicated);
 
-    wgpu::BindGroupLayout bindGroupLayout = pipeline.GetBindGroupLayout(0);
+    // The binding declarations and the explicit layout both come from AddBindings
+    auto layouts = tobi::gpu::LayoutCache{device};
+    auto const source = AddBindings::wgsl() + ShaderCode;
+    auto kernel = tobi::gpu::Kernel{device, source, "main", {32, 64, 128, 256},
+                                    layouts.pipelineLayout<AddBindings>()};
 
     // Create the bind group
-    wgpu::BindGroupEntry bgEntries[3];
-    bgEntries[0].binding = 0;
-    bgEntries[0].buffer = lhs;
-    bgEntries[0].offset = 0;
-    bgEntries[0].size = dataSizeInBytes;
-
-    bgEntries[1].binding = 1;
-    bgEntries[1].buffer = rhs;
-    bgEntries[1].offset = 0;
-    bgEntries[1].size = dataSizeInBytes;
-
-    bgEntries[2].binding = 2;
-    bgEntries[2].buffer = out;
-    bgEntries[2].offset = 0;
-    bgEntries[2].size = dataSizeInBytes;
-
-    auto bindGroupDesc = wgpu::BindGroupDescriptor{};
-    bindGroupDesc.layout = bindGroupLayout;
-    bindGroupDesc.entryCount = 3;
-    bindGroupDesc.entries = bgEntries;
-    wgpu::BindGroup bindGroup = device.CreateBindGroup(&bindGroupDesc);
-
-    // Create command buffer
+    auto bindings = kernel.createBindings(layouts.bindGroup<AddBindings>(lhs, rhs, out));
+    fmt::println("Workgroup size: {}", kernel.tune(bindings, elementCount));
+
+    // The kernel and the copy into a mappable buffer, compiled into one pass and one copy
+    auto const mappable = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst;
+    auto host = pool.allocate(dataSizeInBytes, mappable);
+    auto graph = tobi::gpu::Graph{device};
+    auto const a = graph.external(lhs);
+    auto const b = graph.external(rhs);
+    auto const c = graph.external(out);
+    graph.dispatch(kernel, {graph.read(a), graph.read(b), graph.write(c)}, elementCount);
+    graph.copy(c, graph.external(host));
+
+    // Upload through the staging ring, in the same submit as the graph
     wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
-    wgpu::ComputePassEncoder pass = encoder.BeginComputePass();
-    pass.SetPipeline(pipeline);
-    pass.SetBindGroup(0, bindGroup);
-    pass.DispatchWorkgroups(1024, 1, 1);
-    pass.End();
+    staging.upload(encoder, lhs.buffer, lhs.offset, dataLHS.data(), dataSizeInBytes);
+    staging.upload(encoder, rhs.buffer, rhs.offset, dataRHS.data(), dataSizeInBytes);
+    staging.finish();
+    graph.record(encoder);
 
     wgpu::CommandBuffer commands = encoder.Finish();
     queue.Submit(1, &commands);
-
-    // Read the dataOut
-    wgpu::BufferDescriptor readbackDesc;
-    readbackDesc.size = dataSizeInBytes;
-    readbackDesc.usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead;
-    wgpu::Buffer readbackBuffer = device.CreateBuffer(&readbackDesc);
-
-    encoder = device.CreateCommandEncoder();
-    encoder.CopyBufferToBuffer(out, 0, readbackBuffer, 0, dataSizeInBytes);
-    commands = encoder.Finish();
-    queue.Submit(1, &commands);
-
-    auto done = false;
-    readbackBuffer.MapAsync(
-        wgpu::MapMode::Read, 0, dataSizeInBytes,
-        [](WGPUBufferMapAsyncStatus status, void* userdata) {
-            assert(status == WGPUBufferMapAsyncStatus_Success);
-            *static_cast<bool*>(userdata) = true;
-        },
-        static_cast<void*>(&done));
-
-    while (not done) {
-#if not defined(__EMSCRIPTEN__)
-        // Tick needs to be called in Dawn to display validation errors
-        device.Tick();
-        instance.ProcessEvents();
-#else
-        emscripten_sleep(2);
-#endif
+    staging.recycle();
+
+    // Read the dataOut, the pump thread services the map while this thread is free to record
+    auto result = tobi::gpu::readback(pump, host.buffer, host.offset, dataSizeInBytes);
+    auto const bytes = tobi::gpu::wait(pump, result);
+    std::memcpy(dataOut.data(), bytes.data(), dataSizeInBytes);
+
+    // The same inputs through a lazy expression, fused into a single generated kernel
+    auto arrays = tobi::gpu::ArrayEngine{device};
+    auto const x = arrays.wrap(lhs, elementCount);
+    auto const y = arrays.wrap(rhs, elementCount);
+    auto const mean = sum(sqrt(x * x + y * y)) / static_cast<float>(elementCount);
+    fmt::println("Mean norm: {}", arrays.read(pump, mean)[0]);
+
+    for (auto const& slice : {lhs, rhs, out, host}) {
+        pool.release(slice);
     }
 
-    const void* mappedData = readbackBuffer.GetConstMappedRange();
-    std::memcpy(dataOut.data(), mappedData, dataSizeInBytes);
-    readbackBuffer.Unmap();
+    auto const stats = pool.stats();
+    fmt::println("Buffers created: {}, reuse rate: {:.2f}, fragmentation: {:.2f}",
+                 stats.buffersCreated, stats.reuseRate(), stats.externalFragmentation());
+
+    auto const cacheStats = cache.stats();
+    fmt::println("Shader cache hits: {}, misses: {}", cacheStats.hits, cacheStats.misses);
 
     // Print dataOut
     for (size_t i = 0; i < 10; ++i) {
@@ -1,13 +1,301 @@
 #include <tobi/AudioDevice.hpp>
+#include <tobi/ClapHost.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/GpuSynth.hpp>
+#include <tobi/OfflineRenderer.hpp>
+#include <tobi/SpectrumAnalyzer.hpp>
 #include <tobi/Window.hpp>
 
-#include <clap/clap.h>
+#include <fmt/format.h>
 
+#include "imgui.h"
+
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+auto usage() -> void {
+    fmt::println("usage: render [--headless] [--frames <n>] [--size <width> <height>]");
+    fmt::println("              [--capture <directory>] [--raw]");
+    fmt::println("              [--present-mode fifo|mailbox|immediate] [--frames-in-flight <n>]");
+    fmt::println("              [--on-demand] [--plugin <file.clap>]... [--plugin-workers <n>]");
+    fmt::println("              [--null-audio] [--audio-period <frames>]");
+    fmt::println("              [--render-audio <file.wav|file.f32>]... [--seconds <s>]");
+    fmt::println("              [--gpu-synth] [--reverb <seconds>] [--swiftshader]");
+}
+
+auto gpuSynthPanel(tobi::audio::GpuSynth& synth) -> void {
+    static auto pitch = 0.0F;
+
+    ImGui::Begin("GPU Synth");
+    if (ImGui::SliderFloat("Pitch", &pitch, -24.0F, 24.0F, "%.1f st")) {
+        for (auto v = uint32_t{0}; v < 64; ++v) {
+            auto const semitones = static_cast<float>(v % 48) + pitch;
+            synth.setVoice(v, 55.0F * std::exp2(semitones / 12.0F), 0.5F / 64.0F);
+        }
+    }
+
+    auto const stats = synth.stats();
+    auto const& roundTrip = synth.roundTrip();
+    ImGui::Text("Latency %.1f ms, round trip p50 %.2f p99 %.2f max %.2f ms", synth.latency(),
+                roundTrip.percentile(0.5), roundTrip.percentile(0.99), roundTrip.max());
+    ImGui::Text("GPU blocks %llu, CPU fallback %llu, missed %llu",
+                static_cast<unsigned long long>(stats.gpuBlocks),
+                static_cast<unsigned long long>(stats.fallbackBlocks),
+                static_cast<unsigned long long>(stats.missedBlocks));
+    ImGui::End();
+}
+
+auto analyzerPanel(tobi::AudioDevice& audio, tobi::audio::SpectrumAnalyzer& analyzer) -> void {
+    if (not audio.isInitialized()) {
+        return;
+    }
+    analyzer.analyze(audio.snapshot());
+
+    ImGui::Begin("Analyzer");
+    analyzer.draw();
+    ImGui::End();
+}
+
+// Every plugin gets its own chain, so they run in parallel.
+auto makeHost(std::vector<std::string_view> const& plugins, uint32_t workers)
+    -> std::unique_ptr<tobi::ClapHost> {
+    if (plugins.empty()) {
+        return nullptr;
+    }
+    auto host = std::make_unique<tobi::ClapHost>(workers);
+    for (auto const plugin : plugins) {
+        host->add(host->addChain(), tobi::ClapPlugin::load(plugin));
+    }
+    return host;
+}
+
+// One job per file, each at its own pitch. The jobs are the parallelism here, so their plugin
+// hosts run single-threaded.
+auto renderAudio(std::vector<std::filesystem::path> const& files,
+                 double seconds,
+                 std::vector<std::string_view> const& plugins) -> void {
+    auto jobs = std::vector<tobi::OfflineJob>{};
+    for (auto const& file : files) {
+        auto job = tobi::OfflineJob{};
+        job.path = file;
+        job.format = file.extension() == ".wav" ? tobi::AudioFileFormat::Wav
+                                                : tobi::AudioFileFormat::Raw;
+        job.seconds = seconds;
+        job.device = [&plugins, frequency = 220.0F * static_cast<float>(jobs.size() + 1)] {
+            auto device = std::make_unique<tobi::AudioDevice>(tobi::AudioDeviceOptions{},
+                                                              makeHost(plugins, 0));
+            (void)device->setFrequency(frequency);
+            return device;
+        };
+        jobs.push_back(std::move(job));
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    auto const results = tobi::renderOffline(jobs);
+    auto const wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    for (auto i = std::size_t{0}; i < jobs.size(); ++i) {
+        fmt::println("{}: {:.1f} s of audio in {:.3f} s, {:.1f}x realtime", jobs[i].path.string(),
+                     seconds, results[i].wallSeconds, results[i].realtimeFactor());
+    }
+    fmt::println("total: {:.1f}x realtime",
+                 seconds * static_cast<double>(jobs.size()) / wall.count());
+}
+
+auto audioPanel(tobi::AudioDevice& audio, tobi::Window& window) -> void {
+    static auto frequency = 440.0F;
+    static auto amplitude = 0.2F;
+    static auto muted = false;
+    static auto meters = tobi::AudioMeters{};
+
+    ImGui::Begin("Audio");
+    if (not audio.isInitialized()) {
+        if (ImGui::Button("Enable Audio")) {
+            audio.initialized();
+        }
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::SliderFloat("Frequency", &frequency, 20.0F, 20000.0F, "%.1f Hz",
+                           ImGuiSliderFlags_Logarithmic)) {
+        audio.setFrequency(frequency);
+    }
+    if (ImGui::SliderFloat("Amplitude", &amplitude, 0.0F, 1.0F)) {
+        audio.setAmplitude(amplitude);
+    }
+    if (ImGui::Checkbox("Mute", &muted)) {
+        audio.setMuted(muted);
+    }
+
+    if (auto latest = audio.pollMeters()) {
+        meters = *latest;
+    }
+    ImGui::ProgressBar(meters.peak[0], ImVec2{-1, 0}, "L");
+    ImGui::ProgressBar(meters.peak[1], ImVec2{-1, 0}, "R");
+    ImGui::Text("RMS %.3f / %.3f", meters.rms[0], meters.rms[1]);
+    ImGui::Text("Frames %llu, dropped commands %u",
+                static_cast<unsigned long long>(meters.framesProcessed), meters.droppedCommands);
+
+    if (ImGui::CollapsingHeader("Callback")) {
+        auto const stats = audio.callbackStats();
+        ImGui::Text("Budget %.0f us, p50 %.1f p99 %.1f worst %.1f us", stats.budget, stats.p50,
+                    stats.p99, stats.worst);
+        ImGui::Text("Load p99 %.1f%%, worst %.1f%%",
+                    stats.budget > 0.0 ? 100.0 * stats.p99 / stats.budget : 0.0,
+                    stats.budget > 0.0 ? 100.0 * stats.worst / stats.budget : 0.0);
+        ImGui::Text("Callbacks %llu, deadline misses %llu, xruns %llu",
+                    static_cast<unsigned long long>(stats.callbacks),
+                    static_cast<unsigned long long>(stats.deadlineMisses),
+                    static_cast<unsigned long long>(stats.xruns));
+        auto const counts = audio.callbackTime().counts();
+        ImGui::PlotHistogram("Time", counts.data(), static_cast<int>(counts.size()), 0, nullptr,
+                             0.0F, 3.4e38F, ImVec2{0, 40});
+        if (ImGui::Button("Reset")) {
+            audio.resetCallbackStats();
+        }
+    }
+    ImGui::End();
+
+    // Meters change without input, keep redrawing while audio runs.
+    window.animateFor(std::chrono::milliseconds{100});
+}
 
-int main(int, char**) {
-    auto audioDevice = tobi::AudioDevice{};
-    auto window = tobi::Window{};
+}  // namespace
+
+int main(int argc, char** argv) {
+    auto options = tobi::WindowOptions{};
+    auto plugins = std::vector<std::string_view>{};
+    auto pluginWorkers = tobi::ThreadPool::defaultWorkers();
+    auto audioOptions = tobi::AudioDeviceOptions{};
+    auto audioFiles = std::vector<std::filesystem::path>{};
+    auto audioSeconds = 10.0;
+    auto gpuSynth = false;
+    auto reverbSeconds = 1.0;
+    auto swiftshader = false;
+    for (auto i = 1; i < argc; ++i) {
+        auto const arg = std::string_view{argv[i]};
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" and i + 1 < argc) {
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--size" and i + 2 < argc) {
+            options.width = std::atoi(argv[++i]);
+            options.height = std::atoi(argv[++i]);
+        } else if (arg == "--capture" and i + 1 < argc) {
+            options.captureDirectory = argv[++i];
+        } else if (arg == "--raw") {
+            options.captureFormat = tobi::FrameFormat::Raw;
+        } else if (arg == "--present-mode" and i + 1 < argc) {
+            auto const mode = std::string_view{argv[++i]};
+            if (mode == "mailbox") {
+                options.presentMode = wgpu::PresentMode::Mailbox;
+            } else if (mode == "immediate") {
+                options.presentMode = wgpu::PresentMode::Immediate;
+            } else {
+                options.presentMode = wgpu::PresentMode::Fifo;
+            }
+        } else if (arg == "--on-demand") {
+            options.redrawOnDemand = true;
+        } else if (arg == "--frames-in-flight" and i + 1 < argc) {
+            options.framesInFlight = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--plugin" and i + 1 < argc) {
+            plugins.emplace_back(argv[++i]);
+        } else if (arg == "--plugin-workers" and i + 1 < argc) {
+            pluginWorkers = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--null-audio") {
+            audioOptions.backend = tobi::AudioBackend::Null;
+        } else if (arg == "--audio-period" and i + 1 < argc) {
+            audioOptions.periodFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--render-audio" and i + 1 < argc) {
+            audioFiles.emplace_back(argv[++i]);
+        } else if (arg == "--seconds" and i + 1 < argc) {
+            audioSeconds = std::atof(argv[++i]);
+        } else if (arg == "--gpu-synth") {
+            gpuSynth = true;
+        } else if (arg == "--reverb" and i + 1 < argc) {
+            reverbSeconds = std::atof(argv[++i]);
+        } else if (arg == "--swiftshader") {
+            swiftshader = true;
+        } else {
+            usage();
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.width < 1 or options.height < 1 or (gpuSynth and not plugins.empty())) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    auto host = std::unique_ptr<tobi::ClapHost>{};
+    try {
+        if (not audioFiles.empty()) {
+            renderAudio(audioFiles, audioSeconds, plugins);
+            return EXIT_SUCCESS;
+        }
+        host = makeHost(plugins, pluginWorkers);
+    } catch (std::runtime_error const& error) {
+        fmt::println("{}", error.what());
+        return EXIT_FAILURE;
+    }
+
+    // The synth gets a device of its own, so its dispatches never queue behind a frame.
+    auto source = std::unique_ptr<tobi::audio::Node>{std::move(host)};
+    auto* clapHost = static_cast<tobi::ClapHost*>(source.get());
+    auto* synth = static_cast<tobi::audio::GpuSynth*>(nullptr);
+    if (gpuSynth) {
+        auto instance = wgpu::CreateInstance(nullptr);
+        auto device = tobi::gpu::getDefaultDevice(
+            instance, {.forceFallbackAdapter = swiftshader, .cache = nullptr});
+        if (not device) {
+            return EXIT_FAILURE;
+        }
+        device.SetUncapturedErrorCallback(tobi::gpu::errorCallback, nullptr);
+
+        auto synthOptions = tobi::audio::GpuSynthOptions{};
+        if (reverbSeconds > 0.0) {
+            synthOptions.impulse = tobi::audio::GpuSynth::syntheticImpulse(
+                reverbSeconds, tobi::AudioDevice::sampleRate);
+        }
+        source = std::make_unique<tobi::audio::GpuSynth>(device, std::move(synthOptions));
+        synth = static_cast<tobi::audio::GpuSynth*>(source.get());
+        clapHost = nullptr;
+    }
+
+    auto audioDevice = tobi::AudioDevice{audioOptions, std::move(source)};
+    // Nothing to hear on the null backend, start it right away so headless runs are measured.
+    if (audioOptions.backend == tobi::AudioBackend::Null) {
+        audioDevice.initialized();
+    }
+
+    auto analyzer = tobi::audio::SpectrumAnalyzer{};
+    auto window = tobi::Window{options};
+    window.onGui([&] {
+        if (clapHost != nullptr) {
+            clapHost->idle();
+        }
+        if (synth != nullptr) {
+            gpuSynthPanel(*synth);
+        }
+        audioPanel(audioDevice, window);
+        analyzerPanel(audioDevice, analyzer);
+    });
     window.show();
+
+    if (audioDevice.isInitialized()) {
+        auto const stats = audioDevice.callbackStats();
+        fmt::println("audio callbacks: {}, budget {:.0f} us, p50 {:.1f} us, p99 {:.1f} us, "
+                     "worst {:.1f} us, deadline misses {}, xruns {}",
+                     stats.callbacks, stats.budget, stats.p50, stats.p99, stats.worst,
+                     stats.deadlineMisses, stats.xruns);
+    }
     return EXIT_SUCCESS;
 }
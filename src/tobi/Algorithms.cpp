@@ -0,0 +1,632 @@
+#include "Algorithms.hpp"
+
+#include <tobi/Capabilities.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string_view>
+
+namespace tobi::gpu {
+
+namespace {
+
+// All kernels share the parameter block and index their workgroups in two dimensions, see
+// dispatchGrid().
+constexpr auto const* Common = R"(
+    alias T = {{type}};
+
+    struct Params {
+        count: u32,
+        shift: u32,
+        blocks: u32,
+        flags: u32,
+    }
+
+    fn groupIndex(wid: vec3<u32>, groups: vec3<u32>) -> u32 {
+        return wid.x + wid.y * groups.x;
+    }
+)";
+
+constexpr auto const* ReduceShader = R"(
+    @group(0) @binding(0) var<storage, read> input: array<T>;
+    @group(0) @binding(1) var<storage, read_write> output: array<T>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    var<workgroup> scratch: array<T, {{workgroup_size}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let group = groupIndex(wid, groups);
+        let base = group * {{workgroup_size}}u * {{items}}u + lid.x;
+
+        var sum = T(0);
+        for (var i = 0u; i < {{items}}u; i++) {
+            let index = base + i * {{workgroup_size}}u;
+            if (index < params.count) {
+                sum += input[index];
+            }
+        }
+        scratch[lid.x] = sum;
+        workgroupBarrier();
+
+        for (var stride = {{workgroup_size}}u / 2u; stride > 0u; stride >>= 1u) {
+            if (lid.x < stride) {
+                scratch[lid.x] += scratch[lid.x + stride];
+            }
+            workgroupBarrier();
+        }
+
+        // The 2D grid can contain padding workgroups past the last block.
+        let first = group * {{workgroup_size}}u * {{items}}u;
+        if (lid.x == 0u && (group == 0u || first < params.count)) {
+            output[group] = scratch[0];
+        }
+    }
+)";
+
+constexpr auto const* ScanBlocksShader = R"(
+    @group(0) @binding(0) var<storage, read> input: array<T>;
+    @group(0) @binding(1) var<storage, read_write> output: array<T>;
+    @group(0) @binding(2) var<storage, read_write> sums: array<T>;
+    @group(0) @binding(3) var<uniform> params: Params;
+
+    var<workgroup> scratch: array<T, {{workgroup_size}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let group = groupIndex(wid, groups);
+        let index = group * {{workgroup_size}}u + lid.x;
+
+        var value = T(0);
+        if (index < params.count) {
+            value = input[index];
+        }
+        scratch[lid.x] = value;
+        workgroupBarrier();
+
+        // Hillis-Steele inclusive scan
+        for (var offset = 1u; offset < {{workgroup_size}}u; offset <<= 1u) {
+            var add = T(0);
+            if (lid.x >= offset) {
+                add = scratch[lid.x - offset];
+            }
+            workgroupBarrier();
+            scratch[lid.x] += add;
+            workgroupBarrier();
+        }
+
+        if (index < params.count) {
+            var exclusive = T(0);
+            if (lid.x > 0u) {
+                exclusive = scratch[lid.x - 1u];
+            }
+            output[index] = exclusive;
+        }
+        if (lid.x == {{workgroup_size}}u - 1u && group < params.blocks) {
+            sums[group] = scratch[lid.x];
+        }
+    }
+)";
+
+constexpr auto const* AddOffsetsShader = R"(
+    @group(0) @binding(0) var<storage, read_write> output: array<T>;
+    @group(0) @binding(1) var<storage, read> offsets: array<T>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let group = groupIndex(wid, groups);
+        let index = group * {{workgroup_size}}u + lid.x;
+        if (index < params.count) {
+            output[index] += offsets[group];
+        }
+    }
+)";
+
+// flags: 1 = f32 to ordered u32, 2 = ordered u32 to f32, 3 = flip the sign bit of i32
+constexpr auto const* KeyTransformShader = R"(
+    @group(0) @binding(0) var<storage, read_write> keys: array<u32>;
+    @group(0) @binding(1) var<uniform> params: Params;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index = groupIndex(wid, groups) * {{workgroup_size}}u + lid.x;
+        if (index >= params.count) {
+            return;
+        }
+
+        let key = keys[index];
+        switch params.flags {
+            case 1u: {
+                keys[index] = select(key | 0x80000000u, ~key, (key & 0x80000000u) != 0u);
+            }
+            case 2u: {
+                keys[index] = select(~key, key & 0x7fffffffu, (key & 0x80000000u) != 0u);
+            }
+            default: {
+                keys[index] = key ^ 0x80000000u;
+            }
+        }
+    }
+)";
+
+constexpr auto const* HistogramShader = R"(
+    @group(0) @binding(0) var<storage, read> keys: array<u32>;
+    @group(0) @binding(1) var<storage, read_write> histogram: array<u32>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    var<workgroup> counts: array<atomic<u32>, {{radix}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let block = groupIndex(wid, groups);
+        if (lid.x < {{radix}}u) {
+            atomicStore(&counts[lid.x], 0u);
+        }
+        workgroupBarrier();
+
+        let index = block * {{workgroup_size}}u + lid.x;
+        if (index < params.count) {
+            let digit = (keys[index] >> params.shift) & ({{radix}}u - 1u);
+            atomicAdd(&counts[digit], 1u);
+        }
+        workgroupBarrier();
+
+        // Digit major, so one exclusive scan yields every block's scatter base per digit.
+        if (lid.x < {{radix}}u && block < params.blocks) {
+            histogram[lid.x * params.blocks + block] = atomicLoad(&counts[lid.x]);
+        }
+    }
+)";
+
+constexpr auto const* ScatterShader = R"(
+    @group(0) @binding(0) var<storage, read> keysIn: array<u32>;
+    @group(0) @binding(1) var<storage, read_write> keysOut: array<u32>;
+    @group(0) @binding(2) var<storage, read> valuesIn: array<u32>;
+    @group(0) @binding(3) var<storage, read_write> valuesOut: array<u32>;
+    @group(0) @binding(4) var<storage, read> offsets: array<u32>;
+    @group(0) @binding(5) var<uniform> params: Params;
+
+    var<workgroup> digits: array<u32, {{workgroup_size}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let block = groupIndex(wid, groups);
+        let index = block * {{workgroup_size}}u + lid.x;
+
+        var key = 0u;
+        var digit = {{radix}}u;
+        if (index < params.count) {
+            key = keysIn[index];
+            digit = (key >> params.shift) & ({{radix}}u - 1u);
+        }
+        digits[lid.x] = digit;
+        workgroupBarrier();
+
+        if (index >= params.count) {
+            return;
+        }
+
+        // Rank among equal digits of lower lanes keeps the sort stable.
+        var rank = 0u;
+        for (var i = 0u; i < lid.x; i++) {
+            rank += select(0u, 1u, digits[i] == digit);
+        }
+
+        let target = offsets[digit * params.blocks + block] + rank;
+        keysOut[target] = key;
+        if (params.flags != 0u) {
+            valuesOut[target] = valuesIn[index];
+        }
+    }
+)";
+
+// Packed kernels move quads of four elements, loaded and stored through the snippets of
+// wgslLoad() and wgslStore().
+constexpr auto const* PackedCommon = R"(
+    {{enable}}
+    alias real = {{real}};
+
+    struct Params {
+        count: u32,
+        quads: u32,
+        blocks: u32,
+        flags: u32,
+        decode: vec2<f32>,
+        encode: vec2<f32>,
+    }
+
+    fn groupIndex(wid: vec3<u32>, groups: vec3<u32>) -> u32 {
+        return wid.x + wid.y * groups.x;
+    }
+)";
+
+constexpr auto const* PackedMapShader = R"(
+    @group(0) @binding(0) var<storage, read> input: array<{{input}}>;
+    @group(0) @binding(1) var<storage, read_write> output: array<{{output}}>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    fn apply(x: vec4<real>) -> vec4<real> {
+        return {{expression}};
+    }
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let quad = groupIndex(wid, groups) * {{workgroup_size}}u + lid.x;
+        if (quad >= params.quads) {
+            return;
+        }
+        store(quad, vec4<f32>(apply(vec4<real>(load(quad)))));
+    }
+)";
+
+constexpr auto const* PackedReduceShader = R"(
+    @group(0) @binding(0) var<storage, read> input: array<{{input}}>;
+    @group(0) @binding(1) var<storage, read_write> output: array<f32>;
+    @group(0) @binding(2) var<uniform> params: Params;
+
+    var<workgroup> scratch: array<f32, {{workgroup_size}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let group = groupIndex(wid, groups);
+        let base = group * {{workgroup_size}}u * {{items}}u + lid.x;
+
+        var sum = vec4<f32>(0.0);
+        for (var i = 0u; i < {{items}}u; i++) {
+            let quad = base + i * {{workgroup_size}}u;
+            if (quad < params.quads) {
+                let lanes = vec4<u32>(quad * 4u) + vec4<u32>(0u, 1u, 2u, 3u);
+                sum += select(vec4<f32>(0.0), load(quad), lanes < vec4<u32>(params.count));
+            }
+        }
+        scratch[lid.x] = sum.x + sum.y + sum.z + sum.w;
+        workgroupBarrier();
+
+        for (var stride = {{workgroup_size}}u / 2u; stride > 0u; stride >>= 1u) {
+            if (lid.x < stride) {
+                scratch[lid.x] += scratch[lid.x + stride];
+            }
+            workgroupBarrier();
+        }
+
+        let first = group * {{workgroup_size}}u * {{items}}u * 4u;
+        if (lid.x == 0u && (group == 0u || first < params.count)) {
+            output[group] = scratch[0];
+        }
+    }
+)";
+
+auto replaceAll(std::string str, std::string_view from, std::string_view to) -> std::string {
+    auto pos = str.find(from);
+    while (pos != std::string::npos) {
+        str.replace(pos, from.size(), to);
+        pos = str.find(from, pos + to.size());
+    }
+    return str;
+}
+
+auto blocks(uint32_t count, uint32_t perBlock) -> uint32_t {
+    return (count + perBlock - 1) / perBlock;
+}
+
+auto packedParams(uint32_t count, Quantization decode, Quantization encode)
+    -> std::vector<uint32_t> {
+    return {
+        count,
+        blocks(count, 4),
+        0,
+        0,
+        std::bit_cast<uint32_t>(decode.scale),
+        std::bit_cast<uint32_t>(decode.offset),
+        std::bit_cast<uint32_t>(1.0F / encode.scale),
+        std::bit_cast<uint32_t>(encode.offset),
+    };
+}
+
+}  // namespace
+
+auto wgslName(ScalarType type) -> char const* {
+    switch (type) {
+        case ScalarType::U32:
+            return "u32";
+        case ScalarType::I32:
+            return "i32";
+        case ScalarType::F32:
+            return "f32";
+    }
+    return "u32";
+}
+
+Algorithms::Algorithms(wgpu::Device device, PipelineCache* pipelines)
+    : _device{std::move(device)},
+      _pipelines{pipelines},
+      _bindGroups{_device},
+      _pool{_device, 1024 * 1024} {
+    _pool.attach(&_bindGroups);
+}
+
+auto Algorithms::reduce(ScalarType type,
+                        BufferSlice const& input,
+                        uint32_t count,
+                        BufferSlice const& output) -> void {
+    auto call = Call{};
+    auto const& k = kernel("reduce", type);
+    auto const perGroup = workgroupSize * reduceItemsPerThread;
+
+    auto current = input;
+    auto n = count;
+    do {
+        auto const groups = std::max(blocks(n, perGroup), 1U);
+        auto const target = groups == 1 ? output : scratch(call, uint64_t{groups} * 4);
+        dispatch(call, k, {current, target, params(call, {n, 0, 0, 0})}, groups * workgroupSize);
+        current = target;
+        n = groups;
+    } while (n > 1);
+
+    submit(call);
+}
+
+auto Algorithms::exclusiveScan(ScalarType type,
+                               BufferSlice const& input,
+                               BufferSlice const& output,
+                               uint32_t count) -> void {
+    if (count == 0) {
+        return;
+    }
+
+    auto call = Call{};
+    scan(call, type, input, output, count);
+    submit(call);
+}
+
+auto Algorithms::sort(ScalarType keyType,
+                      BufferSlice const& keys,
+                      uint32_t count,
+                      BufferSlice const* payload) -> void {
+    static constexpr auto radix = 1U << radixBits;
+    static constexpr auto passes = 32 / radixBits;
+
+    if (count == 0) {
+        return;
+    }
+
+    auto call = Call{};
+    auto const numBlocks = blocks(count, workgroupSize);
+    auto const histogramSize = radix * numBlocks;
+    auto const hasValues = payload != nullptr ? 1U : 0U;
+
+    auto const transformMode = keyType == ScalarType::F32 ? 1U : 3U;
+    if (keyType != ScalarType::U32) {
+        auto const& transform = kernel("transform", ScalarType::U32);
+        dispatch(call, transform, {keys, params(call, {count, 0, 0, transformMode})},
+                 numBlocks * workgroupSize);
+    }
+
+    auto const altKeys = scratch(call, uint64_t{count} * 4);
+    auto const values = hasValues != 0 ? *payload : scratch(call, 4);
+    auto const altValues = hasValues != 0 ? scratch(call, uint64_t{count} * 4) : scratch(call, 4);
+    auto const histogram = scratch(call, uint64_t{histogramSize} * 4);
+    auto const offsets = scratch(call, uint64_t{histogramSize} * 4);
+
+    auto const& histogramKernel = kernel("histogram", ScalarType::U32);
+    auto const& scatterKernel = kernel("scatter", ScalarType::U32);
+    for (auto pass = 0U; pass < passes; ++pass) {
+        auto const even = pass % 2 == 0;
+        auto const& keysIn = even ? keys : altKeys;
+        auto const& keysOut = even ? altKeys : keys;
+        auto const& valuesIn = even ? values : altValues;
+        auto const& valuesOut = even ? altValues : values;
+        auto const p = params(call, {count, pass * radixBits, numBlocks, hasValues});
+
+        dispatch(call, histogramKernel, {keysIn, histogram, p}, numBlocks * workgroupSize);
+        scan(call, ScalarType::U32, histogram, offsets, histogramSize);
+        dispatch(call, scatterKernel, {keysIn, keysOut, valuesIn, valuesOut, offsets, p},
+                 numBlocks * workgroupSize);
+    }
+
+    if (keyType != ScalarType::U32) {
+        auto const& transform = kernel("transform", ScalarType::U32);
+        auto const inverseMode = keyType == ScalarType::F32 ? 2U : 3U;
+        dispatch(call, transform, {keys, params(call, {count, 0, 0, inverseMode})},
+                 numBlocks * workgroupSize);
+    }
+
+    submit(call);
+}
+
+auto Algorithms::map(std::string const& expression,
+                     PackedSlice const& input,
+                     PackedSlice const& output,
+                     uint32_t count,
+                     Precision precision) -> void {
+    if (precision == Precision::F16 and
+        not capabilities(_device).has(wgpu::FeatureName::ShaderF16)) {
+        throw std::invalid_argument{"f16 precision needs the shader-f16 feature"};
+    }
+    if (count == 0) {
+        return;
+    }
+
+    auto call = Call{};
+    auto const& k = packedKernel("map", input.format, output.format, precision, expression);
+    auto const p = params(call, packedParams(count, input.quantization, output.quantization));
+    dispatch(call, k, {input.slice, output.slice, p}, blocks(count, 4));
+    submit(call);
+}
+
+auto Algorithms::reduce(PackedSlice const& input, uint32_t count, BufferSlice const& output)
+    -> void {
+    auto call = Call{};
+    auto const perGroup = workgroupSize * reduceItemsPerThread * 4;
+
+    // Partial sums are f32, so only the first pass reads the packed format.
+    auto current = input;
+    auto n = count;
+    do {
+        auto const groups = std::max(blocks(n, perGroup), 1U);
+        auto const target =
+            groups == 1 ? output : scratch(call, packedSize(StorageFormat::F32, groups));
+        auto const& k =
+            packedKernel("reduce", current.format, StorageFormat::F32, Precision::F32);
+        auto const p = params(call, packedParams(n, current.quantization, {}));
+        dispatch(call, k, {current.slice, target, p}, groups * workgroupSize);
+        current = {target, StorageFormat::F32, {}};
+        n = groups;
+    } while (n > 1);
+
+    submit(call);
+}
+
+auto Algorithms::kernel(std::string const& name, ScalarType type) -> Kernel const& {
+    auto const key = name + ":" + wgslName(type);
+    if (auto const found = _kernels.find(key); found != _kernels.end()) {
+        return *found->second;
+    }
+
+    auto body = std::string_view{};
+    if (name == "reduce") {
+        body = ReduceShader;
+    } else if (name == "scan") {
+        body = ScanBlocksShader;
+    } else if (name == "addOffsets") {
+        body = AddOffsetsShader;
+    } else if (name == "transform") {
+        body = KeyTransformShader;
+    } else if (name == "histogram") {
+        body = HistogramShader;
+    } else if (name == "scatter") {
+        body = ScatterShader;
+    } else {
+        throw std::invalid_argument{"unknown kernel " + name};
+    }
+
+    auto source = replaceAll(std::string{Common} + std::string{body}, "{{type}}", wgslName(type));
+    source = replaceAll(source, "{{items}}", std::to_string(reduceItemsPerThread));
+    source = replaceAll(source, "{{radix}}", std::to_string(1U << radixBits));
+
+    auto k = std::make_unique<Kernel>(_device, source, "main",
+                                      std::vector<uint32_t>{workgroupSize},
+                                      wgpu::PipelineLayout{}, _pipelines);
+    return *_kernels.emplace(key, std::move(k)).first->second;
+}
+
+auto Algorithms::packedKernel(std::string const& name,
+                              StorageFormat input,
+                              StorageFormat output,
+                              Precision precision,
+                              std::string const& expression) -> Kernel const& {
+    auto const half = precision == Precision::F16;
+    auto const key = name + ":" + toString(input) + ":" + toString(output) + ":" +
+                     (half ? "f16" : "f32") + ":" + expression;
+    if (auto const found = _kernels.find(key); found != _kernels.end()) {
+        return *found->second;
+    }
+
+    auto source = std::string{PackedCommon} + wgslLoad(input);
+    if (name == "map") {
+        source += wgslStore(output);
+        source += PackedMapShader;
+    } else if (name == "reduce") {
+        source += PackedReduceShader;
+    } else {
+        throw std::invalid_argument{"unknown kernel " + name};
+    }
+
+    source = replaceAll(source, "{{enable}}", half ? "enable f16;" : "");
+    source = replaceAll(source, "{{real}}", half ? "f16" : "f32");
+    source = replaceAll(source, "{{input}}", wgslWord(input));
+    source = replaceAll(source, "{{output}}", wgslWord(output));
+    source = replaceAll(source, "{{items}}", std::to_string(reduceItemsPerThread));
+    source = replaceAll(source, "{{expression}}", expression);
+
+    auto k = std::make_unique<Kernel>(_device, source, "main",
+                                      std::vector<uint32_t>{workgroupSize},
+                                      wgpu::PipelineLayout{}, _pipelines);
+    return *_kernels.emplace(key, std::move(k)).first->second;
+}
+
+auto Algorithms::scratch(Call& call, uint64_t size) -> BufferSlice {
+    auto const usage = wgpu::BufferUsage::Storage;
+    auto slice = _pool.allocate(size, usage, BufferPool::Placement::Dedicated);
+    call.scratch.push_back(slice);
+    return slice;
+}
+
+auto Algorithms::params(Call& call, std::vector<uint32_t> const& values) -> BufferSlice {
+    auto const usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+    auto slice = _pool.allocate(values.size() * sizeof(uint32_t), usage);
+    _device.GetQueue().WriteBuffer(slice.buffer, slice.offset, values.data(), slice.size);
+    call.scratch.push_back(slice);
+    return slice;
+}
+
+auto Algorithms::dispatch(Call& call,
+                          Kernel const& k,
+                          std::vector<BufferSlice> const& bindings,
+                          uint32_t invocations) -> void {
+    auto entries = std::vector<wgpu::BindGroupEntry>{};
+    entries.reserve(bindings.size());
+    for (auto i = uint32_t{0}; i < bindings.size(); ++i) {
+        auto& entry = entries.emplace_back();
+        entry.binding = i;
+        entry.buffer = bindings[i].buffer;
+        entry.offset = bindings[i].offset;
+        entry.size = bindings[i].size;
+    }
+    call.dispatches.push_back({&k, k.createBindings(_bindGroups, entries), invocations});
+}
+
+auto Algorithms::scan(Call& call,
+                      ScalarType type,
+                      BufferSlice const& input,
+                      BufferSlice const& output,
+                      uint32_t count) -> void {
+    auto const numBlocks = blocks(count, workgroupSize);
+    auto const sums = scratch(call, uint64_t{numBlocks} * 4);
+    auto const p = params(call, {count, 0, numBlocks, 0});
+    dispatch(call, kernel("scan", type), {input, output, sums, p}, numBlocks * workgroupSize);
+
+    if (numBlocks > 1) {
+        auto const offsets = scratch(call, uint64_t{numBlocks} * 4);
+        scan(call, type, sums, offsets, numBlocks);
+        dispatch(call, kernel("addOffsets", type), {output, offsets, p},
+                 numBlocks * workgroupSize);
+    }
+}
+
+auto Algorithms::submit(Call& call) -> void {
+    // Consecutive dispatches in one pass see each other's storage writes.
+    auto encoder = _device.CreateCommandEncoder();
+    auto pass = encoder.BeginComputePass();
+    for (auto const& d : call.dispatches) {
+        d.kernel->dispatch(pass, d.bindings, d.invocations);
+    }
+    pass.End();
+
+    auto commands = encoder.Finish();
+    _device.GetQueue().Submit(1, &commands);
+
+    for (auto const& slice : call.scratch) {
+        _pool.release(slice);
+    }
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/BufferPool.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/PipelineCache.hpp>
+#include <tobi/Quantize.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tobi::gpu {
+
+enum struct ScalarType {
+    U32,
+    I32,
+    F32,
+};
+
+[[nodiscard]] auto wgslName(ScalarType type) -> char const*;
+
+// Arithmetic type of the packed kernels. F16 needs a device with the shader-f16 feature.
+enum struct Precision {
+    F32,
+    F16,
+};
+
+// A buffer of packedSize(format, count) bytes.
+struct PackedSlice {
+    BufferSlice slice{};
+    StorageFormat format{StorageFormat::F32};
+    Quantization quantization{};
+};
+
+// Data parallel primitives on storage buffers. Every call records its dispatches into one
+// compute pass and submits it, scratch memory comes from an internal BufferPool and is recycled
+// once the call returns. WebGPU orders queue writes and submits, so a slot reused by the next
+// call is never overwritten before the GPU is done with it.
+//
+// Bind groups come from a BindGroupCache, so repeated calls on the same buffers create no new
+// objects. It holds references to the caller's buffers until they are evicted or invalidated.
+// With a PipelineCache, pipelines are shared with every other user of the cache.
+struct Algorithms {
+    static constexpr uint32_t workgroupSize = 256;
+    static constexpr uint32_t reduceItemsPerThread = 4;
+    static constexpr uint32_t radixBits = 4;
+
+    explicit Algorithms(wgpu::Device device, PipelineCache* pipelines = nullptr);
+
+    // output[0] = input[0] + ... + input[count - 1], as a tree reduction in workgroup memory.
+    auto reduce(ScalarType type,
+                BufferSlice const& input,
+                uint32_t count,
+                BufferSlice const& output) -> void;
+
+    // output[i] = input[0] + ... + input[i - 1]. Multi-pass: every workgroup scans its block,
+    // the block sums are scanned recursively and added back.
+    auto exclusiveScan(ScalarType type,
+                       BufferSlice const& input,
+                       BufferSlice const& output,
+                       uint32_t count) -> void;
+
+    // Stable ascending LSD radix sort of 32-bit keys in place, 4 bits per pass. f32 keys are
+    // mapped to order preserving integers first, so -0.0 sorts before +0.0 and NaNs with the sign
+    // bit set come first. The optional u32 payload is permuted alongside the keys.
+    auto sort(ScalarType keyType,
+              BufferSlice const& keys,
+              uint32_t count,
+              BufferSlice const* payload = nullptr) -> void;
+
+    // Elementwise expression over packed buffers, converting between their formats. The WGSL
+    // expression sees `x: vec4<real>`, four consecutive elements unpacked to f32 or f16, e.g.
+    // "x * 2.0 + 1.0". Elements past count in the last quad are written as well.
+    auto map(std::string const& expression,
+             PackedSlice const& input,
+             PackedSlice const& output,
+             uint32_t count,
+             Precision precision = Precision::F32) -> void;
+
+    // output[0] = input[0] + ... + input[count - 1] as f32. Narrow formats are unpacked on load,
+    // so bandwidth bound reductions read a half or a quarter of the bytes.
+    auto reduce(PackedSlice const& input, uint32_t count, BufferSlice const& output) -> void;
+
+    [[nodiscard]] auto bindGroups() -> BindGroupCache& { return _bindGroups; }
+
+  private:
+    struct Dispatch {
+        Kernel const* kernel{nullptr};
+        Kernel::Bindings bindings{};
+        uint32_t invocations{0};
+    };
+
+    struct Call {
+        std::vector<Dispatch> dispatches{};
+        std::vector<BufferSlice> scratch{};
+    };
+
+    [[nodiscard]] auto kernel(std::string const& name, ScalarType type) -> Kernel const&;
+    [[nodiscard]] auto packedKernel(std::string const& name,
+                                    StorageFormat input,
+                                    StorageFormat output,
+                                    Precision precision,
+                                    std::string const& expression = {}) -> Kernel const&;
+    [[nodiscard]] auto scratch(Call& call, uint64_t size) -> BufferSlice;
+    [[nodiscard]] auto params(Call& call, std::vector<uint32_t> const& values) -> BufferSlice;
+    auto dispatch(Call& call,
+                  Kernel const& kernel,
+                  std::vector<BufferSlice> const& bindings,
+                  uint32_t invocations) -> void;
+    auto scan(Call& call,
+              ScalarType type,
+              BufferSlice const& input,
+              BufferSlice const& output,
+              uint32_t count) -> void;
+    auto submit(Call& call) -> void;
+
+    wgpu::Device _device{};
+    PipelineCache* _pipelines{nullptr};
+    BindGroupCache _bindGroups;
+    BufferPool _pool;
+    std::map<std::string, std::unique_ptr<Kernel>> _kernels{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,613 @@
+#include "Array.hpp"
+
+#include <tobi/Capabilities.hpp>
+#include <tobi/Readback.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+
+namespace tobi::gpu {
+
+enum struct Op {
+    Input,
+    Constant,
+    Unary,
+    Binary,
+    Compare,
+    Select,
+    Reduce,
+};
+
+struct Array::Node {
+    // Returns its slice to the pool once the last node referring to it is gone. Wrapped slices
+    // have no pool.
+    struct Storage {
+        std::shared_ptr<BufferPool> pool{};
+        BufferSlice slice{};
+
+        Storage(std::shared_ptr<BufferPool> p, BufferSlice s)
+            : pool{std::move(p)}, slice{std::move(s)} {}
+        ~Storage() {
+            if (pool) {
+                pool->release(slice);
+            }
+        }
+
+        Storage(Storage const& other) = delete;
+        Storage(Storage&& other) = delete;
+
+        auto operator=(Storage const& other) -> Storage& = delete;
+        auto operator=(Storage&& other) -> Storage& = delete;
+    };
+
+    Op op{Op::Input};
+    std::string name{};  // WGSL operator or builtin
+    std::vector<std::shared_ptr<Node const>> args{};
+    uint32_t count{1};
+    float value{0.0F};
+    std::shared_ptr<Storage> storage{};
+};
+
+namespace {
+
+using Node = Array::Node;
+using NodePtr = std::shared_ptr<Node const>;
+
+constexpr auto const* Header = R"(
+    struct Params {
+        count: u32,
+        reserved0: u32,
+        reserved1: u32,
+        reserved2: u32,
+        constants: array<vec4<f32>, {{constants}}>,
+    }
+
+    @group(0) @binding(0) var<uniform> params: Params;
+    @group(0) @binding(1) var<storage, read_write> output: array<f32>;
+)";
+
+constexpr auto const* MapShader = R"(
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(global_invocation_id) id: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index = id.x + id.y * groups.x * {{workgroup_size}}u;
+        if (index >= params.count) {
+            return;
+        }
+        output[index] = element(index);
+    }
+)";
+
+constexpr auto const* ReduceShader = R"(
+    var<workgroup> scratch: array<f32, {{workgroup_size}}>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let group = wid.x + wid.y * groups.x;
+        let base = group * {{workgroup_size}}u * {{items}}u + lid.x;
+
+        var acc = {{identity}};
+        for (var i = 0u; i < {{items}}u; i++) {
+            let index = base + i * {{workgroup_size}}u;
+            if (index < params.count) {
+                acc = combine(acc, element(index));
+            }
+        }
+        scratch[lid.x] = acc;
+        workgroupBarrier();
+
+        for (var stride = {{workgroup_size}}u / 2u; stride > 0u; stride >>= 1u) {
+            if (lid.x < stride) {
+                scratch[lid.x] = combine(scratch[lid.x], scratch[lid.x + stride]);
+            }
+            workgroupBarrier();
+        }
+
+        // The 2D grid can contain padding workgroups past the last block.
+        let first = group * {{workgroup_size}}u * {{items}}u;
+        if (lid.x == 0u && (group == 0u || first < params.count)) {
+            output[group] = scratch[0];
+        }
+    }
+)";
+
+constexpr auto usage =
+    wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst;
+
+auto replaceAll(std::string str, std::string_view from, std::string_view to) -> std::string {
+    auto pos = str.find(from);
+    while (pos != std::string::npos) {
+        str.replace(pos, from.size(), to);
+        pos = str.find(from, pos + to.size());
+    }
+    return str;
+}
+
+auto makeNode(Op op, std::string name, std::vector<NodePtr> args) -> Array {
+    auto count = 1U;
+    for (auto const& arg : args) {
+        if (arg->count == 1) {
+            continue;
+        }
+        if (count != 1 and count != arg->count) {
+            throw std::invalid_argument{
+                fmt::format("array counts {} and {} do not match", count, arg->count)};
+        }
+        count = arg->count;
+    }
+
+    auto node = Node{};
+    node.op = op;
+    node.name = std::move(name);
+    node.args = std::move(args);
+    node.count = op == Op::Reduce ? 1 : count;
+    return Array{std::make_shared<Node const>(std::move(node))};
+}
+
+auto unary(std::string name, Array const& array) -> Array {
+    return makeNode(Op::Unary, std::move(name), {array.node()});
+}
+
+auto binary(std::string name, Array const& lhs, Array const& rhs) -> Array {
+    return makeNode(Op::Binary, std::move(name), {lhs.node(), rhs.node()});
+}
+
+auto compare(std::string name, Array const& lhs, Array const& rhs) -> Array {
+    return makeNode(Op::Compare, std::move(name), {lhs.node(), rhs.node()});
+}
+
+auto reduction(std::string name, Array const& array) -> Array {
+    return makeNode(Op::Reduce, std::move(name), {array.node()});
+}
+
+// Inputs are identified by their storage, so two arrays over one buffer share a binding.
+// Reductions below the root are inputs too: evaluate() computes them first.
+auto inputKey(Node const& node) -> void const* {
+    return node.op == Op::Input ? static_cast<void const*>(node.storage.get()) : &node;
+}
+
+auto isInput(Node const& node, NodePtr const& root) -> bool {
+    return node.op == Op::Input or (node.op == Op::Reduce and &node != root.get());
+}
+
+auto collectInputs(NodePtr const& node, NodePtr const& root, std::set<void const*>& inputs)
+    -> void {
+    if (isInput(*node, root)) {
+        inputs.insert(inputKey(*node));
+        return;
+    }
+    for (auto const& arg : node->args) {
+        collectInputs(arg, root, inputs);
+    }
+}
+
+auto countInputs(NodePtr const& root) -> std::size_t {
+    auto inputs = std::set<void const*>{};
+    collectInputs(root, root, inputs);
+    return inputs.size();
+}
+
+auto blocks(uint32_t count, uint32_t perBlock) -> uint32_t {
+    return (count + perBlock - 1) / perBlock;
+}
+
+// Emits one `let` per node in dependency order; nodes shared within the tree are computed once.
+struct Emitter {
+    NodePtr root{};
+    uint32_t count{0};
+    std::vector<NodePtr> inputs{};
+    std::map<void const*, std::size_t> inputIndex{};
+    std::vector<float> constants{};
+    std::map<Node const*, std::string> names{};
+    std::string body{};
+
+    auto emit(NodePtr const& node) -> std::string {
+        if (auto const found = names.find(node.get()); found != names.end()) {
+            return found->second;
+        }
+
+        auto args = std::vector<std::string>{};
+        if (not isInput(*node, root)) {
+            for (auto const& arg : node->args) {
+                args.push_back(emit(arg));
+            }
+        }
+
+        auto value = std::string{};
+        switch (node->op) {
+            case Op::Input:
+            case Op::Reduce: {
+                if (not isInput(*node, root)) {
+                    throw std::invalid_argument{"reductions can only be emitted as inputs"};
+                }
+                auto const key = inputKey(*node);
+                auto [it, added] = inputIndex.try_emplace(key, inputs.size());
+                if (added) {
+                    inputs.push_back(node);
+                }
+                auto const broadcast = node->count == 1 and count != 1;
+                value = fmt::format("in{}[{}]", it->second, broadcast ? "0u" : "index");
+                break;
+            }
+            case Op::Constant: {
+                auto const i = constants.size();
+                constants.push_back(node->value);
+                value = fmt::format("params.constants[{}u][{}u]", i / 4, i % 4);
+                break;
+            }
+            case Op::Unary:
+                value = node->name == "-" ? "-" + args[0]
+                                          : fmt::format("{}({})", node->name, args[0]);
+                break;
+            case Op::Binary:
+                if (node->name.size() == 1) {
+                    value = fmt::format("{} {} {}", args[0], node->name, args[1]);
+                } else {
+                    value = fmt::format("{}({}, {})", node->name, args[0], args[1]);
+                }
+                break;
+            case Op::Compare:
+                value = fmt::format("select(0.0, 1.0, {} {} {})", args[0], node->name, args[1]);
+                break;
+            case Op::Select:
+                value = fmt::format("select({}, {}, {} != 0.0)", args[2], args[1], args[0]);
+                break;
+        }
+
+        auto name = fmt::format("v{}", names.size());
+        body += fmt::format("        let {} = {};\n", name, value);
+        names.emplace(node.get(), name);
+        return name;
+    }
+};
+
+}  // namespace
+
+Array::Array(float value) {
+    auto node = Node{};
+    node.op = Op::Constant;
+    node.value = value;
+    _node = std::make_shared<Node const>(std::move(node));
+}
+
+Array::Array(std::shared_ptr<Node const> node) : _node{std::move(node)} {}
+
+auto Array::count() const -> uint32_t {
+    return _node->count;
+}
+
+auto Array::isEvaluated() const -> bool {
+    return _node->op == Op::Input;
+}
+
+auto Array::slice() const -> BufferSlice const& {
+    if (not isEvaluated()) {
+        throw std::invalid_argument{"array is not evaluated"};
+    }
+    return _node->storage->slice;
+}
+
+auto operator+(Array const& lhs, Array const& rhs) -> Array {
+    return binary("+", lhs, rhs);
+}
+
+auto operator-(Array const& lhs, Array const& rhs) -> Array {
+    return binary("-", lhs, rhs);
+}
+
+auto operator*(Array const& lhs, Array const& rhs) -> Array {
+    return binary("*", lhs, rhs);
+}
+
+auto operator/(Array const& lhs, Array const& rhs) -> Array {
+    return binary("/", lhs, rhs);
+}
+
+auto operator-(Array const& array) -> Array {
+    return unary("-", array);
+}
+
+auto operator<(Array const& lhs, Array const& rhs) -> Array {
+    return compare("<", lhs, rhs);
+}
+
+auto operator>(Array const& lhs, Array const& rhs) -> Array {
+    return compare(">", lhs, rhs);
+}
+
+auto operator<=(Array const& lhs, Array const& rhs) -> Array {
+    return compare("<=", lhs, rhs);
+}
+
+auto operator>=(Array const& lhs, Array const& rhs) -> Array {
+    return compare(">=", lhs, rhs);
+}
+
+auto abs(Array const& array) -> Array {
+    return unary("abs", array);
+}
+
+auto sqrt(Array const& array) -> Array {
+    return unary("sqrt", array);
+}
+
+auto exp(Array const& array) -> Array {
+    return unary("exp", array);
+}
+
+auto log(Array const& array) -> Array {
+    return unary("log", array);
+}
+
+auto sin(Array const& array) -> Array {
+    return unary("sin", array);
+}
+
+auto cos(Array const& array) -> Array {
+    return unary("cos", array);
+}
+
+auto tanh(Array const& array) -> Array {
+    return unary("tanh", array);
+}
+
+auto floor(Array const& array) -> Array {
+    return unary("floor", array);
+}
+
+auto min(Array const& lhs, Array const& rhs) -> Array {
+    return binary("min", lhs, rhs);
+}
+
+auto max(Array const& lhs, Array const& rhs) -> Array {
+    return binary("max", lhs, rhs);
+}
+
+auto pow(Array const& base, Array const& exponent) -> Array {
+    return binary("pow", base, exponent);
+}
+
+auto select(Array const& condition, Array const& ifTrue, Array const& ifFalse) -> Array {
+    return makeNode(Op::Select, "select", {condition.node(), ifTrue.node(), ifFalse.node()});
+}
+
+auto sum(Array const& array) -> Array {
+    return reduction("sum", array);
+}
+
+auto reduceMin(Array const& array) -> Array {
+    return reduction("min", array);
+}
+
+auto reduceMax(Array const& array) -> Array {
+    return reduction("max", array);
+}
+
+ArrayEngine::ArrayEngine(wgpu::Device device, PipelineCache* pipelines)
+    : _device{std::move(device)},
+      _pipelines{pipelines},
+      _pool{std::make_shared<BufferPool>(_device)},
+      _bindGroups{_device} {
+    // One storage binding is the output.
+    auto const limit = capabilities(_device).limits.maxStorageBuffersPerShaderStage;
+    _maxInputs = std::max(limit, 4U) - 1;
+}
+
+auto ArrayEngine::upload(std::span<float const> data) -> Array {
+    auto array = allocate(static_cast<uint32_t>(data.size()));
+    auto const& slice = array.slice();
+    _device.GetQueue().WriteBuffer(slice.buffer, slice.offset, data.data(), data.size_bytes());
+    return array;
+}
+
+auto ArrayEngine::wrap(BufferSlice const& slice, uint32_t count) -> Array {
+    if (count == 0 or slice.size < uint64_t{count} * sizeof(float)) {
+        throw std::invalid_argument{"wrapped slice is empty or smaller than the array"};
+    }
+    auto node = Node{};
+    node.count = count;
+    node.storage = std::make_shared<Node::Storage>(nullptr, slice);
+    return Array{std::make_shared<Node const>(std::move(node))};
+}
+
+auto ArrayEngine::evaluate(Array const& array) -> Array {
+    if (array.isEvaluated()) {
+        return array;
+    }
+
+    auto root = prepare(array.node());
+    if (root->op != Op::Reduce) {
+        auto result = allocate(root->count);
+        run(generate(root), result.slice(), root->count, root->count);
+        return result;
+    }
+
+    // The first pass fuses the reduced expression, later ones reduce the partial results of
+    // the pass before with the same operator.
+    auto count = root->args[0]->count;
+    while (true) {
+        auto const groups = std::max(blocks(count, workgroupSize * reduceItemsPerThread), 1U);
+        auto partials = allocate(groups);
+        run(generate(root), partials.slice(), count, groups * workgroupSize);
+        if (groups == 1) {
+            return partials;
+        }
+        root = makeNode(Op::Reduce, root->name, {partials.node()}).node();
+        count = groups;
+    }
+}
+
+auto ArrayEngine::read(EventPump& pump, Array const& array) -> std::vector<float> {
+    auto const result = evaluate(array);
+    auto const& slice = result.slice();
+    auto pending = readback(pump, slice.buffer, slice.offset, uint64_t{result.count()} * 4);
+    auto const bytes = wait(pump, pending);
+    auto values = std::vector<float>(result.count());
+    std::memcpy(values.data(), bytes.data(), bytes.size());
+    return values;
+}
+
+auto ArrayEngine::source(Array const& array) const -> std::string {
+    return generate(array.node()).source;
+}
+
+auto ArrayEngine::stats() const -> ArrayEngineStats {
+    return _stats;
+}
+
+auto ArrayEngine::generate(NodePtr const& root) const -> Generated {
+    auto const reduce = root->op == Op::Reduce;
+    auto const& expression = reduce ? root->args[0] : root;
+
+    auto emitter = Emitter{.root = root, .count = expression->count};
+    auto const result = emitter.emit(expression);
+
+    auto source = std::string{Header};
+    for (auto i = std::size_t{0}; i < emitter.inputs.size(); ++i) {
+        source += fmt::format(
+            "    @group(0) @binding({}) var<storage, read> in{}: array<f32>;\n", i + 2, i);
+    }
+    source += "\n    fn element(index: u32) -> f32 {\n" + emitter.body;
+    source += fmt::format("        return {};\n    }}\n", result);
+
+    if (reduce) {
+        auto const& op = root->name;
+        auto const combine = op == "sum" ? std::string{"a + b"} : op + "(a, b)";
+        source += fmt::format("\n    fn combine(a: f32, b: f32) -> f32 {{\n"
+                              "        return {};\n    }}\n",
+                              combine);
+        source += ReduceShader;
+        // WGSL has no infinity literal, the largest finite float stands in for it.
+        auto identity = std::string{"0.0"};
+        if (op != "sum") {
+            identity = op == "min" ? "0x1.fffffep+127f" : "-0x1.fffffep+127f";
+        }
+        source = replaceAll(source, "{{identity}}", identity);
+        source = replaceAll(source, "{{items}}", std::to_string(reduceItemsPerThread));
+    } else {
+        source += MapShader;
+    }
+
+    auto const vectors = std::max<std::size_t>((emitter.constants.size() + 3) / 4, 1);
+    source = replaceAll(source, "{{constants}}", std::to_string(vectors));
+    return {std::move(source), std::move(emitter.inputs), std::move(emitter.constants)};
+}
+
+// Evaluates reductions below the root, then splits off the arguments with the most inputs
+// until the rest fits the storage bindings of one kernel.
+auto ArrayEngine::prepare(NodePtr const& root) -> NodePtr {
+    auto memo = std::map<Node const*, NodePtr>{};
+    std::function<NodePtr(NodePtr const&)> rewrite = [&](NodePtr const& node) -> NodePtr {
+        if (auto const found = memo.find(node.get()); found != memo.end()) {
+            return found->second;
+        }
+
+        auto result = node;
+        if (node->op == Op::Reduce and node != root) {
+            result = evaluate(Array{node}).node();
+        } else if (node->op != Op::Input) {
+            auto copy = *node;
+            auto changed = false;
+            for (auto& arg : copy.args) {
+                auto rewritten = rewrite(arg);
+                changed = changed or rewritten != arg;
+                arg = std::move(rewritten);
+            }
+            if (changed) {
+                result = std::make_shared<Node const>(std::move(copy));
+            }
+        }
+        memo.emplace(node.get(), result);
+        return result;
+    };
+
+    auto result = rewrite(root);
+    while (countInputs(result) > _maxInputs) {
+        auto copy = *result;
+        auto largest = std::max_element(
+            copy.args.begin(), copy.args.end(),
+            [](auto const& a, auto const& b) { return countInputs(a) < countInputs(b); });
+        *largest = evaluate(Array{*largest}).node();
+        result = std::make_shared<Node const>(std::move(copy));
+    }
+    return result;
+}
+
+auto ArrayEngine::kernel(std::string const& source) -> Kernel const& {
+    if (auto const found = _kernels.find(source); found != _kernels.end()) {
+        ++_stats.cacheHits;
+        return *found->second;
+    }
+
+    ++_stats.kernelsCompiled;
+    auto k = std::make_unique<Kernel>(_device, source, "main",
+                                      std::vector<uint32_t>{workgroupSize},
+                                      wgpu::PipelineLayout{}, _pipelines);
+    return *_kernels.emplace(source, std::move(k)).first->second;
+}
+
+auto ArrayEngine::allocate(uint32_t count) -> Array {
+    if (count == 0) {
+        throw std::invalid_argument{"arrays must not be empty"};
+    }
+    auto const slice = _pool->allocate(uint64_t{count} * sizeof(float), usage,
+                                       BufferPool::Placement::Dedicated);
+    auto node = Node{};
+    node.count = count;
+    node.storage = std::make_shared<Node::Storage>(_pool, slice);
+    return Array{std::make_shared<Node const>(std::move(node))};
+}
+
+auto ArrayEngine::run(Generated const& generated,
+                      BufferSlice const& output,
+                      uint32_t count,
+                      uint32_t invocations) -> void {
+    auto const& k = kernel(generated.source);
+
+    auto const vectors = std::max<std::size_t>((generated.constants.size() + 3) / 4, 1);
+    auto words = std::vector<uint32_t>(4 + vectors * 4);
+    words[0] = count;
+    for (auto i = std::size_t{0}; i < generated.constants.size(); ++i) {
+        words[4 + i] = std::bit_cast<uint32_t>(generated.constants[i]);
+    }
+    auto const params = _pool->allocate(words.size() * sizeof(uint32_t),
+                                        wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst);
+    _device.GetQueue().WriteBuffer(params.buffer, params.offset, words.data(), params.size);
+
+    auto entries = std::vector<wgpu::BindGroupEntry>{};
+    auto bind = [&](uint32_t binding, BufferSlice const& slice, uint64_t size) {
+        auto& entry = entries.emplace_back();
+        entry.binding = binding;
+        entry.buffer = slice.buffer;
+        entry.offset = slice.offset;
+        entry.size = size;
+    };
+    bind(0, params, params.size);
+    bind(1, output, output.size);
+    for (auto i = uint32_t{0}; i < generated.inputs.size(); ++i) {
+        auto const& input = *generated.inputs[i];
+        bind(i + 2, input.storage->slice, uint64_t{input.count} * 4);
+    }
+    auto const bindings = k.createBindings(_bindGroups, entries);
+
+    auto encoder = _device.CreateCommandEncoder();
+    auto pass = encoder.BeginComputePass();
+    k.dispatch(pass, bindings, invocations);
+    pass.End();
+    auto commands = encoder.Finish();
+    _device.GetQueue().Submit(1, &commands);
+    ++_stats.dispatches;
+
+    _pool->release(params);
+}
+
+}  // namespace tobi::gpu
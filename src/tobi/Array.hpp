@@ -0,0 +1,153 @@
+#pragma once
+
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/BufferPool.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/PipelineCache.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct EventPump;
+
+// An f32 array on the GPU, or a lazy expression over such arrays. Operators only build the
+// expression tree; ArrayEngine::evaluate() turns the whole tree into one generated kernel, so
+// intermediate results stay in registers instead of making a round trip through storage
+// buffers. Arrays of one element, constants and reductions broadcast against longer ones.
+//
+// Arrays are cheap to copy, they share their tree and buffers.
+struct Array {
+    struct Node;
+
+    // A constant that broadcasts to every element.
+    Array(float value);
+    explicit Array(std::shared_ptr<Node const> node);
+
+    [[nodiscard]] auto count() const -> uint32_t;
+
+    // True once the array refers to a buffer instead of an expression.
+    [[nodiscard]] auto isEvaluated() const -> bool;
+
+    // The buffer of an evaluated array, std::invalid_argument otherwise.
+    [[nodiscard]] auto slice() const -> BufferSlice const&;
+
+    [[nodiscard]] auto node() const -> std::shared_ptr<Node const> const& { return _node; }
+
+  private:
+    std::shared_ptr<Node const> _node;
+};
+
+// Counts must match unless one side has a single element.
+[[nodiscard]] auto operator+(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator-(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator*(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator/(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator-(Array const& array) -> Array;
+
+// 1.0 where the comparison holds, 0.0 elsewhere.
+[[nodiscard]] auto operator<(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator>(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator<=(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto operator>=(Array const& lhs, Array const& rhs) -> Array;
+
+[[nodiscard]] auto abs(Array const& array) -> Array;
+[[nodiscard]] auto sqrt(Array const& array) -> Array;
+[[nodiscard]] auto exp(Array const& array) -> Array;
+[[nodiscard]] auto log(Array const& array) -> Array;
+[[nodiscard]] auto sin(Array const& array) -> Array;
+[[nodiscard]] auto cos(Array const& array) -> Array;
+[[nodiscard]] auto tanh(Array const& array) -> Array;
+[[nodiscard]] auto floor(Array const& array) -> Array;
+[[nodiscard]] auto min(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto max(Array const& lhs, Array const& rhs) -> Array;
+[[nodiscard]] auto pow(Array const& base, Array const& exponent) -> Array;
+
+// ifTrue where condition is non-zero, ifFalse elsewhere.
+[[nodiscard]] auto select(Array const& condition, Array const& ifTrue, Array const& ifFalse)
+    -> Array;
+
+// Single element arrays. The expression they reduce is fused into the first reduction pass.
+[[nodiscard]] auto sum(Array const& array) -> Array;
+[[nodiscard]] auto reduceMin(Array const& array) -> Array;
+[[nodiscard]] auto reduceMax(Array const& array) -> Array;
+
+struct ArrayEngineStats {
+    uint64_t kernelsCompiled{0};
+    uint64_t cacheHits{0};
+    uint64_t dispatches{0};
+};
+
+// Generates, compiles and runs the kernels of Array expressions. Kernels are cached by the
+// generated WGSL, which only depends on the shape of the expression: operators, which inputs
+// broadcast and how many constants there are. Constant values live in a uniform buffer, so
+// evaluating the same expression over other data or constants reuses the kernel.
+//
+// With a PipelineCache, pipelines are shared with every other user of the cache.
+//
+// Reductions nested in an expression are evaluated first and read as broadcast inputs.
+// Expressions with more distinct inputs than the device has storage bindings are split.
+struct ArrayEngine {
+    static constexpr uint32_t workgroupSize = 256;
+    static constexpr uint32_t reduceItemsPerThread = 4;
+
+    explicit ArrayEngine(wgpu::Device device, PipelineCache* pipelines = nullptr);
+
+    ArrayEngine(ArrayEngine const& other) = delete;
+    ArrayEngine(ArrayEngine&& other) = delete;
+
+    auto operator=(ArrayEngine const& other) -> ArrayEngine& = delete;
+    auto operator=(ArrayEngine&& other) -> ArrayEngine& = delete;
+
+    [[nodiscard]] auto upload(std::span<float const> data) -> Array;
+
+    // The slice must stay alive as long as the array and be readable as storage.
+    [[nodiscard]] auto wrap(BufferSlice const& slice, uint32_t count) -> Array;
+
+    // Records and submits the kernels of the expression. The result owns a buffer from the
+    // engine's pool, which is recycled once the last array referring to it is gone.
+    auto evaluate(Array const& array) -> Array;
+
+    // Evaluates the array and reads it back.
+    [[nodiscard]] auto read(EventPump& pump, Array const& array) -> std::vector<float>;
+
+    // The WGSL that evaluate() compiles for the top of the expression, e.g. to inspect fusion.
+    [[nodiscard]] auto source(Array const& array) const -> std::string;
+
+    [[nodiscard]] auto stats() const -> ArrayEngineStats;
+
+  private:
+    using NodePtr = std::shared_ptr<Array::Node const>;
+
+    struct Generated {
+        std::string source{};
+        std::vector<NodePtr> inputs{};
+        std::vector<float> constants{};
+    };
+
+    [[nodiscard]] auto generate(NodePtr const& root) const -> Generated;
+    [[nodiscard]] auto prepare(NodePtr const& root) -> NodePtr;
+    [[nodiscard]] auto kernel(std::string const& source) -> Kernel const&;
+    [[nodiscard]] auto allocate(uint32_t count) -> Array;
+    auto run(Generated const& generated,
+             BufferSlice const& output,
+             uint32_t count,
+             uint32_t invocations) -> void;
+
+    wgpu::Device _device{};
+    PipelineCache* _pipelines{nullptr};
+    std::shared_ptr<BufferPool> _pool;
+    BindGroupCache _bindGroups;
+    uint32_t _maxInputs{0};
+    std::map<std::string, std::unique_ptr<Kernel>> _kernels{};
+    ArrayEngineStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -3,7 +3,9 @@
 #include <fmt/format.h>
 #include <fmt/os.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -11,12 +13,30 @@
 
 namespace tobi {
 
+AudioDevice::AudioDevice(AudioDeviceOptions options, std::unique_ptr<audio::Node> source)
+    : _options{options} {
+    _oscillator = &_graph.add<audio::Oscillator>(audio::Oscillator::Waveform::Sine, 440.0F);
+    _amplitude = &_graph.add<audio::Gain>(0.2F);
+    _mute = &_graph.add<audio::Gain>(1.0F);
+    _graph.connect(*_oscillator, *_amplitude);
+    _graph.connect(*_amplitude, *_mute);
+    if (source != nullptr) {
+        _graph.connect(_graph.add(std::move(source)), *_mute);
+    }
+    _graph.setOutput(*_mute);
+    _graph.prepare(sampleRate);
+
+    for (auto& ring : _tap) {
+        ring.resize(AudioSnapshot::frames);
+    }
+}
+
 AudioDevice::~AudioDevice() {
     if (ma_device_get_state(&_device) != ma_device_state_uninitialized) {
-        /* Uninitialize the waveform after the device so we don't pull it from under the device
-         * while it's being reference in the data callback. */
         ma_device_uninit(&_device);
-        ma_waveform_uninit(&_sineWave);
+    }
+    if (_hasContext) {
+        ma_context_uninit(&_context);
     }
 }
 
@@ -24,29 +44,37 @@ auto AudioDevice::initialized() -> void {
     if (not isInitialized()) {
         auto config = ma_device_config_init(ma_device_type_playback);
         config.playback.format = audioDeviceFormat;
-        config.playback.channels = audioDeviceChannels;
-        config.sampleRate = audioDeviceSamplerate;
-        config.pUserData = &_sineWave;
+        config.playback.channels = channels;
+        config.sampleRate = sampleRate;
+        config.periodSizeInFrames = _options.periodFrames;
+        config.pUserData = this;
         config.dataCallback = [](ma_device* device, void* output, const void* /*input*/,
                                  ma_uint32 frames) -> void {
-            assert(device->playback.channels == audioDeviceChannels);
+            assert(device->playback.channels == channels);
             assert(device->playback.format == audioDeviceFormat);
 
-            auto* sineWave = static_cast<ma_waveform*>(device->pUserData);
-            assert(sineWave != nullptr);
+            auto* self = static_cast<AudioDevice*>(device->pUserData);
+            assert(self != nullptr);
 
-            ma_waveform_read_pcm_frames(sineWave, output, frames, nullptr);
+            self->callback(static_cast<float*>(output), frames);
         };
 
-        if (ma_device_init(nullptr, &config, &_device) != MA_SUCCESS) {
-            throw std::runtime_error("Failed to open playback device");
+        if (_options.backend == AudioBackend::Null and not _hasContext) {
+            static constexpr auto backends = std::array{ma_backend_null};
+            if (ma_context_init(backends.data(), static_cast<ma_uint32>(backends.size()), nullptr,
+                                &_context) != MA_SUCCESS) {
+                throw std::runtime_error("Failed to initialize null audio backend");
+            }
+            _hasContext = true;
         }
 
-        fmt::println("Device Name: {}", _device.playback.name);
+        if (ma_device_init(_hasContext ? &_context : nullptr, &config, &_device) != MA_SUCCESS) {
+            throw std::runtime_error("Failed to open playback device");
+        }
 
-        auto wave = ma_waveform_config_init(_device.playback.format, _device.playback.channels,
-                                            _device.sampleRate, ma_waveform_type_sine, 0.2, 440.0);
-        ma_waveform_init(&wave, &_sineWave);
+        fmt::println("Device Name: {} ({}, {} frames per period)", _device.playback.name,
+                     ma_get_backend_name(_device.pContext->backend),
+                     _device.playback.internalPeriodSizeInFrames);
 
         if (ma_device_start(&_device) != MA_SUCCESS) {
             throw std::runtime_error("Failed to start playback device");
@@ -58,4 +86,155 @@ auto AudioDevice::isInitialized() const -> bool {
     return ma_device_is_started(&_device);
 }
 
+auto AudioDevice::send(AudioCommand command) -> bool {
+    if (_commands.push(command)) {
+        return true;
+    }
+    ++_droppedCommands;
+    return false;
+}
+
+auto AudioDevice::setFrequency(float hz) -> bool {
+    return send({AudioCommand::Type::SetFrequency, hz});
+}
+
+auto AudioDevice::setAmplitude(float gain) -> bool {
+    return send({AudioCommand::Type::SetAmplitude, gain});
+}
+
+auto AudioDevice::setMuted(bool muted) -> bool {
+    return send({AudioCommand::Type::SetMuted, muted ? 1.0F : 0.0F});
+}
+
+auto AudioDevice::pollMeters() -> std::optional<AudioMeters> {
+    auto meters = _meters.popLatest();
+    if (meters) {
+        meters->droppedCommands = _droppedCommands;
+    }
+    return meters;
+}
+
+auto AudioDevice::snapshot() -> AudioSnapshot const& {
+    _snapshots->update();
+    return _snapshots->front();
+}
+
+auto AudioDevice::callbackStats() const -> AudioCallbackStats {
+    auto stats = AudioCallbackStats{};
+    stats.callbacks = _callbackTime.count();
+    stats.deadlineMisses = _deadlineMisses.load(std::memory_order_relaxed);
+    stats.xruns = _xruns.load(std::memory_order_relaxed);
+    stats.budget = _budget.load(std::memory_order_relaxed);
+    stats.mean = _callbackTime.mean();
+    stats.p50 = _callbackTime.percentile(0.5);
+    stats.p99 = _callbackTime.percentile(0.99);
+    stats.worst = _callbackTime.max();
+    return stats;
+}
+
+auto AudioDevice::callbackTime() const -> Histogram const& {
+    return _callbackTime;
+}
+
+auto AudioDevice::resetCallbackStats() -> void {
+    _callbackTime.reset();
+    _deadlineMisses.store(0, std::memory_order_relaxed);
+    _xruns.store(0, std::memory_order_relaxed);
+}
+
+auto AudioDevice::apply(AudioCommand const& command) -> void {
+    switch (command.type) {
+        case AudioCommand::Type::SetFrequency:
+            _oscillator->frequency.set(std::clamp(command.value, 1.0F, sampleRate * 0.5F));
+            break;
+        case AudioCommand::Type::SetAmplitude:
+            _amplitude->gain.set(std::clamp(command.value, 0.0F, 1.0F));
+            break;
+        case AudioCommand::Type::SetMuted:
+            _mute->gain.set(command.value != 0.0F ? 0.0F : 1.0F);
+            break;
+    }
+}
+
+auto AudioDevice::callback(float* output, uint32_t frames) -> void {
+    using Micros = std::chrono::duration<double, std::micro>;
+
+    auto const start = std::chrono::steady_clock::now();
+    render(output, frames);
+    auto const elapsed = Micros{std::chrono::steady_clock::now() - start}.count();
+
+    auto const budget = 1e6 * frames / sampleRate;
+    _callbackTime.record(elapsed);
+    _budget.store(budget, std::memory_order_relaxed);
+    if (elapsed > budget) {
+        _deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (_lastCallback != std::chrono::steady_clock::time_point{} and
+        Micros{start - _lastCallback}.count() > xrunGap * _lastBudget) {
+        _xruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    _lastCallback = start;
+    _lastBudget = budget;
+}
+
+auto AudioDevice::render(float* output, uint32_t frames) -> void {
+    while (auto command = _commands.pop()) {
+        apply(*command);
+    }
+
+    _graph.process(output, frames);
+
+    auto meters = AudioMeters{};
+    auto sumSquares = std::array<double, channels>{};
+    for (auto i = uint32_t{0}; i < frames; ++i) {
+        for (auto ch = 0; ch < channels; ++ch) {
+            auto const sample = output[i * channels + ch];
+            meters.peak[ch] = std::max(meters.peak[ch], std::abs(sample));
+            sumSquares[ch] += static_cast<double>(sample) * sample;
+        }
+    }
+
+    _framesProcessed += frames;
+    for (auto ch = 0; ch < channels; ++ch) {
+        auto const n = static_cast<double>(std::max(frames, 1U));
+        meters.rms[ch] = static_cast<float>(std::sqrt(sumSquares[ch] / n));
+    }
+    meters.frequency = _oscillator->frequency.target();
+    meters.amplitude = _amplitude->gain.target();
+    meters.muted = _mute->gain.target() == 0.0F;
+    meters.framesProcessed = _framesProcessed;
+
+    // A full meter queue only means the UI is not reading, dropping is fine.
+    (void)_meters.push(meters);
+
+    tap(output, frames);
+}
+
+auto AudioDevice::tap(float const* output, uint32_t frames) -> void {
+    constexpr auto mask = AudioSnapshot::frames - 1;
+    static_assert((AudioSnapshot::frames & mask) == 0);
+
+    for (auto i = uint32_t{0}; i < frames; ++i) {
+        auto const at = (_tapCursor + i) & mask;
+        for (auto ch = 0; ch < channels; ++ch) {
+            _tap[ch][at] = output[i * channels + ch];
+        }
+    }
+    _tapCursor = (_tapCursor + frames) & mask;
+
+    if (_framesProcessed - _lastSnapshot < snapshotInterval) {
+        return;
+    }
+    _lastSnapshot = _framesProcessed;
+
+    auto& snapshot = _snapshots->back();
+    snapshot.frame = _framesProcessed;
+    for (auto ch = 0; ch < channels; ++ch) {
+        auto const tail = _tap[ch].begin() + _tapCursor;
+        auto const rest = std::copy(tail, _tap[ch].end(), snapshot.samples[ch].begin());
+        std::copy(_tap[ch].begin(), tail, rest);
+    }
+    _snapshots->publish();
+}
+
 }  // namespace tobi
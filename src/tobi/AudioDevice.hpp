@@ -1,11 +1,95 @@
 #pragma once
 
+#include <tobi/AudioGraph.hpp>
+#include <tobi/AudioNodes.hpp>
+#include <tobi/Histogram.hpp>
+#include <tobi/SpscQueue.hpp>
+#include <tobi/TripleBuffer.hpp>
+
 #include "miniaudio.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
 namespace tobi {
 
+struct AudioCommand {
+    enum struct Type : uint32_t {
+        SetFrequency,
+        SetAmplitude,
+        SetMuted,
+    };
+
+    Type type{Type::SetFrequency};
+    float value{0.0F};
+};
+
+enum struct AudioBackend {
+    System,  // miniaudio's default backend order
+    Null,    // timer driven, no sound card required
+};
+
+struct AudioDeviceOptions {
+    AudioBackend backend{AudioBackend::System};
+    uint32_t periodFrames{0};  // 0 lets the backend choose
+};
+
+// Device callback timing. The budget of a callback is the duration of the frames it renders;
+// times are in microseconds.
+struct AudioCallbackStats {
+    uint64_t callbacks{0};
+    uint64_t deadlineMisses{0};  // rendering took longer than the budget
+    uint64_t xruns{0};           // the callback came later than two budgets after the last one
+    double budget{0.0};
+    double mean{0.0};
+    double p50{0.0};
+    double p99{0.0};
+    double worst{0.0};
+};
+
+// State the audio thread reports back once per block.
+struct AudioMeters {
+    std::array<float, 2> peak{};
+    std::array<float, 2> rms{};
+    float frequency{0.0F};
+    float amplitude{0.0F};
+    bool muted{false};
+    uint64_t framesProcessed{0};
+    uint32_t droppedCommands{0};
+};
+
+// The most recent output of the device, oldest frame first.
+struct AudioSnapshot {
+    static constexpr uint32_t frames = 8192;
+
+    uint64_t frame{0};  // frames rendered up to the end of the snapshot
+    std::array<std::array<float, frames>, 2> samples{};
+};
+
+// Runs an audio::Graph (sine oscillator into amplitude and mute gains) on the default playback
+// device. The UI talks to the audio callback only through two wait-free SPSC queues: commands
+// go in, meters come out. The callback drains all pending commands at the start of every block
+// and never locks or allocates. An optional source node, e.g. a ClapHost, is mixed in before the
+// mute gain.
+//
+// The output is also copied into a ring on the audio thread and published as an AudioSnapshot
+// through a triple buffer every snapshotInterval frames, for analyzers on the UI thread.
+//
+// Every device callback is timed against its budget into a lock-free histogram, which costs two
+// clock reads and a few relaxed atomics per callback. Xruns are inferred from callback gaps, as
+// miniaudio does not report them.
 struct AudioDevice {
-    AudioDevice() = default;
+    static constexpr auto channels = 2;
+    static constexpr auto sampleRate = 48000;
+    static constexpr uint32_t snapshotInterval = 512;
+
+    explicit AudioDevice(AudioDeviceOptions options = {},
+                         std::unique_ptr<audio::Node> source = nullptr);
     ~AudioDevice();
 
     AudioDevice(AudioDevice const& other) = delete;
@@ -18,13 +102,63 @@ struct AudioDevice {
 
     [[nodiscard]] auto isInitialized() const -> bool;
 
+    // UI thread. False if the command queue is full, the command is dropped.
+    auto send(AudioCommand command) -> bool;
+    auto setFrequency(float hz) -> bool;
+    auto setAmplitude(float gain) -> bool;
+    auto setMuted(bool muted) -> bool;
+
+    // UI thread. Newest meters since the last call, if the callback ran in between.
+    [[nodiscard]] auto pollMeters() -> std::optional<AudioMeters>;
+
+    // UI thread. The newest snapshot, which stays valid until the next call.
+    [[nodiscard]] auto snapshot() -> AudioSnapshot const&;
+
+    // Any thread. Stats since the last reset; reset only approximately when callbacks run.
+    [[nodiscard]] auto callbackStats() const -> AudioCallbackStats;
+    [[nodiscard]] auto callbackTime() const -> Histogram const&;
+    auto resetCallbackStats() -> void;
+
+    // Audio thread. Renders interleaved stereo frames, called by the device callback and by
+    // offline rendering.
+    auto render(float* output, uint32_t frames) -> void;
+
   private:
     static constexpr auto audioDeviceFormat = ma_format_f32;
-    static constexpr auto audioDeviceChannels = 2;
-    static constexpr auto audioDeviceSamplerate = 48000;
+    static constexpr auto xrunGap = 2.0;
+
+    auto apply(AudioCommand const& command) -> void;
+    auto callback(float* output, uint32_t frames) -> void;
+    auto tap(float const* output, uint32_t frames) -> void;
 
-    ma_waveform _sineWave{};
+    AudioDeviceOptions _options;
+    ma_context _context{};
+    bool _hasContext{false};
     ma_device _device{};
+
+    Histogram _callbackTime{1.0, 1e6};
+    std::atomic<uint64_t> _deadlineMisses{0};
+    std::atomic<uint64_t> _xruns{0};
+    std::atomic<double> _budget{0.0};
+    std::chrono::steady_clock::time_point _lastCallback{};  // audio thread
+    double _lastBudget{0.0};                                // audio thread
+
+    SpscQueue<AudioCommand, 256> _commands{};
+    SpscQueue<AudioMeters, 64> _meters{};
+    uint32_t _droppedCommands{0};  // UI thread
+
+    // Audio thread only, after construction.
+    audio::Graph _graph{};
+    audio::Oscillator* _oscillator{nullptr};
+    audio::Gain* _amplitude{nullptr};
+    audio::Gain* _mute{nullptr};
+    uint64_t _framesProcessed{0};
+    std::array<std::vector<float>, channels> _tap{};  // ring of AudioSnapshot::frames
+    uint32_t _tapCursor{0};
+    uint64_t _lastSnapshot{0};
+
+    std::unique_ptr<TripleBuffer<AudioSnapshot>> _snapshots{
+        std::make_unique<TripleBuffer<AudioSnapshot>>()};
 };
 
 }  // namespace tobi
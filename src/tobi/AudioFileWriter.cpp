@@ -0,0 +1,184 @@
+#include "AudioFileWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace tobi {
+
+namespace {
+
+// RIFF, fmt (18 bytes for non-PCM formats), fact and the data chunk header.
+constexpr auto wavHeaderSize = std::streamoff{58};
+constexpr auto wavFormatFloat = uint32_t{3};
+
+auto putU16(std::ofstream& file, uint32_t value) -> void {
+    auto const bytes = std::array{static_cast<char>(value & 0xffU),
+                                  static_cast<char>((value >> 8U) & 0xffU)};
+    file.write(bytes.data(), bytes.size());
+}
+
+auto putU32(std::ofstream& file, uint32_t value) -> void {
+    putU16(file, value);
+    putU16(file, value >> 16U);
+}
+
+auto writeWavHeader(std::ofstream& file, uint32_t channels, uint32_t sampleRate, uint64_t frames)
+    -> void {
+    auto const blockAlign = channels * uint32_t{sizeof(float)};
+    auto const dataSize = static_cast<uint32_t>(std::min<uint64_t>(
+        frames * blockAlign, UINT32_MAX - static_cast<uint64_t>(wavHeaderSize)));
+
+    file.write("RIFF", 4);
+    putU32(file, static_cast<uint32_t>(wavHeaderSize) - 8 + dataSize);
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    putU32(file, 18);
+    putU16(file, wavFormatFloat);
+    putU16(file, channels);
+    putU32(file, sampleRate);
+    putU32(file, sampleRate * blockAlign);
+    putU16(file, blockAlign);
+    putU16(file, 32);
+    putU16(file, 0);
+
+    file.write("fact", 4);
+    putU32(file, 4);
+    putU32(file, static_cast<uint32_t>(dataSize / blockAlign));
+
+    file.write("data", 4);
+    putU32(file, dataSize);
+}
+
+}  // namespace
+
+AudioFileWriter::AudioFileWriter(std::filesystem::path path,
+                                 AudioFileFormat format,
+                                 uint32_t channels,
+                                 uint32_t sampleRate,
+                                 uint32_t bufferFrames)
+    : _path{std::move(path)}, _format{format}, _channels{channels}, _sampleRate{sampleRate} {
+    if (channels == 0 or bufferFrames == 0) {
+        throw std::invalid_argument{"audio file needs at least one channel and buffer frame"};
+    }
+
+    _file.open(_path, std::ios::binary | std::ios::trunc);
+    if (not _file) {
+        throw std::runtime_error{"cannot open " + _path.string()};
+    }
+    if (_format == AudioFileFormat::Wav) {
+        writeWavHeader(_file, _channels, _sampleRate, 0);
+    }
+
+    for (auto& buffer : _buffers) {
+        buffer.resize(std::size_t{bufferFrames} * channels);
+    }
+    _thread = std::thread{[this] { run(); }};
+}
+
+AudioFileWriter::~AudioFileWriter() {
+    try {
+        close();
+    } catch (std::exception const& /*e*/) {
+    }
+}
+
+auto AudioFileWriter::write(float const* interleaved, uint32_t frames) -> void {
+    auto remaining = std::size_t{frames} * _channels;
+    while (remaining > 0) {
+        auto& buffer = _buffers[_back];
+        auto const count = std::min(remaining, buffer.size() - _fill);
+        std::memcpy(buffer.data() + _fill, interleaved, count * sizeof(float));
+        _fill += count;
+        interleaved += count;
+        remaining -= count;
+        if (_fill == buffer.size()) {
+            submit();
+        }
+    }
+    _framesWritten += frames;
+}
+
+auto AudioFileWriter::close() -> void {
+    if (_closed) {
+        return;
+    }
+    _closed = true;
+
+    if (_fill > 0) {
+        submit();
+    }
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stop = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+
+    if (_error.empty()) {
+        finishHeader();
+    }
+    _file.close();
+    if (not _error.empty()) {
+        throw std::runtime_error{_error};
+    }
+}
+
+auto AudioFileWriter::framesWritten() const -> uint64_t {
+    return _framesWritten;
+}
+
+auto AudioFileWriter::submit() -> void {
+    {
+        auto lock = std::unique_lock{_mutex};
+        _changed.wait(lock, [this] { return _pending == 0; });
+        _pending = _fill;
+        _pendingBuffer = _back;
+    }
+    _changed.notify_all();
+    _back = 1 - _back;
+    _fill = 0;
+}
+
+auto AudioFileWriter::run() -> void {
+    while (true) {
+        auto size = std::size_t{0};
+        auto index = std::size_t{0};
+        {
+            auto lock = std::unique_lock{_mutex};
+            _changed.wait(lock, [this] { return _stop or _pending > 0; });
+            if (_pending == 0) {
+                return;
+            }
+            size = _pending;
+            index = _pendingBuffer;
+        }
+
+        // The caller only touches the other buffer until _pending is cleared.
+        _file.write(reinterpret_cast<char const*>(_buffers[index].data()),
+                    static_cast<std::streamsize>(size * sizeof(float)));
+
+        {
+            auto lock = std::scoped_lock{_mutex};
+            if (not _file and _error.empty()) {
+                _error = "cannot write " + _path.string();
+            }
+            _pending = 0;
+        }
+        _changed.notify_all();
+    }
+}
+
+auto AudioFileWriter::finishHeader() -> void {
+    if (_format == AudioFileFormat::Wav) {
+        _file.seekp(0);
+        writeWavHeader(_file, _channels, _sampleRate, _framesWritten);
+    }
+    _file.flush();
+    if (not _file) {
+        _error = "cannot write " + _path.string();
+    }
+}
+
+}  // namespace tobi
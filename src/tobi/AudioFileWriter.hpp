@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tobi {
+
+enum struct AudioFileFormat {
+    Wav,  // IEEE float, 32 bits per sample
+    Raw,  // interleaved float32 samples, no header
+};
+
+// Streams interleaved float samples to disk through two buffers: the caller fills one while a
+// writer thread writes the other, so rendering only waits when it outruns the disk.
+struct AudioFileWriter {
+    AudioFileWriter(std::filesystem::path path,
+                    AudioFileFormat format,
+                    uint32_t channels,
+                    uint32_t sampleRate,
+                    uint32_t bufferFrames = 64 * 1024);
+    ~AudioFileWriter();
+
+    AudioFileWriter(AudioFileWriter const& other) = delete;
+    AudioFileWriter(AudioFileWriter&& other) = delete;
+
+    auto operator=(AudioFileWriter const& other) -> AudioFileWriter& = delete;
+    auto operator=(AudioFileWriter&& other) -> AudioFileWriter& = delete;
+
+    auto write(float const* interleaved, uint32_t frames) -> void;
+
+    // Writes what is buffered and completes the header. Throws std::runtime_error if anything
+    // could not be written. Called by the destructor, which swallows errors.
+    auto close() -> void;
+
+    [[nodiscard]] auto framesWritten() const -> uint64_t;
+
+  private:
+    auto submit() -> void;
+    auto run() -> void;
+    auto finishHeader() -> void;
+
+    std::filesystem::path _path;
+    AudioFileFormat _format;
+    uint32_t _channels;
+    uint32_t _sampleRate;
+    std::ofstream _file{};
+
+    std::array<std::vector<float>, 2> _buffers{};
+    std::size_t _back{0};  // caller side
+    std::size_t _fill{0};  // samples in the back buffer
+    uint64_t _framesWritten{0};
+
+    std::mutex _mutex{};
+    std::condition_variable _changed{};
+    std::size_t _pending{0};  // samples handed to the writer thread, 0 if idle
+    std::size_t _pendingBuffer{0};
+    bool _stop{false};
+    bool _closed{false};
+    std::string _error{};
+    std::thread _thread{};
+};
+
+}  // namespace tobi
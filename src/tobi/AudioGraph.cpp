@@ -0,0 +1,155 @@
+#include "AudioGraph.hpp"
+
+#include <tobi/Simd.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace tobi::audio {
+
+Parameter::Parameter(float value, float smoothing)
+    : _target{value}, _current{value}, _smoothing{std::clamp(smoothing, 0.0F, 1.0F)} {}
+
+auto Parameter::set(float value) -> void {
+    _target.store(value, std::memory_order_relaxed);
+}
+
+auto Parameter::target() const -> float {
+    return _target.load(std::memory_order_relaxed);
+}
+
+auto Parameter::ramp() -> Ramp {
+    auto const start = _current;
+    auto const distance = target() - start;
+    _current = std::abs(distance) < 1e-6F ? target() : start + distance * _smoothing;
+    return {start, (_current - start) / static_cast<float>(blockSize)};
+}
+
+auto Graph::connect(Node& from, Node& to, std::size_t input, std::size_t output) -> void {
+    auto const owned = [this](Node const& node) {
+        return std::any_of(_nodes.begin(), _nodes.end(),
+                           [&](auto const& n) { return n.get() == &node; });
+    };
+    if (not owned(from) or not owned(to)) {
+        throw std::invalid_argument{"node does not belong to this graph"};
+    }
+    if (output >= from.numOutputs() or input >= to.numInputs()) {
+        throw std::invalid_argument{"port index out of range"};
+    }
+    _edges.push_back({&from, output, &to, input});
+}
+
+auto Graph::setOutput(Node& node) -> void {
+    _output = &node;
+}
+
+auto Graph::prepare(double sampleRate) -> void {
+    auto index = std::unordered_map<Node const*, std::size_t>{};
+    for (auto i = std::size_t{0}; i < _nodes.size(); ++i) {
+        index[_nodes[i].get()] = i;
+    }
+
+    // Kahn's algorithm, nodes without pending inputs run first.
+    auto indegree = std::vector<std::size_t>(_nodes.size());
+    for (auto const& edge : _edges) {
+        ++indegree[index[edge.to]];
+    }
+    auto order = std::vector<std::size_t>{};
+    order.reserve(_nodes.size());
+    for (auto i = std::size_t{0}; i < _nodes.size(); ++i) {
+        if (indegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (auto next = std::size_t{0}; next < order.size(); ++next) {
+        auto const* node = _nodes[order[next]].get();
+        for (auto const& edge : _edges) {
+            if (edge.from == node and --indegree[index[edge.to]] == 0) {
+                order.push_back(index[edge.to]);
+            }
+        }
+    }
+    if (order.size() != _nodes.size()) {
+        throw std::invalid_argument{"audio graph contains a cycle"};
+    }
+
+    // Steps are never resized after this, inputs point into their output buses.
+    _steps.clear();
+    _steps.resize(_nodes.size());
+    auto stepOf = std::vector<std::size_t>(_nodes.size());
+    for (auto s = std::size_t{0}; s < order.size(); ++s) {
+        auto& step = _steps[s];
+        step.node = _nodes[order[s]].get();
+        step.outputs.resize(step.node->numOutputs());
+        stepOf[order[s]] = s;
+    }
+
+    for (auto& step : _steps) {
+        auto sources = std::vector<std::vector<AudioBus const*>>(step.node->numInputs());
+        for (auto const& edge : _edges) {
+            if (edge.to == step.node) {
+                auto const& from = _steps[stepOf[index[edge.from]]];
+                sources[edge.input].push_back(&from.outputs[edge.output]);
+            }
+        }
+
+        auto const mixes = std::count_if(sources.begin(), sources.end(),
+                                         [](auto const& s) { return s.size() > 1; });
+        step.mixed.resize(static_cast<std::size_t>(mixes));
+        step.inputs.assign(sources.size(), &_silence);
+        step.mixes.clear();
+        for (auto i = std::size_t{0}; i < sources.size(); ++i) {
+            if (sources[i].size() == 1) {
+                step.inputs[i] = sources[i].front();
+            } else if (sources[i].size() > 1) {
+                auto* target = &step.mixed[step.mixes.size()];
+                step.inputs[i] = target;
+                step.mixes.push_back({target, std::move(sources[i])});
+            }
+        }
+
+        step.node->prepare(sampleRate);
+    }
+
+    _result = &_silence;
+    if (_output != nullptr and _output->numOutputs() > 0) {
+        _result = &_steps[stepOf[index.at(_output)]].outputs.front();
+    }
+    _context = {sampleRate, 0};
+    _readPosition = blockSize;
+}
+
+auto Graph::process(float* output, uint32_t frames) -> void {
+    while (frames > 0) {
+        if (_readPosition == blockSize) {
+            renderBlock();
+            _readPosition = 0;
+        }
+
+        auto const n = std::min<std::size_t>(frames, blockSize - _readPosition);
+        simd::interleave(output, _result->channel[0].data() + _readPosition,
+                         _result->channel[1].data() + _readPosition, n);
+        output += n * channels;
+        frames -= static_cast<uint32_t>(n);
+        _readPosition += n;
+    }
+}
+
+auto Graph::renderBlock() -> void {
+    for (auto& step : _steps) {
+        for (auto& mix : step.mixes) {
+            for (auto ch = std::size_t{0}; ch < channels; ++ch) {
+                auto* dst = mix.target->channel[ch].data();
+                simd::copy(dst, mix.sources.front()->channel[ch].data(), blockSize);
+                for (auto s = std::size_t{1}; s < mix.sources.size(); ++s) {
+                    simd::add(dst, mix.sources[s]->channel[ch].data(), blockSize);
+                }
+            }
+        }
+        step.node->process(_context, step.inputs, step.outputs);
+    }
+    _context.frame += blockSize;
+}
+
+}  // namespace tobi::audio
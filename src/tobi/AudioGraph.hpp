@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace tobi::audio {
+
+inline constexpr std::size_t blockSize = 128;
+inline constexpr std::size_t channels = 2;
+
+using Channel = std::array<float, blockSize>;
+
+// One block of planar stereo audio. Channels are 32 byte aligned for the SIMD kernels.
+struct alignas(32) AudioBus {
+    std::array<Channel, channels> channel{};
+};
+
+struct ProcessContext {
+    double sampleRate{48000.0};
+    uint64_t frame{0};  // index of the block's first frame since prepare()
+};
+
+// A value set from any thread and read by the audio thread once per block. The audio side
+// moves a fraction of the remaining distance per block and interpolates linearly inside the
+// block, so steps in the target do not produce zipper noise.
+struct Parameter {
+    struct Ramp {
+        float start{0.0F};
+        float step{0.0F};  // per sample
+
+        [[nodiscard]] auto end() const -> float { return start + step * blockSize; }
+    };
+
+    explicit Parameter(float value, float smoothing = 0.25F);
+
+    Parameter(Parameter const& other) = delete;
+    Parameter(Parameter&& other) = delete;
+
+    auto operator=(Parameter const& other) -> Parameter& = delete;
+    auto operator=(Parameter&& other) -> Parameter& = delete;
+
+    auto set(float value) -> void;
+    [[nodiscard]] auto target() const -> float;
+
+    // Audio thread, once per block.
+    [[nodiscard]] auto ramp() -> Ramp;
+
+  private:
+    std::atomic<float> _target;
+    float _current;
+    float _smoothing;
+};
+
+struct Node {
+    Node() = default;
+    virtual ~Node() = default;
+
+    Node(Node const& other) = delete;
+    Node(Node&& other) = delete;
+
+    auto operator=(Node const& other) -> Node& = delete;
+    auto operator=(Node&& other) -> Node& = delete;
+
+    [[nodiscard]] virtual auto numInputs() const -> std::size_t { return 1; }
+    [[nodiscard]] virtual auto numOutputs() const -> std::size_t { return 1; }
+
+    // Called from Graph::prepare(), the only place a node may allocate.
+    virtual auto prepare(double sampleRate) -> void { (void)sampleRate; }
+
+    // Inputs are never null, unconnected inputs read silence. Several connections into the same
+    // input are summed by the graph.
+    virtual auto process(ProcessContext const& context,
+                         std::span<AudioBus const* const> inputs,
+                         std::span<AudioBus> outputs) -> void = 0;
+};
+
+// Owns the nodes and runs them in topological order. Build and prepare() on any thread before
+// the graph is handed to the audio callback, process() then neither locks nor allocates.
+struct Graph {
+    Graph() = default;
+
+    Graph(Graph const& other) = delete;
+    Graph(Graph&& other) = delete;
+
+    auto operator=(Graph const& other) -> Graph& = delete;
+    auto operator=(Graph&& other) -> Graph& = delete;
+
+    template <typename T, typename... Args>
+    auto add(Args&&... args) -> T& {
+        auto node = std::make_unique<T>(std::forward<Args>(args)...);
+        auto& ref = *node;
+        _nodes.push_back(std::move(node));
+        return ref;
+    }
+
+    // Takes ownership of a node built elsewhere.
+    auto add(std::unique_ptr<Node> node) -> Node& {
+        auto& ref = *node;
+        _nodes.push_back(std::move(node));
+        return ref;
+    }
+
+    auto connect(Node& from, Node& to, std::size_t input = 0, std::size_t output = 0) -> void;
+
+    // The node whose first output is rendered by process().
+    auto setOutput(Node& node) -> void;
+
+    // Sorts the nodes topologically and allocates all buffers. Throws std::invalid_argument on
+    // cycles, feedback belongs inside a node such as Delay.
+    auto prepare(double sampleRate) -> void;
+
+    // Audio thread. Renders interleaved stereo frames, any count, blocks are split internally.
+    auto process(float* output, uint32_t frames) -> void;
+
+    [[nodiscard]] auto size() const -> std::size_t { return _nodes.size(); }
+
+  private:
+    struct Edge {
+        Node* from{nullptr};
+        std::size_t output{0};
+        Node* to{nullptr};
+        std::size_t input{0};
+    };
+
+    // Several sources into one input, summed into target before the node runs.
+    struct Mix {
+        AudioBus* target{nullptr};
+        std::vector<AudioBus const*> sources{};
+    };
+
+    struct Step {
+        Node* node{nullptr};
+        std::vector<AudioBus> outputs{};
+        std::vector<AudioBus> mixed{};
+        std::vector<AudioBus const*> inputs{};
+        std::vector<Mix> mixes{};
+    };
+
+    auto renderBlock() -> void;
+
+    std::vector<std::unique_ptr<Node>> _nodes{};
+    std::vector<Edge> _edges{};
+    Node* _output{nullptr};
+
+    std::vector<Step> _steps{};
+    AudioBus const* _result{nullptr};
+    AudioBus _silence{};
+    ProcessContext _context{};
+    std::size_t _readPosition{blockSize};
+};
+
+}  // namespace tobi::audio
@@ -0,0 +1,257 @@
+#include "AudioNodes.hpp"
+
+#include <tobi/Simd.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+namespace tobi::audio {
+
+namespace {
+
+constexpr auto sineTableSize = std::size_t{4096};
+
+// One extra entry so interpolation never wraps.
+auto sineTable() -> std::array<float, sineTableSize + 1> const& {
+    static auto const table = [] {
+        auto t = std::array<float, sineTableSize + 1>{};
+        for (auto i = std::size_t{0}; i <= sineTableSize; ++i) {
+            auto const phase = static_cast<double>(i) / sineTableSize;
+            t[i] = static_cast<float>(std::sin(2.0 * std::numbers::pi * phase));
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Residual that removes the aliasing step of a discontinuity at phase 0.
+auto polyBlep(double phase, double increment) -> double {
+    if (phase < increment) {
+        auto const t = phase / increment;
+        return t + t - t * t - 1.0;
+    }
+    if (phase > 1.0 - increment) {
+        auto const t = (phase - 1.0) / increment;
+        return t * t + t + t + 1.0;
+    }
+    return 0.0;
+}
+
+}  // namespace
+
+Oscillator::Oscillator(Waveform waveform, float frequency)
+    : frequency{frequency}, _waveform{waveform} {}
+
+auto Oscillator::prepare(double sampleRate) -> void {
+    _sampleRate = sampleRate;
+    _phase = 0.0;
+    _triangle = 0.0F;
+    (void)sineTable();  // build the table here, not on the audio thread
+}
+
+auto Oscillator::process(ProcessContext const& /*context*/,
+                         std::span<AudioBus const* const> /*inputs*/,
+                         std::span<AudioBus> outputs) -> void {
+    auto const ramp = frequency.ramp();
+    auto& out = outputs[0].channel[0];
+    auto const& table = sineTable();
+
+    for (auto i = std::size_t{0}; i < blockSize; ++i) {
+        auto const hz = ramp.start + ramp.step * static_cast<float>(i);
+        auto const increment = std::clamp(static_cast<double>(hz) / _sampleRate, 0.0, 0.5);
+
+        auto sample = 0.0;
+        switch (_waveform) {
+            case Waveform::Sine: {
+                auto const position = _phase * sineTableSize;
+                auto const index = static_cast<std::size_t>(position);
+                auto const frac = static_cast<float>(position - static_cast<double>(index));
+                sample = table[index] + (table[index + 1] - table[index]) * frac;
+                break;
+            }
+            case Waveform::Saw:
+                sample = 2.0 * _phase - 1.0 - polyBlep(_phase, increment);
+                break;
+            case Waveform::Square:
+            case Waveform::Triangle: {
+                auto square = _phase < 0.5 ? 1.0 : -1.0;
+                square += polyBlep(_phase, increment);
+                square -= polyBlep(std::fmod(_phase + 0.5, 1.0), increment);
+                if (_waveform == Waveform::Square) {
+                    sample = square;
+                    break;
+                }
+                // Leaky integration of the band-limited square.
+                _triangle = static_cast<float>(increment * 4.0 * square +
+                                               (1.0 - increment) * _triangle);
+                sample = _triangle;
+                break;
+            }
+        }
+
+        out[i] = static_cast<float>(sample);
+        _phase += increment;
+        _phase -= std::floor(_phase);
+    }
+
+    simd::copy(outputs[0].channel[1].data(), out.data(), blockSize);
+}
+
+Gain::Gain(float gain) : gain{gain} {}
+
+auto Gain::process(ProcessContext const& /*context*/,
+                   std::span<AudioBus const* const> inputs,
+                   std::span<AudioBus> outputs) -> void {
+    auto const ramp = gain.ramp();
+    for (auto ch = std::size_t{0}; ch < channels; ++ch) {
+        simd::copyRamped(outputs[0].channel[ch].data(), inputs[0]->channel[ch].data(), ramp.start,
+                         ramp.step, blockSize);
+    }
+}
+
+Mixer::Mixer(std::size_t inputs) {
+    _gains.reserve(inputs);
+    for (auto i = std::size_t{0}; i < inputs; ++i) {
+        _gains.push_back(std::make_unique<Parameter>(1.0F));
+    }
+}
+
+auto Mixer::gain(std::size_t input) -> Parameter& {
+    return *_gains.at(input);
+}
+
+auto Mixer::process(ProcessContext const& /*context*/,
+                    std::span<AudioBus const* const> inputs,
+                    std::span<AudioBus> outputs) -> void {
+    auto& out = outputs[0];
+    for (auto& channel : out.channel) {
+        simd::clear(channel.data(), blockSize);
+    }
+    for (auto i = std::size_t{0}; i < _gains.size(); ++i) {
+        auto const ramp = _gains[i]->ramp();
+        for (auto ch = std::size_t{0}; ch < channels; ++ch) {
+            simd::addRamped(out.channel[ch].data(), inputs[i]->channel[ch].data(), ramp.start,
+                            ramp.step, blockSize);
+        }
+    }
+}
+
+BiquadFilter::BiquadFilter(Type type, float cutoff, float q)
+    : cutoff{cutoff}, q{q}, _type{type} {}
+
+auto BiquadFilter::prepare(double sampleRate) -> void {
+    _sampleRate = sampleRate;
+    _state = {};
+    _lastCutoff = -1.0F;
+}
+
+auto BiquadFilter::updateCoefficients(float frequency, float resonance) -> void {
+    auto const f = std::clamp(static_cast<double>(frequency), 10.0, _sampleRate * 0.49);
+    auto const w0 = 2.0 * std::numbers::pi * f / _sampleRate;
+    auto const alpha = std::sin(w0) / (2.0 * std::max(static_cast<double>(resonance), 0.05));
+    auto const cosw = std::cos(w0);
+
+    auto b0 = 0.0;
+    auto b1 = 0.0;
+    auto b2 = 0.0;
+    switch (_type) {
+        case Type::LowPass:
+            b0 = (1.0 - cosw) / 2.0;
+            b1 = 1.0 - cosw;
+            b2 = b0;
+            break;
+        case Type::HighPass:
+            b0 = (1.0 + cosw) / 2.0;
+            b1 = -(1.0 + cosw);
+            b2 = b0;
+            break;
+        case Type::BandPass:
+            b0 = alpha;
+            b1 = 0.0;
+            b2 = -alpha;
+            break;
+    }
+
+    auto const a0 = 1.0 + alpha;
+    _coefficients = {
+        static_cast<float>(b0 / a0),
+        static_cast<float>(b1 / a0),
+        static_cast<float>(b2 / a0),
+        static_cast<float>(-2.0 * cosw / a0),
+        static_cast<float>((1.0 - alpha) / a0),
+    };
+}
+
+auto BiquadFilter::process(ProcessContext const& /*context*/,
+                           std::span<AudioBus const* const> inputs,
+                           std::span<AudioBus> outputs) -> void {
+    auto const f = cutoff.ramp().end();
+    auto const r = q.ramp().end();
+    if (f != _lastCutoff or r != _lastQ) {
+        updateCoefficients(f, r);
+        _lastCutoff = f;
+        _lastQ = r;
+    }
+
+    // The recursion runs along time, so this stays scalar; channels are independent.
+    auto const [b0, b1, b2, a1, a2] = _coefficients;
+    for (auto ch = std::size_t{0}; ch < channels; ++ch) {
+        auto const& in = inputs[0]->channel[ch];
+        auto& out = outputs[0].channel[ch];
+        auto [z1, z2] = _state[ch];
+        for (auto i = std::size_t{0}; i < blockSize; ++i) {
+            auto const x = in[i];
+            auto const y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            out[i] = y;
+        }
+        _state[ch] = {z1, z2};
+    }
+}
+
+Delay::Delay(float maxSeconds, float seconds, float feedback, float mix)
+    : time{seconds}, feedback{feedback}, mix{mix}, _maxSeconds{maxSeconds} {}
+
+auto Delay::prepare(double sampleRate) -> void {
+    _sampleRate = sampleRate;
+    auto const size = std::bit_ceil(static_cast<std::size_t>(_maxSeconds * sampleRate) + 2);
+    _mask = size - 1;
+    _write = 0;
+    for (auto& line : _lines) {
+        line.assign(size, 0.0F);
+    }
+}
+
+auto Delay::process(ProcessContext const& /*context*/,
+                    std::span<AudioBus const* const> inputs,
+                    std::span<AudioBus> outputs) -> void {
+    auto const maxDelay = static_cast<double>(_mask - 1);
+    auto const delay = std::clamp(time.ramp().end() * _sampleRate, 1.0, maxDelay);
+    auto const whole = static_cast<std::size_t>(delay);
+    auto const frac = static_cast<float>(delay - static_cast<double>(whole));
+    auto const fb = std::clamp(feedback.ramp().end(), -0.99F, 0.99F);
+    auto const wet = mix.ramp();
+
+    for (auto ch = std::size_t{0}; ch < channels; ++ch) {
+        auto const& in = inputs[0]->channel[ch];
+        auto& out = outputs[0].channel[ch];
+        auto& line = _lines[ch];
+        auto write = _write;
+        for (auto i = std::size_t{0}; i < blockSize; ++i) {
+            auto const a = line[(write - whole) & _mask];
+            auto const b = line[(write - whole - 1) & _mask];
+            auto const delayed = a + (b - a) * frac;
+            auto const m = wet.start + wet.step * static_cast<float>(i);
+
+            line[write] = in[i] + delayed * fb;
+            out[i] = in[i] + (delayed - in[i]) * m;
+            write = (write + 1) & _mask;
+        }
+    }
+    _write = (_write + blockSize) & _mask;
+}
+
+}  // namespace tobi::audio
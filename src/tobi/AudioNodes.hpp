@@ -0,0 +1,119 @@
+#pragma once
+
+#include <tobi/AudioGraph.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tobi::audio {
+
+// Band-limited with PolyBLEP for saw and square, sine reads an interpolated wavetable. Writes
+// the same signal to both channels. No inputs.
+struct Oscillator final : Node {
+    enum struct Waveform {
+        Sine,
+        Saw,
+        Square,
+        Triangle,
+    };
+
+    explicit Oscillator(Waveform waveform = Waveform::Sine, float frequency = 440.0F);
+
+    [[nodiscard]] auto numInputs() const -> std::size_t override { return 0; }
+    auto prepare(double sampleRate) -> void override;
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+    Parameter frequency;
+
+  private:
+    Waveform _waveform;
+    double _phase{0.0};
+    double _sampleRate{48000.0};
+    float _triangle{0.0F};
+};
+
+struct Gain final : Node {
+    explicit Gain(float gain = 1.0F);
+
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+    Parameter gain;
+};
+
+// Sums its inputs with a gain per input.
+struct Mixer final : Node {
+    explicit Mixer(std::size_t inputs);
+
+    [[nodiscard]] auto numInputs() const -> std::size_t override { return _gains.size(); }
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+    [[nodiscard]] auto gain(std::size_t input) -> Parameter&;
+
+  private:
+    std::vector<std::unique_ptr<Parameter>> _gains;
+};
+
+// RBJ cookbook biquad in transposed direct form II. Coefficients are recomputed once per block
+// when cutoff or resonance moved.
+struct BiquadFilter final : Node {
+    enum struct Type {
+        LowPass,
+        HighPass,
+        BandPass,
+    };
+
+    explicit BiquadFilter(Type type = Type::LowPass, float cutoff = 1000.0F, float q = 0.707F);
+
+    auto prepare(double sampleRate) -> void override;
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+    Parameter cutoff;
+    Parameter q;
+
+  private:
+    auto updateCoefficients(float cutoff, float q) -> void;
+
+    Type _type;
+    double _sampleRate{48000.0};
+    float _lastCutoff{-1.0F};
+    float _lastQ{-1.0F};
+    std::array<float, 5> _coefficients{};  // b0 b1 b2 a1 a2, normalized by a0
+    std::array<std::array<float, 2>, channels> _state{};
+};
+
+// Feedback delay with linear interpolation between samples.
+struct Delay final : Node {
+    explicit Delay(float maxSeconds = 2.0F,
+                   float seconds = 0.25F,
+                   float feedback = 0.3F,
+                   float mix = 0.3F);
+
+    auto prepare(double sampleRate) -> void override;
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+    Parameter time;  // seconds
+    Parameter feedback;
+    Parameter mix;
+
+  private:
+    float _maxSeconds;
+    double _sampleRate{48000.0};
+    std::size_t _mask{0};
+    std::size_t _write{0};
+    std::array<std::vector<float>, channels> _lines{};
+};
+
+}  // namespace tobi::audio
@@ -0,0 +1,134 @@
+#include "BindGroupCache.hpp"
+
+#include <tobi/PipelineCache.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace tobi::gpu {
+
+namespace {
+
+auto handle(auto const& object) -> uint64_t {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object.Get()));
+}
+
+}  // namespace
+
+auto BindGroupCacheStats::hitRate() const -> double {
+    if (hits + misses == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(hits) / static_cast<double>(hits + misses);
+}
+
+BindGroupCache::BindGroupCache(wgpu::Device device, std::size_t capacity)
+    : _device{std::move(device)}, _capacity{std::max(capacity, std::size_t{1})} {}
+
+auto BindGroupCache::KeyHash::operator()(Key const& key) const -> std::size_t {
+    return static_cast<std::size_t>(hash(key.data(), key.size() * sizeof(uint64_t)));
+}
+
+auto BindGroupCache::makeKey(wgpu::BindGroupLayout const& layout,
+                             std::span<wgpu::BindGroupEntry const> entries) -> Key {
+    auto key = Key{};
+    key.reserve(1 + entries.size() * 4);
+    key.push_back(handle(layout));
+    for (auto const& entry : entries) {
+        if (not entry.buffer or entry.sampler or entry.textureView) {
+            throw std::invalid_argument{"bind group cache only supports buffer bindings"};
+        }
+        key.push_back(entry.binding);
+        key.push_back(handle(entry.buffer));
+        key.push_back(entry.offset);
+        key.push_back(entry.size);
+    }
+    return key;
+}
+
+auto BindGroupCache::get(wgpu::BindGroupLayout const& layout,
+                         std::span<wgpu::BindGroupEntry const> entries) -> wgpu::BindGroup {
+    auto key = makeKey(layout, entries);
+
+    auto const lock = std::scoped_lock{_mutex};
+    if (auto const found = _index.find(key); found != _index.end()) {
+        ++_stats.hits;
+        _entries.splice(_entries.begin(), _entries, found->second);
+        return found->second->group;
+    }
+
+    ++_stats.misses;
+    auto descriptor = wgpu::BindGroupDescriptor{};
+    descriptor.layout = layout;
+    descriptor.entryCount = entries.size();
+    descriptor.entries = entries.data();
+    auto group = _device.CreateBindGroup(&descriptor);
+
+    _entries.push_front({key, group});
+    _index.emplace(std::move(key), _entries.begin());
+    while (_entries.size() > _capacity) {
+        _index.erase(_entries.back().key);
+        _entries.pop_back();
+        ++_stats.evictions;
+    }
+    return group;
+}
+
+auto BindGroupCache::dynamic(wgpu::BindGroupLayout const& layout,
+                             std::span<BufferSlice const> slices) -> DynamicBindGroup {
+    auto result = DynamicBindGroup{};
+    auto entries = std::vector<wgpu::BindGroupEntry>(slices.size());
+    result.offsets.reserve(slices.size());
+    for (auto i = std::size_t{0}; i < slices.size(); ++i) {
+        if (slices[i].offset > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument{"dynamic offsets are limited to 32 bits"};
+        }
+        entries[i].binding = static_cast<uint32_t>(i);
+        entries[i].buffer = slices[i].buffer;
+        entries[i].offset = 0;
+        entries[i].size = slices[i].size;
+        result.offsets.push_back(static_cast<uint32_t>(slices[i].offset));
+    }
+    result.group = get(layout, entries);
+    return result;
+}
+
+auto BindGroupCache::invalidate(wgpu::Buffer const& buffer) -> void {
+    auto const target = handle(buffer);
+
+    auto const lock = std::scoped_lock{_mutex};
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        auto const& key = it->key;
+        auto binds = false;
+        for (auto i = std::size_t{2}; i < key.size(); i += 4) {
+            binds = binds or key[i] == target;
+        }
+        if (not binds) {
+            ++it;
+            continue;
+        }
+        _index.erase(key);
+        it = _entries.erase(it);
+        ++_stats.invalidations;
+    }
+}
+
+auto BindGroupCache::clear() -> void {
+    auto const lock = std::scoped_lock{_mutex};
+    _index.clear();
+    _entries.clear();
+}
+
+auto BindGroupCache::size() const -> std::size_t {
+    auto const lock = std::scoped_lock{_mutex};
+    return _entries.size();
+}
+
+auto BindGroupCache::stats() const -> BindGroupCacheStats {
+    auto const lock = std::scoped_lock{_mutex};
+    return _stats;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <tobi/BufferPool.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct BindGroupCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+    uint64_t invalidations{0};
+
+    [[nodiscard]] auto hitRate() const -> double;
+};
+
+// A bind group together with the dynamic offsets to pass to SetBindGroup.
+struct DynamicBindGroup {
+    wgpu::BindGroup group{};
+    std::vector<uint32_t> offsets{};
+};
+
+// Returns existing bind groups for repeated combinations of layout and buffer bindings, keyed by
+// the layout, and the buffer, offset and size of every entry. Only buffer bindings are supported.
+//
+// A cached bind group keeps its buffers alive: invalidate() drops the groups of a buffer that is
+// about to be destroyed, BufferPool::trim() does so for the blocks it destroys once the cache is
+// attached to the pool. Beyond the capacity the least recently used groups are evicted.
+// Thread-safe.
+struct BindGroupCache {
+    explicit BindGroupCache(wgpu::Device device, std::size_t capacity = 1024);
+
+    BindGroupCache(BindGroupCache const& other) = delete;
+    BindGroupCache(BindGroupCache&& other) = delete;
+
+    auto operator=(BindGroupCache const& other) -> BindGroupCache& = delete;
+    auto operator=(BindGroupCache&& other) -> BindGroupCache& = delete;
+
+    [[nodiscard]] auto get(wgpu::BindGroupLayout const& layout,
+                           std::span<wgpu::BindGroupEntry const> entries) -> wgpu::BindGroup;
+
+    // For layouts whose bindings all have dynamic offsets: binds each slice's buffer at offset
+    // zero with the slice's size and returns the slice offsets as dynamic offsets, so all slices
+    // of the same size in the same buffer share one bind group. Offsets must be multiples of the
+    // device's minimum binding offset alignment, which BufferPool slices are.
+    [[nodiscard]] auto dynamic(wgpu::BindGroupLayout const& layout,
+                               std::span<BufferSlice const> slices) -> DynamicBindGroup;
+
+    // Drops every bind group that binds the buffer.
+    auto invalidate(wgpu::Buffer const& buffer) -> void;
+    auto clear() -> void;
+
+    [[nodiscard]] auto size() const -> std::size_t;
+    [[nodiscard]] auto stats() const -> BindGroupCacheStats;
+
+  private:
+    using Key = std::vector<uint64_t>;
+
+    struct KeyHash {
+        auto operator()(Key const& key) const -> std::size_t;
+    };
+
+    struct Entry {
+        Key key{};
+        wgpu::BindGroup group{};
+    };
+
+    // Layout handle first, then binding, buffer handle, offset and size of every entry.
+    [[nodiscard]] static auto makeKey(wgpu::BindGroupLayout const& layout,
+                                      std::span<wgpu::BindGroupEntry const> entries) -> Key;
+
+    wgpu::Device _device{};
+    std::size_t _capacity{0};
+    mutable std::mutex _mutex{};
+    std::list<Entry> _entries{};
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index{};
+    BindGroupCacheStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,312 @@
+#include "BufferPool.hpp"
+
+#include <tobi/BindGroupCache.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace tobi::gpu {
+
+namespace {
+
+auto alignUp(uint64_t value, uint64_t alignment) -> uint64_t {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+auto isMappable(wgpu::BufferUsage usage) -> bool {
+    auto const mapUsage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::MapWrite;
+    return static_cast<uint32_t>(usage & mapUsage) != 0;
+}
+
+}  // namespace
+
+auto BufferPoolStats::reuseRate() const -> double {
+    if (allocations == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(reused) / static_cast<double>(allocations);
+}
+
+auto BufferPoolStats::internalFragmentation() const -> double {
+    if (bytesInUse == 0) {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(bytesRequested) / static_cast<double>(bytesInUse);
+}
+
+auto BufferPoolStats::externalFragmentation() const -> double {
+    if (bytesReserved == 0) {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(bytesInUse) / static_cast<double>(bytesReserved);
+}
+
+BufferPool::BufferPool(wgpu::Device device, uint64_t blockSize)
+    : _device{std::move(device)}, _blockSize{std::bit_ceil(std::max(blockSize, minSlotSize))} {}
+
+auto BufferPool::allocate(uint64_t size, wgpu::BufferUsage usage, Placement placement)
+    -> BufferSlice {
+    auto& b = bucket(size, usage, placement);
+    if (b.free.empty()) {
+        grow(b, usage);
+    } else {
+        ++_stats.reused;
+    }
+
+    auto const slot = b.free.back();
+    b.free.pop_back();
+    ++b.blocks[slot.block].liveSlots;
+
+    ++_stats.allocations;
+    _stats.bytesInUse += b.slotSize;
+    _stats.bytesRequested += size;
+    return {b.blocks[slot.block].buffer, slot.offset, size};
+}
+
+auto BufferPool::release(BufferSlice const& slice) -> void {
+    if (not slice) {
+        return;
+    }
+
+    auto const owns = [&](Bucket& candidate) {
+        return std::find_if(candidate.blocks.begin(), candidate.blocks.end(),
+                            [&](auto const& blk) { return blk.buffer == slice.buffer; });
+    };
+
+    auto const usage = slice.buffer.GetUsage();
+    auto* b = &bucket(slice.size, usage, Placement::Shared);
+    auto block = owns(*b);
+    if (block == b->blocks.end()) {
+        b = &bucket(slice.size, usage, Placement::Dedicated);
+        block = owns(*b);
+    }
+    if (block == b->blocks.end()) {
+        throw std::invalid_argument{"slice was not allocated from this pool"};
+    }
+
+    assert(block->liveSlots > 0);
+    --block->liveSlots;
+    b->free.push_back({static_cast<std::size_t>(block - b->blocks.begin()), slice.offset});
+
+    _stats.bytesInUse -= b->slotSize;
+    _stats.bytesRequested -= slice.size;
+}
+
+auto BufferPool::trim() -> void {
+    for (auto& [key, b] : _buckets) {
+        auto remap = std::vector<std::size_t>(b.blocks.size());
+        auto kept = std::vector<Block>{};
+        for (auto i = std::size_t{0}; i < b.blocks.size(); ++i) {
+            if (b.blocks[i].liveSlots == 0) {
+                if (_bindGroups != nullptr) {
+                    _bindGroups->invalidate(b.blocks[i].buffer);
+                }
+                b.blocks[i].buffer.Destroy();
+                _stats.bytesReserved -= b.blockSize;
+                remap[i] = b.blocks.size();
+                continue;
+            }
+            remap[i] = kept.size();
+            kept.push_back(std::move(b.blocks[i]));
+        }
+
+        auto const removed = b.blocks.size();
+        std::erase_if(b.free, [&](auto const& slot) { return remap[slot.block] == removed; });
+        for (auto& slot : b.free) {
+            slot.block = remap[slot.block];
+        }
+        b.blocks = std::move(kept);
+    }
+}
+
+auto BufferPool::attach(BindGroupCache* cache) -> void {
+    _bindGroups = cache;
+}
+
+auto BufferPool::stats() const -> BufferPoolStats {
+    return _stats;
+}
+
+auto BufferPool::bucket(uint64_t size, wgpu::BufferUsage usage, Placement placement) -> Bucket& {
+    auto const slotSize = std::bit_ceil(std::max(size, minSlotSize));
+    auto const key = BucketKey{static_cast<uint32_t>(usage), slotSize, placement};
+    auto [it, inserted] = _buckets.try_emplace(key);
+    if (inserted) {
+        // Small classes get smaller blocks, a rarely used size must not pin a whole block.
+        it->second.slotSize = slotSize;
+        it->second.blockSize = slotSize;
+        if (placement == Placement::Shared and not isMappable(usage)) {
+            it->second.blockSize = std::max(slotSize, std::min(_blockSize, slotSize * 64));
+        }
+    }
+    return it->second;
+}
+
+auto BufferPool::grow(Bucket& b, wgpu::BufferUsage usage) -> void {
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = b.blockSize;
+    descriptor.usage = usage;
+
+    auto const index = b.blocks.size();
+    b.blocks.push_back({_device.CreateBuffer(&descriptor), 0});
+
+    // Hand out low offsets first.
+    for (auto offset = b.blockSize; offset >= b.slotSize; offset -= b.slotSize) {
+        b.free.push_back({index, offset - b.slotSize});
+    }
+
+    ++_stats.buffersCreated;
+    _stats.bytesReserved += b.blockSize;
+}
+
+StagingRing::StagingRing(wgpu::Device device, uint64_t chunkSize)
+    : _device{std::move(device)}, _chunkSize{alignUp(chunkSize, 4)} {}
+
+StagingRing::~StagingRing() {
+    // Destroying a buffer with a pending map fires its callback, which takes the lock and
+    // deletes the chunk. The handles are copied out so they outlive the chunks.
+    auto buffers = std::vector<wgpu::Buffer>{};
+    {
+        auto lock = std::scoped_lock{_shared->mutex};
+        _shared->closed = true;
+        for (auto& chunk : _chunks) {
+            buffers.push_back(chunk->buffer);
+            if (chunk->inFlight) {
+                // The map callback still references the chunk and deletes it once it fires.
+                chunk.release();
+            }
+        }
+    }
+    for (auto const& buffer : buffers) {
+        buffer.Destroy();
+    }
+}
+
+auto StagingRing::upload(wgpu::CommandEncoder const& encoder,
+                         wgpu::Buffer const& dst,
+                         uint64_t dstOffset,
+                         void const* data,
+                         uint64_t size) -> void {
+    assert(size % 4 == 0);
+    assert(dstOffset % 4 == 0);
+
+    auto& chunk = acquire(size);
+    std::memcpy(chunk.mapped + chunk.cursor, data, size);
+    encoder.CopyBufferToBuffer(chunk.buffer, chunk.cursor, dst, dstOffset, size);
+
+    chunk.cursor += alignUp(size, 4);
+    _stats.bytesUploaded += size;
+}
+
+auto StagingRing::finish() -> void {
+    for (auto* chunk : _active) {
+        chunk->buffer.Unmap();
+        chunk->mapped = nullptr;
+        _closed.push_back(chunk);
+    }
+    _active.clear();
+}
+
+auto StagingRing::recycle() -> void {
+    dropFailed();
+
+    auto callback = [](WGPUBufferMapAsyncStatus status, void* userdata) {
+        auto* chunk = static_cast<Chunk*>(userdata);
+        auto const shared = chunk->shared;
+        auto lock = std::unique_lock{shared->mutex};
+        chunk->inFlight = false;
+
+        if (shared->closed) {
+            lock.unlock();
+            delete chunk;
+            return;
+        }
+        if (status != WGPUBufferMapAsyncStatus_Success) {
+            // The ring owns the chunk, it is dropped on the next acquire() or recycle().
+            shared->failed.push_back(chunk);
+            ++shared->dropped;
+            return;
+        }
+
+        chunk->mapped = static_cast<std::byte*>(chunk->buffer.GetMappedRange(0, chunk->size));
+        chunk->cursor = 0;
+        shared->free.push_back(chunk);
+        ++shared->recycled;
+    };
+
+    {
+        auto lock = std::scoped_lock{_shared->mutex};
+        for (auto* chunk : _closed) {
+            chunk->inFlight = true;
+        }
+    }
+
+    for (auto* chunk : _closed) {
+        chunk->buffer.MapAsync(wgpu::MapMode::Write, 0, chunk->size, callback, chunk);
+    }
+    _closed.clear();
+}
+
+auto StagingRing::stats() const -> StagingRingStats {
+    auto stats = _stats;
+    auto lock = std::scoped_lock{_shared->mutex};
+    stats.chunksRecycled = _shared->recycled;
+    stats.chunksDropped = _shared->dropped;
+    return stats;
+}
+
+auto StagingRing::acquire(uint64_t size) -> Chunk& {
+    for (auto* chunk : _active) {
+        if (chunk->cursor + size <= chunk->size) {
+            return *chunk;
+        }
+    }
+
+    {
+        auto lock = std::scoped_lock{_shared->mutex};
+        auto& free = _shared->free;
+        auto const fits = std::find_if(free.begin(), free.end(),
+                                       [size](auto const* chunk) { return chunk->size >= size; });
+        if (fits != free.end()) {
+            auto* chunk = *fits;
+            free.erase(fits);
+            _active.push_back(chunk);
+            return *chunk;
+        }
+    }
+    dropFailed();
+
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = std::max(_chunkSize, alignUp(size, 4));
+    descriptor.usage = wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc;
+    descriptor.mappedAtCreation = true;
+
+    auto chunk = std::make_unique<Chunk>();
+    chunk->shared = _shared;
+    chunk->buffer = _device.CreateBuffer(&descriptor);
+    chunk->size = descriptor.size;
+    chunk->mapped = static_cast<std::byte*>(chunk->buffer.GetMappedRange(0, chunk->size));
+
+    ++_stats.chunksCreated;
+    _active.push_back(chunk.get());
+    _chunks.push_back(std::move(chunk));
+    return *_active.back();
+}
+
+// Chunks whose map failed are unusable, a new chunk takes their place when needed.
+auto StagingRing::dropFailed() -> void {
+    auto failed = std::vector<Chunk*>{};
+    {
+        auto lock = std::scoped_lock{_shared->mutex};
+        failed.swap(_shared->failed);
+    }
+    for (auto* chunk : failed) {
+        chunk->buffer.Destroy();
+        std::erase_if(_chunks, [chunk](auto const& owned) { return owned.get() == chunk; });
+    }
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct BindGroupCache;
+
+struct BufferSlice {
+    wgpu::Buffer buffer{};
+    uint64_t offset{0};
+    uint64_t size{0};
+
+    explicit operator bool() const { return static_cast<bool>(buffer); }
+};
+
+struct BufferPoolStats {
+    uint64_t allocations{0};
+    uint64_t reused{0};
+    uint64_t buffersCreated{0};
+    uint64_t bytesReserved{0};
+    uint64_t bytesInUse{0};
+    uint64_t bytesRequested{0};
+
+    // Share of allocations served from a previously released slot.
+    [[nodiscard]] auto reuseRate() const -> double;
+
+    // Bytes lost to rounding requests up to their size class.
+    [[nodiscard]] auto internalFragmentation() const -> double;
+
+    // Reserved bytes that are not handed out at the moment.
+    [[nodiscard]] auto externalFragmentation() const -> double;
+};
+
+// Sub-allocates slices from large buffers. Buckets are keyed by usage flags and a power-of-two
+// size class, so every slot in a bucket is interchangeable and released slots are reused without
+// searching. Offsets are aligned to 256 bytes, which satisfies the storage and uniform binding
+// offset alignment of every WebGPU implementation. Mappable buffers can only be mapped as a whole
+// while a slice is in use, so MapRead/MapWrite requests get one dedicated buffer per slot.
+//
+// WebGPU tracks usage per buffer, not per range: a slice bound as writable storage must not share
+// its buffer with any other binding of the same dispatch. Such slices need Placement::Dedicated.
+struct BufferPool {
+    static constexpr uint64_t minSlotSize = 256;
+
+    enum struct Placement {
+        Shared,
+        Dedicated,
+    };
+
+    explicit BufferPool(wgpu::Device device, uint64_t blockSize = 64 * 1024 * 1024);
+
+    BufferPool(BufferPool const& other) = delete;
+    BufferPool(BufferPool&& other) = delete;
+
+    auto operator=(BufferPool const& other) -> BufferPool& = delete;
+    auto operator=(BufferPool&& other) -> BufferPool& = delete;
+
+    [[nodiscard]] auto allocate(uint64_t size,
+                                wgpu::BufferUsage usage,
+                                Placement placement = Placement::Shared) -> BufferSlice;
+    auto release(BufferSlice const& slice) -> void;
+
+    // Destroys blocks that have no live slices left.
+    auto trim() -> void;
+
+    // trim() drops the cached bind groups of the blocks it destroys. The cache must outlive the
+    // pool or be detached with nullptr.
+    auto attach(BindGroupCache* cache) -> void;
+
+    [[nodiscard]] auto stats() const -> BufferPoolStats;
+
+  private:
+    struct Block {
+        wgpu::Buffer buffer{};
+        uint32_t liveSlots{0};
+    };
+
+    struct Slot {
+        std::size_t block{0};
+        uint64_t offset{0};
+    };
+
+    struct Bucket {
+        uint64_t slotSize{0};
+        uint64_t blockSize{0};
+        std::vector<Block> blocks{};
+        std::vector<Slot> free{};
+    };
+
+    using BucketKey = std::tuple<uint32_t, uint64_t, Placement>;
+
+    [[nodiscard]] auto bucket(uint64_t size, wgpu::BufferUsage usage, Placement placement)
+        -> Bucket&;
+    auto grow(Bucket& bucket, wgpu::BufferUsage usage) -> void;
+
+    wgpu::Device _device{};
+    uint64_t _blockSize{0};
+    std::map<BucketKey, Bucket> _buckets{};
+    BindGroupCache* _bindGroups{nullptr};
+    BufferPoolStats _stats{};
+};
+
+struct StagingRingStats {
+    uint64_t chunksCreated{0};
+    uint64_t chunksRecycled{0};
+    uint64_t chunksDropped{0};  // the map to recycle them failed
+    uint64_t bytesUploaded{0};
+};
+
+// Upload path through persistently mapped MapWrite|CopySrc chunks. Chunks travel around a ring:
+// free (mapped) -> active (being written) -> closed (unmapped, referenced by recorded copies) ->
+// in flight (MapAsync pending) -> free. A chunk only becomes free again once its map callback
+// fires, which happens after the GPU consumed every copy reading from it. Map callbacks are
+// delivered while the device is ticked, e.g. by waitForQueue() or an EventPump thread.
+struct StagingRing {
+    explicit StagingRing(wgpu::Device device, uint64_t chunkSize = 4 * 1024 * 1024);
+    ~StagingRing();
+
+    StagingRing(StagingRing const& other) = delete;
+    StagingRing(StagingRing&& other) = delete;
+
+    auto operator=(StagingRing const& other) -> StagingRing& = delete;
+    auto operator=(StagingRing&& other) -> StagingRing& = delete;
+
+    // Copies size bytes into staging memory and records a copy into dst. Size and dstOffset
+    // must be multiples of 4, like for wgpu::Queue::WriteBuffer.
+    auto upload(wgpu::CommandEncoder const& encoder,
+                wgpu::Buffer const& dst,
+                uint64_t dstOffset,
+                void const* data,
+                uint64_t size) -> void;
+
+    // Unmaps all chunks written since the last call. Must run before the encoder is submitted.
+    auto finish() -> void;
+
+    // Requests closed chunks to be mapped again. Call after the submit that consumes them.
+    auto recycle() -> void;
+
+    [[nodiscard]] auto stats() const -> StagingRingStats;
+
+  private:
+    // State shared with map callbacks, which can outlive the ring and run on another thread.
+    struct Chunk;
+    struct Shared {
+        std::mutex mutex{};
+        std::vector<Chunk*> free{};
+        std::vector<Chunk*> failed{};
+        uint64_t recycled{0};
+        uint64_t dropped{0};
+        bool closed{false};
+    };
+
+    struct Chunk {
+        std::shared_ptr<Shared> shared{};
+        wgpu::Buffer buffer{};
+        uint64_t size{0};
+        uint64_t cursor{0};
+        std::byte* mapped{nullptr};
+        bool inFlight{false};
+    };
+
+    [[nodiscard]] auto acquire(uint64_t size) -> Chunk&;
+    auto dropFailed() -> void;
+
+    wgpu::Device _device{};
+    uint64_t _chunkSize{0};
+    std::vector<std::unique_ptr<Chunk>> _chunks{};
+    std::vector<Chunk*> _active{};
+    std::vector<Chunk*> _closed{};
+    std::shared_ptr<Shared> _shared{std::make_shared<Shared>()};
+    StagingRingStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,453 @@
+#include "Capabilities.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace tobi::gpu {
+
+namespace {
+
+constexpr auto featureNames = std::array<std::pair<wgpu::FeatureName, char const*>, 12>{{
+    {wgpu::FeatureName::DepthClipControl, "depth-clip-control"},
+    {wgpu::FeatureName::Depth32FloatStencil8, "depth32float-stencil8"},
+    {wgpu::FeatureName::TimestampQuery, "timestamp-query"},
+    {wgpu::FeatureName::TextureCompressionBC, "texture-compression-bc"},
+    {wgpu::FeatureName::IndirectFirstInstance, "indirect-first-instance"},
+    {wgpu::FeatureName::ShaderF16, "shader-f16"},
+    {wgpu::FeatureName::RG11B10UfloatRenderable, "rg11b10ufloat-renderable"},
+    {wgpu::FeatureName::BGRA8UnormStorage, "bgra8unorm-storage"},
+    {wgpu::FeatureName::Float32Filterable, "float32-filterable"},
+    {wgpu::FeatureName::ChromiumExperimentalSubgroups, "chromium-experimental-subgroups"},
+    {wgpu::FeatureName::ChromiumExperimentalTimestampQueryInsidePasses,
+     "chromium-experimental-timestamp-query-inside-passes"},
+    {wgpu::FeatureName::ImplicitDeviceSynchronization, "implicit-device-synchronization"},
+}};
+constexpr auto unknownFeaturePrefix = std::string_view{"feature-"};
+
+constexpr auto backendNames = std::array<std::pair<wgpu::BackendType, char const*>, 9>{{
+    {wgpu::BackendType::Undefined, "undefined"},
+    {wgpu::BackendType::Null, "null"},
+    {wgpu::BackendType::WebGPU, "webgpu"},
+    {wgpu::BackendType::D3D11, "d3d11"},
+    {wgpu::BackendType::D3D12, "d3d12"},
+    {wgpu::BackendType::Metal, "metal"},
+    {wgpu::BackendType::Vulkan, "vulkan"},
+    {wgpu::BackendType::OpenGL, "opengl"},
+    {wgpu::BackendType::OpenGLES, "opengles"},
+}};
+
+constexpr auto adapterTypeNames = std::array<std::pair<wgpu::AdapterType, char const*>, 4>{{
+    {wgpu::AdapterType::DiscreteGPU, "discrete-gpu"},
+    {wgpu::AdapterType::IntegratedGPU, "integrated-gpu"},
+    {wgpu::AdapterType::CPU, "cpu"},
+    {wgpu::AdapterType::Unknown, "unknown"},
+}};
+
+// clang-format off
+constexpr auto limits32 = std::array<std::pair<char const*, uint32_t wgpu::Limits::*>, 29>{{
+    {"maxTextureDimension1D", &wgpu::Limits::maxTextureDimension1D},
+    {"maxTextureDimension2D", &wgpu::Limits::maxTextureDimension2D},
+    {"maxTextureDimension3D", &wgpu::Limits::maxTextureDimension3D},
+    {"maxTextureArrayLayers", &wgpu::Limits::maxTextureArrayLayers},
+    {"maxBindGroups", &wgpu::Limits::maxBindGroups},
+    {"maxBindGroupsPlusVertexBuffers", &wgpu::Limits::maxBindGroupsPlusVertexBuffers},
+    {"maxBindingsPerBindGroup", &wgpu::Limits::maxBindingsPerBindGroup},
+    {"maxDynamicUniformBuffersPerPipelineLayout", &wgpu::Limits::maxDynamicUniformBuffersPerPipelineLayout},
+    {"maxDynamicStorageBuffersPerPipelineLayout", &wgpu::Limits::maxDynamicStorageBuffersPerPipelineLayout},
+    {"maxSampledTexturesPerShaderStage", &wgpu::Limits::maxSampledTexturesPerShaderStage},
+    {"maxSamplersPerShaderStage", &wgpu::Limits::maxSamplersPerShaderStage},
+    {"maxStorageBuffersPerShaderStage", &wgpu::Limits::maxStorageBuffersPerShaderStage},
+    {"maxStorageTexturesPerShaderStage", &wgpu::Limits::maxStorageTexturesPerShaderStage},
+    {"maxUniformBuffersPerShaderStage", &wgpu::Limits::maxUniformBuffersPerShaderStage},
+    {"minUniformBufferOffsetAlignment", &wgpu::Limits::minUniformBufferOffsetAlignment},
+    {"minStorageBufferOffsetAlignment", &wgpu::Limits::minStorageBufferOffsetAlignment},
+    {"maxVertexBuffers", &wgpu::Limits::maxVertexBuffers},
+    {"maxVertexAttributes", &wgpu::Limits::maxVertexAttributes},
+    {"maxVertexBufferArrayStride", &wgpu::Limits::maxVertexBufferArrayStride},
+    {"maxInterStageShaderComponents", &wgpu::Limits::maxInterStageShaderComponents},
+    {"maxInterStageShaderVariables", &wgpu::Limits::maxInterStageShaderVariables},
+    {"maxColorAttachments", &wgpu::Limits::maxColorAttachments},
+    {"maxColorAttachmentBytesPerSample", &wgpu::Limits::maxColorAttachmentBytesPerSample},
+    {"maxComputeWorkgroupStorageSize", &wgpu::Limits::maxComputeWorkgroupStorageSize},
+    {"maxComputeInvocationsPerWorkgroup", &wgpu::Limits::maxComputeInvocationsPerWorkgroup},
+    {"maxComputeWorkgroupSizeX", &wgpu::Limits::maxComputeWorkgroupSizeX},
+    {"maxComputeWorkgroupSizeY", &wgpu::Limits::maxComputeWorkgroupSizeY},
+    {"maxComputeWorkgroupSizeZ", &wgpu::Limits::maxComputeWorkgroupSizeZ},
+    {"maxComputeWorkgroupsPerDimension", &wgpu::Limits::maxComputeWorkgroupsPerDimension},
+}};
+
+constexpr auto limits64 = std::array<std::pair<char const*, uint64_t wgpu::Limits::*>, 3>{{
+    {"maxUniformBufferBindingSize", &wgpu::Limits::maxUniformBufferBindingSize},
+    {"maxStorageBufferBindingSize", &wgpu::Limits::maxStorageBufferBindingSize},
+    {"maxBufferSize", &wgpu::Limits::maxBufferSize},
+}};
+// clang-format on
+
+template <typename Enum, std::size_t N>
+auto nameOf(std::array<std::pair<Enum, char const*>, N> const& names, Enum value)
+    -> std::string_view {
+    auto const found = std::find_if(names.begin(), names.end(),
+                                    [&](auto const& entry) { return entry.first == value; });
+    return found != names.end() ? found->second : "unknown";
+}
+
+template <typename Enum, std::size_t N>
+auto valueOf(std::array<std::pair<Enum, char const*>, N> const& names, std::string_view name)
+    -> std::optional<Enum> {
+    auto const found = std::find_if(names.begin(), names.end(),
+                                    [&](auto const& entry) { return entry.second == name; });
+    return found != names.end() ? std::optional{found->first} : std::nullopt;
+}
+
+auto parseFeature(std::string_view name) -> std::optional<wgpu::FeatureName> {
+    if (auto const feature = valueOf(featureNames, name)) {
+        return feature;
+    }
+    if (name.starts_with(unknownFeaturePrefix)) {
+        name.remove_prefix(unknownFeaturePrefix.size());
+        auto value = uint32_t{0};
+        auto const [end, error] = std::from_chars(name.data(), name.data() + name.size(), value);
+        if (error == std::errc{} and end == name.data() + name.size()) {
+            return static_cast<wgpu::FeatureName>(value);
+        }
+    }
+    return std::nullopt;
+}
+
+auto quoted(std::string_view text) -> std::string {
+    auto result = std::string{"\""};
+    for (auto const c : text) {
+        if (c == '"' or c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            result += fmt::format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            result += c;
+        }
+    }
+    return result + '"';
+}
+
+// Just enough JSON for what toJson() writes: objects, arrays, strings and unsigned integers.
+// Other values are skipped.
+struct JsonReader {
+    std::string_view text;
+    std::size_t pos{0};
+
+    auto fail() const -> void {
+        throw std::invalid_argument{fmt::format("malformed capabilities JSON at offset {}", pos)};
+    }
+
+    auto peek() -> char {
+        while (pos < text.size() and
+               (text[pos] == ' ' or text[pos] == '\n' or text[pos] == '\r' or text[pos] == '\t')) {
+            ++pos;
+        }
+        if (pos == text.size()) {
+            fail();
+        }
+        return text[pos];
+    }
+
+    auto expect(char c) -> void {
+        if (peek() != c) {
+            fail();
+        }
+        ++pos;
+    }
+
+    auto string() -> std::string {
+        expect('"');
+        auto result = std::string{};
+        while (pos < text.size() and text[pos] != '"') {
+            auto c = text[pos++];
+            if (c == '\\' and pos < text.size()) {
+                c = text[pos++];
+                if (c == 'u' and pos + 4 <= text.size()) {
+                    auto code = 0U;
+                    std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16);
+                    c = static_cast<char>(code);
+                    pos += 4;
+                } else if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                }
+            }
+            result += c;
+        }
+        expect('"');
+        return result;
+    }
+
+    auto number() -> uint64_t {
+        peek();
+        auto value = uint64_t{0};
+        auto const [end, error] =
+            std::from_chars(text.data() + pos, text.data() + text.size(), value);
+        if (error != std::errc{}) {
+            fail();
+        }
+        pos = static_cast<std::size_t>(end - text.data());
+        return value;
+    }
+
+    template <typename Fn>
+    auto array(Fn&& element) -> void {
+        expect('[');
+        if (peek() == ']') {
+            ++pos;
+            return;
+        }
+        while (true) {
+            element();
+            if (peek() != ',') {
+                break;
+            }
+            ++pos;
+        }
+        expect(']');
+    }
+
+    template <typename Fn>
+    auto object(Fn&& member) -> void {
+        expect('{');
+        if (peek() == '}') {
+            ++pos;
+            return;
+        }
+        while (true) {
+            auto const key = string();
+            expect(':');
+            member(key);
+            if (peek() != ',') {
+                break;
+            }
+            ++pos;
+        }
+        expect('}');
+    }
+
+    auto skip() -> void {
+        switch (peek()) {
+            case '"':
+                (void)string();
+                break;
+            case '[':
+                array([this] { skip(); });
+                break;
+            case '{':
+                object([this](std::string const&) { skip(); });
+                break;
+            default:
+                while (pos < text.size() and text[pos] != ',' and text[pos] != '}' and
+                       text[pos] != ']') {
+                    ++pos;
+                }
+        }
+    }
+};
+
+struct CapabilitiesCache {
+    std::mutex mutex{};
+    std::unordered_map<WGPUDevice, Capabilities> devices{};
+};
+
+auto cache() -> CapabilitiesCache& {
+    static auto instance = CapabilitiesCache{};
+    return instance;
+}
+
+template <typename T>
+auto queryFeatures(T const& object) -> std::vector<wgpu::FeatureName> {
+    auto features = std::vector<wgpu::FeatureName>(object.EnumerateFeatures(nullptr));
+    object.EnumerateFeatures(features.data());
+    std::sort(features.begin(), features.end());
+    return features;
+}
+
+}  // namespace
+
+auto Capabilities::query(wgpu::Adapter const& adapter) -> Capabilities {
+    auto capabilities = Capabilities{};
+    capabilities.features = queryFeatures(adapter);
+
+    auto limits = wgpu::SupportedLimits{};
+    if (adapter.GetLimits(&limits)) {
+        capabilities.limits = limits.limits;
+    }
+
+    auto properties = wgpu::AdapterProperties{};
+    adapter.GetProperties(&properties);
+    capabilities.name = properties.name != nullptr ? properties.name : "";
+    capabilities.driver = properties.driverDescription != nullptr ? properties.driverDescription
+                                                                  : "";
+    capabilities.vendorId = properties.vendorID;
+    capabilities.deviceId = properties.deviceID;
+    capabilities.backend = properties.backendType;
+    capabilities.adapterType = properties.adapterType;
+    return capabilities;
+}
+
+auto Capabilities::query(wgpu::Device const& device) -> Capabilities {
+#ifdef __EMSCRIPTEN__
+    // The browser does not hand out the adapter of the device.
+    auto capabilities = Capabilities{};
+    capabilities.backend = wgpu::BackendType::WebGPU;
+#else
+    auto capabilities = query(device.GetAdapter());
+#endif
+    capabilities.features = queryFeatures(device);
+
+    auto limits = wgpu::SupportedLimits{};
+    if (device.GetLimits(&limits)) {
+        capabilities.limits = limits.limits;
+    }
+    return capabilities;
+}
+
+auto Capabilities::has(wgpu::FeatureName feature) const -> bool {
+    return std::find(features.begin(), features.end(), feature) != features.end();
+}
+
+auto Capabilities::isSoftware() const -> bool {
+    return adapterType == wgpu::AdapterType::CPU;
+}
+
+auto Capabilities::toJson() const -> std::string {
+    auto json = fmt::format(R"({{"name":{},"driver":{},"vendorId":{},"deviceId":{},)",
+                            quoted(name), quoted(driver), vendorId, deviceId);
+    json += fmt::format(R"("backend":"{}","adapterType":"{}","features":[)", toString(backend),
+                        toString(adapterType));
+    for (auto i = std::size_t{0}; i < features.size(); ++i) {
+        json += fmt::format(R"({}"{}")", i == 0 ? "" : ",", toString(features[i]));
+    }
+    json += R"(],"limits":{)";
+    for (auto i = std::size_t{0}; i < limits32.size(); ++i) {
+        json += fmt::format(R"({}"{}":{})", i == 0 ? "" : ",", limits32[i].first,
+                            limits.*limits32[i].second);
+    }
+    for (auto const& [key, member] : limits64) {
+        json += fmt::format(R"(,"{}":{})", key, limits.*member);
+    }
+    json += "}}";
+    return json;
+}
+
+auto Capabilities::fromJson(std::string_view json) -> Capabilities {
+    auto capabilities = Capabilities{};
+    auto reader = JsonReader{json};
+    reader.object([&](std::string const& key) {
+        if (key == "name") {
+            capabilities.name = reader.string();
+        } else if (key == "driver") {
+            capabilities.driver = reader.string();
+        } else if (key == "vendorId") {
+            capabilities.vendorId = static_cast<uint32_t>(reader.number());
+        } else if (key == "deviceId") {
+            capabilities.deviceId = static_cast<uint32_t>(reader.number());
+        } else if (key == "backend") {
+            capabilities.backend = parseBackend(reader.string()).value_or(wgpu::BackendType{});
+        } else if (key == "adapterType") {
+            capabilities.adapterType = valueOf(adapterTypeNames, reader.string())
+                                           .value_or(wgpu::AdapterType::Unknown);
+        } else if (key == "features") {
+            reader.array([&] {
+                if (auto const feature = parseFeature(reader.string())) {
+                    capabilities.features.push_back(*feature);
+                }
+            });
+            std::sort(capabilities.features.begin(), capabilities.features.end());
+        } else if (key == "limits") {
+            reader.object([&](std::string const& limit) {
+                auto const is = [&](auto const& entry) { return limit == entry.first; };
+                if (auto const found = std::find_if(limits32.begin(), limits32.end(), is);
+                    found != limits32.end()) {
+                    capabilities.limits.*found->second = static_cast<uint32_t>(reader.number());
+                } else if (auto const found64 = std::find_if(limits64.begin(), limits64.end(), is);
+                           found64 != limits64.end()) {
+                    capabilities.limits.*found64->second = reader.number();
+                } else {
+                    reader.skip();
+                }
+            });
+        } else {
+            reader.skip();
+        }
+    });
+    return capabilities;
+}
+
+auto Capabilities::describe() const -> std::string {
+    auto text = fmt::format("{} ({}, {})\n", name, toString(backend), toString(adapterType));
+    if (not driver.empty()) {
+        text += fmt::format("driver: {}\n", driver);
+    }
+    text += fmt::format("vendor: {:#06x}, device: {:#06x}\nfeatures:", vendorId, deviceId);
+    for (auto const feature : features) {
+        text += fmt::format(" {}", toString(feature));
+    }
+    text += "\nlimits:\n";
+    for (auto const& [key, member] : limits32) {
+        text += fmt::format(" - {}: {}\n", key, limits.*member);
+    }
+    for (auto const& [key, member] : limits64) {
+        text += fmt::format(" - {}: {}\n", key, limits.*member);
+    }
+    return text;
+}
+
+auto capabilities(wgpu::Device const& device) -> Capabilities {
+    auto& shared = cache();
+    {
+        auto const lock = std::lock_guard{shared.mutex};
+        if (auto const found = shared.devices.find(device.Get()); found != shared.devices.end()) {
+            return found->second;
+        }
+    }
+    return Capabilities::query(device);
+}
+
+auto cacheCapabilities(wgpu::Device const& device) -> void {
+    auto capabilities = Capabilities::query(device);
+    auto& shared = cache();
+    auto const lock = std::lock_guard{shared.mutex};
+    shared.devices.insert_or_assign(device.Get(), std::move(capabilities));
+}
+
+auto evictCapabilities(WGPUDevice device) -> void {
+    auto& shared = cache();
+    auto const lock = std::lock_guard{shared.mutex};
+    shared.devices.erase(device);
+}
+
+auto toString(wgpu::FeatureName feature) -> std::string {
+    if (auto const found = std::find_if(featureNames.begin(), featureNames.end(),
+                                        [&](auto const& entry) { return entry.first == feature; });
+        found != featureNames.end()) {
+        return found->second;
+    }
+    return fmt::format("{}{}", unknownFeaturePrefix, static_cast<uint32_t>(feature));
+}
+
+auto toString(wgpu::BackendType backend) -> std::string_view {
+    return nameOf(backendNames, backend);
+}
+
+auto toString(wgpu::AdapterType type) -> std::string_view {
+    return nameOf(adapterTypeNames, type);
+}
+
+auto parseBackend(std::string_view name) -> std::optional<wgpu::BackendType> {
+    return valueOf(backendNames, name);
+}
+
+}  // namespace tobi::gpu
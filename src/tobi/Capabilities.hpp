@@ -0,0 +1,60 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tobi::gpu {
+
+// What an adapter or device offers: where it runs, the features it has and its limits. For a
+// device these are the features that were enabled and the limits it was created with, not what
+// the adapter could have offered.
+//
+// Serializes to a flat JSON object, e.g. to keep next to benchmark results or to compare
+// machines without having their GPUs at hand.
+struct Capabilities {
+    std::string name{};
+    std::string driver{};
+    uint32_t vendorId{0};
+    uint32_t deviceId{0};
+    wgpu::BackendType backend{wgpu::BackendType::Undefined};
+    wgpu::AdapterType adapterType{wgpu::AdapterType::Unknown};
+    std::vector<wgpu::FeatureName> features{};
+    wgpu::Limits limits{};
+
+    [[nodiscard]] static auto query(wgpu::Adapter const& adapter) -> Capabilities;
+    [[nodiscard]] static auto query(wgpu::Device const& device) -> Capabilities;
+
+    [[nodiscard]] auto has(wgpu::FeatureName feature) const -> bool;
+    [[nodiscard]] auto isSoftware() const -> bool;
+
+    [[nodiscard]] auto toJson() const -> std::string;
+
+    // Unknown keys are skipped, missing ones keep their defaults. std::invalid_argument if the
+    // text is not a JSON object.
+    [[nodiscard]] static auto fromJson(std::string_view json) -> Capabilities;
+
+    // Properties, features by name and all limits, one per line.
+    [[nodiscard]] auto describe() const -> std::string;
+};
+
+// Queried once per device and cached. Devices from getDefaultDevice are evicted when they are
+// lost or destroyed; other devices are queried on every call instead.
+[[nodiscard]] auto capabilities(wgpu::Device const& device) -> Capabilities;
+
+// Called by getDefaultDevice.
+auto cacheCapabilities(wgpu::Device const& device) -> void;
+auto evictCapabilities(WGPUDevice device) -> void;
+
+// WebGPU spec names, e.g. "shader-f16", "vulkan", "discrete-gpu".
+[[nodiscard]] auto toString(wgpu::FeatureName feature) -> std::string;
+[[nodiscard]] auto toString(wgpu::BackendType backend) -> std::string_view;
+[[nodiscard]] auto toString(wgpu::AdapterType type) -> std::string_view;
+
+[[nodiscard]] auto parseBackend(std::string_view name) -> std::optional<wgpu::BackendType>;
+
+}  // namespace tobi::gpu
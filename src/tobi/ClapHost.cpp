@@ -0,0 +1,393 @@
+#include "ClapHost.hpp"
+
+#include <tobi/Simd.hpp>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace tobi {
+
+namespace {
+
+thread_local bool isAudioThread = false;
+auto const mainThread = std::this_thread::get_id();
+
+auto openLibrary(std::filesystem::path const& path) -> void* {
+#ifdef _WIN32
+    return static_cast<void*>(LoadLibraryW(path.c_str()));
+#else
+    return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+auto closeLibrary(void* handle) -> void {
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(handle));
+#else
+    dlclose(handle);
+#endif
+}
+
+auto findEntry(void* handle) -> clap_plugin_entry_t const* {
+#ifdef _WIN32
+    auto* symbol = GetProcAddress(static_cast<HMODULE>(handle), "clap_entry");
+#else
+    auto* symbol = dlsym(handle, "clap_entry");
+#endif
+    return reinterpret_cast<clap_plugin_entry_t const*>(symbol);
+}
+
+// On macOS a .clap is a bundle directory with the binary inside.
+auto binaryPath(std::filesystem::path const& path) -> std::filesystem::path {
+#ifdef __APPLE__
+    if (std::filesystem::is_directory(path)) {
+        return path / "Contents" / "MacOS" / path.stem();
+    }
+#endif
+    return path;
+}
+
+auto emptySize(clap_input_events_t const* /*events*/) -> uint32_t {
+    return 0;
+}
+
+auto emptyGet(clap_input_events_t const* /*events*/, uint32_t /*index*/)
+    -> clap_event_header_t const* {
+    return nullptr;
+}
+
+auto discardPush(clap_output_events_t const* /*events*/, clap_event_header_t const* /*event*/)
+    -> bool {
+    return true;
+}
+
+constexpr auto noInputEvents = clap_input_events_t{nullptr, emptySize, emptyGet};
+constexpr auto discardOutputEvents = clap_output_events_t{nullptr, discardPush};
+
+}  // namespace
+
+// Entries must see init() once before any plugin is created and deinit() after the last one is
+// destroyed, so instances from the same file share one library.
+struct ClapPlugin::Library {
+    void* handle{nullptr};
+    clap_plugin_entry_t const* entry{nullptr};
+
+    Library(void* h, clap_plugin_entry_t const* e) : handle{h}, entry{e} {}
+
+    ~Library() {
+        entry->deinit();
+        if (handle != nullptr) {
+            closeLibrary(handle);
+        }
+    }
+
+    Library(Library const& other) = delete;
+    Library(Library&& other) = delete;
+
+    auto operator=(Library const& other) -> Library& = delete;
+    auto operator=(Library&& other) -> Library& = delete;
+
+    static auto acquire(std::string const& key,
+                        std::filesystem::path const& path,
+                        clap_plugin_entry_t const* entry) -> std::shared_ptr<Library> {
+        static auto mutex = std::mutex{};
+        static auto libraries = std::map<std::string, std::weak_ptr<Library>>{};
+
+        auto lock = std::scoped_lock{mutex};
+        if (auto existing = libraries[key].lock()) {
+            return existing;
+        }
+
+        auto* handle = static_cast<void*>(nullptr);
+        if (entry == nullptr) {
+            handle = openLibrary(binaryPath(path));
+            if (handle == nullptr) {
+                throw std::runtime_error{"cannot open " + path.string()};
+            }
+            entry = findEntry(handle);
+            if (entry == nullptr) {
+                closeLibrary(handle);
+                throw std::runtime_error{path.string() + " has no clap_entry"};
+            }
+        }
+
+        if (not clap_version_is_compatible(entry->clap_version) or
+            not entry->init(path.string().c_str())) {
+            if (handle != nullptr) {
+                closeLibrary(handle);
+            }
+            throw std::runtime_error{"cannot initialize " + path.string()};
+        }
+
+        auto library = std::make_shared<Library>(handle, entry);
+        libraries[key] = library;
+        return library;
+    }
+};
+
+auto ClapPlugin::load(std::filesystem::path const& path, std::string const& id)
+    -> std::unique_ptr<ClapPlugin> {
+    auto library = Library::acquire(std::filesystem::absolute(path).string(), path, nullptr);
+    return std::unique_ptr<ClapPlugin>{new ClapPlugin{std::move(library), id}};
+}
+
+auto ClapPlugin::create(clap_plugin_entry_t const& entry, std::string const& id)
+    -> std::unique_ptr<ClapPlugin> {
+    auto const key = "static:" + std::to_string(reinterpret_cast<uintptr_t>(&entry));
+    auto library = Library::acquire(key, {}, &entry);
+    return std::unique_ptr<ClapPlugin>{new ClapPlugin{std::move(library), id}};
+}
+
+ClapPlugin::ClapPlugin(std::shared_ptr<Library> library, std::string const& id)
+    : _library{std::move(library)} {
+    _host.clap_version = CLAP_VERSION_INIT;
+    _host.host_data = this;
+    _host.name = "tobi";
+    _host.vendor = "tobi";
+    _host.url = "";
+    _host.version = "0.1.0";
+    _host.get_extension = [](clap_host_t const* /*host*/, char const* extension) -> void const* {
+        static constexpr auto threadPool = clap_host_thread_pool_t{
+            [](clap_host_t const* host, uint32_t tasks) -> bool {
+                auto& self = fromHost(host);
+                if (self._threadPool == nullptr) {
+                    return false;
+                }
+                auto const exec = [&](uint32_t task) {
+                    self._threadPool->exec(self._plugin, task);
+                };
+                if (self._pool != nullptr) {
+                    self._pool->parallelFor(tasks, exec);
+                } else {
+                    for (auto task = uint32_t{0}; task < tasks; ++task) {
+                        exec(task);
+                    }
+                }
+                return true;
+            },
+        };
+        static constexpr auto threadCheck = clap_host_thread_check_t{
+            [](clap_host_t const* /*host*/) { return std::this_thread::get_id() == mainThread; },
+            [](clap_host_t const* /*host*/) {
+                return isAudioThread or ThreadPool::onWorkerThread();
+            },
+        };
+
+        if (std::strcmp(extension, CLAP_EXT_THREAD_POOL) == 0) {
+            return &threadPool;
+        }
+        if (std::strcmp(extension, CLAP_EXT_THREAD_CHECK) == 0) {
+            return &threadCheck;
+        }
+        return nullptr;
+    };
+    _host.request_restart = [](clap_host_t const* /*host*/) {};
+    _host.request_process = [](clap_host_t const* /*host*/) {};
+    _host.request_callback = [](clap_host_t const* host) {
+        fromHost(host)._callbackRequested = true;
+    };
+
+    auto const* entry = _library->entry;
+    auto const* factory =
+        static_cast<clap_plugin_factory_t const*>(entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    if (factory == nullptr or factory->get_plugin_count(factory) == 0) {
+        throw std::runtime_error{"no plugin factory"};
+    }
+
+    auto pluginId = id;
+    if (pluginId.empty()) {
+        pluginId = factory->get_plugin_descriptor(factory, 0)->id;
+    }
+    _plugin = factory->create_plugin(factory, &_host, pluginId.c_str());
+    if (_plugin == nullptr) {
+        throw std::runtime_error{"cannot create plugin " + pluginId};
+    }
+    if (not _plugin->init(_plugin)) {
+        _plugin->destroy(_plugin);
+        throw std::runtime_error{"cannot initialize plugin " + pluginId};
+    }
+
+    _threadPool = static_cast<clap_plugin_thread_pool_t const*>(
+        _plugin->get_extension(_plugin, CLAP_EXT_THREAD_POOL));
+
+    auto const* ports = static_cast<clap_plugin_audio_ports_t const*>(
+        _plugin->get_extension(_plugin, CLAP_EXT_AUDIO_PORTS));
+    auto info = clap_audio_port_info_t{};
+    if (ports != nullptr and ports->count(_plugin, true) > 0 and
+        ports->get(_plugin, 0, true, &info)) {
+        _inputChannels = std::min(info.channel_count, uint32_t{2});
+    }
+}
+
+ClapPlugin::~ClapPlugin() {
+    deactivate();
+    _plugin->destroy(_plugin);
+}
+
+auto ClapPlugin::fromHost(clap_host_t const* host) -> ClapPlugin& {
+    return *static_cast<ClapPlugin*>(host->host_data);
+}
+
+auto ClapPlugin::name() const -> std::string {
+    return _plugin->desc != nullptr and _plugin->desc->name != nullptr ? _plugin->desc->name : "";
+}
+
+auto ClapPlugin::setThreadPool(ThreadPool* pool) -> void {
+    _pool = pool;
+}
+
+auto ClapPlugin::activate(double sampleRate, uint32_t maxFrames) -> void {
+    deactivate();
+    if (not _plugin->activate(_plugin, sampleRate, 1, maxFrames)) {
+        throw std::runtime_error{"cannot activate plugin " + name()};
+    }
+    _active = true;
+}
+
+auto ClapPlugin::deactivate() -> void {
+    if (not _active) {
+        return;
+    }
+    // The audio side is stopped at this point, so this thread acts as the audio thread.
+    if (_processing) {
+        _plugin->stop_processing(_plugin);
+        _processing = false;
+    }
+    _plugin->deactivate(_plugin);
+    _active = false;
+}
+
+auto ClapPlugin::idle() -> void {
+    if (_callbackRequested.exchange(false)) {
+        _plugin->on_main_thread(_plugin);
+    }
+}
+
+auto ClapPlugin::process(float* const* input,
+                         float* const* output,
+                         uint32_t frames,
+                         int64_t steadyTime) -> clap_process_status {
+    auto const previous = isAudioThread;
+    isAudioThread = true;
+    if (not _processing) {
+        _processing = _plugin->start_processing(_plugin);
+    }
+
+    auto inputBuffer = clap_audio_buffer_t{};
+    inputBuffer.data32 = const_cast<float**>(input);
+    inputBuffer.channel_count = _inputChannels;
+
+    auto outputBuffer = clap_audio_buffer_t{};
+    outputBuffer.data32 = const_cast<float**>(output);
+    outputBuffer.channel_count = 2;
+
+    auto process = clap_process_t{};
+    process.steady_time = steadyTime;
+    process.frames_count = frames;
+    process.audio_inputs = &inputBuffer;
+    process.audio_inputs_count = _inputChannels > 0 and input != nullptr ? 1 : 0;
+    process.audio_outputs = &outputBuffer;
+    process.audio_outputs_count = 1;
+    process.in_events = &noInputEvents;
+    process.out_events = &discardOutputEvents;
+
+    auto const status = _processing ? _plugin->process(_plugin, &process) : CLAP_PROCESS_ERROR;
+    isAudioThread = previous;
+    return status;
+}
+
+ClapHost::ClapHost(uint32_t workers) : _pool{workers} {}
+
+ClapHost::~ClapHost() = default;
+
+auto ClapHost::addChain() -> std::size_t {
+    _chains.push_back(std::make_unique<Chain>());
+    return _chains.size() - 1;
+}
+
+auto ClapHost::add(std::size_t chain, std::unique_ptr<ClapPlugin> plugin) -> ClapPlugin& {
+    auto& ref = *plugin;
+    ref.setThreadPool(&_pool);
+    _chains.at(chain)->plugins.push_back(std::move(plugin));
+    return ref;
+}
+
+auto ClapHost::idle() -> void {
+    for (auto& chain : _chains) {
+        for (auto& plugin : chain->plugins) {
+            plugin->idle();
+        }
+    }
+}
+
+auto ClapHost::chains() const -> std::size_t {
+    return _chains.size();
+}
+
+auto ClapHost::pool() -> ThreadPool& {
+    return _pool;
+}
+
+auto ClapHost::prepare(double sampleRate) -> void {
+    for (auto& chain : _chains) {
+        for (auto& plugin : chain->plugins) {
+            plugin->activate(sampleRate, audio::blockSize);
+        }
+    }
+}
+
+auto ClapHost::process(audio::ProcessContext const& context,
+                       std::span<audio::AudioBus const* const> /*inputs*/,
+                       std::span<audio::AudioBus> outputs) -> void {
+    auto const steadyTime = static_cast<int64_t>(context.frame);
+    _pool.parallelFor(static_cast<uint32_t>(_chains.size()),
+                      [&](uint32_t index) { processChain(*_chains[index], steadyTime); });
+
+    // Summed on this thread in chain order, so the result does not depend on scheduling.
+    auto& out = outputs[0];
+    for (auto& channel : out.channel) {
+        audio::simd::clear(channel.data(), audio::blockSize);
+    }
+    for (auto const& chain : _chains) {
+        auto const& bus = chain->buses[chain->result];
+        for (auto ch = std::size_t{0}; ch < audio::channels; ++ch) {
+            audio::simd::add(out.channel[ch].data(), bus.channel[ch].data(), audio::blockSize);
+        }
+    }
+}
+
+auto ClapHost::processChain(Chain& chain, int64_t steadyTime) -> void {
+    auto current = std::size_t{0};
+    for (auto& channel : chain.buses[current].channel) {
+        audio::simd::clear(channel.data(), audio::blockSize);
+    }
+
+    for (auto& plugin : chain.plugins) {
+        auto& in = chain.buses[current];
+        auto& out = chain.buses[1 - current];
+        auto inputs = std::array<float*, 2>{in.channel[0].data(), in.channel[1].data()};
+        auto outputs = std::array<float*, 2>{out.channel[0].data(), out.channel[1].data()};
+
+        auto const status = plugin->process(inputs.data(), outputs.data(),
+                                            static_cast<uint32_t>(audio::blockSize), steadyTime);
+        if (status == CLAP_PROCESS_ERROR) {
+            for (auto& channel : out.channel) {
+                audio::simd::clear(channel.data(), audio::blockSize);
+            }
+        }
+        current = 1 - current;
+    }
+    chain.result = current;
+}
+
+}  // namespace tobi
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <tobi/AudioGraph.hpp>
+#include <tobi/ThreadPool.hpp>
+
+#include <clap/clap.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tobi {
+
+// One plugin instance and the clap_host it sees. Main thread: construction, activate(),
+// deactivate(), idle(). Audio thread: process().
+struct ClapPlugin {
+    // Loads the plugin with the given id from a .clap file, the first one if id is empty.
+    // Throws std::runtime_error if the file or the plugin cannot be loaded.
+    [[nodiscard]] static auto load(std::filesystem::path const& path, std::string const& id = {})
+        -> std::unique_ptr<ClapPlugin>;
+
+    // Plugins linked into the executable, e.g. for tests and benchmarks.
+    [[nodiscard]] static auto create(clap_plugin_entry_t const& entry,
+                                     std::string const& id = {}) -> std::unique_ptr<ClapPlugin>;
+
+    ~ClapPlugin();
+
+    ClapPlugin(ClapPlugin const& other) = delete;
+    ClapPlugin(ClapPlugin&& other) = delete;
+
+    auto operator=(ClapPlugin const& other) -> ClapPlugin& = delete;
+    auto operator=(ClapPlugin&& other) -> ClapPlugin& = delete;
+
+    [[nodiscard]] auto name() const -> std::string;
+
+    // Work requested through the thread-pool extension runs here, serially if null.
+    auto setThreadPool(ThreadPool* pool) -> void;
+
+    auto activate(double sampleRate, uint32_t maxFrames) -> void;
+    auto deactivate() -> void;
+
+    // Runs on_main_thread() if the plugin asked for it.
+    auto idle() -> void;
+
+    // Stereo in and out, planar. Input may be null for plugins without audio inputs.
+    auto process(float* const* input, float* const* output, uint32_t frames, int64_t steadyTime)
+        -> clap_process_status;
+
+  private:
+    struct Library;
+
+    ClapPlugin(std::shared_ptr<Library> library, std::string const& id);
+
+    static auto fromHost(clap_host_t const* host) -> ClapPlugin&;
+
+    std::shared_ptr<Library> _library;
+    clap_host_t _host{};
+    clap_plugin_t const* _plugin{nullptr};
+    clap_plugin_thread_pool_t const* _threadPool{nullptr};
+    ThreadPool* _pool{nullptr};
+    uint32_t _inputChannels{0};
+    bool _active{false};
+    bool _processing{false};
+    std::atomic<bool> _callbackRequested{false};
+};
+
+// Hosts CLAP plugins as a node of an audio::Graph. Plugins are arranged in independent chains,
+// each chain runs its plugins in series and the chains run in parallel on a ThreadPool; their
+// outputs are summed. The same pool serves the plugins' thread-pool extension requests, which
+// run serially when they arrive from inside a parallel chain.
+struct ClapHost final : audio::Node {
+    explicit ClapHost(uint32_t workers = ThreadPool::defaultWorkers());
+    ~ClapHost() override;
+
+    [[nodiscard]] auto numInputs() const -> std::size_t override { return 0; }
+
+    // Main thread, before prepare().
+    auto addChain() -> std::size_t;
+    auto add(std::size_t chain, std::unique_ptr<ClapPlugin> plugin) -> ClapPlugin&;
+
+    // Main thread, e.g. once per UI frame.
+    auto idle() -> void;
+
+    [[nodiscard]] auto chains() const -> std::size_t;
+    [[nodiscard]] auto pool() -> ThreadPool&;
+
+    auto prepare(double sampleRate) -> void override;
+    auto process(audio::ProcessContext const& context,
+                 std::span<audio::AudioBus const* const> inputs,
+                 std::span<audio::AudioBus> outputs) -> void override;
+
+  private:
+    struct Chain {
+        std::vector<std::unique_ptr<ClapPlugin>> plugins{};
+        std::array<audio::AudioBus, 2> buses{};  // ping-pong between plugins
+        std::size_t result{0};
+    };
+
+    auto processChain(Chain& chain, int64_t steadyTime) -> void;
+
+    ThreadPool _pool;
+    std::vector<std::unique_ptr<Chain>> _chains{};
+};
+
+}  // namespace tobi
@@ -0,0 +1,88 @@
+#include "Fft.hpp"
+
+#include <tobi/Simd.hpp>
+
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+namespace tobi::audio {
+
+Fft::Fft(std::size_t size) : _size{size} {
+    if (size < 2 or not std::has_single_bit(size)) {
+        throw std::invalid_argument{"FFT size must be a power of two"};
+    }
+
+    auto const bits = std::countr_zero(size);
+    _reversed.resize(size);
+    for (auto i = std::size_t{0}; i < size; ++i) {
+        auto r = uint32_t{0};
+        for (auto b = 0; b < bits; ++b) {
+            r |= ((i >> b) & 1U) << (bits - 1 - b);
+        }
+        _reversed[i] = r;
+    }
+
+    _cos.resize(size - 1);
+    _sin.resize(size - 1);
+    for (auto m = std::size_t{1}; m < size; m *= 2) {
+        for (auto j = std::size_t{0}; j < m; ++j) {
+            auto const angle = -std::numbers::pi * static_cast<double>(j) / static_cast<double>(m);
+            _cos[m - 1 + j] = static_cast<float>(std::cos(angle));
+            _sin[m - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+}
+
+auto Fft::forward(float* re, float* im) const -> void {
+    using simd::Batch;
+
+    for (auto i = std::size_t{0}; i < _size; ++i) {
+        auto const r = _reversed[i];
+        if (i < r) {
+            std::swap(re[i], re[r]);
+            std::swap(im[i], im[r]);
+        }
+    }
+
+    for (auto m = std::size_t{1}; m < _size; m *= 2) {
+        auto const* wr = _cos.data() + m - 1;
+        auto const* wi = _sin.data() + m - 1;
+        for (auto k = std::size_t{0}; k < _size; k += 2 * m) {
+            auto* ar = re + k;
+            auto* ai = im + k;
+            auto* br = re + k + m;
+            auto* bi = im + k + m;
+
+            auto j = std::size_t{0};
+            if (m >= Batch::size) {
+                for (; j < m; j += Batch::size) {
+                    auto const c = Batch::load(wr + j);
+                    auto const s = Batch::load(wi + j);
+                    auto const xr = Batch::load(br + j);
+                    auto const xi = Batch::load(bi + j);
+                    auto const tr = c * xr - s * xi;
+                    auto const ti = c * xi + s * xr;
+                    auto const yr = Batch::load(ar + j);
+                    auto const yi = Batch::load(ai + j);
+                    (yr - tr).store(br + j);
+                    (yi - ti).store(bi + j);
+                    (yr + tr).store(ar + j);
+                    (yi + ti).store(ai + j);
+                }
+            }
+            for (; j < m; ++j) {
+                auto const tr = wr[j] * br[j] - wi[j] * bi[j];
+                auto const ti = wr[j] * bi[j] + wi[j] * br[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+}  // namespace tobi::audio
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tobi::audio {
+
+// In-place radix-2 complex FFT on split real and imaginary arrays. Twiddles are stored per
+// stage and contiguous, so every butterfly loop with at least a batch of twiddles runs on
+// simd::Batch; only the first stages fall back to scalar code.
+struct Fft {
+    // Size must be a power of two, std::invalid_argument otherwise.
+    explicit Fft(std::size_t size);
+
+    [[nodiscard]] auto size() const -> std::size_t { return _size; }
+
+    // X[k] = sum x[n] e^(-2 pi i k n / size)
+    auto forward(float* re, float* im) const -> void;
+
+  private:
+    std::size_t _size;
+    std::vector<uint32_t> _reversed{};
+    std::vector<float> _cos{};  // stage with half size m starts at m - 1
+    std::vector<float> _sin{};
+};
+
+}  // namespace tobi::audio
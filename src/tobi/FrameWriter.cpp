@@ -0,0 +1,234 @@
+#include "FrameWriter.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+namespace tobi {
+
+namespace {
+
+auto crcTable() -> std::array<uint32_t, 256> const& {
+    static auto const table = [] {
+        auto t = std::array<uint32_t, 256>{};
+        for (auto n = uint32_t{0}; n < 256; ++n) {
+            auto c = n;
+            for (auto k = 0; k < 8; ++k) {
+                c = (c & 1U) != 0 ? 0xedb88320U ^ (c >> 1U) : c >> 1U;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+auto crc32(std::byte const* data, std::size_t size, uint32_t crc = 0) -> uint32_t {
+    auto const& table = crcTable();
+    crc = ~crc;
+    for (auto i = std::size_t{0}; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint32_t>(data[i])) & 0xffU] ^ (crc >> 8U);
+    }
+    return ~crc;
+}
+
+struct ByteWriter {
+    std::vector<std::byte>& out;
+
+    auto u8(uint32_t value) -> void { out.push_back(static_cast<std::byte>(value & 0xffU)); }
+
+    auto u16le(uint32_t value) -> void {
+        u8(value);
+        u8(value >> 8U);
+    }
+
+    auto u32be(uint32_t value) -> void {
+        u8(value >> 24U);
+        u8(value >> 16U);
+        u8(value >> 8U);
+        u8(value);
+    }
+
+    auto bytes(std::byte const* data, std::size_t size) -> void {
+        out.insert(out.end(), data, data + size);
+    }
+};
+
+auto chunk(std::vector<std::byte>& out, char const (&type)[5], std::vector<std::byte> const& data)
+    -> void {
+    auto w = ByteWriter{out};
+    w.u32be(static_cast<uint32_t>(data.size()));
+    auto const start = out.size();
+    w.bytes(reinterpret_cast<std::byte const*>(type), 4);
+    w.bytes(data.data(), data.size());
+    w.u32be(crc32(out.data() + start, out.size() - start));
+}
+
+}  // namespace
+
+auto encodePng(std::span<std::byte const> pixels,
+               uint32_t width,
+               uint32_t height,
+               uint32_t bytesPerRow) -> std::vector<std::byte> {
+    static constexpr auto maxStoredBlock = std::size_t{65535};
+    static constexpr auto signature =
+        std::array<uint8_t, 8>{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    auto const rowSize = std::size_t{width} * 4;
+    if (bytesPerRow < rowSize or pixels.size() < std::size_t{bytesPerRow} * height) {
+        throw std::invalid_argument{"pixel data is smaller than the image"};
+    }
+
+    // Filter type 0 for every row, then the rows as is.
+    auto raw = std::vector<std::byte>{};
+    raw.reserve((rowSize + 1) * height);
+    for (auto y = uint32_t{0}; y < height; ++y) {
+        auto const* row = pixels.data() + std::size_t{y} * bytesPerRow;
+        raw.push_back(std::byte{0});
+        raw.insert(raw.end(), row, row + rowSize);
+    }
+
+    auto zlib = std::vector<std::byte>{};
+    zlib.reserve(raw.size() + raw.size() / maxStoredBlock * 5 + 16);
+    auto z = ByteWriter{zlib};
+    z.u8(0x78);
+    z.u8(0x01);
+    auto a = uint32_t{1};
+    auto b = uint32_t{0};
+    auto offset = std::size_t{0};
+    do {
+        auto const size = std::min(maxStoredBlock, raw.size() - offset);
+        auto const last = offset + size == raw.size();
+        z.u8(last ? 1 : 0);
+        z.u16le(static_cast<uint32_t>(size));
+        z.u16le(static_cast<uint32_t>(~size));
+        z.bytes(raw.data() + offset, size);
+        for (auto i = offset; i < offset + size; ++i) {
+            a = (a + static_cast<uint32_t>(raw[i])) % 65521U;
+            b = (b + a) % 65521U;
+        }
+        offset += size;
+    } while (offset < raw.size());
+    z.u32be((b << 16U) | a);
+
+    auto header = std::vector<std::byte>{};
+    auto h = ByteWriter{header};
+    h.u32be(width);
+    h.u32be(height);
+    h.u8(8);  // bit depth
+    h.u8(6);  // RGBA
+    h.u8(0);  // deflate
+    h.u8(0);  // adaptive filtering
+    h.u8(0);  // no interlace
+
+    auto png = std::vector<std::byte>{};
+    png.reserve(zlib.size() + 64);
+    ByteWriter{png}.bytes(reinterpret_cast<std::byte const*>(signature.data()), signature.size());
+    chunk(png, "IHDR", header);
+    chunk(png, "IDAT", zlib);
+    chunk(png, "IEND", {});
+    return png;
+}
+
+FrameWriter::FrameWriter(std::filesystem::path directory,
+                         FrameFormat format,
+                         std::size_t maxQueued)
+    : _directory{std::move(directory)},
+      _format{format},
+      _maxQueued{std::max<std::size_t>(maxQueued, 1)} {
+    std::filesystem::create_directories(_directory);
+    _thread = std::thread{[this] { run(); }};
+}
+
+FrameWriter::~FrameWriter() {
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stop = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+}
+
+auto FrameWriter::write(Frame frame) -> void {
+    {
+        auto lock = std::unique_lock{_mutex};
+        _changed.wait(lock, [this] { return _queue.size() < _maxQueued; });
+        _queue.push_back(std::move(frame));
+    }
+    _changed.notify_all();
+}
+
+auto FrameWriter::flush() -> void {
+    auto lock = std::unique_lock{_mutex};
+    _changed.wait(lock, [this] { return _queue.empty() and not _busy; });
+}
+
+auto FrameWriter::stats() const -> FrameWriterStats {
+    auto lock = std::scoped_lock{_mutex};
+    return _stats;
+}
+
+auto FrameWriter::run() -> void {
+    while (true) {
+        auto frame = Frame{};
+        {
+            auto lock = std::unique_lock{_mutex};
+            _changed.wait(lock, [this] { return _stop or not _queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            frame = std::move(_queue.front());
+            _queue.pop_front();
+            _busy = true;
+        }
+        _changed.notify_all();
+
+        try {
+            encode(frame);
+        } catch (std::exception const& e) {
+            fmt::println("Frame {} not written: {}", frame.index, e.what());
+        }
+
+        {
+            auto lock = std::scoped_lock{_mutex};
+            _busy = false;
+        }
+        _changed.notify_all();
+    }
+}
+
+auto FrameWriter::encode(Frame& frame) -> void {
+    // The event pump delivers the map callback, get() only waits for it.
+    auto const pixels = frame.pixels.get();
+
+    auto data = std::vector<std::byte>{};
+    auto path = _directory;
+    if (_format == FrameFormat::Png) {
+        data = encodePng(pixels, frame.width, frame.height, frame.bytesPerRow);
+        path /= fmt::format("frame-{:06}.png", frame.index);
+    } else {
+        auto const rowSize = std::size_t{frame.width} * 4;
+        data.reserve(rowSize * frame.height);
+        for (auto y = uint32_t{0}; y < frame.height; ++y) {
+            auto const* row = pixels.data() + std::size_t{y} * frame.bytesPerRow;
+            data.insert(data.end(), row, row + rowSize);
+        }
+        path /= fmt::format("frame-{:06}-{}x{}.rgba", frame.index, frame.width, frame.height);
+    }
+
+    auto file = std::ofstream{path, std::ios::binary};
+    file.write(reinterpret_cast<char const*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (not file) {
+        throw std::runtime_error{"cannot write " + path.string()};
+    }
+
+    auto lock = std::scoped_lock{_mutex};
+    ++_stats.framesWritten;
+    _stats.bytesWritten += data.size();
+}
+
+}  // namespace tobi
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <tobi/Readback.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace tobi {
+
+enum struct FrameFormat {
+    Png,
+    Raw,  // tightly packed RGBA8 rows, no header
+};
+
+struct FrameWriterStats {
+    uint64_t framesWritten{0};
+    uint64_t bytesWritten{0};
+};
+
+// Encodes frames on a worker thread. Pixels arrive as pending readbacks of a texture copy, so
+// neither the render loop nor the worker ever waits for a map callback that is not done yet.
+// write() blocks once maxQueued frames are waiting, exports never drop frames.
+struct FrameWriter {
+    struct Frame {
+        uint64_t index{0};
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t bytesPerRow{0};  // row pitch of the readback, at least width * 4
+        gpu::Readback pixels{};
+    };
+
+    FrameWriter(std::filesystem::path directory, FrameFormat format, std::size_t maxQueued = 8);
+    ~FrameWriter();
+
+    FrameWriter(FrameWriter const& other) = delete;
+    FrameWriter(FrameWriter&& other) = delete;
+
+    auto operator=(FrameWriter const& other) -> FrameWriter& = delete;
+    auto operator=(FrameWriter&& other) -> FrameWriter& = delete;
+
+    auto write(Frame frame) -> void;
+
+    // Blocks until every queued frame is on disk.
+    auto flush() -> void;
+
+    [[nodiscard]] auto stats() const -> FrameWriterStats;
+
+  private:
+    auto run() -> void;
+    auto encode(Frame& frame) -> void;
+
+    std::filesystem::path _directory;
+    FrameFormat _format;
+    std::size_t _maxQueued;
+
+    mutable std::mutex _mutex{};
+    std::condition_variable _changed{};
+    std::deque<Frame> _queue{};
+    bool _busy{false};
+    bool _stop{false};
+    FrameWriterStats _stats{};
+    std::thread _thread{};
+};
+
+// Encodes RGBA8 rows as an uncompressed PNG, using stored deflate blocks. Trades file size for
+// an encoder that keeps up with the render loop.
+[[nodiscard]] auto encodePng(std::span<std::byte const> pixels,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t bytesPerRow) -> std::vector<std::byte>;
+
+}  // namespace tobi
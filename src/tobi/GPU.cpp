@@ -1,5 +1,9 @@
 #include "GPU.hpp"
 
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/Capabilities.hpp>
+#include <tobi/PipelineCache.hpp>
+
 #include <fmt/format.h>
 #include <fmt/os.h>
 
@@ -9,23 +13,57 @@
 #include <emscripten/html5_webgpu.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
 namespace tobi::gpu {
 
 #ifndef __EMSCRIPTEN__
-auto requesAdapter(wgpu::Instance& instance) -> wgpu::Adapter {
-    auto callback = [](auto status, WGPUAdapter adapter, const char* message, void* pUserData) {
-        if (status == WGPURequestAdapterStatus_Success) {
-            *(wgpu::Adapter*)(pUserData) = wgpu::Adapter{adapter};
-        } else {
-            fmt::println("Could not get WebGPU adapter: {}", message);
-        }
-    };
-    wgpu::Adapter adapter;
-    instance.RequestAdapter(nullptr, callback, static_cast<void*>(&adapter));
-    return adapter;
+namespace {
+
+// Higher is faster.
+auto adapterRank(Capabilities const& adapter, wgpu::PowerPreference preference) -> int {
+    auto type = 0;
+    switch (adapter.adapterType) {
+        case wgpu::AdapterType::DiscreteGPU:
+            type = preference == wgpu::PowerPreference::LowPower ? 2 : 3;
+            break;
+        case wgpu::AdapterType::IntegratedGPU:
+            type = preference == wgpu::PowerPreference::LowPower ? 3 : 2;
+            break;
+        case wgpu::AdapterType::Unknown:
+            type = 1;
+            break;
+        default:
+            break;
+    }
+
+    auto backend = 0;
+    switch (adapter.backend) {
+        case wgpu::BackendType::D3D12:
+        case wgpu::BackendType::Metal:
+        case wgpu::BackendType::Vulkan:
+            backend = 3;
+            break;
+        case wgpu::BackendType::D3D11:
+            backend = 2;
+            break;
+        case wgpu::BackendType::OpenGL:
+        case wgpu::BackendType::OpenGLES:
+            backend = 1;
+            break;
+        default:
+            break;
+    }
+    return type * 10 + backend;
 }
 
-auto requestDevice(wgpu::Adapter& adapter) -> wgpu::Device {
+auto requestDevice(wgpu::Adapter& adapter, DeviceOptions const& options) -> wgpu::Device {
     auto callback = [](WGPURequestDeviceStatus status, WGPUDevice device, const char* message,
                        void* pUserData) {
         if (status == WGPURequestDeviceStatus_Success) {
@@ -34,24 +72,114 @@ auto requestDevice(wgpu::Adapter& adapter) -> wgpu::Device {
             fmt::println("Could not get WebGPU device: {}", message);
         }
     };
+    auto features = options.requiredFeatures;
+    for (auto const feature : options.optionalFeatures) {
+        if (adapter.HasFeature(feature) and
+            std::find(features.begin(), features.end(), feature) == features.end()) {
+            features.push_back(feature);
+        }
+    }
+
+    auto descriptor = wgpu::DeviceDescriptor{};
+    descriptor.requiredFeatureCount = features.size();
+    descriptor.requiredFeatures = features.data();
+
+    auto supported = wgpu::SupportedLimits{};
+    auto required = wgpu::RequiredLimits{};
+    if (options.maxLimits and adapter.GetLimits(&supported)) {
+        required.limits = supported.limits;
+        descriptor.requiredLimits = &required;
+    }
+
+    descriptor.deviceLostCallbackInfo.mode = wgpu::CallbackMode::AllowSpontaneous;
+    descriptor.deviceLostCallbackInfo.callback = [](WGPUDevice const* device,
+                                                    WGPUDeviceLostReason reason,
+                                                    char const* message, void*) {
+        evictCapabilities(*device);
+        if (reason != WGPUDeviceLostReason_Destroyed) {
+            fmt::println("Device lost: {}", message);
+        }
+    };
+
+    auto isolationKey = std::string{};
+    auto cacheDescriptor = wgpu::DawnCacheDeviceDescriptor{};
+    if (options.cache != nullptr) {
+        isolationKey = adapterIdentity(adapter);
+        cacheDescriptor.isolationKey = isolationKey.c_str();
+        cacheDescriptor.loadDataFunction = [](void const* key, size_t keySize, void* value,
+                                              size_t valueSize, void* userdata) -> size_t {
+            return static_cast<BlobCache*>(userdata)->load(key, keySize, value, valueSize);
+        };
+        cacheDescriptor.storeDataFunction = [](void const* key, size_t keySize, void const* value,
+                                               size_t valueSize, void* userdata) {
+            static_cast<BlobCache*>(userdata)->store(key, keySize, value, valueSize);
+        };
+        cacheDescriptor.functionUserdata = options.cache;
+        descriptor.nextInChain = &cacheDescriptor;
+    }
+
     wgpu::Device device;
-    adapter.RequestDevice(nullptr, callback, static_cast<void*>(&device));
+    adapter.RequestDevice(&descriptor, callback, static_cast<void*>(&device));
     return device;
 }
+
+}  // namespace
+
+auto selectAdapter(wgpu::Instance const& instance, DeviceOptions const& options) -> wgpu::Adapter {
+    auto adapterOptions = wgpu::RequestAdapterOptions{};
+    adapterOptions.powerPreference = options.powerPreference;
+    adapterOptions.backendType = options.backend;
+    adapterOptions.forceFallbackAdapter = options.forceFallbackAdapter;
+
+    auto best = wgpu::Adapter{};
+    auto bestRank = -1;
+    auto const count = instance.EnumerateAdapters(&adapterOptions, nullptr);
+    auto adapters = std::vector<wgpu::Adapter>(count);
+    instance.EnumerateAdapters(&adapterOptions, adapters.data());
+    for (auto const& adapter : adapters) {
+        auto const capabilities = Capabilities::query(adapter);
+        auto const missing = std::any_of(
+            options.requiredFeatures.begin(), options.requiredFeatures.end(),
+            [&](auto feature) { return not capabilities.has(feature); });
+        if (missing or capabilities.backend == wgpu::BackendType::Null) {
+            continue;
+        }
+        if (auto const rank = adapterRank(capabilities, options.powerPreference); rank > bestRank) {
+            best = adapter;
+            bestRank = rank;
+        }
+    }
+
+    if (not best and options.allowFallbackAdapter and not options.forceFallbackAdapter) {
+        auto fallback = options;
+        fallback.forceFallbackAdapter = true;
+        return selectAdapter(instance, fallback);
+    }
+    if (not best) {
+        fmt::println("Could not find a WebGPU adapter{}",
+                     options.requiredFeatures.empty() ? "" : " with the required features");
+    }
+    return best;
+}
 #endif
 
-auto getDefaultDevice(wgpu::Instance instance) -> wgpu::Device {
+auto getDefaultDevice(wgpu::Instance instance, DeviceOptions const& options) -> wgpu::Device {
 #ifdef __EMSCRIPTEN__
+    (void)options;
     auto device = wgpu::Device{emscripten_webgpu_get_device()};
     if (not device) {
         return {};
     }
 #else
-    auto adapter = requesAdapter(instance);
+    auto adapter = selectAdapter(instance, options);
     if (not adapter) {
         return {};
     }
-    auto device = requestDevice(adapter);
+    auto device = requestDevice(adapter, options);
+    if (not device) {
+        return {};
+    }
+    cacheCapabilities(device);
 #endif
 
     return device;
@@ -67,111 +195,250 @@ auto createShaderModule(const wgpu::Device& device, const char* source) -> wgpu:
     return device.CreateShaderModule(&descriptor);
 }
 
+auto isThreadSafe(wgpu::Device const& device) -> bool {
+#ifdef __EMSCRIPTEN__
+    (void)device;
+    return false;
+#else
+    return device.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization);
+#endif
+}
+
+auto waitForQueue(wgpu::Device const& device) -> void {
+    // The callback may fire on an EventPump thread.
+    auto done = std::atomic<bool>{false};
+    device.GetQueue().OnSubmittedWorkDone(
+        [](WGPUQueueWorkDoneStatus, void* userdata) {
+            static_cast<std::atomic<bool>*>(userdata)->store(true);
+        },
+        static_cast<void*>(&done));
+
+#ifndef __EMSCRIPTEN__
+    auto instance = device.GetAdapter().GetInstance();
+#endif
+    while (not done) {
+#ifndef __EMSCRIPTEN__
+        device.Tick();
+        instance.ProcessEvents();
+#else
+        emscripten_sleep(1);
+#endif
+    }
+}
+
+auto dispatchGrid(uint32_t count, uint32_t workgroupSize, uint32_t maxPerDimension)
+    -> DispatchGrid {
+    auto const groups = std::max((count + workgroupSize - 1) / workgroupSize, 1U);
+    if (groups <= maxPerDimension) {
+        return {groups, 1};
+    }
+    return {maxPerDimension, (groups + maxPerDimension - 1) / maxPerDimension};
+}
+
+namespace {
+
+auto maxWorkgroupSize(wgpu::Device const& device) -> uint32_t {
+    auto limits = wgpu::SupportedLimits{};
+    if (not device.GetLimits(&limits)) {
+        return 256;
+    }
+    return std::min(limits.limits.maxComputeInvocationsPerWorkgroup,
+                    limits.limits.maxComputeWorkgroupSizeX);
+}
+
+auto withWorkgroupSize(std::string code, uint32_t size) -> std::string {
+    auto const placeholder = std::string_view{Kernel::workgroupSizePlaceholder};
+    auto const value = std::to_string(size);
+    for (auto pos = code.find(placeholder); pos != std::string::npos;
+         pos = code.find(placeholder, pos + value.size())) {
+        code.replace(pos, placeholder.size(), value);
+    }
+    return code;
+}
+
+}  // namespace
+
+Kernel::Kernel(wgpu::Device device,
+               std::string const& source,
+               char const* entryPoint,
+               std::vector<uint32_t> const& candidates,
+               wgpu::PipelineLayout layout,
+               PipelineCache* pipelines)
+    : _device{std::move(device)}, _layout{std::move(layout)} {
+    auto limits = wgpu::SupportedLimits{};
+    if (_device.GetLimits(&limits)) {
+        _maxWorkgroupsPerDimension = limits.limits.maxComputeWorkgroupsPerDimension;
+    }
+
+    auto const maxSize = maxWorkgroupSize(_device);
+    for (auto const size : candidates) {
+        if (size == 0 or size > maxSize) {
+            continue;
+        }
+
+        auto const code = withWorkgroupSize(source, size);
+        if (pipelines != nullptr) {
+            _variants.push_back({size, pipelines->computePipeline(code, entryPoint, _layout)});
+            continue;
+        }
+
+        auto descriptor = wgpu::ComputePipelineDescriptor{};
+        descriptor.layout = _layout;
+        descriptor.compute.module = createShaderModule(_device, code.c_str());
+        descriptor.compute.entryPoint = entryPoint;
+        _variants.push_back({size, _device.CreateComputePipeline(&descriptor)});
+    }
+
+    if (_variants.empty()) {
+        throw std::invalid_argument{"no workgroup size candidate fits the device limits"};
+    }
+
+    // 64 invocations fill a wavefront on most desktop GPUs and two SIMD groups elsewhere.
+    auto const preferred = std::find_if(_variants.begin(), _variants.end(),
+                                        [](auto const& v) { return v.workgroupSize >= 64; });
+    _defaultVariant = preferred != _variants.end()
+                          ? static_cast<std::size_t>(preferred - _variants.begin())
+                          : _variants.size() - 1;
+}
+
+auto Kernel::manifest(wgpu::Device const& device,
+                      std::string const& source,
+                      char const* entryPoint,
+                      std::vector<uint32_t> const& candidates,
+                      wgpu::PipelineLayout const& layout) -> std::vector<PipelineManifestEntry> {
+    auto const maxSize = maxWorkgroupSize(device);
+    auto entries = std::vector<PipelineManifestEntry>{};
+    for (auto const size : candidates) {
+        if (size != 0 and size <= maxSize) {
+            entries.push_back({withWorkgroupSize(source, size), entryPoint, layout});
+        }
+    }
+    return entries;
+}
+
+auto Kernel::createBindings(std::vector<wgpu::BindGroupEntry> const& entries) const -> Bindings {
+    auto bindings = Bindings{};
+    bindings.groups.reserve(_variants.size());
+    for (auto const& variant : _variants) {
+        if (_layout and not bindings.groups.empty()) {
+            bindings.groups.push_back(bindings.groups.front());
+            continue;
+        }
+
+        auto descriptor = wgpu::BindGroupDescriptor{};
+        descriptor.layout = variant.pipeline.GetBindGroupLayout(0);
+        descriptor.entryCount = entries.size();
+        descriptor.entries = entries.data();
+        bindings.groups.push_back(_device.CreateBindGroup(&descriptor));
+    }
+    return bindings;
+}
+
+auto Kernel::createBindings(BindGroupCache& cache,
+                            std::vector<wgpu::BindGroupEntry> const& entries) const -> Bindings {
+    auto bindings = Bindings{};
+    bindings.groups.reserve(_variants.size());
+    for (auto const& variant : _variants) {
+        if (_layout and not bindings.groups.empty()) {
+            bindings.groups.push_back(bindings.groups.front());
+            continue;
+        }
+        bindings.groups.push_back(cache.get(variant.pipeline.GetBindGroupLayout(0), entries));
+    }
+    return bindings;
+}
+
+auto Kernel::createBindings(wgpu::BindGroup const& group,
+                            std::vector<uint32_t> dynamicOffsets) const -> Bindings {
+    if (not _layout) {
+        throw std::invalid_argument{"shared bind groups need a kernel with an explicit layout"};
+    }
+    return Bindings{.groups = std::vector<wgpu::BindGroup>(_variants.size(), group),
+                    .dynamicOffsets = std::move(dynamicOffsets)};
+}
+
+auto Kernel::tune(Bindings const& bindings, uint32_t count) -> uint32_t {
+    static constexpr auto dispatchesPerRun = 8;
+    static constexpr auto runs = 3;
+
+    auto queue = _device.GetQueue();
+    auto run = [&](std::size_t index) {
+        auto const& variant = _variants[index];
+        auto const grid = dispatchGrid(count, variant.workgroupSize, _maxWorkgroupsPerDimension);
+
+        auto encoder = _device.CreateCommandEncoder();
+        auto pass = encoder.BeginComputePass();
+        pass.SetPipeline(variant.pipeline);
+        pass.SetBindGroup(0, bindings.groups[index], bindings.dynamicOffsets.size(),
+                         bindings.dynamicOffsets.data());
+        for (auto i = 0; i < dispatchesPerRun; ++i) {
+            pass.DispatchWorkgroups(grid.x, grid.y, 1);
+        }
+        pass.End();
+
+        auto commands = encoder.Finish();
+        auto const start = std::chrono::steady_clock::now();
+        queue.Submit(1, &commands);
+        waitForQueue(_device);
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    auto best = _defaultVariant;
+    auto bestTime = std::chrono::steady_clock::duration::max();
+    for (auto index = std::size_t{0}; index < _variants.size(); ++index) {
+        // First run pays for lazy pipeline creation and cold caches, keep only the fastest.
+        run(index);
+        auto fastest = std::chrono::steady_clock::duration::max();
+        for (auto i = 0; i < runs; ++i) {
+            fastest = std::min(fastest, run(index));
+        }
+        if (fastest < bestTime) {
+            best = index;
+            bestTime = fastest;
+        }
+    }
+
+    _tuned[sizeClass(count)] = best;
+    return _variants[best].workgroupSize;
+}
+
+auto Kernel::workgroupSize(uint32_t count) const -> uint32_t {
+    return _variants[variantIndex(count)].workgroupSize;
+}
+
+auto Kernel::pipeline(uint32_t count) const -> wgpu::ComputePipeline const& {
+    return _variants[variantIndex(count)].pipeline;
+}
+
+auto Kernel::dispatch(wgpu::ComputePassEncoder const& pass,
+                      Bindings const& bindings,
+                      uint32_t count) const -> void {
+    auto const index = variantIndex(count);
+    auto const& variant = _variants[index];
+    auto const grid = dispatchGrid(count, variant.workgroupSize, _maxWorkgroupsPerDimension);
+    pass.SetPipeline(variant.pipeline);
+    pass.SetBindGroup(0, bindings.groups[index], bindings.dynamicOffsets.size(),
+                      bindings.dynamicOffsets.data());
+    pass.DispatchWorkgroups(grid.x, grid.y, 1);
+}
+
+auto Kernel::variantIndex(uint32_t count) const -> std::size_t {
+    if (auto const found = _tuned.find(sizeClass(count)); found != _tuned.end()) {
+        return found->second;
+    }
+    return _defaultVariant;
+}
+
+auto Kernel::sizeClass(uint32_t count) -> uint32_t {
+    return static_cast<uint32_t>(std::bit_width(count));
+}
+
 auto inspectAdapter(wgpu::Adapter const& adapter) -> void {
-    std::vector<wgpu::FeatureName> features;
-    size_t featureCount = adapter.EnumerateFeatures(nullptr);
-    features.resize(featureCount);
-    adapter.EnumerateFeatures(features.data());
-
-    fmt::println("Adapter features:");
-    for (auto f : features) {
-        fmt::println(" - {}", static_cast<uint32_t>(f));
-    }
-
-    wgpu::SupportedLimits limits = {};
-    limits.nextInChain = nullptr;
-    bool success = adapter.GetLimits(&limits);
-    if (success) {
-        // clang-format off
-		fmt::println("Adapter limits:");
-		fmt::println("maxTextureDimension1D: {}", limits.limits.maxTextureDimension1D);
-		fmt::println("maxTextureDimension2D: {}", limits.limits.maxTextureDimension2D);
-		fmt::println("maxTextureDimension3D: {}", limits.limits.maxTextureDimension3D);
-		fmt::println("maxTextureArrayLayers: {}", limits.limits.maxTextureArrayLayers);
-		fmt::println("maxBindGroups: {}", limits.limits.maxBindGroups);
-		fmt::println("maxDynamicUniformBuffersPerPipelineLayout: {}", limits.limits.maxDynamicUniformBuffersPerPipelineLayout);
-		fmt::println("maxDynamicStorageBuffersPerPipelineLayout: {}", limits.limits.maxDynamicStorageBuffersPerPipelineLayout);
-		fmt::println("maxSampledTexturesPerShaderStage: {}", limits.limits.maxSampledTexturesPerShaderStage);
-		fmt::println("maxSamplersPerShaderStage: {}", limits.limits.maxSamplersPerShaderStage);
-		fmt::println("maxStorageBuffersPerShaderStage: {}", limits.limits.maxStorageBuffersPerShaderStage);
-		fmt::println("maxStorageTexturesPerShaderStage: {}", limits.limits.maxStorageTexturesPerShaderStage);
-		fmt::println("maxUniformBuffersPerShaderStage: {}", limits.limits.maxUniformBuffersPerShaderStage);
-		fmt::println("maxUniformBufferBindingSize: {}", limits.limits.maxUniformBufferBindingSize);
-		fmt::println("maxStorageBufferBindingSize: {}", limits.limits.maxStorageBufferBindingSize);
-		fmt::println("minUniformBufferOffsetAlignment: {}", limits.limits.minUniformBufferOffsetAlignment);
-		fmt::println("minStorageBufferOffsetAlignment: {}", limits.limits.minStorageBufferOffsetAlignment);
-		fmt::println("maxVertexBuffers: {}", limits.limits.maxVertexBuffers);
-		fmt::println("maxVertexAttributes: {}", limits.limits.maxVertexAttributes);
-		fmt::println("maxVertexBufferArrayStride: {}", limits.limits.maxVertexBufferArrayStride);
-		fmt::println("maxInterStageShaderComponents: {}", limits.limits.maxInterStageShaderComponents);
-		fmt::println("maxComputeWorkgroupStorageSize: {}", limits.limits.maxComputeWorkgroupStorageSize);
-		fmt::println("maxComputeInvocationsPerWorkgroup: {}", limits.limits.maxComputeInvocationsPerWorkgroup);
-		fmt::println("maxComputeWorkgroupSizeX: {}", limits.limits.maxComputeWorkgroupSizeX);
-		fmt::println("maxComputeWorkgroupSizeY: {}", limits.limits.maxComputeWorkgroupSizeY);
-		fmt::println("maxComputeWorkgroupSizeZ: {}", limits.limits.maxComputeWorkgroupSizeZ);
-		fmt::println("maxComputeWorkgroupsPerDimension: {}", limits.limits.maxComputeWorkgroupsPerDimension);
-        // clang-format on
-    }
-
-    wgpu::AdapterProperties properties = {};
-    properties.nextInChain = nullptr;
-    adapter.GetProperties(&properties);
-    fmt::println("Adapter properties:");
-    fmt::println(" - vendorID: {}", properties.vendorID);
-    fmt::println(" - deviceID: {}", properties.deviceID);
-    fmt::println(" - name: {}", properties.name);
-    if (properties.driverDescription) {
-        fmt::println(" - driverDescription: {}", properties.driverDescription);
-    }
-    fmt::println(" - adapterType: {}", static_cast<uint32_t>(properties.adapterType));
-    fmt::println(" - backendType: {}", static_cast<uint32_t>(properties.backendType));
+    fmt::print("Adapter {}", Capabilities::query(adapter).describe());
 }
 
 auto inspectDevice(wgpu::Device const& device) -> void {
-    std::vector<wgpu::FeatureName> features;
-    size_t featureCount = device.EnumerateFeatures(nullptr);
-    features.resize(featureCount);
-    device.EnumerateFeatures(features.data());
-
-    fmt::println("Device features:");
-    for (auto f : features) {
-        fmt::println(" - {}", static_cast<uint32_t>(f));
-    }
-
-    wgpu::SupportedLimits limits = {};
-    limits.nextInChain = nullptr;
-    bool success = device.GetLimits(&limits);
-    if (success) {
-        // clang-format off
-        fmt::println("Device limits:");
-		fmt::println("maxTextureDimension1D: {}", limits.limits.maxTextureDimension1D);
-		fmt::println("maxTextureDimension2D: {}", limits.limits.maxTextureDimension2D);
-		fmt::println("maxTextureDimension3D: {}", limits.limits.maxTextureDimension3D);
-		fmt::println("maxTextureArrayLayers: {}", limits.limits.maxTextureArrayLayers);
-		fmt::println("maxBindGroups: {}", limits.limits.maxBindGroups);
-		fmt::println("maxDynamicUniformBuffersPerPipelineLayout: {}", limits.limits.maxDynamicUniformBuffersPerPipelineLayout);
-		fmt::println("maxDynamicStorageBuffersPerPipelineLayout: {}", limits.limits.maxDynamicStorageBuffersPerPipelineLayout);
-		fmt::println("maxSampledTexturesPerShaderStage: {}", limits.limits.maxSampledTexturesPerShaderStage);
-		fmt::println("maxSamplersPerShaderStage: {}", limits.limits.maxSamplersPerShaderStage);
-		fmt::println("maxStorageBuffersPerShaderStage: {}", limits.limits.maxStorageBuffersPerShaderStage);
-		fmt::println("maxStorageTexturesPerShaderStage: {}", limits.limits.maxStorageTexturesPerShaderStage);
-		fmt::println("maxUniformBuffersPerShaderStage: {}", limits.limits.maxUniformBuffersPerShaderStage);
-		fmt::println("maxUniformBufferBindingSize: {}", limits.limits.maxUniformBufferBindingSize);
-		fmt::println("maxStorageBufferBindingSize: {}", limits.limits.maxStorageBufferBindingSize);
-		fmt::println("minUniformBufferOffsetAlignment: {}", limits.limits.minUniformBufferOffsetAlignment);
-		fmt::println("minStorageBufferOffsetAlignment: {}", limits.limits.minStorageBufferOffsetAlignment);
-		fmt::println("maxVertexBuffers: {}", limits.limits.maxVertexBuffers);
-		fmt::println("maxVertexAttributes: {}", limits.limits.maxVertexAttributes);
-		fmt::println("maxVertexBufferArrayStride: {}", limits.limits.maxVertexBufferArrayStride);
-		fmt::println("maxInterStageShaderComponents: {}", limits.limits.maxInterStageShaderComponents);
-		fmt::println("maxComputeWorkgroupStorageSize: {}", limits.limits.maxComputeWorkgroupStorageSize);
-		fmt::println("maxComputeInvocationsPerWorkgroup: {}", limits.limits.maxComputeInvocationsPerWorkgroup);
-		fmt::println("maxComputeWorkgroupSizeX: {}", limits.limits.maxComputeWorkgroupSizeX);
-		fmt::println("maxComputeWorkgroupSizeY: {}", limits.limits.maxComputeWorkgroupSizeY);
-		fmt::println("maxComputeWorkgroupSizeZ: {}", limits.limits.maxComputeWorkgroupSizeZ);
-		fmt::println("maxComputeWorkgroupsPerDimension: {}", limits.limits.maxComputeWorkgroupsPerDimension);
-        // clang-format on
-    }
+    fmt::print("Device on {}", capabilities(device).describe());
 }
 
 auto errorCallback(WGPUErrorType errorType, const char* message, void*) -> void {
@@ -1,14 +1,159 @@
 #pragma once
 
+#include <tobi/PipelineCache.hpp>
+
 #include <webgpu/webgpu_cpp.h>
 
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
 namespace tobi::gpu {
 
-[[nodiscard]] auto getDefaultDevice(wgpu::Instance instance) -> wgpu::Device;
+struct BindGroupCache;
+
+struct DeviceOptions {
+    // Picks the software adapter, SwiftShader's Vulkan on Dawn builds with
+    // DAWN_ENABLE_SWIFTSHADER. Lets benchmarks and tests run on machines without a GPU.
+    bool forceFallbackAdapter{false};
+
+    // Falls back to the software adapter when no hardware adapter has the required features.
+    bool allowFallbackAdapter{true};
+
+    wgpu::PowerPreference powerPreference{wgpu::PowerPreference::HighPerformance};
+
+    // Undefined ranks the adapters of all backends and takes the fastest, see selectAdapter.
+    wgpu::BackendType backend{wgpu::BackendType::Undefined};
+
+    // Adapters without these are skipped.
+    std::vector<wgpu::FeatureName> requiredFeatures{};
+
+    // Enabled where the adapter has them. Implicit synchronization lets the EventPump tick the
+    // device from its own thread, timestamp queries feed the Profiler.
+    std::vector<wgpu::FeatureName> optionalFeatures{
+        wgpu::FeatureName::ImplicitDeviceSynchronization,
+        wgpu::FeatureName::TimestampQuery,
+        wgpu::FeatureName::ShaderF16,
+    };
+
+    // Requests every limit at the adapter's maximum instead of the WebGPU defaults, which cap
+    // storage bindings at 128 MiB and workgroup storage at 16 KiB.
+    bool maxLimits{true};
+
+    // Compiled shaders and pipelines are persisted through the cache when given (native only).
+    BlobCache* cache{nullptr};
+};
+
+// Enumerates the adapters of every backend and returns the one expected to be fastest: discrete
+// before integrated before software (integrated first for LowPower), then the platform's native
+// API before D3D11 and OpenGL. Null when no adapter qualifies (native only).
+[[nodiscard]] auto selectAdapter(wgpu::Instance const& instance, DeviceOptions const& options)
+    -> wgpu::Adapter;
+
+// The device's capabilities() are cached until it is lost or destroyed.
+[[nodiscard]] auto getDefaultDevice(wgpu::Instance instance, DeviceOptions const& options = {})
+    -> wgpu::Device;
 
 [[nodiscard]] auto createShaderModule(const wgpu::Device& device,
                                       const char* source) -> wgpu::ShaderModule;
 
+// Whether the device may be used from several threads at once, which Dawn only allows with
+// ImplicitDeviceSynchronization enabled. getDefaultDevice() requests it where the adapter has
+// it. Always false on Emscripten.
+[[nodiscard]] auto isThreadSafe(wgpu::Device const& device) -> bool;
+
+// Blocks until all work submitted to the device queue so far has completed.
+auto waitForQueue(wgpu::Device const& device) -> void;
+
+struct DispatchGrid {
+    uint32_t x{1};
+    uint32_t y{1};
+};
+
+// Number of workgroups needed to cover count invocations. Spills into the y dimension once x
+// exceeds maxPerDimension, shaders recover the linear index via @builtin(num_workgroups).
+[[nodiscard]] auto dispatchGrid(uint32_t count, uint32_t workgroupSize, uint32_t maxPerDimension)
+    -> DispatchGrid;
+
+// Compute kernel compiled from a WGSL template in several workgroup sizes. Every occurrence of
+// {{workgroup_size}} in the source is replaced by the variant's size. The fastest variant is
+// measured per problem size class by tune(), dispatch() falls back to a sensible default for
+// size classes that were never tuned.
+//
+// With a PipelineCache the variants are taken from it, so kernels built from the same source
+// share their pipelines and a cache warmed up with manifest() compiles nothing.
+struct Kernel {
+    static constexpr auto const* workgroupSizePlaceholder = "{{workgroup_size}}";
+
+    // Auto-generated bind group layouts are only compatible with the pipeline they were derived
+    // from, so bindings hold one bind group per variant. With an explicit pipeline layout all
+    // entries refer to the same bind group.
+    struct Bindings {
+        std::vector<wgpu::BindGroup> groups{};
+        std::vector<uint32_t> dynamicOffsets{};
+    };
+
+    Kernel(wgpu::Device device,
+           std::string const& source,
+           char const* entryPoint = "main",
+           std::vector<uint32_t> const& candidates = {32, 64, 128, 256},
+           wgpu::PipelineLayout layout = {},
+           PipelineCache* pipelines = nullptr);
+
+    // The pipelines a kernel with the same arguments compiles, for PipelineCache::warmup().
+    [[nodiscard]] static auto manifest(wgpu::Device const& device,
+                                       std::string const& source,
+                                       char const* entryPoint = "main",
+                                       std::vector<uint32_t> const& candidates = {32, 64, 128,
+                                                                                  256},
+                                       wgpu::PipelineLayout const& layout = {})
+        -> std::vector<PipelineManifestEntry>;
+
+    [[nodiscard]] auto createBindings(std::vector<wgpu::BindGroupEntry> const& entries) const
+        -> Bindings;
+
+    // Takes the bind groups from the cache, so repeated bindings create no new objects.
+    [[nodiscard]] auto createBindings(BindGroupCache& cache,
+                                      std::vector<wgpu::BindGroupEntry> const& entries) const
+        -> Bindings;
+
+    // Uses a bind group created for the kernel's explicit layout, e.g. by LayoutCache or
+    // BindGroupCache::dynamic(), for every variant. std::invalid_argument for kernels with
+    // auto-generated layouts.
+    [[nodiscard]] auto createBindings(wgpu::BindGroup const& group,
+                                      std::vector<uint32_t> dynamicOffsets = {}) const
+        -> Bindings;
+
+    // Times every variant on the device with the given bindings and remembers the fastest one
+    // for all counts in the same size class. Returns the chosen workgroup size.
+    auto tune(Bindings const& bindings, uint32_t count) -> uint32_t;
+
+    [[nodiscard]] auto workgroupSize(uint32_t count) const -> uint32_t;
+    [[nodiscard]] auto pipeline(uint32_t count) const -> wgpu::ComputePipeline const&;
+
+    auto dispatch(wgpu::ComputePassEncoder const& pass,
+                  Bindings const& bindings,
+                  uint32_t count) const -> void;
+
+  private:
+    struct Variant {
+        uint32_t workgroupSize{0};
+        wgpu::ComputePipeline pipeline{};
+    };
+
+    [[nodiscard]] auto variantIndex(uint32_t count) const -> std::size_t;
+    [[nodiscard]] static auto sizeClass(uint32_t count) -> uint32_t;
+
+    wgpu::Device _device{};
+    wgpu::PipelineLayout _layout{};
+    uint32_t _maxWorkgroupsPerDimension{65535};
+    std::vector<Variant> _variants{};
+    std::size_t _defaultVariant{0};
+    std::map<uint32_t, std::size_t> _tuned{};
+};
+
+// Print Capabilities::describe().
 auto inspectAdapter(wgpu::Adapter const& adapter) -> void;
 auto inspectDevice(wgpu::Device const& device) -> void;
 
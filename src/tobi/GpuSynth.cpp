@@ -0,0 +1,451 @@
+#include "GpuSynth.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace tobi::audio {
+
+namespace {
+
+constexpr auto wavetableSize = std::size_t{2048};
+
+// Between feeder iterations, bounds how late a finished readback is noticed.
+constexpr auto pollInterval = std::chrono::microseconds{200};
+
+struct Params {
+    uint32_t start{0};
+    uint32_t frames{0};
+    uint32_t voices{0};
+    uint32_t harmonics{0};
+    uint32_t taps{0};
+    uint32_t mask{0};
+    float wet{0.0F};
+    float gain{0.0F};
+};
+
+constexpr auto const* Common = R"(
+    struct Params {
+        start: u32,
+        frames: u32,
+        voices: u32,
+        harmonics: u32,
+        taps: u32,
+        mask: u32,
+        wet: f32,
+        gain: f32,
+    }
+
+    fn globalIndex(lid: vec3<u32>, wid: vec3<u32>, groups: vec3<u32>) -> u32 {
+        return (wid.x + wid.y * groups.x) * {{workgroup_size}}u + lid.x;
+    }
+)";
+
+// One invocation per frame, writes the dry mono signal into the history ring. Phases are in
+// cycles and reduced with fract() before sin(), which keeps f32 accurate for long runs.
+constexpr auto const* SynthShader = R"(
+    struct Voice {
+        phase: f32,
+        increment: f32,
+        amplitude: f32,
+        padding: f32,
+    }
+
+    @group(0) @binding(0) var<uniform> params: Params;
+    @group(0) @binding(1) var<storage, read> voices: array<Voice>;
+    @group(0) @binding(2) var<storage, read_write> history: array<f32>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let i = globalIndex(lid, wid, groups);
+        if (i >= params.frames) {
+            return;
+        }
+
+        var sum = 0.0;
+        for (var v = 0u; v < params.voices; v++) {
+            let voice = voices[v];
+            let phase = fract(voice.phase + f32(i) * voice.increment);
+            var partial = 0.0;
+            for (var h = 1u; h <= params.harmonics; h++) {
+                partial += sin(6.283185307 * fract(f32(h) * phase)) / f32(h);
+            }
+            sum += voice.amplitude * partial;
+        }
+        history[(params.start + i) & params.mask] = params.gain * sum;
+    }
+)";
+
+// One invocation per output sample, interleaved stereo. Direct form: every sample reads the
+// whole impulse, which is what GPUs are good at and CPUs in an audio callback are not.
+constexpr auto const* ConvolveShader = R"(
+    @group(0) @binding(0) var<uniform> params: Params;
+    @group(0) @binding(2) var<storage, read> history: array<f32>;
+    @group(0) @binding(3) var<storage, read> impulse: array<f32>;
+    @group(0) @binding(4) var<storage, read_write> output: array<f32>;
+
+    @compute @workgroup_size({{workgroup_size}})
+    fn main(@builtin(local_invocation_id) lid: vec3<u32>,
+            @builtin(workgroup_id) wid: vec3<u32>,
+            @builtin(num_workgroups) groups: vec3<u32>) {
+        let index = globalIndex(lid, wid, groups);
+        if (index >= params.frames * 2u) {
+            return;
+        }
+
+        let n = params.start + index / 2u;
+        let first = (index % 2u) * params.taps;
+        var wet = 0.0;
+        for (var k = 0u; k < params.taps; k++) {
+            wet += history[(n - k) & params.mask] * impulse[first + k];
+        }
+        output[index] = history[n & params.mask] + params.wet * wet;
+    }
+)";
+
+auto createBuffer(wgpu::Device const& device, uint64_t size, wgpu::BufferUsage usage)
+    -> wgpu::Buffer {
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = std::max<uint64_t>(size, 16);
+    descriptor.usage = usage;
+    return device.CreateBuffer(&descriptor);
+}
+
+auto entry(uint32_t binding, wgpu::Buffer const& buffer) -> wgpu::BindGroupEntry {
+    auto result = wgpu::BindGroupEntry{};
+    result.binding = binding;
+    result.buffer = buffer;
+    result.size = buffer.GetSize();
+    return result;
+}
+
+}  // namespace
+
+GpuSynth::GpuSynth(wgpu::Device device, GpuSynthOptions options)
+    : _device{std::move(device)}, _options{std::move(options)} {
+    if (_options.blockFrames == 0 or _options.blockFrames % blockSize != 0) {
+        throw std::invalid_argument{"GPU synth block must be a multiple of the audio block"};
+    }
+    if (_options.ring < 2 or _options.voices == 0) {
+        throw std::invalid_argument{"GPU synth needs at least two slots and one voice"};
+    }
+    if (_options.impulse[0].size() != _options.impulse[1].size()) {
+        throw std::invalid_argument{"impulse channels differ in length"};
+    }
+#ifndef __EMSCRIPTEN__
+    if (not gpu::isThreadSafe(_device)) {
+        throw std::runtime_error{"the GPU synth feeder needs a thread-safe device"};
+    }
+#endif
+
+    _taps = static_cast<uint32_t>(_options.impulse[0].size());
+    _historyMask = std::bit_ceil(_taps + _options.blockFrames) - 1;
+
+    auto const frames = uint64_t{_options.blockFrames};
+    _params = createBuffer(_device, sizeof(Params),
+                           wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst);
+    _voiceBuffer = createBuffer(_device, _options.voices * sizeof(Voice),
+                                wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst);
+    _history = createBuffer(_device, (uint64_t{_historyMask} + 1) * sizeof(float),
+                            wgpu::BufferUsage::Storage);
+    _impulse = createBuffer(_device, uint64_t{_taps} * 2 * sizeof(float),
+                            wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst);
+    _output = createBuffer(_device, frames * channels * sizeof(float),
+                           wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc);
+
+    auto queue = _device.GetQueue();
+    for (auto ch = std::size_t{0}; ch < channels and _taps > 0; ++ch) {
+        queue.WriteBuffer(_impulse, ch * _taps * sizeof(float), _options.impulse[ch].data(),
+                          _taps * sizeof(float));
+    }
+
+    _synth = std::make_unique<gpu::Kernel>(_device, std::string{Common} + SynthShader);
+    _convolve = std::make_unique<gpu::Kernel>(_device, std::string{Common} + ConvolveShader);
+    _synthBindings = _synth->createBindings(
+        {entry(0, _params), entry(1, _voiceBuffer), entry(2, _history)});
+    _convolveBindings = _convolve->createBindings(
+        {entry(0, _params), entry(2, _history), entry(3, _impulse), entry(4, _output)});
+
+    for (auto i = uint32_t{0}; i < _options.ring; ++i) {
+        auto slot = std::make_unique<Slot>();
+        slot->owner = this;
+        slot->readback = createBuffer(_device, frames * channels * sizeof(float),
+                                      wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst);
+        slot->voices.resize(_options.voices);
+        _slots.push_back(std::move(slot));
+    }
+
+    // One period of the same harmonic series the shader sums, plus a guard point.
+    _wavetable.resize(wavetableSize + 1);
+    for (auto i = std::size_t{0}; i <= wavetableSize; ++i) {
+        auto const x = static_cast<double>(i) / wavetableSize;
+        auto sum = 0.0;
+        for (auto h = uint32_t{1}; h <= _options.harmonics; ++h) {
+            sum += std::sin(2.0 * std::numbers::pi * h * x) / h;
+        }
+        _wavetable[i] = static_cast<float>(sum);
+    }
+
+    _controls.resize(_options.voices);
+    _phases.resize(_options.voices);
+    for (auto v = uint32_t{0}; v < _options.voices; ++v) {
+        auto const frequency = 55.0F * std::exp2(static_cast<float>(v % 48) / 12.0F);
+        _controls[v] = {frequency, 0.5F / static_cast<float>(_options.voices)};
+    }
+}
+
+GpuSynth::~GpuSynth() {
+    _stop = true;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    // Map callbacks reference their slot.
+    auto const pending = [this] {
+        return std::any_of(_slots.begin(), _slots.end(),
+                           [](auto const& slot) { return slot->state == SlotState::Pending; });
+    };
+    while (pending()) {
+        gpu::waitForQueue(_device);
+    }
+}
+
+auto GpuSynth::syntheticImpulse(double seconds, double sampleRate, uint32_t seed)
+    -> std::array<std::vector<float>, 2> {
+    auto const taps = static_cast<std::size_t>(std::max(seconds * sampleRate, 1.0));
+    auto engine = std::minstd_rand{seed};
+    auto noise = std::uniform_real_distribution<float>{-1.0F, 1.0F};
+
+    // -60 dB at the end, normalized so the tail does not swamp the dry signal.
+    auto const decay = std::log(1000.0) / static_cast<double>(taps);
+    auto const scale = static_cast<float>(std::sqrt(3.0 * 2.0 * decay));
+    auto impulse = std::array<std::vector<float>, 2>{};
+    for (auto& channel : impulse) {
+        channel.resize(taps);
+        for (auto k = std::size_t{0}; k < taps; ++k) {
+            channel[k] = scale * noise(engine) * static_cast<float>(std::exp(-decay * k));
+        }
+    }
+    return impulse;
+}
+
+auto GpuSynth::setVoice(uint32_t voice, float frequency, float amplitude) -> void {
+    auto lock = std::scoped_lock{_controlsMutex};
+    _controls.at(voice) = {frequency, amplitude};
+}
+
+auto GpuSynth::pump() -> void {
+    if (_sampleRate <= 0.0) {
+        return;
+    }
+    auto const audioBlock = _audioFrame.load(std::memory_order_acquire) / _options.blockFrames;
+
+    // The audio thread is done with every block before the current one.
+    for (auto& slot : _slots) {
+        if (slot->state.load(std::memory_order_acquire) == SlotState::Ready and
+            slot->block.load(std::memory_order_relaxed) < audioBlock) {
+            slot->mapped = nullptr;
+            slot->readback.Unmap();
+            slot->state.store(SlotState::Free, std::memory_order_release);
+        }
+    }
+
+    // Blocks the audio clock has already passed are not worth dispatching.
+    if (_nextBlock < audioBlock) {
+        advancePhases(audioBlock - _nextBlock);
+        _nextBlock = audioBlock;
+    }
+
+    while (_nextBlock < audioBlock + _ahead) {
+        auto& slot = *_slots[_nextBlock % _slots.size()];
+        if (slot.state.load(std::memory_order_acquire) != SlotState::Free) {
+            break;
+        }
+        dispatch(slot, _nextBlock);
+        advancePhases(1);
+        ++_nextBlock;
+    }
+
+#ifndef __EMSCRIPTEN__
+    _device.Tick();
+    _device.GetAdapter().GetInstance().ProcessEvents();
+#endif
+}
+
+auto GpuSynth::stats() const -> GpuSynthStats {
+    return {_gpuBlocks.load(std::memory_order_relaxed),
+            _fallbackBlocks.load(std::memory_order_relaxed),
+            _missedBlocks.load(std::memory_order_relaxed)};
+}
+
+auto GpuSynth::roundTrip() const -> Histogram const& {
+    return _roundTrip;
+}
+
+auto GpuSynth::ready() const -> bool {
+    auto const block = _audioFrame.load(std::memory_order_acquire) / _options.blockFrames;
+    auto const& slot = *_slots[block % _slots.size()];
+    return slot.state.load(std::memory_order_acquire) == SlotState::Ready and
+           slot.block.load(std::memory_order_relaxed) == block;
+}
+
+auto GpuSynth::latency() const -> double {
+    return _sampleRate > 0.0 ? 1000.0 * _ahead * _options.blockFrames / _sampleRate : 0.0;
+}
+
+auto GpuSynth::prepare(double sampleRate) -> void {
+    _sampleRate = sampleRate;
+    auto const budget = std::chrono::duration<double>(_options.latencyBudget).count();
+    auto const blocks = std::ceil(budget * sampleRate / _options.blockFrames);
+    _ahead = std::clamp(static_cast<uint32_t>(blocks), 1U, _options.ring - 1);
+
+#ifndef __EMSCRIPTEN__
+    if (not _thread.joinable()) {
+        _thread = std::thread{[this] { run(); }};
+    }
+#endif
+}
+
+auto GpuSynth::process(ProcessContext const& context,
+                       std::span<AudioBus const* const> /*inputs*/,
+                       std::span<AudioBus> outputs) -> void {
+    auto& out = outputs[0];
+    auto const block = context.frame / _options.blockFrames;
+    auto const offset = static_cast<uint32_t>(context.frame % _options.blockFrames);
+    auto& slot = *_slots[block % _slots.size()];
+
+    // Decided once per GPU block, so a readback that lands halfway does not cause a seam.
+    if (offset == 0) {
+        auto const state = slot.state.load(std::memory_order_acquire);
+        auto const current = state != SlotState::Free and
+                             slot.block.load(std::memory_order_relaxed) == block;
+        if (not current) {
+            _source = Source::Silence;
+            _missedBlocks.fetch_add(1, std::memory_order_relaxed);
+        } else if (state == SlotState::Ready) {
+            _source = Source::Gpu;
+            _gpuBlocks.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            _source = Source::Fallback;
+            _fallbackBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    switch (_source) {
+        case Source::Gpu: {
+            auto const* samples = slot.mapped + std::size_t{offset} * channels;
+            for (auto i = std::size_t{0}; i < blockSize; ++i) {
+                out.channel[0][i] = samples[i * channels];
+                out.channel[1][i] = samples[i * channels + 1];
+            }
+            break;
+        }
+        case Source::Fallback:
+            renderFallback(slot, offset, out);
+            break;
+        case Source::Silence:
+            out.channel[0].fill(0.0F);
+            out.channel[1].fill(0.0F);
+            break;
+    }
+
+    _audioFrame.store(context.frame + blockSize, std::memory_order_release);
+}
+
+auto GpuSynth::advancePhases(uint64_t blocks) -> void {
+    auto lock = std::scoped_lock{_controlsMutex};
+    auto const frames = static_cast<double>(blocks * _options.blockFrames);
+    for (auto v = std::size_t{0}; v < _phases.size(); ++v) {
+        auto const phase = _phases[v] + frames * _controls[v].frequency / _sampleRate;
+        _phases[v] = phase - std::floor(phase);
+    }
+}
+
+auto GpuSynth::dispatch(Slot& slot, uint64_t block) -> void {
+    {
+        auto lock = std::scoped_lock{_controlsMutex};
+        for (auto v = std::size_t{0}; v < _controls.size(); ++v) {
+            slot.voices[v] = {static_cast<float>(_phases[v]),
+                              static_cast<float>(_controls[v].frequency / _sampleRate),
+                              _controls[v].amplitude, 0.0F};
+        }
+    }
+
+    auto const frames = _options.blockFrames;
+    auto params = Params{};
+    params.start = static_cast<uint32_t>(block * frames);  // wraps consistently with the mask
+    params.frames = frames;
+    params.voices = _options.voices;
+    params.harmonics = _options.harmonics;
+    params.taps = _taps;
+    params.mask = _historyMask;
+    params.wet = _options.wet;
+    params.gain = _options.gain;
+
+    auto queue = _device.GetQueue();
+    queue.WriteBuffer(_params, 0, &params, sizeof(params));
+    queue.WriteBuffer(_voiceBuffer, 0, slot.voices.data(), slot.voices.size() * sizeof(Voice));
+
+    auto encoder = _device.CreateCommandEncoder();
+    auto pass = encoder.BeginComputePass();
+    _synth->dispatch(pass, _synthBindings, frames);
+    _convolve->dispatch(pass, _convolveBindings, frames * channels);
+    pass.End();
+    encoder.CopyBufferToBuffer(_output, 0, slot.readback, 0, slot.readback.GetSize());
+    auto commands = encoder.Finish();
+    queue.Submit(1, &commands);
+
+    slot.block.store(block, std::memory_order_relaxed);
+    slot.submitted = std::chrono::steady_clock::now();
+    slot.state.store(SlotState::Pending, std::memory_order_release);
+
+    auto callback = [](WGPUBufferMapAsyncStatus status, void* userdata) {
+        auto& s = *static_cast<Slot*>(userdata);
+        if (status != WGPUBufferMapAsyncStatus_Success) {
+            s.state.store(SlotState::Free, std::memory_order_release);
+            return;
+        }
+        auto const elapsed = std::chrono::steady_clock::now() - s.submitted;
+        s.owner->_roundTrip.record(
+            std::chrono::duration<double, std::milli>(elapsed).count());
+        s.mapped = static_cast<float const*>(s.readback.GetConstMappedRange());
+        s.state.store(SlotState::Ready, std::memory_order_release);
+    };
+    slot.readback.MapAsync(wgpu::MapMode::Read, 0, slot.readback.GetSize(), callback, &slot);
+}
+
+auto GpuSynth::renderFallback(Slot const& slot, uint32_t offset, AudioBus& out) const -> void {
+    auto& mono = out.channel[0];
+    mono.fill(0.0F);
+    for (auto const& voice : slot.voices) {
+        auto phase = voice.phase + static_cast<float>(offset) * voice.increment;
+        for (auto i = std::size_t{0}; i < blockSize; ++i) {
+            auto const position = (phase - std::floor(phase)) * static_cast<float>(wavetableSize);
+            auto const index = std::min(static_cast<std::size_t>(position), wavetableSize - 1);
+            auto const frac = position - static_cast<float>(index);
+            auto const a = _wavetable[index];
+            auto const b = _wavetable[index + 1];
+            mono[i] += voice.amplitude * (a + frac * (b - a));
+            phase += voice.increment;
+        }
+    }
+    for (auto& sample : mono) {
+        sample *= _options.gain;
+    }
+    out.channel[1] = mono;
+}
+
+auto GpuSynth::run() -> void {
+    while (not _stop) {
+        pump();
+        std::this_thread::sleep_for(pollInterval);
+    }
+}
+
+}  // namespace tobi::audio
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <tobi/AudioGraph.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/Histogram.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tobi::audio {
+
+struct GpuSynthOptions {
+    uint32_t voices{64};
+    uint32_t harmonics{16};
+
+    // Frames per dispatch, a multiple of audio::blockSize.
+    uint32_t blockFrames{512};
+
+    // Readback slots, bounds how far the GPU can run ahead.
+    uint32_t ring{8};
+
+    // How far ahead of the audio clock blocks are dispatched. Parameter changes take this long
+    // to become audible, and a GPU round trip longer than this falls back to the CPU.
+    std::chrono::milliseconds latencyBudget{40};
+
+    // Convolution reverb per output channel, both the same length. Empty for a dry signal.
+    std::array<std::vector<float>, 2> impulse{};
+    float wet{0.3F};
+    float gain{1.0F};
+};
+
+struct GpuSynthStats {
+    uint64_t gpuBlocks{0};
+    uint64_t fallbackBlocks{0};  // GPU result late, rendered dry on the CPU
+    uint64_t missedBlocks{0};    // not even dispatched in time, silence
+};
+
+// Additive synthesis and long-impulse convolution on the GPU, played as a node of an
+// audio::Graph. A feeder thread dispatches blocks ahead of the audio clock, each into its own
+// slot of a ring of MapRead buffers, and ticks the device until they are mapped. The audio
+// thread only reads mapped memory and flips atomics, it never calls into WebGPU.
+//
+// A block whose readback is not mapped when the audio thread reaches it is rendered on the CPU
+// from a wavetable with the same harmonics. The convolution does not fit the audio thread's
+// budget, so fallback blocks are dry.
+//
+// The feeder thread ticks and submits to the device alongside other threads, so native builds
+// need a thread-safe device, see gpu::isThreadSafe(); the constructor throws
+// std::runtime_error otherwise. Emscripten has no threads here, call pump() once per frame
+// instead.
+struct GpuSynth final : Node {
+    GpuSynth(wgpu::Device device, GpuSynthOptions options = {});
+    ~GpuSynth() override;
+
+    // Decaying stereo noise, a stand-in for a measured room response.
+    [[nodiscard]] static auto syntheticImpulse(double seconds, double sampleRate, uint32_t seed = 1)
+        -> std::array<std::vector<float>, 2>;
+
+    [[nodiscard]] auto numInputs() const -> std::size_t override { return 0; }
+
+    // Any thread except the audio thread, audible after the latency budget.
+    auto setVoice(uint32_t voice, float frequency, float amplitude) -> void;
+
+    // Dispatches due blocks and delivers finished readbacks.
+    auto pump() -> void;
+
+    [[nodiscard]] auto stats() const -> GpuSynthStats;
+
+    // Submit to mapped, in milliseconds.
+    [[nodiscard]] auto roundTrip() const -> Histogram const&;
+
+    // Whether the block at the audio clock is mapped, e.g. to wait for the first round trip
+    // before playing.
+    [[nodiscard]] auto ready() const -> bool;
+
+    // Blocks dispatched ahead of the audio clock, in milliseconds.
+    [[nodiscard]] auto latency() const -> double;
+
+    auto prepare(double sampleRate) -> void override;
+    auto process(ProcessContext const& context,
+                 std::span<AudioBus const* const> inputs,
+                 std::span<AudioBus> outputs) -> void override;
+
+  private:
+    enum struct SlotState : uint32_t {
+        Free,
+        Pending,  // dispatched, readback not mapped yet
+        Ready,    // mapped until the audio clock has passed the block
+    };
+
+    enum struct Source {
+        Gpu,
+        Fallback,
+        Silence,
+    };
+
+    struct Control {
+        float frequency{0.0F};
+        float amplitude{0.0F};
+    };
+
+    struct Voice {
+        float phase{0.0F};  // cycles at the first frame of the block, in [0, 1)
+        float increment{0.0F};
+        float amplitude{0.0F};
+        float padding{0.0F};
+    };
+
+    struct Slot {
+        GpuSynth* owner{nullptr};
+        wgpu::Buffer readback{};
+        std::vector<Voice> voices{};  // for the CPU fallback
+        float const* mapped{nullptr};
+        std::chrono::steady_clock::time_point submitted{};
+        std::atomic<uint64_t> block{UINT64_MAX};
+        std::atomic<SlotState> state{SlotState::Free};
+    };
+
+    auto advancePhases(uint64_t blocks) -> void;
+    auto dispatch(Slot& slot, uint64_t block) -> void;
+    auto renderFallback(Slot const& slot, uint32_t offset, AudioBus& out) const -> void;
+    auto run() -> void;
+
+    wgpu::Device _device;
+    GpuSynthOptions _options;
+    double _sampleRate{0.0};
+    uint32_t _taps{0};
+    uint32_t _historyMask{0};
+    uint32_t _ahead{1};
+
+    std::unique_ptr<gpu::Kernel> _synth{};
+    std::unique_ptr<gpu::Kernel> _convolve{};
+    gpu::Kernel::Bindings _synthBindings{};
+    gpu::Kernel::Bindings _convolveBindings{};
+    wgpu::Buffer _params{};
+    wgpu::Buffer _voiceBuffer{};
+    wgpu::Buffer _history{};
+    wgpu::Buffer _impulse{};
+    wgpu::Buffer _output{};
+    std::vector<std::unique_ptr<Slot>> _slots{};
+    std::vector<float> _wavetable{};
+
+    std::mutex _controlsMutex{};
+    std::vector<Control> _controls{};  // guarded by _controlsMutex
+    std::vector<double> _phases{};     // feeder, at the start of _nextBlock
+    uint64_t _nextBlock{0};            // feeder
+
+    std::atomic<uint64_t> _audioFrame{0};
+    Source _source{Source::Silence};  // audio thread, for the current block
+    std::atomic<uint64_t> _gpuBlocks{0};
+    std::atomic<uint64_t> _fallbackBlocks{0};
+    std::atomic<uint64_t> _missedBlocks{0};
+    Histogram _roundTrip{0.01, 1000.0};
+
+    std::atomic<bool> _stop{false};
+    std::thread _thread{};
+};
+
+}  // namespace tobi::audio
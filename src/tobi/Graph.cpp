@@ -0,0 +1,398 @@
+#include "Graph.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+namespace tobi::gpu {
+
+auto GraphStats::transientBytesSaved() const -> uint64_t {
+    return transientBytesRequested - transientBytesAllocated;
+}
+
+auto Graph::read(Resource resource) -> Binding {
+    return {resource, Access::Read};
+}
+
+auto Graph::write(Resource resource) -> Binding {
+    return {resource, Access::Write};
+}
+
+Graph::Graph(wgpu::Device device) : _device{std::move(device)}, _bindGroups{_device} {}
+
+auto Graph::external(BufferSlice const& slice) -> Resource {
+    _buffers.push_back({.slice = slice, .external = true});
+    _compiled = false;
+    return {static_cast<uint32_t>(_buffers.size() - 1)};
+}
+
+auto Graph::transient(uint64_t size, wgpu::BufferUsage usage) -> Resource {
+    if (size == 0) {
+        throw std::invalid_argument{"transient buffers need a size"};
+    }
+    _buffers.push_back({.slice = {{}, 0, size}, .usage = usage});
+    _compiled = false;
+    return {static_cast<uint32_t>(_buffers.size() - 1)};
+}
+
+auto Graph::bind(Resource resource, BufferSlice const& slice) -> void {
+    if (resource.index >= _buffers.size() or not _buffers[resource.index].external) {
+        throw std::invalid_argument{"only external resources can be rebound"};
+    }
+    for (auto const& node : _nodes) {
+        if (node.kernel != nullptr) {
+            continue;
+        }
+        auto const rebindsSource = node.source.index == resource.index;
+        auto const rebindsDestination = node.destination.index == resource.index;
+        if (rebindsSource or rebindsDestination) {
+            checkCopy(node, rebindsSource ? slice : _buffers[node.source.index].slice,
+                      rebindsDestination ? slice : _buffers[node.destination.index].slice);
+        }
+    }
+    _buffers[resource.index].slice = slice;
+    _rebound = true;
+}
+
+auto Graph::dispatch(Kernel const& kernel, std::vector<Binding> bindings, uint32_t count) -> void {
+    for (auto const& binding : bindings) {
+        if (binding.resource.index >= _buffers.size()) {
+            throw std::invalid_argument{"dispatch binds an unknown resource"};
+        }
+    }
+    _nodes.push_back({.kernel = &kernel, .bindings = std::move(bindings), .count = count});
+    _compiled = false;
+}
+
+auto Graph::copy(Resource source,
+                 Resource destination,
+                 uint64_t size,
+                 uint64_t sourceOffset,
+                 uint64_t destinationOffset) -> void {
+    if (source.index >= _buffers.size() or destination.index >= _buffers.size()) {
+        throw std::invalid_argument{"copy refers to an unknown resource"};
+    }
+    if (source.index == destination.index) {
+        throw std::invalid_argument{"copy source and destination must differ"};
+    }
+    auto node = Node{
+        .source = source,
+        .destination = destination,
+        .size = size,
+        .sourceOffset = sourceOffset,
+        .destinationOffset = destinationOffset,
+    };
+    checkCopy(node, _buffers[source.index].slice, _buffers[destination.index].slice);
+    _nodes.push_back(std::move(node));
+    _compiled = false;
+}
+
+auto Graph::copySize(Node const& node, BufferSlice const& source) -> uint64_t {
+    return node.size != 0 ? node.size : source.size - node.sourceOffset;
+}
+
+// WebGPU copies need sizes and buffer offsets in multiples of 4.
+auto Graph::checkCopy(Node const& node, BufferSlice const& source, BufferSlice const& destination)
+    -> void {
+    if (node.sourceOffset > source.size or node.destinationOffset > destination.size) {
+        throw std::invalid_argument{"copy offset is past the end of the slice"};
+    }
+    auto const size = copySize(node, source);
+    if (size % 4 != 0 or (source.offset + node.sourceOffset) % 4 != 0 or
+        (destination.offset + node.destinationOffset) % 4 != 0) {
+        throw std::invalid_argument{"copy size and offsets must be multiples of 4"};
+    }
+    if (size > source.size - node.sourceOffset or
+        size > destination.size - node.destinationOffset) {
+        throw std::invalid_argument{"copy does not fit into its source and destination"};
+    }
+}
+
+auto Graph::isDispatch(std::size_t node) const -> bool {
+    return _nodes[node].kernel != nullptr;
+}
+
+auto Graph::uses(std::size_t node) const -> std::vector<Binding> {
+    auto const& n = _nodes[node];
+    if (isDispatch(node)) {
+        return n.bindings;
+    }
+    return {read(n.source), write(n.destination)};
+}
+
+auto Graph::live() const -> std::vector<bool> {
+    // Walks backwards: a node is needed if it writes an external buffer or something a needed
+    // node reads later. Storage bindings may read what they write, copies only overwrite.
+    auto result = std::vector<bool>(_nodes.size(), false);
+    auto wanted = std::vector<bool>(_buffers.size(), false);
+    for (auto i = _nodes.size(); i-- > 0;) {
+        auto const bindings = uses(i);
+        result[i] = std::any_of(bindings.begin(), bindings.end(), [&](Binding const& b) {
+            auto const r = b.resource.index;
+            return b.access == Access::Write and (_buffers[r].external or wanted[r]);
+        });
+        if (not result[i]) {
+            continue;
+        }
+        for (auto const& b : bindings) {
+            if (b.access == Access::Read or isDispatch(i)) {
+                wanted[b.resource.index] = true;
+            }
+        }
+    }
+    return result;
+}
+
+auto Graph::schedule(std::vector<bool> const& live) -> void {
+    // Read after write, write after write and write after read dependencies in program order.
+    auto successors = std::vector<std::vector<std::size_t>>(_nodes.size());
+    auto pending = std::vector<uint32_t>(_nodes.size(), 0);
+    auto lastWriter = std::vector<std::optional<std::size_t>>(_buffers.size());
+    auto readers = std::vector<std::vector<std::size_t>>(_buffers.size());
+    for (auto i = std::size_t{0}; i < _nodes.size(); ++i) {
+        if (not live[i]) {
+            continue;
+        }
+        auto const bindings = uses(i);
+        auto const after = [&](std::size_t node) {
+            successors[node].push_back(i);
+            ++pending[i];
+        };
+        for (auto const& b : bindings) {
+            auto const r = b.resource.index;
+            if (lastWriter[r]) {
+                after(*lastWriter[r]);
+            }
+            if (b.access == Access::Write) {
+                std::for_each(readers[r].begin(), readers[r].end(), after);
+            }
+        }
+        for (auto const& b : bindings) {
+            auto const r = b.resource.index;
+            if (b.access == Access::Write) {
+                lastWriter[r] = i;
+                readers[r].clear();
+            } else {
+                readers[r].push_back(i);
+            }
+        }
+    }
+
+    // Alternates between draining every ready dispatch into one pass and every ready copy, in
+    // program order where the dependencies leave a choice.
+    auto ready = std::array<std::set<std::size_t>, 2>{};
+    auto remaining = std::size_t{0};
+    for (auto i = std::size_t{0}; i < _nodes.size(); ++i) {
+        if (live[i]) {
+            ++remaining;
+            if (pending[i] == 0) {
+                ready[isDispatch(i) ? 1 : 0].insert(i);
+            }
+        }
+    }
+
+    _steps.clear();
+    auto pass = not ready[1].empty();
+    while (remaining > 0) {
+        auto& queue = ready[pass ? 1 : 0];
+        auto step = Step{.pass = pass};
+        while (not queue.empty()) {
+            auto const node = *queue.begin();
+            queue.erase(queue.begin());
+            step.nodes.push_back(node);
+            --remaining;
+            for (auto const next : successors[node]) {
+                if (--pending[next] == 0) {
+                    ready[isDispatch(next) ? 1 : 0].insert(next);
+                }
+            }
+        }
+        if (not step.nodes.empty()) {
+            _steps.push_back(std::move(step));
+        }
+        pass = not pass;
+    }
+}
+
+auto Graph::allocateTransients() -> void {
+    static constexpr auto unused = std::numeric_limits<std::size_t>::max();
+
+    auto first = std::vector<std::size_t>(_buffers.size(), unused);
+    auto last = std::vector<std::size_t>(_buffers.size(), 0);
+    auto usage = std::vector<wgpu::BufferUsage>(_buffers.size());
+    for (auto r = std::size_t{0}; r < _buffers.size(); ++r) {
+        usage[r] = _buffers[r].usage;
+    }
+    auto position = std::size_t{0};
+    for (auto const& step : _steps) {
+        for (auto const node : step.nodes) {
+            for (auto const& b : uses(node)) {
+                auto const r = b.resource.index;
+                first[r] = std::min(first[r], position);
+                last[r] = position;
+            }
+            if (not isDispatch(node)) {
+                usage[_nodes[node].source.index] |= wgpu::BufferUsage::CopySrc;
+                usage[_nodes[node].destination.index] |= wgpu::BufferUsage::CopyDst;
+            }
+            ++position;
+        }
+    }
+
+    auto order = std::vector<std::size_t>{};
+    for (auto r = std::size_t{0}; r < _buffers.size(); ++r) {
+        if (not _buffers[r].external and first[r] != unused) {
+            order.push_back(r);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](auto a, auto b) { return first[a] < first[b]; });
+
+    // Greedy interval assignment: the smallest free buffer that fits, else the largest free one
+    // grown to fit, else a new one.
+    struct Physical {
+        uint64_t size{0};
+        wgpu::BufferUsage usage{wgpu::BufferUsage::None};
+        std::size_t busyUntil{0};
+    };
+    auto physical = std::vector<Physical>{};
+    _stats.transientBytesRequested = 0;
+    for (auto const r : order) {
+        auto& buffer = _buffers[r];
+        auto best = physical.size();
+        for (auto p = std::size_t{0}; p < physical.size(); ++p) {
+            if (physical[p].busyUntil >= first[r]) {
+                continue;
+            }
+            if (best == physical.size()) {
+                best = p;
+                continue;
+            }
+            auto const fits = physical[p].size >= buffer.slice.size;
+            auto const bestFits = physical[best].size >= buffer.slice.size;
+            if ((fits and (not bestFits or physical[p].size < physical[best].size)) or
+                (not fits and not bestFits and physical[p].size > physical[best].size)) {
+                best = p;
+            }
+        }
+        if (best == physical.size()) {
+            physical.emplace_back();
+        }
+        physical[best].size = std::max(physical[best].size, buffer.slice.size);
+        physical[best].usage |= usage[r];
+        physical[best].busyUntil = last[r];
+        buffer.physical = best;
+        // Rounded like the allocation, so the saved bytes cannot go negative.
+        _stats.transientBytesRequested += (buffer.slice.size + 3) / 4 * 4;
+    }
+
+    _physical.clear();
+    _stats.transientBytesAllocated = 0;
+    for (auto const& p : physical) {
+        auto descriptor = wgpu::BufferDescriptor{};
+        descriptor.size = (p.size + 3) / 4 * 4;
+        descriptor.usage = p.usage;
+        _physical.push_back(_device.CreateBuffer(&descriptor));
+        _stats.transientBytesAllocated += descriptor.size;
+    }
+    for (auto const r : order) {
+        _buffers[r].slice.buffer = _physical[_buffers[r].physical];
+    }
+    _stats.transientBuffers = _physical.size();
+}
+
+auto Graph::createBindings() -> void {
+    for (auto const& step : _steps) {
+        if (not step.pass) {
+            continue;
+        }
+        for (auto const index : step.nodes) {
+            auto& node = _nodes[index];
+            auto entries = std::vector<wgpu::BindGroupEntry>{};
+            entries.reserve(node.bindings.size());
+            for (auto const& b : node.bindings) {
+                auto const& slice = _buffers[b.resource.index].slice;
+                auto& entry = entries.emplace_back();
+                entry.binding = static_cast<uint32_t>(entries.size() - 1);
+                entry.buffer = slice.buffer;
+                entry.offset = slice.offset;
+                entry.size = slice.size;
+            }
+            node.groups = node.kernel->createBindings(_bindGroups, entries);
+        }
+    }
+}
+
+auto Graph::compile() -> void {
+    auto const needed = live();
+    schedule(needed);
+    allocateTransients();
+    _bindGroups.clear();
+    createBindings();
+
+    _stats.nodes = static_cast<uint64_t>(std::count(needed.begin(), needed.end(), true));
+    _stats.culled = _nodes.size() - _stats.nodes;
+    _stats.dispatches = 0;
+    _stats.copies = 0;
+    _stats.passes = 0;
+    for (auto const& step : _steps) {
+        if (step.pass) {
+            _stats.dispatches += step.nodes.size();
+            ++_stats.passes;
+        } else {
+            _stats.copies += step.nodes.size();
+        }
+    }
+    _compiled = true;
+    _rebound = false;
+}
+
+auto Graph::record(wgpu::CommandEncoder const& encoder) -> void {
+    if (not _compiled) {
+        compile();
+    }
+    if (_rebound) {
+        createBindings();
+        _rebound = false;
+    }
+
+    for (auto const& step : _steps) {
+        if (step.pass) {
+            auto pass = encoder.BeginComputePass();
+            for (auto const index : step.nodes) {
+                auto const& node = _nodes[index];
+                node.kernel->dispatch(pass, node.groups, node.count);
+            }
+            pass.End();
+            continue;
+        }
+
+        for (auto const index : step.nodes) {
+            auto const& node = _nodes[index];
+            auto const& source = _buffers[node.source.index].slice;
+            auto const& destination = _buffers[node.destination.index].slice;
+            encoder.CopyBufferToBuffer(source.buffer, source.offset + node.sourceOffset,
+                                       destination.buffer,
+                                       destination.offset + node.destinationOffset,
+                                       copySize(node, source));
+        }
+    }
+    ++_stats.executions;
+}
+
+auto Graph::execute() -> void {
+    auto encoder = _device.CreateCommandEncoder();
+    record(encoder);
+    auto commands = encoder.Finish();
+    _device.GetQueue().Submit(1, &commands);
+    ++_stats.submits;
+}
+
+auto Graph::stats() const -> GraphStats {
+    return _stats;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/BufferPool.hpp>
+#include <tobi/GPU.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct GraphStats {
+    // Per execution, after compile().
+    uint64_t nodes{0};
+    uint64_t culled{0};
+    uint64_t dispatches{0};
+    uint64_t copies{0};
+    uint64_t passes{0};
+    uint64_t transientBuffers{0};
+    uint64_t transientBytesRequested{0};
+    uint64_t transientBytesAllocated{0};
+
+    // Totals.
+    uint64_t executions{0};
+    uint64_t submits{0};
+
+    [[nodiscard]] auto transientBytesSaved() const -> uint64_t;
+};
+
+// A frame of GPU work declared up front and compiled once. Nodes are dispatches and buffer copies
+// that name the resources they read and write; the declaration order is the program order.
+//
+// compile() culls nodes whose results are never used, then reorders the rest within their
+// dependencies so that dispatches run back to back in as few compute passes as possible, with
+// copies between them. Transient buffers are created by the graph, and transients whose
+// lifetimes in that order do not overlap share one buffer. Execution records everything into one
+// command encoder and submits it once.
+struct Graph {
+    struct Resource {
+        uint32_t index{0};
+    };
+
+    enum struct Access {
+        Read,
+        Write,
+    };
+
+    // A binding of a dispatch, bound in order: the first at binding 0 of group 0.
+    struct Binding {
+        Resource resource{};
+        Access access{Access::Read};
+    };
+
+    [[nodiscard]] static auto read(Resource resource) -> Binding;
+    [[nodiscard]] static auto write(Resource resource) -> Binding;
+
+    explicit Graph(wgpu::Device device);
+
+    Graph(Graph const& other) = delete;
+    Graph(Graph&& other) = delete;
+
+    auto operator=(Graph const& other) -> Graph& = delete;
+    auto operator=(Graph&& other) -> Graph& = delete;
+
+    // A buffer owned by the caller. Nodes writing it are never culled.
+    [[nodiscard]] auto external(BufferSlice const& slice) -> Resource;
+
+    // A buffer that only lives within the graph. Copy usages are added as needed.
+    [[nodiscard]] auto transient(uint64_t size,
+                                 wgpu::BufferUsage usage = wgpu::BufferUsage::Storage)
+        -> Resource;
+
+    // Points an external resource at another slice, e.g. the next buffer of a double buffer.
+    // Copies of the resource are checked against the new slice like in copy().
+    auto bind(Resource resource, BufferSlice const& slice) -> void;
+
+    // The kernel must outlive the graph.
+    auto dispatch(Kernel const& kernel, std::vector<Binding> bindings, uint32_t count) -> void;
+
+    // Copies size bytes, the whole source if zero. Throws std::invalid_argument unless the size
+    // and offsets are multiples of 4 and the copy fits into both slices.
+    auto copy(Resource source,
+              Resource destination,
+              uint64_t size = 0,
+              uint64_t sourceOffset = 0,
+              uint64_t destinationOffset = 0) -> void;
+
+    // Runs implicitly on the first execution after nodes were added.
+    auto compile() -> void;
+
+    // Records the frame into the caller's encoder, e.g. after staging uploads, without submitting.
+    auto record(wgpu::CommandEncoder const& encoder) -> void;
+
+    // Records the frame and submits it.
+    auto execute() -> void;
+
+    [[nodiscard]] auto stats() const -> GraphStats;
+
+  private:
+    struct Buffer {
+        BufferSlice slice{};
+        wgpu::BufferUsage usage{wgpu::BufferUsage::None};
+        bool external{false};
+        std::size_t physical{0};
+    };
+
+    struct Node {
+        Kernel const* kernel{nullptr};
+        std::vector<Binding> bindings{};
+        uint32_t count{0};
+
+        Resource source{};
+        Resource destination{};
+        uint64_t size{0};
+        uint64_t sourceOffset{0};
+        uint64_t destinationOffset{0};
+
+        Kernel::Bindings groups{};
+    };
+
+    struct Step {
+        bool pass{false};
+        std::vector<std::size_t> nodes{};
+    };
+
+    [[nodiscard]] static auto copySize(Node const& node, BufferSlice const& source) -> uint64_t;
+    static auto checkCopy(Node const& node,
+                          BufferSlice const& source,
+                          BufferSlice const& destination) -> void;
+
+    [[nodiscard]] auto isDispatch(std::size_t node) const -> bool;
+    [[nodiscard]] auto uses(std::size_t node) const -> std::vector<Binding>;
+    [[nodiscard]] auto live() const -> std::vector<bool>;
+    auto schedule(std::vector<bool> const& live) -> void;
+    auto allocateTransients() -> void;
+    auto createBindings() -> void;
+
+    wgpu::Device _device{};
+    BindGroupCache _bindGroups;
+    std::vector<Buffer> _buffers{};
+    std::vector<Node> _nodes{};
+    std::vector<Step> _steps{};
+    std::vector<wgpu::Buffer> _physical{};
+    bool _compiled{false};
+    bool _rebound{false};
+    GraphStats _stats{};
+};
+
+}  // namespace tobi::gpu
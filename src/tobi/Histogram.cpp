@@ -0,0 +1,97 @@
+#include "Histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tobi {
+
+Histogram::Histogram(double min, double max, uint32_t bucketsPerOctave)
+    : _min{min}, _bucketsPerOctave{static_cast<double>(bucketsPerOctave)} {
+    if (min <= 0.0 or max <= min or bucketsPerOctave == 0) {
+        throw std::invalid_argument{"histogram range must be positive and non-empty"};
+    }
+
+    _size = static_cast<std::size_t>(std::ceil(std::log2(max / min) * _bucketsPerOctave)) + 1;
+    _buckets = std::make_unique<std::atomic<uint64_t>[]>(_size);
+    reset();
+}
+
+auto Histogram::record(double value) -> void {
+    _buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+
+    auto current = _max.load(std::memory_order_relaxed);
+    while (value > current and not _max.compare_exchange_weak(current, value)) {
+    }
+}
+
+auto Histogram::reset() -> void {
+    for (auto i = std::size_t{0}; i < _size; ++i) {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    _count = 0;
+    _sum = 0.0;
+    _max = 0.0;
+}
+
+auto Histogram::count() const -> uint64_t {
+    return _count.load(std::memory_order_relaxed);
+}
+
+auto Histogram::mean() const -> double {
+    auto const n = count();
+    return n == 0 ? 0.0 : _sum.load(std::memory_order_relaxed) / static_cast<double>(n);
+}
+
+auto Histogram::max() const -> double {
+    return _max.load(std::memory_order_relaxed);
+}
+
+auto Histogram::percentile(double q) const -> double {
+    // Sum the buckets instead of trusting _count, records may be in progress.
+    auto total = uint64_t{0};
+    for (auto i = std::size_t{0}; i < _size; ++i) {
+        total += _buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    auto const rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * total));
+    auto seen = uint64_t{0};
+    for (auto i = std::size_t{0}; i < _size; ++i) {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+            return std::min(bucketUpperEdge(i), max());
+        }
+    }
+    return max();
+}
+
+auto Histogram::bucketCount() const -> std::size_t {
+    return _size;
+}
+
+auto Histogram::bucketUpperEdge(std::size_t index) const -> double {
+    return _min * std::exp2(static_cast<double>(index) / _bucketsPerOctave);
+}
+
+auto Histogram::counts() const -> std::vector<float> {
+    auto result = std::vector<float>(_size);
+    for (auto i = std::size_t{0}; i < _size; ++i) {
+        result[i] = static_cast<float>(_buckets[i].load(std::memory_order_relaxed));
+    }
+    return result;
+}
+
+auto Histogram::bucketIndex(double value) const -> std::size_t {
+    if (not(value > _min)) {
+        return 0;
+    }
+    auto const index = std::ceil(std::log2(value / _min) * _bucketsPerOctave);
+    return std::min(static_cast<std::size_t>(index), _size - 1);
+}
+
+}  // namespace tobi
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tobi {
+
+// Lock-free histogram with logarithmic buckets, every octave between min and max is split into
+// bucketsPerOctave buckets, so percentiles carry a relative error of at most 2^(1/n) - 1.
+// Values outside the range land in the first or last bucket. record() only touches atomics and
+// can be called from any thread, including GPU callbacks and the audio thread; readers see a
+// consistent enough view for display and reporting.
+struct Histogram {
+    explicit Histogram(double min = 0.01, double max = 1000.0, uint32_t bucketsPerOctave = 8);
+
+    Histogram(Histogram const& other) = delete;
+    Histogram(Histogram&& other) = delete;
+
+    auto operator=(Histogram const& other) -> Histogram& = delete;
+    auto operator=(Histogram&& other) -> Histogram& = delete;
+
+    auto record(double value) -> void;
+    auto reset() -> void;
+
+    [[nodiscard]] auto count() const -> uint64_t;
+    [[nodiscard]] auto mean() const -> double;
+    [[nodiscard]] auto max() const -> double;
+
+    // Upper edge of the bucket holding the q-th quantile, q in [0, 1].
+    [[nodiscard]] auto percentile(double q) const -> double;
+
+    [[nodiscard]] auto bucketCount() const -> std::size_t;
+    [[nodiscard]] auto bucketUpperEdge(std::size_t index) const -> double;
+
+    // Snapshot of all bucket counts, e.g. for ImGui::PlotHistogram.
+    [[nodiscard]] auto counts() const -> std::vector<float>;
+
+  private:
+    [[nodiscard]] auto bucketIndex(double value) const -> std::size_t;
+
+    double _min;
+    double _bucketsPerOctave;
+    std::size_t _size;
+    std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+    std::atomic<uint64_t> _count{0};
+    std::atomic<double> _sum{0.0};
+    std::atomic<double> _max{0.0};
+};
+
+}  // namespace tobi
@@ -0,0 +1,87 @@
+#include "Layout.hpp"
+
+#include <utility>
+
+namespace tobi::gpu {
+
+namespace {
+
+auto bufferBindingType(BindingType type) -> wgpu::BufferBindingType {
+    switch (type) {
+        case BindingType::ReadOnlyStorage:
+            return wgpu::BufferBindingType::ReadOnlyStorage;
+        case BindingType::Storage:
+            return wgpu::BufferBindingType::Storage;
+        case BindingType::Uniform:
+            return wgpu::BufferBindingType::Uniform;
+    }
+    return wgpu::BufferBindingType::Uniform;
+}
+
+}  // namespace
+
+LayoutCache::LayoutCache(wgpu::Device device) : _device{std::move(device)} {}
+
+auto LayoutCache::bindGroupLayout(std::span<BindingInfo const> bindings)
+    -> wgpu::BindGroupLayout {
+    auto key = std::vector<uint64_t>{};
+    key.reserve(bindings.size() * 3);
+    for (auto const& binding : bindings) {
+        key.push_back(static_cast<uint64_t>(binding.type));
+        key.push_back(binding.minBindingSize);
+        key.push_back(binding.dynamicOffset ? 1 : 0);
+    }
+
+    auto const lock = std::scoped_lock{_mutex};
+    if (auto const found = _groups.find(key); found != _groups.end()) {
+        ++_stats.hits;
+        return found->second;
+    }
+
+    auto entries = std::vector<wgpu::BindGroupLayoutEntry>(bindings.size());
+    for (auto i = std::size_t{0}; i < bindings.size(); ++i) {
+        entries[i].binding = static_cast<uint32_t>(i);
+        entries[i].visibility = wgpu::ShaderStage::Compute;
+        entries[i].buffer.type = bufferBindingType(bindings[i].type);
+        entries[i].buffer.minBindingSize = bindings[i].minBindingSize;
+        entries[i].buffer.hasDynamicOffset = bindings[i].dynamicOffset;
+    }
+
+    auto descriptor = wgpu::BindGroupLayoutDescriptor{};
+    descriptor.entryCount = entries.size();
+    descriptor.entries = entries.data();
+    auto layout = _device.CreateBindGroupLayout(&descriptor);
+    _groups.emplace(std::move(key), layout);
+    ++_stats.bindGroupLayouts;
+    return layout;
+}
+
+auto LayoutCache::pipelineLayout(std::vector<wgpu::BindGroupLayout> const& groups)
+    -> wgpu::PipelineLayout {
+    auto key = std::vector<WGPUBindGroupLayout>{};
+    key.reserve(groups.size());
+    for (auto const& group : groups) {
+        key.push_back(group.Get());
+    }
+
+    auto const lock = std::scoped_lock{_mutex};
+    if (auto const found = _pipelines.find(key); found != _pipelines.end()) {
+        ++_stats.hits;
+        return found->second;
+    }
+
+    auto descriptor = wgpu::PipelineLayoutDescriptor{};
+    descriptor.bindGroupLayoutCount = groups.size();
+    descriptor.bindGroupLayouts = groups.data();
+    auto layout = _device.CreatePipelineLayout(&descriptor);
+    _pipelines.emplace(std::move(key), layout);
+    ++_stats.pipelineLayouts;
+    return layout;
+}
+
+auto LayoutCache::stats() const -> LayoutCacheStats {
+    auto const lock = std::scoped_lock{_mutex};
+    return _stats;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <tobi/BufferPool.hpp>
+
+#include <fmt/format.h>
+#include <glm/glm.hpp>
+#include <webgpu/webgpu_cpp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace tobi::gpu {
+
+// A string literal as template argument, e.g. ReadOnly<"lhs", float>.
+template <std::size_t N>
+struct FixedString {
+    char value[N]{};
+
+    constexpr FixedString(char const (&str)[N]) { std::copy_n(str, N, value); }
+
+    [[nodiscard]] constexpr auto view() const -> std::string_view { return {value, N - 1}; }
+};
+
+// Name, alignment and size of the WGSL type matching a host type, after the memory layout rules
+// of the WGSL spec. Specialized for 32-bit scalars, glm vectors and float matrices, and structs
+// that describe their fields with a nested WgslStruct.
+template <typename T>
+struct Wgsl;
+
+namespace detail {
+
+constexpr auto roundUp(std::size_t value, std::size_t alignment) -> std::size_t {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Offsets of consecutive fields with the given alignments and sizes, followed by the end of the
+// last one.
+template <std::size_t N>
+constexpr auto fieldOffsets(std::array<std::size_t, N> const& aligns,
+                            std::array<std::size_t, N> const& sizes)
+    -> std::array<std::size_t, N + 1> {
+    auto result = std::array<std::size_t, N + 1>{};
+    auto offset = std::size_t{0};
+    for (auto i = std::size_t{0}; i < N; ++i) {
+        offset = roundUp(offset, aligns[i]);
+        result[i] = offset;
+        offset += sizes[i];
+    }
+    result[N] = offset;
+    return result;
+}
+
+template <typename T>
+concept WgslStruct = requires { typename T::WgslStruct; };
+
+template <typename M>
+struct MemberPointer;
+
+template <typename C, typename M>
+struct MemberPointer<M C::*> {
+    using Class = C;
+    using Type = M;
+};
+
+// Appends the declarations of T and the structs it contains, innermost first.
+template <typename T>
+auto declareStructs(std::vector<std::string>& declarations) -> void;
+
+// Structs nested in a uniform buffer must be 16 byte aligned.
+template <typename T>
+constexpr auto uniformCompatible() -> bool;
+
+}  // namespace detail
+
+template <>
+struct Wgsl<float> {
+    static constexpr std::size_t align = 4;
+    static constexpr std::size_t size = 4;
+    static auto name() -> std::string { return "f32"; }
+};
+
+template <>
+struct Wgsl<int32_t> {
+    static constexpr std::size_t align = 4;
+    static constexpr std::size_t size = 4;
+    static auto name() -> std::string { return "i32"; }
+};
+
+template <>
+struct Wgsl<uint32_t> {
+    static constexpr std::size_t align = 4;
+    static constexpr std::size_t size = 4;
+    static auto name() -> std::string { return "u32"; }
+};
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct Wgsl<glm::vec<L, T, Q>> {
+    static_assert(L >= 2 and L <= 4, "WGSL vectors have 2 to 4 components");
+    static constexpr std::size_t align = L == 2 ? 8 : 16;
+    static constexpr std::size_t size = L * Wgsl<T>::size;
+    static auto name() -> std::string { return fmt::format("vec{}<{}>", L, Wgsl<T>::name()); }
+};
+
+template <glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+struct Wgsl<glm::mat<C, R, T, Q>> {
+    static_assert(std::is_same_v<T, float>, "WGSL matrices hold floats");
+    using Column = Wgsl<glm::vec<R, T, Q>>;
+    static constexpr std::size_t align = Column::align;
+    static constexpr std::size_t size = C * detail::roundUp(Column::size, Column::align);
+    static auto name() -> std::string { return fmt::format("mat{}x{}<f32>", C, R); }
+};
+
+template <FixedString Name, auto Member>
+struct Field {
+    using Class = typename detail::MemberPointer<decltype(Member)>::Class;
+    using Type = typename detail::MemberPointer<decltype(Member)>::Type;
+    static constexpr auto name = Name;
+};
+
+// Describes a host struct to WGSL, every field in declaration order:
+//
+//     struct Params {
+//         uint32_t count;
+//         float scale;
+//
+//         using WgslStruct = gpu::Struct<"Params",
+//                                        gpu::Field<"count", &Params::count>,
+//                                        gpu::Field<"scale", &Params::scale>>;
+//     };
+//
+// Wgsl<Params> static_asserts that the host layout matches the WGSL one: a glm::vec3 after a
+// float, for example, is at offset 4 in C++ and 16 in WGSL and needs explicit padding. Host
+// offsets are derived from the listed fields, not from the struct, so padding in the middle has
+// to be listed as well, e.g. three float fields pad0 to pad2 between the float and the vec3.
+// Only the padding at the end may stay unlisted.
+template <FixedString Name, typename... Fields>
+struct Struct {
+    static_assert(sizeof...(Fields) > 0, "WGSL structs need at least one field");
+
+    static constexpr std::size_t align = std::max({Wgsl<typename Fields::Type>::align...});
+    static constexpr auto offsets = detail::fieldOffsets<sizeof...(Fields)>(
+        {Wgsl<typename Fields::Type>::align...}, {Wgsl<typename Fields::Type>::size...});
+    static constexpr auto hostOffsets = detail::fieldOffsets<sizeof...(Fields)>(
+        {alignof(typename Fields::Type)...}, {sizeof(typename Fields::Type)...});
+    static constexpr std::size_t size = detail::roundUp(offsets.back(), align);
+    static constexpr bool uniformCompatible =
+        (detail::uniformCompatible<typename Fields::Type>() and ...);
+
+    template <typename T>
+    static constexpr bool describes = (std::is_same_v<typename Fields::Class, T> and ...);
+
+    static auto name() -> std::string { return std::string{Name.view()}; }
+
+    static auto declaration() -> std::string {
+        auto result = fmt::format("struct {} {{\n", Name.view());
+        ((result += fmt::format("    {}: {},\n", Fields::name.view(),
+                                Wgsl<typename Fields::Type>::name())),
+         ...);
+        return result + "}\n";
+    }
+
+    static auto declareFields(std::vector<std::string>& declarations) -> void {
+        (detail::declareStructs<typename Fields::Type>(declarations), ...);
+    }
+};
+
+template <detail::WgslStruct T>
+struct Wgsl<T> {
+    using Layout = typename T::WgslStruct;
+    static_assert(std::is_trivially_copyable_v<T> and std::is_standard_layout_v<T>,
+                  "structs shared with WGSL must be plain data");
+    static_assert(Layout::template describes<T>, "WgslStruct fields belong to another struct");
+    static_assert(Layout::offsets == Layout::hostOffsets,
+                  "a field is not where WGSL expects it, add padding before it and list the "
+                  "padding as WgslStruct fields");
+    static_assert(sizeof(T) == Layout::size,
+                  "struct size differs from WGSL, list every field and pad the end to the "
+                  "largest WGSL alignment");
+
+    static constexpr std::size_t align = Layout::align;
+    static constexpr std::size_t size = Layout::size;
+    static auto name() -> std::string { return Layout::name(); }
+};
+
+template <typename T>
+auto detail::declareStructs(std::vector<std::string>& declarations) -> void {
+    if constexpr (WgslStruct<T>) {
+        T::WgslStruct::declareFields(declarations);
+        auto declaration = T::WgslStruct::declaration();
+        if (std::find(declarations.begin(), declarations.end(), declaration) ==
+            declarations.end()) {
+            declarations.push_back(std::move(declaration));
+        }
+    }
+}
+
+template <typename T>
+constexpr auto detail::uniformCompatible() -> bool {
+    if constexpr (WgslStruct<T>) {
+        return Wgsl<T>::align % 16 == 0 and T::WgslStruct::uniformCompatible;
+    }
+    return true;
+}
+
+enum struct BindingType {
+    ReadOnlyStorage,
+    Storage,
+    Uniform,
+};
+
+struct BindingInfo {
+    BindingType type{BindingType::Uniform};
+    uint64_t minBindingSize{0};
+    bool dynamicOffset{false};
+};
+
+namespace detail {
+
+template <FixedString Name, typename T, BindingType Type>
+struct StorageArray {
+    using Element = T;
+    static constexpr auto stride = roundUp(Wgsl<T>::size, Wgsl<T>::align);
+    static_assert(sizeof(T) == stride,
+                  "WGSL pads array elements to their alignment, pad the host type to match");
+    static constexpr auto info = BindingInfo{Type, stride};
+
+    static auto declaration(uint32_t group, uint32_t binding) -> std::string {
+        auto const* access = Type == BindingType::Storage ? "read_write" : "read";
+        return fmt::format("@group({}) @binding({}) var<storage, {}> {}: array<{}>;", group,
+                           binding, access, Name.view(), Wgsl<T>::name());
+    }
+};
+
+}  // namespace detail
+
+// var<storage, read> Name: array<T>
+template <FixedString Name, typename T>
+using ReadOnly = detail::StorageArray<Name, T, BindingType::ReadOnlyStorage>;
+
+// var<storage, read_write> Name: array<T>
+template <FixedString Name, typename T>
+using ReadWrite = detail::StorageArray<Name, T, BindingType::Storage>;
+
+// var<uniform> Name: T
+template <FixedString Name, typename T>
+struct Uniform {
+    using Element = T;
+    static_assert(detail::uniformCompatible<T>(),
+                  "structs nested in a uniform buffer need 16 byte alignment");
+    static constexpr auto info = BindingInfo{BindingType::Uniform, Wgsl<T>::size};
+
+    static auto declaration(uint32_t group, uint32_t binding) -> std::string {
+        return fmt::format("@group({}) @binding({}) var<uniform> {}: {};", group, binding,
+                           Name.view(), Wgsl<T>::name());
+    }
+};
+
+// A binding with a dynamic offset, e.g. Dynamic<Uniform<"params", Params>>. Bind groups of
+// such layouts come from BindGroupCache::dynamic(), which lets one group serve every slice of
+// a buffer.
+template <typename Binding>
+struct Dynamic : Binding {
+    static constexpr auto info =
+        BindingInfo{Binding::info.type, Binding::info.minBindingSize, true};
+};
+
+// A bind group described by its bindings, numbered in order:
+//
+//     struct AddBindings : gpu::Layout<gpu::ReadOnly<"lhs", float>,
+//                                      gpu::ReadOnly<"rhs", float>,
+//                                      gpu::ReadWrite<"out", float>> {};
+//
+// wgsl() emits the matching declarations for the shader, LayoutCache turns the bindings into
+// an explicit wgpu::BindGroupLayout. Layouts with the same binding types and sizes are the same
+// layout, whatever their names.
+template <typename... Bindings>
+struct Layout {
+    static constexpr auto size = sizeof...(Bindings);
+    static constexpr auto bindings = std::array<BindingInfo, size>{Bindings::info...};
+
+    // Struct and variable declarations.
+    static auto wgsl(uint32_t group = 0) -> std::string {
+        auto declarations = std::vector<std::string>{};
+        (detail::declareStructs<typename Bindings::Element>(declarations), ...);
+
+        auto result = std::string{};
+        for (auto const& declaration : declarations) {
+            result += declaration;
+        }
+        auto binding = uint32_t{0};
+        ((result += Bindings::declaration(group, binding++) + "\n"), ...);
+        return result;
+    }
+
+    // One slice per binding, std::invalid_argument if one is smaller than its binding needs.
+    template <typename... Slices>
+    static auto entries(Slices const&... slices) -> std::vector<wgpu::BindGroupEntry> {
+        static_assert(sizeof...(Slices) == size, "one buffer slice per binding");
+        auto result = std::vector<wgpu::BindGroupEntry>{};
+        result.reserve(size);
+        auto const add = [&](BufferSlice const& slice) {
+            auto const binding = static_cast<uint32_t>(result.size());
+            if (slice.size < bindings[binding].minBindingSize) {
+                throw std::invalid_argument{
+                    fmt::format("slice for binding {} holds {} bytes, the binding needs {}",
+                                binding, slice.size, bindings[binding].minBindingSize)};
+            }
+            auto& entry = result.emplace_back();
+            entry.binding = binding;
+            entry.buffer = slice.buffer;
+            entry.offset = slice.offset;
+            entry.size = slice.size;
+        };
+        (add(slices), ...);
+        return result;
+    }
+};
+
+struct LayoutCacheStats {
+    uint64_t bindGroupLayouts{0};
+    uint64_t pipelineLayouts{0};
+    uint64_t hits{0};
+};
+
+// Interns explicit layouts per device. Typed layouts with equal bindings get the same
+// wgpu::BindGroupLayout, and pipeline layouts built from the same group layouts the same
+// wgpu::PipelineLayout, so bind groups created here work with every pipeline that shares them.
+// Bindings are visible to compute shaders. Thread-safe.
+struct LayoutCache {
+    explicit LayoutCache(wgpu::Device device);
+
+    LayoutCache(LayoutCache const& other) = delete;
+    LayoutCache(LayoutCache&& other) = delete;
+
+    auto operator=(LayoutCache const& other) -> LayoutCache& = delete;
+    auto operator=(LayoutCache&& other) -> LayoutCache& = delete;
+
+    template <typename L>
+    [[nodiscard]] auto bindGroupLayout() -> wgpu::BindGroupLayout {
+        return bindGroupLayout(L::bindings);
+    }
+    [[nodiscard]] auto bindGroupLayout(std::span<BindingInfo const> bindings)
+        -> wgpu::BindGroupLayout;
+
+    // One typed layout per bind group, group 0 first.
+    template <typename... Groups>
+    [[nodiscard]] auto pipelineLayout() -> wgpu::PipelineLayout {
+        return pipelineLayout({bindGroupLayout<Groups>()...});
+    }
+    [[nodiscard]] auto pipelineLayout(std::vector<wgpu::BindGroupLayout> const& groups)
+        -> wgpu::PipelineLayout;
+
+    template <typename L, typename... Slices>
+    [[nodiscard]] auto bindGroup(Slices const&... slices) -> wgpu::BindGroup {
+        auto const entries = L::entries(slices...);
+        auto descriptor = wgpu::BindGroupDescriptor{};
+        descriptor.layout = bindGroupLayout<L>();
+        descriptor.entryCount = entries.size();
+        descriptor.entries = entries.data();
+        return _device.CreateBindGroup(&descriptor);
+    }
+
+    [[nodiscard]] auto stats() const -> LayoutCacheStats;
+
+  private:
+    wgpu::Device _device{};
+    mutable std::mutex _mutex{};
+    std::map<std::vector<uint64_t>, wgpu::BindGroupLayout> _groups{};
+    std::map<std::vector<WGPUBindGroupLayout>, wgpu::PipelineLayout> _pipelines{};
+    LayoutCacheStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,142 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdexcept>
+
+namespace tobi {
+
+MappedFile::MappedFile(std::filesystem::path const& path) {
+    map(path, false, 0);
+}
+
+MappedFile::MappedFile(std::filesystem::path const& path, uint64_t size) {
+    map(path, true, size);
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+auto MappedFile::release() -> void {
+#ifdef _WIN32
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr) {
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    if (_data != nullptr) {
+        munmap(_data, _size);
+    }
+    if (_file >= 0) {
+        close(_file);
+    }
+    _data = nullptr;
+    _file = -1;
+#endif
+}
+
+auto MappedFile::size() const -> uint64_t {
+    return _size;
+}
+
+auto MappedFile::bytes() const -> std::span<std::byte const> {
+    return {_data, static_cast<std::size_t>(_size)};
+}
+
+auto MappedFile::writableBytes() -> std::span<std::byte> {
+    if (not _writable) {
+        return {};
+    }
+    return {_data, static_cast<std::size_t>(_size)};
+}
+
+auto MappedFile::map(std::filesystem::path const& path, bool writable, uint64_t size) -> void {
+    auto const fail = [&](char const* what) {
+        release();
+        throw std::runtime_error{std::string{what} + " " + path.string()};
+    };
+    _writable = writable;
+
+#ifdef _WIN32
+    auto* file = CreateFileW(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                             FILE_SHARE_READ, nullptr, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        fail("cannot open");
+    }
+    _file = file;
+
+    if (writable) {
+        _size = size;
+    } else {
+        auto fileSize = LARGE_INTEGER{};
+        GetFileSizeEx(file, &fileSize);
+        _size = static_cast<uint64_t>(fileSize.QuadPart);
+    }
+    if (_size == 0) {
+        return;
+    }
+
+    _mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                  static_cast<DWORD>(_size >> 32U), static_cast<DWORD>(_size),
+                                  nullptr);
+    if (_mapping == nullptr) {
+        fail("cannot map");
+    }
+    _data = static_cast<std::byte*>(
+        MapViewOfFile(_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr) {
+        fail("cannot map");
+    }
+#else
+    _file = writable ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)
+                     : open(path.c_str(), O_RDONLY);
+    if (_file < 0) {
+        fail("cannot open");
+    }
+
+    if (writable) {
+        if (ftruncate(_file, static_cast<off_t>(size)) != 0) {
+            fail("cannot resize");
+        }
+        _size = size;
+    } else {
+        struct stat status {};
+        if (fstat(_file, &status) != 0) {
+            fail("cannot stat");
+        }
+        _size = static_cast<uint64_t>(status.st_size);
+    }
+    if (_size == 0) {
+        return;
+    }
+
+    auto* data = mmap(nullptr, _size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                      _file, 0);
+    if (data == MAP_FAILED) {
+        fail("cannot map");
+    }
+    _data = static_cast<std::byte*>(data);
+    // Streamed front to back, let the kernel read ahead aggressively.
+    madvise(_data, _size, MADV_SEQUENTIAL);
+#endif
+}
+
+}  // namespace tobi
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace tobi {
+
+// A whole file mapped into memory. Pages are read from disk on first access and written back by
+// the OS, so files far larger than RAM can be streamed through without explicit I/O.
+struct MappedFile {
+    // Maps an existing file read-only. Throws std::runtime_error if it cannot be opened.
+    explicit MappedFile(std::filesystem::path const& path);
+
+    // Creates or truncates the file to size bytes and maps it writable.
+    MappedFile(std::filesystem::path const& path, uint64_t size);
+
+    ~MappedFile();
+
+    MappedFile(MappedFile const& other) = delete;
+    MappedFile(MappedFile&& other) = delete;
+
+    auto operator=(MappedFile const& other) -> MappedFile& = delete;
+    auto operator=(MappedFile&& other) -> MappedFile& = delete;
+
+    [[nodiscard]] auto size() const -> uint64_t;
+    [[nodiscard]] auto bytes() const -> std::span<std::byte const>;
+
+    // Empty for read-only mappings.
+    [[nodiscard]] auto writableBytes() -> std::span<std::byte>;
+
+  private:
+    auto map(std::filesystem::path const& path, bool writable, uint64_t size) -> void;
+    auto release() -> void;
+
+    std::byte* _data{nullptr};
+    uint64_t _size{0};
+    bool _writable{false};
+#ifdef _WIN32
+    void* _file{nullptr};
+    void* _mapping{nullptr};
+#else
+    int _file{-1};
+#endif
+};
+
+}  // namespace tobi
@@ -0,0 +1,75 @@
+#include "OfflineRenderer.hpp"
+
+#include <tobi/ThreadPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+namespace tobi {
+
+namespace {
+
+auto renderJob(OfflineJob const& job) -> OfflineResult {
+    if (not job.device) {
+        throw std::invalid_argument{"offline job without a device"};
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    auto device = job.device();
+    auto writer = AudioFileWriter{job.path, job.format, AudioDevice::channels,
+                                  AudioDevice::sampleRate};
+
+    auto const total = static_cast<uint64_t>(std::llround(job.seconds * AudioDevice::sampleRate));
+    auto block = std::vector<float>(std::size_t{offlineBlockFrames} * AudioDevice::channels);
+    for (auto frame = uint64_t{0}; frame < total; frame += offlineBlockFrames) {
+        auto const frames =
+            static_cast<uint32_t>(std::min<uint64_t>(offlineBlockFrames, total - frame));
+        device->render(block.data(), frames);
+        writer.write(block.data(), frames);
+    }
+    writer.close();
+
+    auto result = OfflineResult{};
+    result.frames = total;
+    result.wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+}  // namespace
+
+auto OfflineResult::realtimeFactor() const -> double {
+    auto const audioSeconds = static_cast<double>(frames) / AudioDevice::sampleRate;
+    return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+}
+
+auto renderOffline(std::span<OfflineJob const> jobs, uint32_t threads)
+    -> std::vector<OfflineResult> {
+    if (threads == 0) {
+        threads = ThreadPool::defaultWorkers() + 1;
+    }
+    auto const workers = std::min<std::size_t>(threads, std::max<std::size_t>(jobs.size(), 1)) - 1;
+
+    auto results = std::vector<OfflineResult>(jobs.size());
+    auto errors = std::vector<std::exception_ptr>(jobs.size());
+    auto pool = ThreadPool{static_cast<uint32_t>(workers)};
+    pool.parallelFor(static_cast<uint32_t>(jobs.size()), [&](uint32_t index) {
+        try {
+            results[index] = renderJob(jobs[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+
+    for (auto const& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+}  // namespace tobi
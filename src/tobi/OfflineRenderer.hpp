@@ -0,0 +1,43 @@
+#pragma once
+
+#include <tobi/AudioDevice.hpp>
+#include <tobi/AudioFileWriter.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace tobi {
+
+// Frames per AudioDevice::render() call.
+inline constexpr uint32_t offlineBlockFrames = 1024;
+
+struct OfflineJob {
+    std::filesystem::path path{};
+    AudioFileFormat format{AudioFileFormat::Wav};
+    double seconds{10.0};
+
+    // Builds the device to render, called on the thread that runs the job. The device is never
+    // opened, only its render() is driven.
+    std::function<std::unique_ptr<AudioDevice>()> device{};
+};
+
+struct OfflineResult {
+    uint64_t frames{0};
+    double wallSeconds{0.0};
+
+    // Seconds of audio rendered per second of wall time.
+    [[nodiscard]] auto realtimeFactor() const -> double;
+};
+
+// Renders each job as fast as the CPU allows by calling AudioDevice::render() in a loop, the
+// same code the device callback runs, and streams the output to the job's file. Independent
+// jobs run in parallel on up to threads threads. Rethrows the first job's exception once all
+// jobs are done.
+[[nodiscard]] auto renderOffline(std::span<OfflineJob const> jobs, uint32_t threads = 0)
+    -> std::vector<OfflineResult>;
+
+}  // namespace tobi
@@ -0,0 +1,59 @@
+#include "ParallelRecorder.hpp"
+
+#include <tobi/GPU.hpp>
+
+#include <algorithm>
+
+namespace tobi::gpu {
+
+ParallelRecorder::ParallelRecorder(wgpu::Device device, ThreadPool& pool, std::size_t arenaSize)
+    : _device{std::move(device)}, _pool{pool}, _serial{not isThreadSafe(_device)} {
+    // Slot 0 serves the calling thread, including the serial fallback of parallelFor().
+    for (auto i = uint32_t{0}; i <= _pool.workers(); ++i) {
+        _arenas.push_back(std::make_unique<ScratchArena>(arenaSize));
+    }
+}
+
+auto ParallelRecorder::begin(uint32_t jobs) -> void {
+    if (_commands.size() < jobs) {
+        _commands.resize(jobs);
+        _errors.resize(jobs);
+    }
+}
+
+auto ParallelRecorder::end(uint32_t jobs) -> std::span<wgpu::CommandBuffer const> {
+    for (auto& arena : _arenas) {
+        _stats.peakArenaBytes = std::max<uint64_t>(_stats.peakArenaBytes, arena->used());
+        auto const growths = arena->growths();
+        arena->reset();
+        _stats.arenaGrowths += arena->growths() - growths;
+    }
+
+    auto const failed = std::find_if(_errors.begin(), _errors.begin() + jobs,
+                                     [](auto const& error) { return error != nullptr; });
+    if (failed != _errors.begin() + jobs) {
+        auto const error = *failed;
+        std::fill_n(_errors.begin(), jobs, nullptr);
+        std::fill_n(_commands.begin(), jobs, wgpu::CommandBuffer{});
+        std::rethrow_exception(error);
+    }
+
+    ++_stats.frames;
+    _stats.jobs += jobs;
+    return {_commands.data(), jobs};
+}
+
+auto ParallelRecorder::submitRecorded(std::span<wgpu::CommandBuffer const> commands) -> void {
+    if (commands.empty()) {
+        return;
+    }
+    _device.GetQueue().Submit(commands.size(), commands.data());
+    ++_stats.submits;
+    std::fill_n(_commands.begin(), commands.size(), wgpu::CommandBuffer{});
+}
+
+auto ParallelRecorder::stats() const -> ParallelRecorderStats {
+    return _stats;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <tobi/ScratchArena.hpp>
+#include <tobi/ThreadPool.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct ParallelRecorderStats {
+    uint64_t frames{0};
+    uint64_t jobs{0};
+    uint64_t submits{0};
+    uint64_t arenaGrowths{0};
+
+    // Most scratch memory one thread used in a frame.
+    uint64_t peakArenaBytes{0};
+};
+
+// Records independent jobs of GPU work in parallel on a ThreadPool. Every job gets a command
+// encoder of its own and the scratch arena of the thread it runs on, for descriptors and entry
+// arrays that would otherwise be heap allocated; arenas are reset after each frame. Command
+// buffers are gathered by job index, so they are submitted in the same order however the jobs
+// were scheduled.
+//
+// Encoders are used from several threads at once, which needs a thread-safe device, see
+// isThreadSafe(). Without one the jobs are recorded one after the other on the calling thread.
+// One record() or submit() at a time.
+struct ParallelRecorder {
+    ParallelRecorder(wgpu::Device device, ThreadPool& pool, std::size_t arenaSize = 64 * 1024);
+
+    ParallelRecorder(ParallelRecorder const& other) = delete;
+    ParallelRecorder(ParallelRecorder&& other) = delete;
+
+    auto operator=(ParallelRecorder const& other) -> ParallelRecorder& = delete;
+    auto operator=(ParallelRecorder&& other) -> ParallelRecorder& = delete;
+
+    // Calls fn(job, encoder, arena) for every job in [0, jobs) and returns one command buffer
+    // per job in job order, valid until the next call. An exception from fn does not stop the
+    // other jobs, the one of the first failed job is rethrown here once all of them ran.
+    template <typename Fn>
+    auto record(uint32_t jobs, Fn&& fn) -> std::span<wgpu::CommandBuffer const> {
+        begin(jobs);
+        auto const recordJob = [&](uint32_t job) {
+            try {
+                auto& arena = *_arenas[_pool.workerIndex()];
+                auto encoder = _device.CreateCommandEncoder();
+                fn(job, encoder, arena);
+                _commands[job] = encoder.Finish();
+            } catch (...) {
+                _errors[job] = std::current_exception();
+            }
+        };
+        if (_serial) {
+            for (auto job = uint32_t{0}; job < jobs; ++job) {
+                recordJob(job);
+            }
+        } else {
+            _pool.parallelFor(jobs, recordJob);
+        }
+        return end(jobs);
+    }
+
+    // Records the jobs and submits all of them with a single Submit.
+    template <typename Fn>
+    auto submit(uint32_t jobs, Fn&& fn) -> void {
+        submitRecorded(record(jobs, std::forward<Fn>(fn)));
+    }
+
+    [[nodiscard]] auto stats() const -> ParallelRecorderStats;
+
+  private:
+    auto begin(uint32_t jobs) -> void;
+    auto end(uint32_t jobs) -> std::span<wgpu::CommandBuffer const>;
+    auto submitRecorded(std::span<wgpu::CommandBuffer const> commands) -> void;
+
+    wgpu::Device _device{};
+    ThreadPool& _pool;
+    std::vector<std::unique_ptr<ScratchArena>> _arenas{};
+    std::vector<wgpu::CommandBuffer> _commands{};
+    std::vector<std::exception_ptr> _errors{};
+    bool _serial{false};
+    ParallelRecorderStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,243 @@
+#include "PipelineCache.hpp"
+
+#include <fmt/format.h>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <system_error>
+
+namespace tobi::gpu {
+
+auto hash(void const* data, std::size_t size, uint64_t seed) -> uint64_t {
+    auto const* bytes = static_cast<unsigned char const*>(data);
+    auto h = seed;
+    for (auto i = std::size_t{0}; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+auto hash(std::string_view str, uint64_t seed) -> uint64_t {
+    return hash(str.data(), str.size(), seed);
+}
+
+auto adapterIdentity(wgpu::Adapter const& adapter) -> std::string {
+    auto properties = wgpu::AdapterProperties{};
+    adapter.GetProperties(&properties);
+    return fmt::format("{:04x}:{:04x}:{}:{}", properties.vendorID, properties.deviceID,
+                       static_cast<uint32_t>(properties.backendType),
+                       properties.driverDescription ? properties.driverDescription : "");
+}
+
+BlobCache::BlobCache(std::filesystem::path directory) : _directory{std::move(directory)} {
+    auto error = std::error_code{};
+    std::filesystem::create_directories(_directory, error);
+    if (error) {
+        fmt::println("Could not create cache directory {}: {}", _directory.string(),
+                     error.message());
+    }
+}
+
+auto BlobCache::load(void const* key, std::size_t keySize, void* value, std::size_t valueSize)
+    -> std::size_t {
+    auto const isQuery = value == nullptr;
+    auto miss = [&] {
+        if (isQuery) {
+            ++_misses;
+        }
+        return std::size_t{0};
+    };
+
+    auto lock = std::scoped_lock{_mutex};
+    auto file = std::ifstream{path(key, keySize), std::ios::binary | std::ios::ate};
+    if (not file) {
+        return miss();
+    }
+
+    auto const fileSize = static_cast<std::size_t>(file.tellg());
+    auto storedKeySize = uint64_t{0};
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&storedKeySize), sizeof(storedKeySize));
+    if (not file or storedKeySize != keySize or fileSize < sizeof(storedKeySize) + keySize) {
+        return miss();
+    }
+
+    auto storedKey = std::vector<char>(keySize);
+    file.read(storedKey.data(), static_cast<std::streamsize>(keySize));
+    if (not file or not std::equal(storedKey.begin(), storedKey.end(),
+                                   static_cast<char const*>(key))) {
+        return miss();
+    }
+
+    auto const size = fileSize - sizeof(storedKeySize) - keySize;
+    if (isQuery) {
+        ++_hits;
+        return size;
+    }
+
+    auto const count = std::min(size, valueSize);
+    file.read(static_cast<char*>(value), static_cast<std::streamsize>(count));
+    return file ? count : 0;
+}
+
+auto BlobCache::store(void const* key,
+                      std::size_t keySize,
+                      void const* value,
+                      std::size_t valueSize) -> void {
+    auto const target = path(key, keySize);
+    auto temporary = target;
+    temporary += ".tmp";
+
+    auto lock = std::scoped_lock{_mutex};
+    {
+        auto file = std::ofstream{temporary, std::ios::binary | std::ios::trunc};
+        auto const storedKeySize = static_cast<uint64_t>(keySize);
+        file.write(reinterpret_cast<char const*>(&storedKeySize), sizeof(storedKeySize));
+        file.write(static_cast<char const*>(key), static_cast<std::streamsize>(keySize));
+        file.write(static_cast<char const*>(value), static_cast<std::streamsize>(valueSize));
+        if (not file) {
+            return;
+        }
+    }
+
+    // Readers in other processes never see a partially written entry.
+    auto error = std::error_code{};
+    std::filesystem::rename(temporary, target, error);
+    if (not error) {
+        ++_stores;
+    }
+}
+
+auto BlobCache::directory() const -> std::filesystem::path const& {
+    return _directory;
+}
+
+auto BlobCache::stats() const -> CacheStats {
+    return {_hits.load(), _misses.load(), _stores.load()};
+}
+
+auto BlobCache::path(void const* key, std::size_t keySize) const -> std::filesystem::path {
+    return _directory / fmt::format("{:016x}.bin", hash(key, keySize));
+}
+
+auto PipelineCache::KeyHash::operator()(KeyView key) const -> std::size_t {
+    auto h = hash(key.source);
+    h = hash(key.entryPoint, h);
+    return static_cast<std::size_t>(hash(&key.layout, sizeof(key.layout), h));
+}
+
+auto PipelineCache::KeyEqual::operator()(KeyView lhs, KeyView rhs) const -> bool {
+    return lhs == rhs;
+}
+
+PipelineCache::PipelineCache(wgpu::Device device) : _device{std::move(device)} {}
+
+auto PipelineCache::shaderModule(std::string const& source) -> wgpu::ShaderModule {
+    if (auto const found = _modules.find(source); found != _modules.end()) {
+        return found->second;
+    }
+
+    auto wgsl = wgpu::ShaderModuleWGSLDescriptor{};
+    wgsl.code = source.c_str();
+
+    auto descriptor = wgpu::ShaderModuleDescriptor{};
+    descriptor.nextInChain = &wgsl;
+
+    auto module = _device.CreateShaderModule(&descriptor);
+    _modules.emplace(source, module);
+    return module;
+}
+
+auto PipelineCache::computePipeline(std::string const& source,
+                                    std::string const& entryPoint,
+                                    wgpu::PipelineLayout const& layout) -> wgpu::ComputePipeline {
+    auto const k = KeyView{source, entryPoint, layout.Get()};
+    if (auto const found = _pipelines.find(k); found != _pipelines.end()) {
+        ++_stats.hits;
+        return found->second;
+    }
+    ++_stats.misses;
+
+    auto descriptor = wgpu::ComputePipelineDescriptor{};
+    descriptor.layout = layout;
+    descriptor.compute.module = shaderModule(source);
+    descriptor.compute.entryPoint = entryPoint.c_str();
+
+    auto pipeline = _device.CreateComputePipeline(&descriptor);
+    _pipelines.emplace(Key{source, entryPoint, layout}, pipeline);
+    ++_stats.stores;
+    return pipeline;
+}
+
+auto PipelineCache::warmup(std::vector<PipelineManifestEntry> const& manifest) -> void {
+    // Callbacks may fire on an EventPump thread, results are moved into the cache afterwards.
+    struct Pending {
+        PipelineManifestEntry const* entry{nullptr};
+        wgpu::ComputePipeline pipeline{};
+        std::atomic<bool> done{false};
+    };
+
+    auto pending = std::vector<std::unique_ptr<Pending>>{};
+
+    for (auto const& entry : manifest) {
+        if (_pipelines.contains(KeyView{entry.source, entry.entryPoint, entry.layout.Get()})) {
+            ++_stats.hits;
+            continue;
+        }
+        ++_stats.misses;
+
+        auto descriptor = wgpu::ComputePipelineDescriptor{};
+        descriptor.layout = entry.layout;
+        descriptor.compute.module = shaderModule(entry.source);
+        descriptor.compute.entryPoint = entry.entryPoint.c_str();
+
+        auto& p = pending.emplace_back(std::make_unique<Pending>());
+        p->entry = &entry;
+        _device.CreateComputePipelineAsync(
+            &descriptor,
+            [](WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline,
+               char const* message, void* userdata) {
+                auto* p = static_cast<Pending*>(userdata);
+                if (status == WGPUCreatePipelineAsyncStatus_Success) {
+                    p->pipeline = wgpu::ComputePipeline::Acquire(pipeline);
+                } else {
+                    fmt::println("Pipeline warm-up failed: {}", message);
+                }
+                p->done = true;
+            },
+            p.get());
+    }
+
+#ifndef __EMSCRIPTEN__
+    auto instance = _device.GetAdapter().GetInstance();
+#endif
+    auto const isDone = [](auto const& p) { return p->done.load(); };
+    while (not std::all_of(pending.begin(), pending.end(), isDone)) {
+#ifndef __EMSCRIPTEN__
+        _device.Tick();
+        instance.ProcessEvents();
+#else
+        emscripten_sleep(1);
+#endif
+    }
+
+    for (auto& p : pending) {
+        if (p->pipeline) {
+            _pipelines.emplace(Key{p->entry->source, p->entry->entryPoint, p->entry->layout},
+                               std::move(p->pipeline));
+            ++_stats.stores;
+        }
+    }
+}
+
+auto PipelineCache::stats() const -> CacheStats {
+    return _stats;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tobi::gpu {
+
+// 64-bit FNV-1a, stable across runs and platforms.
+[[nodiscard]] auto hash(void const* data, std::size_t size, uint64_t seed = 14695981039346656037ULL)
+    -> uint64_t;
+[[nodiscard]] auto hash(std::string_view str, uint64_t seed = 14695981039346656037ULL)
+    -> uint64_t;
+
+// Vendor, device, backend and driver of the adapter. Compiled backend code is only valid for
+// the exact same combination, so it is part of every cache key.
+[[nodiscard]] auto adapterIdentity(wgpu::Adapter const& adapter) -> std::string;
+
+struct CacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t stores{0};
+};
+
+// On-disk backing store for Dawn's blob cache. Dawn hands over opaque keys for compiled shaders
+// and pipelines, each entry is stored as one file named after the key hash. The full key is
+// stored in front of the value and compared on load, so hash collisions read as misses.
+//
+// Dawn may call into the cache from its worker threads.
+struct BlobCache {
+    explicit BlobCache(std::filesystem::path directory);
+
+    BlobCache(BlobCache const& other) = delete;
+    BlobCache(BlobCache&& other) = delete;
+
+    auto operator=(BlobCache const& other) -> BlobCache& = delete;
+    auto operator=(BlobCache&& other) -> BlobCache& = delete;
+
+    // Dawn calls load twice per lookup: once without a destination to query the size, then with
+    // a buffer of that size. Returns the value size or zero on a miss.
+    auto load(void const* key, std::size_t keySize, void* value, std::size_t valueSize)
+        -> std::size_t;
+    auto store(void const* key, std::size_t keySize, void const* value, std::size_t valueSize)
+        -> void;
+
+    [[nodiscard]] auto directory() const -> std::filesystem::path const&;
+    [[nodiscard]] auto stats() const -> CacheStats;
+
+  private:
+    [[nodiscard]] auto path(void const* key, std::size_t keySize) const -> std::filesystem::path;
+
+    std::filesystem::path _directory;
+    std::mutex _mutex{};
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    std::atomic<uint64_t> _stores{0};
+};
+
+struct PipelineManifestEntry {
+    std::string source{};
+    std::string entryPoint{"main"};
+    wgpu::PipelineLayout layout{};  // auto-generated when null
+};
+
+// In-process cache of shader modules and compute pipelines, keyed by the WGSL source, the entry
+// point and the pipeline layout. Keys are compared in full, so a hash collision is a miss.
+// Together with a BlobCache attached to the device (see getDefaultDevice) a cold start only pays
+// for WGSL parsing, the backend compilation is loaded from disk. Kernels take their variants from
+// the cache when given one, see Kernel::manifest() for warming it up. One thread at a time.
+struct PipelineCache {
+    explicit PipelineCache(wgpu::Device device);
+
+    [[nodiscard]] auto shaderModule(std::string const& source) -> wgpu::ShaderModule;
+
+    // Pipelines use the auto-generated layout unless an explicit one is given.
+    [[nodiscard]] auto computePipeline(std::string const& source,
+                                       std::string const& entryPoint = "main",
+                                       wgpu::PipelineLayout const& layout = {})
+        -> wgpu::ComputePipeline;
+
+    // Compiles all pipelines of the manifest concurrently and blocks until they are ready.
+    auto warmup(std::vector<PipelineManifestEntry> const& manifest) -> void;
+
+    [[nodiscard]] auto stats() const -> CacheStats;
+
+  private:
+    struct KeyView {
+        std::string_view source{};
+        std::string_view entryPoint{};
+        WGPUPipelineLayout layout{nullptr};
+
+        auto operator==(KeyView const& other) const -> bool = default;
+    };
+
+    struct Key {
+        std::string source{};
+        std::string entryPoint{};
+
+        // Held, so the handle cannot be reused by another layout while the entry is cached.
+        wgpu::PipelineLayout layout{};
+
+        operator KeyView() const { return {source, entryPoint, layout.Get()}; }
+    };
+
+    // Transparent, lookups do not copy the source.
+    struct KeyHash {
+        using is_transparent = void;
+        auto operator()(KeyView key) const -> std::size_t;
+    };
+
+    struct KeyEqual {
+        using is_transparent = void;
+        auto operator()(KeyView lhs, KeyView rhs) const -> bool;
+    };
+
+    wgpu::Device _device{};
+    std::unordered_map<std::string, wgpu::ShaderModule> _modules{};
+    std::unordered_map<Key, wgpu::ComputePipeline, KeyHash, KeyEqual> _pipelines{};
+    CacheStats _stats{};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,274 @@
+#include "Profiler.hpp"
+
+#include <fmt/format.h>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
+namespace tobi::gpu {
+
+namespace {
+
+auto microseconds(Profiler::Clock::duration duration) -> double {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+auto escapeJson(std::string_view str) -> std::string {
+    auto escaped = std::string{};
+    escaped.reserve(str.size());
+    for (auto const c : str) {
+        switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+}  // namespace
+
+Profiler::CpuScope::CpuScope(Profiler& profiler, char const* name)
+    : _profiler{profiler}, _name{name}, _start{Clock::now()} {}
+
+Profiler::CpuScope::~CpuScope() {
+    _profiler.record(_name, _start, Clock::now());
+}
+
+Profiler::Profiler(wgpu::Device device, uint32_t maxScopesPerFrame, std::size_t capacity)
+    : _device{std::move(device)},
+      _maxScopesPerFrame{maxScopesPerFrame},
+      _enabled{_device.HasFeature(wgpu::FeatureName::TimestampQuery)},
+      _capacity{std::max<std::size_t>(capacity, 1)} {
+    _ring.reserve(_capacity);
+    if (not _enabled) {
+        return;
+    }
+
+    auto const queryCount = maxScopesPerFrame * 2;
+    auto const bufferSize = uint64_t{queryCount} * sizeof(uint64_t);
+    for (auto& frame : _frames) {
+        frame = std::make_unique<Frame>();
+        frame->profiler = this;
+        frame->names.reserve(maxScopesPerFrame);
+
+        auto querySet = wgpu::QuerySetDescriptor{};
+        querySet.type = wgpu::QueryType::Timestamp;
+        querySet.count = queryCount;
+        frame->querySet = _device.CreateQuerySet(&querySet);
+
+        auto buffer = wgpu::BufferDescriptor{};
+        buffer.size = bufferSize;
+        buffer.usage = wgpu::BufferUsage::QueryResolve | wgpu::BufferUsage::CopySrc;
+        frame->resolveBuffer = _device.CreateBuffer(&buffer);
+
+        buffer.usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst;
+        frame->readbackBuffer = _device.CreateBuffer(&buffer);
+    }
+    _current = _frames.front().get();
+}
+
+Profiler::~Profiler() {
+    // Map callbacks reference the frames, let the outstanding ones land first.
+#ifndef __EMSCRIPTEN__
+    auto instance = _device.GetAdapter().GetInstance();
+#endif
+    while (_pending > 0) {
+#ifndef __EMSCRIPTEN__
+        _device.Tick();
+        instance.ProcessEvents();
+#else
+        emscripten_sleep(1);
+#endif
+    }
+}
+
+auto Profiler::enabled() const -> bool {
+    return _enabled;
+}
+
+auto Profiler::beginComputePass(wgpu::CommandEncoder const& encoder, char const* name)
+    -> wgpu::ComputePassEncoder {
+    auto descriptor = wgpu::ComputePassDescriptor{};
+    descriptor.label = name;
+
+    auto writes = wgpu::ComputePassTimestampWrites{};
+    if (auto* frame = nextQueries(name); frame != nullptr) {
+        writes.querySet = frame->querySet;
+        writes.beginningOfPassWriteIndex = frame->queryCount - 2;
+        writes.endOfPassWriteIndex = frame->queryCount - 1;
+        descriptor.timestampWrites = &writes;
+    }
+    return encoder.BeginComputePass(&descriptor);
+}
+
+auto Profiler::beginRenderPass(wgpu::CommandEncoder const& encoder,
+                               wgpu::RenderPassDescriptor descriptor,
+                               char const* name) -> wgpu::RenderPassEncoder {
+    descriptor.label = name;
+
+    auto writes = wgpu::RenderPassTimestampWrites{};
+    if (auto* frame = nextQueries(name); frame != nullptr) {
+        writes.querySet = frame->querySet;
+        writes.beginningOfPassWriteIndex = frame->queryCount - 2;
+        writes.endOfPassWriteIndex = frame->queryCount - 1;
+        descriptor.timestampWrites = &writes;
+    }
+    return encoder.BeginRenderPass(&descriptor);
+}
+
+auto Profiler::resolve(wgpu::CommandEncoder const& encoder) -> void {
+    if (_current == nullptr or _current->queryCount == 0) {
+        return;
+    }
+
+    auto const size = uint64_t{_current->queryCount} * sizeof(uint64_t);
+    encoder.ResolveQuerySet(_current->querySet, 0, _current->queryCount, _current->resolveBuffer,
+                            0);
+    encoder.CopyBufferToBuffer(_current->resolveBuffer, 0, _current->readbackBuffer, 0, size);
+}
+
+auto Profiler::submitted() -> void {
+    if (not _enabled) {
+        return;
+    }
+
+    if (_current != nullptr and _current->queryCount > 0) {
+        auto* frame = _current;
+        frame->submitTime = Clock::now();
+        frame->busy = true;
+        ++_pending;
+
+        auto const size = uint64_t{frame->queryCount} * sizeof(uint64_t);
+        frame->readbackBuffer.MapAsync(
+            wgpu::MapMode::Read, 0, size,
+            [](WGPUBufferMapAsyncStatus status, void* userdata) {
+                auto* f = static_cast<Frame*>(userdata);
+                if (status == WGPUBufferMapAsyncStatus_Success) {
+                    f->profiler->collect(*f);
+                }
+                f->busy = false;
+                --f->profiler->_pending;
+            },
+            frame);
+
+        _next = (_next + 1) % _frames.size();
+        _current = nullptr;
+    }
+
+    if (_current == nullptr) {
+        auto& candidate = _frames[_next];
+        if (not candidate->busy) {
+            candidate->names.clear();
+            candidate->queryCount = 0;
+            _current = candidate.get();
+        }
+    }
+}
+
+auto Profiler::record(char const* name, Clock::time_point start, Clock::time_point end) -> void {
+    push({name, TraceEvent::Track::Cpu, microseconds(start - _epoch), microseconds(end - start)});
+}
+
+auto Profiler::events() const -> std::vector<TraceEvent> {
+    auto lock = std::scoped_lock{_mutex};
+    auto events = std::vector<TraceEvent>{};
+    events.reserve(_ring.size());
+    events.insert(events.end(), _ring.begin() + static_cast<std::ptrdiff_t>(_head), _ring.end());
+    events.insert(events.end(), _ring.begin(), _ring.begin() + static_cast<std::ptrdiff_t>(_head));
+    return events;
+}
+
+auto Profiler::lastGpuTime(std::string_view name) const -> double {
+    auto lock = std::scoped_lock{_mutex};
+    for (auto i = std::size_t{0}; i < _ring.size(); ++i) {
+        auto const& event = _ring[(_head + _ring.size() - 1 - i) % _ring.size()];
+        if (event.track == TraceEvent::Track::Gpu and event.name == name) {
+            return event.duration / 1000.0;
+        }
+    }
+    return 0.0;
+}
+
+auto Profiler::toChromeTrace() const -> std::string {
+    auto json = std::string{"{\"displayTimeUnit\":\"ms\",\"traceEvents\":["};
+    json += R"({"name":"thread_name","ph":"M","pid":1,"tid":0,"args":{"name":"CPU"}},)";
+    json += R"({"name":"thread_name","ph":"M","pid":1,"tid":1,"args":{"name":"GPU"}})";
+    for (auto const& event : events()) {
+        json += fmt::format(R"(,{{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},)"
+                            R"("pid":1,"tid":{}}})",
+                            escapeJson(event.name),
+                            event.track == TraceEvent::Track::Gpu ? "gpu" : "cpu", event.start,
+                            event.duration, static_cast<uint32_t>(event.track));
+    }
+    json += "]}";
+    return json;
+}
+
+auto Profiler::nextQueries(char const* name) -> Frame* {
+    if (_current == nullptr or _current->queryCount + 2 > _maxScopesPerFrame * 2) {
+        return nullptr;
+    }
+    _current->names.push_back(name);
+    _current->queryCount += 2;
+    return _current;
+}
+
+auto Profiler::push(TraceEvent event) -> void {
+    auto lock = std::scoped_lock{_mutex};
+    if (_ring.size() < _capacity) {
+        _ring.push_back(std::move(event));
+        return;
+    }
+    _ring[_head] = std::move(event);
+    _head = (_head + 1) % _capacity;
+}
+
+auto Profiler::collect(Frame& frame) -> void {
+    auto const size = uint64_t{frame.queryCount} * sizeof(uint64_t);
+    auto const* timestamps =
+        static_cast<uint64_t const*>(frame.readbackBuffer.GetConstMappedRange(0, size));
+
+    auto first = std::numeric_limits<uint64_t>::max();
+    for (auto i = uint32_t{0}; i < frame.queryCount; i += 2) {
+        first = std::min(first, timestamps[i]);
+    }
+
+    auto offset = 0.0;
+    {
+        auto lock = std::scoped_lock{_mutex};
+        auto const bound = microseconds(frame.submitTime - _epoch) - first / 1000.0;
+        if (not _calibrated or bound > _gpuOffset) {
+            _gpuOffset = bound;
+            _calibrated = true;
+        }
+        offset = _gpuOffset;
+    }
+
+    for (auto i = uint32_t{0}; i < frame.queryCount; i += 2) {
+        auto const begin = timestamps[i];
+        auto const end = std::max(timestamps[i + 1], begin);
+        push({frame.names[i / 2], TraceEvent::Track::Gpu, begin / 1000.0 + offset,
+              (end - begin) / 1000.0});
+    }
+
+    frame.readbackBuffer.Unmap();
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct TraceEvent {
+    enum struct Track : uint32_t {
+        Cpu,
+        Gpu,
+    };
+
+    std::string name{};
+    Track track{Track::Cpu};
+    double start{0.0};     // microseconds since the profiler was created
+    double duration{0.0};  // microseconds
+};
+
+// Measures compute and render passes with timestamp queries. Every frame records into its own
+// query set, which is resolved into a readback buffer at the end of the frame and mapped
+// asynchronously, nothing ever waits for the GPU. If all frame slots are still being read back
+// the frame is simply not measured.
+//
+// GPU timestamps are mapped onto the CPU clock with the tightest offset observed so far: work
+// cannot start before it was submitted, so every frame yields a lower bound for the offset.
+//
+// Events land in a fixed size ring and can be exported as Chrome trace-event JSON, viewable in
+// chrome://tracing or Perfetto.
+struct Profiler {
+    using Clock = std::chrono::steady_clock;
+
+    struct CpuScope {
+        CpuScope(Profiler& profiler, char const* name);
+        ~CpuScope();
+
+        CpuScope(CpuScope const& other) = delete;
+        CpuScope(CpuScope&& other) = delete;
+
+        auto operator=(CpuScope const& other) -> CpuScope& = delete;
+        auto operator=(CpuScope&& other) -> CpuScope& = delete;
+
+      private:
+        Profiler& _profiler;
+        char const* _name;
+        Clock::time_point _start;
+    };
+
+    explicit Profiler(wgpu::Device device,
+                      uint32_t maxScopesPerFrame = 32,
+                      std::size_t capacity = 8192);
+    ~Profiler();
+
+    Profiler(Profiler const& other) = delete;
+    Profiler(Profiler&& other) = delete;
+
+    auto operator=(Profiler const& other) -> Profiler& = delete;
+    auto operator=(Profiler&& other) -> Profiler& = delete;
+
+    // False if the device was created without the timestamp-query feature. Passes are still
+    // created, just not measured.
+    [[nodiscard]] auto enabled() const -> bool;
+
+    [[nodiscard]] auto beginComputePass(wgpu::CommandEncoder const& encoder, char const* name)
+        -> wgpu::ComputePassEncoder;
+    [[nodiscard]] auto beginRenderPass(wgpu::CommandEncoder const& encoder,
+                                       wgpu::RenderPassDescriptor descriptor,
+                                       char const* name) -> wgpu::RenderPassEncoder;
+
+    // Records the query resolve for the current frame. Call on the last encoder of the frame.
+    auto resolve(wgpu::CommandEncoder const& encoder) -> void;
+
+    // Call right after the queue submit containing resolve(). Starts the readback and moves on
+    // to the next frame slot.
+    auto submitted() -> void;
+
+    auto record(char const* name, Clock::time_point start, Clock::time_point end) -> void;
+
+    [[nodiscard]] auto events() const -> std::vector<TraceEvent>;
+
+    // Duration in milliseconds of the most recent GPU scope with that name.
+    [[nodiscard]] auto lastGpuTime(std::string_view name) const -> double;
+
+    [[nodiscard]] auto toChromeTrace() const -> std::string;
+
+  private:
+    static constexpr auto framesInFlight = 4;
+
+    struct Frame {
+        Profiler* profiler{nullptr};
+        wgpu::QuerySet querySet{};
+        wgpu::Buffer resolveBuffer{};
+        wgpu::Buffer readbackBuffer{};
+        std::vector<char const*> names{};
+        uint32_t queryCount{0};
+        Clock::time_point submitTime{};
+        std::atomic<bool> busy{false};
+    };
+
+    [[nodiscard]] auto nextQueries(char const* name) -> Frame*;
+    auto push(TraceEvent event) -> void;
+    auto collect(Frame& frame) -> void;
+
+    wgpu::Device _device{};
+    uint32_t _maxScopesPerFrame{0};
+    Clock::time_point _epoch{Clock::now()};
+    bool _enabled{false};
+
+    std::array<std::unique_ptr<Frame>, framesInFlight> _frames{};
+    Frame* _current{nullptr};
+    std::size_t _next{0};
+    std::atomic<std::size_t> _pending{0};
+
+    // Map callbacks can run on an EventPump thread.
+    mutable std::mutex _mutex{};
+    std::vector<TraceEvent> _ring{};
+    std::size_t _capacity{0};
+    std::size_t _head{0};
+    double _gpuOffset{0.0};
+    bool _calibrated{false};
+};
+
+}  // namespace tobi::gpu
@@ -0,0 +1,489 @@
+#include "Quantize.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// F16C is not part of the x86-64 baseline, the half conversions are compiled for it separately
+// and picked at runtime.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TOBI_F16C_DISPATCH 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace tobi::gpu {
+
+namespace {
+
+constexpr auto const* LoadF32 = R"(
+    fn load(quad: u32) -> vec4<f32> {
+        return bitcast<vec4<f32>>(input[quad]);
+    }
+)";
+
+constexpr auto const* LoadF16 = R"(
+    fn load(quad: u32) -> vec4<f32> {
+        let word = input[quad];
+        return vec4<f32>(unpack2x16float(word.x), unpack2x16float(word.y));
+    }
+)";
+
+constexpr auto const* LoadI8 = R"(
+    fn load(quad: u32) -> vec4<f32> {
+        let word = bitcast<i32>(input[quad]);
+        let q = vec4<i32>(extractBits(word, 0u, 8u), extractBits(word, 8u, 8u),
+                          extractBits(word, 16u, 8u), extractBits(word, 24u, 8u));
+        return vec4<f32>(q) * params.decode.x + params.decode.y;
+    }
+)";
+
+constexpr auto const* LoadU16 = R"(
+    fn load(quad: u32) -> vec4<f32> {
+        let word = input[quad];
+        let q = vec4<u32>(word.x & 0xffffu, word.x >> 16u, word.y & 0xffffu, word.y >> 16u);
+        return vec4<f32>(q) * params.decode.x + params.decode.y;
+    }
+)";
+
+constexpr auto const* StoreF32 = R"(
+    fn store(quad: u32, value: vec4<f32>) {
+        output[quad] = bitcast<vec4<u32>>(value);
+    }
+)";
+
+constexpr auto const* StoreF16 = R"(
+    fn store(quad: u32, value: vec4<f32>) {
+        output[quad] = vec2<u32>(pack2x16float(value.xy), pack2x16float(value.zw));
+    }
+)";
+
+constexpr auto const* StoreI8 = R"(
+    fn store(quad: u32, value: vec4<f32>) {
+        let scaled = round((value - params.encode.y) * params.encode.x);
+        let q = clamp(scaled, vec4<f32>(-128.0), vec4<f32>(127.0));
+        let bytes = bitcast<vec4<u32>>(vec4<i32>(q)) & vec4<u32>(0xffu);
+        output[quad] = bytes.x | (bytes.y << 8u) | (bytes.z << 16u) | (bytes.w << 24u);
+    }
+)";
+
+constexpr auto const* StoreU16 = R"(
+    fn store(quad: u32, value: vec4<f32>) {
+        let scaled = round((value - params.encode.y) * params.encode.x);
+        let q = vec4<u32>(clamp(scaled, vec4<f32>(0.0), vec4<f32>(65535.0)));
+        output[quad] = vec2<u32>(q.x | (q.y << 16u), q.z | (q.w << 16u));
+    }
+)";
+
+// Round to nearest even, overflow to infinity, NaN stays NaN. After Fabian Giesen's
+// float_to_half_fast3_rtne.
+auto toHalf(float value) -> uint16_t {
+    static constexpr auto infinity = uint32_t{255} << 23U;
+    static constexpr auto halfOverflow = uint32_t{127 + 16} << 23U;
+    static constexpr auto halfNormal = uint32_t{113} << 23U;
+    static constexpr auto denormalMagic = uint32_t{(127 - 15) + (23 - 10) + 1} << 23U;
+
+    auto bits = std::bit_cast<uint32_t>(value);
+    auto const sign = bits & 0x80000000U;
+    bits ^= sign;
+
+    auto half = uint32_t{0};
+    if (bits >= halfOverflow) {
+        half = bits > infinity ? 0x7e00U : 0x7c00U;
+    } else if (bits < halfNormal) {
+        // The float addition rounds the mantissa into place.
+        auto const magic = std::bit_cast<float>(denormalMagic);
+        half = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) + magic) - denormalMagic;
+    } else {
+        auto const odd = (bits >> 13U) & 1U;
+        bits = bits - (uint32_t{127 - 15} << 23U) + 0xfffU + odd;
+        half = bits >> 13U;
+    }
+    return static_cast<uint16_t>(half | (sign >> 16U));
+}
+
+auto fromHalf(uint16_t half) -> float {
+    static constexpr auto exponentMask = uint32_t{0x7c00} << 13U;
+    static constexpr auto denormalMagic = uint32_t{113} << 23U;
+
+    auto bits = static_cast<uint32_t>(half & 0x7fffU) << 13U;
+    auto const exponent = bits & exponentMask;
+    bits += uint32_t{127 - 15} << 23U;
+    if (exponent == exponentMask) {
+        bits += uint32_t{128 - 16} << 23U;
+    } else if (exponent == 0) {
+        bits += 1U << 23U;
+        bits = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) -
+                                       std::bit_cast<float>(denormalMagic));
+    }
+    return std::bit_cast<float>(bits | static_cast<uint32_t>(half & 0x8000U) << 16U);
+}
+
+// Same order of operations as the vector code, NaN ends up at hi like with minps and maxps on
+// SSE2 and vminnmq and vmaxnmq on NEON.
+auto quantize(float value, float invScale, float offset, float lo, float hi) -> float {
+    return std::nearbyint(std::max(lo, std::min(hi, (value - offset) * invScale)));
+}
+
+#if defined(TOBI_F16C_DISPATCH)
+auto hasF16c() -> bool {
+    static auto const supported = __builtin_cpu_supports("avx") and __builtin_cpu_supports("f16c");
+    return supported;
+}
+
+// Both return the number of elements converted, the rest is left to the scalar loop.
+__attribute__((target("avx,f16c"))) auto packHalfF16c(float const* src,
+                                                       uint16_t* dst,
+                                                       std::size_t n) -> std::size_t {
+    auto i = std::size_t{0};
+    for (; i + 8 <= n; i += 8) {
+        auto const halves = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), halves);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c"))) auto unpackHalfF16c(uint16_t const* src,
+                                                         float* dst,
+                                                         std::size_t n) -> std::size_t {
+    auto i = std::size_t{0};
+    for (; i + 8 <= n; i += 8) {
+        auto const halves = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(halves));
+    }
+    return i;
+}
+#endif
+
+auto packHalf(float const* src, uint16_t* dst, std::size_t n) -> void {
+    auto i = std::size_t{0};
+#if defined(TOBI_F16C_DISPATCH)
+    if (hasF16c()) {
+        i = packHalfF16c(src, dst, n);
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = toHalf(src[i]);
+    }
+}
+
+auto unpackHalf(uint16_t const* src, float* dst, std::size_t n) -> void {
+    auto i = std::size_t{0};
+#if defined(TOBI_F16C_DISPATCH)
+    if (hasF16c()) {
+        i = unpackHalfF16c(src, dst, n);
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = fromHalf(src[i]);
+    }
+}
+
+auto packI8(float const* src, int8_t* dst, std::size_t n, Quantization q) -> void {
+    auto const invScale = 1.0F / q.scale;
+    auto i = std::size_t{0};
+#if defined(__SSE2__) || defined(_M_X64)
+    auto const scale = _mm_set1_ps(invScale);
+    auto const offset = _mm_set1_ps(q.offset);
+    auto const lo = _mm_set1_ps(-128.0F);
+    auto const hi = _mm_set1_ps(127.0F);
+    auto const convert = [&](float const* p) {
+        auto const scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), offset), scale);
+        return _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(scaled, hi), lo));
+    };
+    for (; i + 16 <= n; i += 16) {
+        auto const a = _mm_packs_epi32(convert(src + i), convert(src + i + 4));
+        auto const b = _mm_packs_epi32(convert(src + i + 8), convert(src + i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi16(a, b));
+    }
+#elif defined(__aarch64__)
+    auto const scale = vdupq_n_f32(invScale);
+    auto const offset = vdupq_n_f32(q.offset);
+    auto const lo = vdupq_n_f32(-128.0F);
+    auto const hi = vdupq_n_f32(127.0F);
+    auto const convert = [&](float const* p) {
+        auto const scaled = vmulq_f32(vsubq_f32(vld1q_f32(p), offset), scale);
+        return vqmovn_s32(vcvtnq_s32_f32(vmaxnmq_f32(vminnmq_f32(scaled, hi), lo)));
+    };
+    for (; i + 16 <= n; i += 16) {
+        auto const a = vcombine_s16(convert(src + i), convert(src + i + 4));
+        auto const b = vcombine_s16(convert(src + i + 8), convert(src + i + 12));
+        vst1q_s8(dst + i, vcombine_s8(vqmovn_s16(a), vqmovn_s16(b)));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = static_cast<int8_t>(quantize(src[i], invScale, q.offset, -128.0F, 127.0F));
+    }
+}
+
+auto unpackI8(int8_t const* src, float* dst, std::size_t n, Quantization q) -> void {
+    auto i = std::size_t{0};
+#if defined(__SSE2__) || defined(_M_X64)
+    auto const scale = _mm_set1_ps(q.scale);
+    auto const offset = _mm_set1_ps(q.offset);
+    // Sign extends by duplicating each lane into the upper half and shifting it back down.
+    auto const convert = [&](__m128i words, float* p) {
+        auto const a = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+        auto const b = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+        _mm_storeu_ps(p, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(a), scale), offset));
+        _mm_storeu_ps(p + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), scale), offset));
+    };
+    for (; i + 16 <= n; i += 16) {
+        auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        convert(_mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8), dst + i);
+        convert(_mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8), dst + i + 8);
+    }
+#elif defined(__aarch64__)
+    auto const scale = vdupq_n_f32(q.scale);
+    auto const offset = vdupq_n_f32(q.offset);
+    auto const convert = [&](int16x8_t words, float* p) {
+        auto const a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(words)));
+        auto const b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(words)));
+        vst1q_f32(p, vaddq_f32(vmulq_f32(a, scale), offset));
+        vst1q_f32(p + 4, vaddq_f32(vmulq_f32(b, scale), offset));
+    };
+    for (; i + 16 <= n; i += 16) {
+        auto const bytes = vld1q_s8(src + i);
+        convert(vmovl_s8(vget_low_s8(bytes)), dst + i);
+        convert(vmovl_s8(vget_high_s8(bytes)), dst + i + 8);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]) * q.scale + q.offset;
+    }
+}
+
+auto packU16(float const* src, uint16_t* dst, std::size_t n, Quantization q) -> void {
+    auto const invScale = 1.0F / q.scale;
+    auto i = std::size_t{0};
+#if defined(__SSE2__) || defined(_M_X64)
+    auto const scale = _mm_set1_ps(invScale);
+    auto const offset = _mm_set1_ps(q.offset);
+    auto const lo = _mm_set1_ps(0.0F);
+    auto const hi = _mm_set1_ps(65535.0F);
+    // SSE2 only packs signed words, so the range is shifted down by 32768 and the sign bit
+    // flipped back afterwards.
+    auto const bias = _mm_set1_epi32(32768);
+    auto const flip = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    auto const convert = [&](float const* p) {
+        auto const scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), offset), scale);
+        return _mm_sub_epi32(_mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(scaled, hi), lo)), bias);
+    };
+    for (; i + 8 <= n; i += 8) {
+        auto const words = _mm_packs_epi32(convert(src + i), convert(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(words, flip));
+    }
+#elif defined(__aarch64__)
+    auto const scale = vdupq_n_f32(invScale);
+    auto const offset = vdupq_n_f32(q.offset);
+    auto const lo = vdupq_n_f32(0.0F);
+    auto const hi = vdupq_n_f32(65535.0F);
+    auto const convert = [&](float const* p) {
+        auto const scaled = vmulq_f32(vsubq_f32(vld1q_f32(p), offset), scale);
+        return vqmovn_u32(vcvtnq_u32_f32(vmaxnmq_f32(vminnmq_f32(scaled, hi), lo)));
+    };
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u16(dst + i, vcombine_u16(convert(src + i), convert(src + i + 4)));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = static_cast<uint16_t>(quantize(src[i], invScale, q.offset, 0.0F, 65535.0F));
+    }
+}
+
+auto unpackU16(uint16_t const* src, float* dst, std::size_t n, Quantization q) -> void {
+    auto i = std::size_t{0};
+#if defined(__SSE2__) || defined(_M_X64)
+    auto const scale = _mm_set1_ps(q.scale);
+    auto const offset = _mm_set1_ps(q.offset);
+    auto const zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        auto const words = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        auto const b = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(a, scale), offset));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(b, scale), offset));
+    }
+#elif defined(__aarch64__)
+    auto const scale = vdupq_n_f32(q.scale);
+    auto const offset = vdupq_n_f32(q.offset);
+    for (; i + 8 <= n; i += 8) {
+        auto const words = vld1q_u16(src + i);
+        auto const a = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+        auto const b = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+        vst1q_f32(dst + i, vaddq_f32(vmulq_f32(a, scale), offset));
+        vst1q_f32(dst + i + 4, vaddq_f32(vmulq_f32(b, scale), offset));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]) * q.scale + q.offset;
+    }
+}
+
+auto checkQuantization(StorageFormat format, Quantization quantization) -> void {
+    auto const integer = format == StorageFormat::I8 or format == StorageFormat::U16;
+    if (integer and not(std::isfinite(quantization.scale) and quantization.scale != 0.0F)) {
+        throw std::invalid_argument{"quantization scale must be finite and non-zero"};
+    }
+}
+
+}  // namespace
+
+auto toString(StorageFormat format) -> char const* {
+    switch (format) {
+        case StorageFormat::F32:
+            return "f32";
+        case StorageFormat::F16:
+            return "f16";
+        case StorageFormat::I8:
+            return "i8";
+        case StorageFormat::U16:
+            return "u16";
+    }
+    return "f32";
+}
+
+auto elementSize(StorageFormat format) -> uint32_t {
+    switch (format) {
+        case StorageFormat::F32:
+            return 4;
+        case StorageFormat::F16:
+        case StorageFormat::U16:
+            return 2;
+        case StorageFormat::I8:
+            return 1;
+    }
+    return 4;
+}
+
+auto packedSize(StorageFormat format, std::size_t count) -> std::size_t {
+    return (count + 3) / 4 * 4 * elementSize(format);
+}
+
+auto fitQuantization(StorageFormat format, std::span<float const> data) -> Quantization {
+    if (format == StorageFormat::F32 or format == StorageFormat::F16 or data.empty()) {
+        return {};
+    }
+
+    auto lo = std::numeric_limits<float>::max();
+    auto hi = std::numeric_limits<float>::lowest();
+    for (auto const value : data) {
+        lo = std::min(lo, value);
+        hi = std::max(hi, value);
+    }
+
+    auto const steps = format == StorageFormat::I8 ? 255.0F : 65535.0F;
+    auto const scale = hi > lo ? (hi - lo) / steps : 1.0F;
+    auto const offset = format == StorageFormat::I8 ? lo + 128.0F * scale : lo;
+    return {scale, offset};
+}
+
+auto pack(StorageFormat format,
+          Quantization quantization,
+          std::span<float const> src,
+          std::span<std::byte> dst) -> void {
+    if (dst.size() < src.size() * elementSize(format)) {
+        throw std::invalid_argument{"packed destination is too small"};
+    }
+    checkQuantization(format, quantization);
+
+    auto const n = src.size();
+    switch (format) {
+        case StorageFormat::F32:
+            std::copy(src.begin(), src.end(), reinterpret_cast<float*>(dst.data()));
+            break;
+        case StorageFormat::F16:
+            packHalf(src.data(), reinterpret_cast<uint16_t*>(dst.data()), n);
+            break;
+        case StorageFormat::I8:
+            packI8(src.data(), reinterpret_cast<int8_t*>(dst.data()), n, quantization);
+            break;
+        case StorageFormat::U16:
+            packU16(src.data(), reinterpret_cast<uint16_t*>(dst.data()), n, quantization);
+            break;
+    }
+}
+
+auto unpack(StorageFormat format,
+            Quantization quantization,
+            std::span<std::byte const> src,
+            std::span<float> dst) -> void {
+    if (src.size() < dst.size() * elementSize(format)) {
+        throw std::invalid_argument{"packed source is too small"};
+    }
+
+    auto const n = dst.size();
+    switch (format) {
+        case StorageFormat::F32: {
+            auto const* first = reinterpret_cast<float const*>(src.data());
+            std::copy(first, first + n, dst.begin());
+            break;
+        }
+        case StorageFormat::F16:
+            unpackHalf(reinterpret_cast<uint16_t const*>(src.data()), dst.data(), n);
+            break;
+        case StorageFormat::I8:
+            unpackI8(reinterpret_cast<int8_t const*>(src.data()), dst.data(), n, quantization);
+            break;
+        case StorageFormat::U16:
+            unpackU16(reinterpret_cast<uint16_t const*>(src.data()), dst.data(), n, quantization);
+            break;
+    }
+}
+
+auto wgslWord(StorageFormat format) -> char const* {
+    switch (format) {
+        case StorageFormat::F32:
+            return "vec4<u32>";
+        case StorageFormat::F16:
+        case StorageFormat::U16:
+            return "vec2<u32>";
+        case StorageFormat::I8:
+            return "u32";
+    }
+    return "vec4<u32>";
+}
+
+auto wgslLoad(StorageFormat format) -> char const* {
+    switch (format) {
+        case StorageFormat::F32:
+            return LoadF32;
+        case StorageFormat::F16:
+            return LoadF16;
+        case StorageFormat::I8:
+            return LoadI8;
+        case StorageFormat::U16:
+            return LoadU16;
+    }
+    return LoadF32;
+}
+
+auto wgslStore(StorageFormat format) -> char const* {
+    switch (format) {
+        case StorageFormat::F32:
+            return StoreF32;
+        case StorageFormat::F16:
+            return StoreF16;
+        case StorageFormat::I8:
+            return StoreI8;
+        case StorageFormat::U16:
+            return StoreU16;
+    }
+    return StoreF32;
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace tobi::gpu {
+
+// How float data is stored in a buffer. Bandwidth bound kernels read and write fewer bytes
+// with the narrow formats and compute on unpacked f32 or f16 values.
+enum struct StorageFormat {
+    F32,
+    F16,  // IEEE binary16, round to nearest even
+    I8,   // value = q * scale + offset, q in [-128, 127]
+    U16,  // value = q * scale + offset, q in [0, 65535]
+};
+
+// Affine mapping of the integer formats, ignored by F32 and F16.
+struct Quantization {
+    float scale{1.0F};
+    float offset{0.0F};
+};
+
+[[nodiscard]] auto toString(StorageFormat format) -> char const*;
+[[nodiscard]] auto elementSize(StorageFormat format) -> uint32_t;
+
+// Bytes for count elements, rounded up to a whole number of 16 byte quads of four elements so
+// kernels can load and store four elements at a time.
+[[nodiscard]] auto packedSize(StorageFormat format, std::size_t count) -> std::size_t;
+
+// Spans the range of data with the format's integers.
+[[nodiscard]] auto fitQuantization(StorageFormat format, std::span<float const> data)
+    -> Quantization;
+
+// Vectorized with NEON, or F16C when the CPU has it, for halves and SSE2 or NEON for the integer
+// formats. Values out of range saturate, NaN to the top of the range with every backend. dst
+// must hold at least src.size() packed elements.
+auto pack(StorageFormat format,
+          Quantization quantization,
+          std::span<float const> src,
+          std::span<std::byte> dst) -> void;
+auto unpack(StorageFormat format,
+            Quantization quantization,
+            std::span<std::byte const> src,
+            std::span<float> dst) -> void;
+
+// WGSL for a buffer of quads: the element type of the array at binding `input` or `output`,
+// and `fn load(quad: u32) -> vec4<f32>` reading from `input` or `fn store(quad: u32,
+// value: vec4<f32>)` writing to `output`. Decoding reads (scale, offset) from params.decode,
+// encoding (1 / scale, offset) from params.encode.
+[[nodiscard]] auto wgslWord(StorageFormat format) -> char const*;
+[[nodiscard]] auto wgslLoad(StorageFormat format) -> char const*;
+[[nodiscard]] auto wgslStore(StorageFormat format) -> char const*;
+
+}  // namespace tobi::gpu
@@ -0,0 +1,150 @@
+#include "Readback.hpp"
+
+#include <tobi/GPU.hpp>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace tobi::gpu {
+
+namespace {
+
+// Upper bound for the extra latency a completed map sees before its callback runs.
+constexpr auto pollInterval = std::chrono::microseconds{100};
+
+}  // namespace
+
+EventPump::EventPump(wgpu::Device device) : _device{std::move(device)} {
+#ifndef __EMSCRIPTEN__
+    _instance = _device.GetAdapter().GetInstance();
+    if (isThreadSafe(_device)) {
+        _thread = std::thread{[this] { run(); }};
+    }
+#endif
+}
+
+EventPump::~EventPump() {
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stop = true;
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    // Callbacks reference their request, drain them before the pump goes away.
+    while (pending() > 0) {
+        tick();
+    }
+}
+
+auto EventPump::device() const -> wgpu::Device const& {
+    return _device;
+}
+
+auto EventPump::pending() const -> std::size_t {
+    auto lock = std::scoped_lock{_mutex};
+    return _pending;
+}
+
+auto EventPump::addPending() -> void {
+    {
+        auto lock = std::scoped_lock{_mutex};
+        ++_pending;
+    }
+    _wake.notify_one();
+}
+
+auto EventPump::removePending() -> void {
+    auto lock = std::scoped_lock{_mutex};
+    --_pending;
+}
+
+auto EventPump::run() -> void {
+    while (true) {
+        {
+            // Not held while ticking, callbacks take the lock in removePending().
+            auto lock = std::unique_lock{_mutex};
+            _wake.wait(lock, [this] { return _stop or _pending > 0; });
+            if (_stop) {
+                break;
+            }
+        }
+        tick();
+        std::this_thread::sleep_for(pollInterval);
+    }
+}
+
+auto EventPump::tick() -> void {
+#ifndef __EMSCRIPTEN__
+    _device.Tick();
+    _instance.ProcessEvents();
+#else
+    emscripten_sleep(1);
+#endif
+}
+
+auto readback(EventPump& pump, wgpu::Buffer const& buffer, uint64_t offset, uint64_t size)
+    -> Readback {
+    auto request = std::make_unique<EventPump::Request>();
+    request->pump = &pump;
+    request->size = size;
+    auto future = request->promise.get_future();
+
+    auto const& device = pump._device;
+    if ((buffer.GetUsage() & wgpu::BufferUsage::MapRead) == wgpu::BufferUsage::None) {
+        auto descriptor = wgpu::BufferDescriptor{};
+        descriptor.size = size;
+        descriptor.usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead;
+        request->buffer = device.CreateBuffer(&descriptor);
+
+        auto encoder = device.CreateCommandEncoder();
+        encoder.CopyBufferToBuffer(buffer, offset, request->buffer, 0, size);
+        auto commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+    } else {
+        request->buffer = buffer;
+        request->offset = offset;
+    }
+
+    auto callback = [](WGPUBufferMapAsyncStatus status, void* userdata) {
+        // Runs on whichever thread ticks the device.
+        auto r = std::unique_ptr<EventPump::Request>{static_cast<EventPump::Request*>(userdata)};
+        r->pump->removePending();
+
+        if (status != WGPUBufferMapAsyncStatus_Success) {
+            auto const error = std::runtime_error{"buffer mapping for readback failed"};
+            r->promise.set_exception(std::make_exception_ptr(error));
+            return;
+        }
+
+        auto data = std::vector<std::byte>(r->size);
+        std::memcpy(data.data(), r->buffer.GetConstMappedRange(r->offset, r->size), r->size);
+        r->buffer.Unmap();
+        r->promise.set_value(std::move(data));
+    };
+
+    pump.addPending();
+    auto* userdata = request.release();
+    userdata->buffer.MapAsync(wgpu::MapMode::Read, userdata->offset, size, callback, userdata);
+
+    return future;
+}
+
+auto wait(EventPump& pump, Readback& readback) -> std::vector<std::byte> {
+    if (not pump._thread.joinable()) {
+        while (readback.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            pump.tick();
+        }
+    }
+    return readback.get();
+}
+
+}  // namespace tobi::gpu
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tobi::gpu {
+
+using Readback = std::future<std::vector<std::byte>>;
+
+// Owns the thread that ticks the device while map requests are outstanding, so any number of
+// MapAsync calls can be in flight without the caller spinning. The thread sleeps on a condition
+// variable while nothing is pending.
+//
+// Ticking from a second thread needs a thread-safe device, see isThreadSafe(). Without one, and
+// on Emscripten, no thread is started and the pump is driven from wait() instead.
+struct EventPump {
+    explicit EventPump(wgpu::Device device);
+    ~EventPump();
+
+    EventPump(EventPump const& other) = delete;
+    EventPump(EventPump&& other) = delete;
+
+    auto operator=(EventPump const& other) -> EventPump& = delete;
+    auto operator=(EventPump&& other) -> EventPump& = delete;
+
+    [[nodiscard]] auto device() const -> wgpu::Device const&;
+
+    // Number of map requests that have not completed yet.
+    [[nodiscard]] auto pending() const -> std::size_t;
+
+    // Keeps the pump ticking for requests issued elsewhere, e.g. a MapAsync or
+    // OnSubmittedWorkDone of the caller's own. Call addPending() before issuing the request and
+    // removePending() from its callback, which runs on whichever thread ticks the device.
+    auto addPending() -> void;
+    auto removePending() -> void;
+
+  private:
+    friend auto readback(EventPump& pump,
+                         wgpu::Buffer const& buffer,
+                         uint64_t offset,
+                         uint64_t size) -> Readback;
+    friend auto wait(EventPump& pump, Readback& readback) -> std::vector<std::byte>;
+
+    struct Request {
+        EventPump* pump{nullptr};
+        wgpu::Buffer buffer{};
+        uint64_t offset{0};
+        uint64_t size{0};
+        std::promise<std::vector<std::byte>> promise{};
+    };
+
+    auto run() -> void;
+    auto tick() -> void;
+
+    wgpu::Device _device{};
+    wgpu::Instance _instance{};
+
+    mutable std::mutex _mutex{};
+    std::condition_variable _wake{};
+    std::size_t _pending{0};
+    std::atomic<bool> _stop{false};
+    std::thread _thread{};
+};
+
+// Downloads size bytes starting at offset. Buffers without MapRead usage are first copied into
+// a temporary MapRead buffer on the device queue. Offset must be a multiple of 8 and size a
+// multiple of 4.
+[[nodiscard]] auto readback(EventPump& pump,
+                            wgpu::Buffer const& buffer,
+                            uint64_t offset,
+                            uint64_t size) -> Readback;
+
+// Blocks until the readback completed and returns its data.
+[[nodiscard]] auto wait(EventPump& pump, Readback& readback) -> std::vector<std::byte>;
+
+}  // namespace tobi::gpu
@@ -0,0 +1,65 @@
+#include "ScratchArena.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace tobi {
+
+ScratchArena::ScratchArena(std::size_t capacity)
+    : _block{std::make_unique_for_overwrite<std::byte[]>(std::max<std::size_t>(capacity, 64))},
+      _capacity{std::max<std::size_t>(capacity, 64)} {}
+
+ScratchArena::~ScratchArena() {
+    destroyItems();
+}
+
+auto ScratchArena::allocate(std::size_t size, std::size_t alignment) -> void* {
+    auto const base = reinterpret_cast<uintptr_t>(_block.get());
+    auto const aligned = (base + _offset + alignment - 1) / alignment * alignment - base;
+    if (aligned + size <= _capacity) {
+        _offset = aligned + size;
+        return _block.get() + aligned;
+    }
+
+    // Rare: a block of its own, padded so any alignment fits.
+    auto const padded = size + alignment;
+    auto& block = _overflow.emplace_back(std::make_unique_for_overwrite<std::byte[]>(padded));
+    _overflowBytes += padded;
+    auto const address = reinterpret_cast<uintptr_t>(block.get());
+    return block.get() + ((address + alignment - 1) / alignment * alignment - address);
+}
+
+auto ScratchArena::destroyItems() -> void {
+    for (auto* cleanup = _cleanup; cleanup != nullptr;) {
+        auto* next = cleanup->next;
+        cleanup->destroy(cleanup->items, cleanup->count);
+        cleanup = next;
+    }
+    _cleanup = nullptr;
+}
+
+auto ScratchArena::reset() -> void {
+    destroyItems();
+    if (not _overflow.empty()) {
+        _capacity = std::bit_ceil(_offset + _overflowBytes);
+        _block = std::make_unique_for_overwrite<std::byte[]>(_capacity);
+        _overflow.clear();
+        _overflowBytes = 0;
+        ++_growths;
+    }
+    _offset = 0;
+}
+
+auto ScratchArena::used() const -> std::size_t {
+    return _offset + _overflowBytes;
+}
+
+auto ScratchArena::capacity() const -> std::size_t {
+    return _capacity;
+}
+
+auto ScratchArena::growths() const -> uint64_t {
+    return _growths;
+}
+
+}  // namespace tobi
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace tobi {
+
+// Bump allocator for short-lived data such as descriptors and entry arrays built while recording
+// commands. make() hands out value-initialized arrays, reset() destroys all of them at once and
+// rewinds. A request that does not fit gets a block of its own; the next reset() replaces the
+// block with one large enough for everything, so a repeating workload stops allocating after
+// its first round.
+//
+// Not thread-safe, every thread uses an arena of its own.
+struct ScratchArena {
+    explicit ScratchArena(std::size_t capacity = 64 * 1024);
+    ~ScratchArena();
+
+    ScratchArena(ScratchArena const& other) = delete;
+    ScratchArena(ScratchArena&& other) = delete;
+
+    auto operator=(ScratchArena const& other) -> ScratchArena& = delete;
+    auto operator=(ScratchArena&& other) -> ScratchArena& = delete;
+
+    template <typename T>
+    [[nodiscard]] auto make(std::size_t count) -> std::span<T> {
+        auto* items = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_value_construct_n(items, count);
+        if constexpr (not std::is_trivially_destructible_v<T>) {
+            auto* memory = allocate(sizeof(Cleanup), alignof(Cleanup));
+            _cleanup = new (memory) Cleanup{_cleanup, items, count, [](void* p, std::size_t n) {
+                                                std::destroy_n(static_cast<T*>(p), n);
+                                            }};
+        }
+        return {items, count};
+    }
+
+    auto reset() -> void;
+
+    // Bytes handed out since the last reset, including alignment and overflow blocks.
+    [[nodiscard]] auto used() const -> std::size_t;
+    [[nodiscard]] auto capacity() const -> std::size_t;
+
+    // Number of times reset() had to replace the block with a larger one.
+    [[nodiscard]] auto growths() const -> uint64_t;
+
+  private:
+    struct Cleanup {
+        Cleanup* next{nullptr};
+        void* items{nullptr};
+        std::size_t count{0};
+        void (*destroy)(void*, std::size_t){nullptr};
+    };
+
+    [[nodiscard]] auto allocate(std::size_t size, std::size_t alignment) -> void*;
+    auto destroyItems() -> void;
+
+    std::unique_ptr<std::byte[]> _block;
+    std::size_t _capacity{0};
+    std::size_t _offset{0};
+    std::vector<std::unique_ptr<std::byte[]>> _overflow{};
+    std::size_t _overflowBytes{0};
+    Cleanup* _cleanup{nullptr};
+    uint64_t _growths{0};
+};
+
+}  // namespace tobi
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace tobi::audio::simd {
+
+// Thin wrapper over the widest float vector the target was compiled for. Kernels are written
+// once against it and handle the tail that does not fill a whole batch with scalar code.
+struct Batch {
+#if defined(__AVX__)
+    static constexpr std::size_t size = 8;
+    __m256 v;
+
+    static auto load(float const* p) -> Batch { return {_mm256_loadu_ps(p)}; }
+    static auto broadcast(float x) -> Batch { return {_mm256_set1_ps(x)}; }
+    auto store(float* p) const -> void { _mm256_storeu_ps(p, v); }
+    friend auto operator+(Batch a, Batch b) -> Batch { return {_mm256_add_ps(a.v, b.v)}; }
+    friend auto operator-(Batch a, Batch b) -> Batch { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend auto operator*(Batch a, Batch b) -> Batch { return {_mm256_mul_ps(a.v, b.v)}; }
+    friend auto max(Batch a, Batch b) -> Batch { return {_mm256_max_ps(a.v, b.v)}; }
+    friend auto abs(Batch a) -> Batch { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0F), a.v)}; }
+#elif defined(__SSE2__) || defined(_M_X64)
+    static constexpr std::size_t size = 4;
+    __m128 v;
+
+    static auto load(float const* p) -> Batch { return {_mm_loadu_ps(p)}; }
+    static auto broadcast(float x) -> Batch { return {_mm_set1_ps(x)}; }
+    auto store(float* p) const -> void { _mm_storeu_ps(p, v); }
+    friend auto operator+(Batch a, Batch b) -> Batch { return {_mm_add_ps(a.v, b.v)}; }
+    friend auto operator-(Batch a, Batch b) -> Batch { return {_mm_sub_ps(a.v, b.v)}; }
+    friend auto operator*(Batch a, Batch b) -> Batch { return {_mm_mul_ps(a.v, b.v)}; }
+    friend auto max(Batch a, Batch b) -> Batch { return {_mm_max_ps(a.v, b.v)}; }
+    friend auto abs(Batch a) -> Batch { return {_mm_andnot_ps(_mm_set1_ps(-0.0F), a.v)}; }
+#elif defined(__ARM_NEON)
+    static constexpr std::size_t size = 4;
+    float32x4_t v;
+
+    static auto load(float const* p) -> Batch { return {vld1q_f32(p)}; }
+    static auto broadcast(float x) -> Batch { return {vdupq_n_f32(x)}; }
+    auto store(float* p) const -> void { vst1q_f32(p, v); }
+    friend auto operator+(Batch a, Batch b) -> Batch { return {vaddq_f32(a.v, b.v)}; }
+    friend auto operator-(Batch a, Batch b) -> Batch { return {vsubq_f32(a.v, b.v)}; }
+    friend auto operator*(Batch a, Batch b) -> Batch { return {vmulq_f32(a.v, b.v)}; }
+    friend auto max(Batch a, Batch b) -> Batch { return {vmaxq_f32(a.v, b.v)}; }
+    friend auto abs(Batch a) -> Batch { return {vabsq_f32(a.v)}; }
+#else
+    static constexpr std::size_t size = 1;
+    float v;
+
+    static auto load(float const* p) -> Batch { return {*p}; }
+    static auto broadcast(float x) -> Batch { return {x}; }
+    auto store(float* p) const -> void { *p = v; }
+    friend auto operator+(Batch a, Batch b) -> Batch { return {a.v + b.v}; }
+    friend auto operator-(Batch a, Batch b) -> Batch { return {a.v - b.v}; }
+    friend auto operator*(Batch a, Batch b) -> Batch { return {a.v * b.v}; }
+    friend auto max(Batch a, Batch b) -> Batch { return {std::max(a.v, b.v)}; }
+    friend auto abs(Batch a) -> Batch { return {std::abs(a.v)}; }
+#endif
+
+    // {0, 1, 2, ...}, the per lane offset of a ramp.
+    static auto iota() -> Batch {
+        alignas(32) static constexpr float lanes[8]{0, 1, 2, 3, 4, 5, 6, 7};
+        return load(lanes);
+    }
+};
+
+inline auto clear(float* dst, std::size_t n) -> void {
+    std::fill(dst, dst + n, 0.0F);
+}
+
+inline auto copy(float* dst, float const* src, std::size_t n) -> void {
+    std::copy(src, src + n, dst);
+}
+
+// dst += src
+inline auto add(float* dst, float const* src, std::size_t n) -> void {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    for (; i < whole; i += Batch::size) {
+        (Batch::load(dst + i) + Batch::load(src + i)).store(dst + i);
+    }
+    for (; i < n; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+// dst += src * (start + step * i), a linearly interpolated gain.
+inline auto addRamped(float* dst, float const* src, float start, float step, std::size_t n)
+    -> void {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    auto const lane = Batch::iota() * Batch::broadcast(step);
+    auto const advance = Batch::broadcast(step * static_cast<float>(Batch::size));
+    auto gain = Batch::broadcast(start) + lane;
+    for (; i < whole; i += Batch::size) {
+        (Batch::load(dst + i) + Batch::load(src + i) * gain).store(dst + i);
+        gain = gain + advance;
+    }
+    for (; i < n; ++i) {
+        dst[i] += src[i] * (start + step * static_cast<float>(i));
+    }
+}
+
+// dst = src * (start + step * i)
+inline auto copyRamped(float* dst, float const* src, float start, float step, std::size_t n)
+    -> void {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    auto const lane = Batch::iota() * Batch::broadcast(step);
+    auto const advance = Batch::broadcast(step * static_cast<float>(Batch::size));
+    auto gain = Batch::broadcast(start) + lane;
+    for (; i < whole; i += Batch::size) {
+        (Batch::load(src + i) * gain).store(dst + i);
+        gain = gain + advance;
+    }
+    for (; i < n; ++i) {
+        dst[i] = src[i] * (start + step * static_cast<float>(i));
+    }
+}
+
+// dst *= src
+inline auto multiply(float* dst, float const* src, std::size_t n) -> void {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    for (; i < whole; i += Batch::size) {
+        (Batch::load(dst + i) * Batch::load(src + i)).store(dst + i);
+    }
+    for (; i < n; ++i) {
+        dst[i] *= src[i];
+    }
+}
+
+[[nodiscard]] inline auto peak(float const* src, std::size_t n) -> float {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    auto acc = Batch::broadcast(0.0F);
+    for (; i < whole; i += Batch::size) {
+        acc = max(acc, abs(Batch::load(src + i)));
+    }
+
+    alignas(32) float lanes[Batch::size];
+    acc.store(lanes);
+    auto result = *std::max_element(lanes, lanes + Batch::size);
+    for (; i < n; ++i) {
+        result = std::max(result, std::abs(src[i]));
+    }
+    return result;
+}
+
+[[nodiscard]] inline auto sumSquares(float const* src, std::size_t n) -> float {
+    auto const whole = n - n % Batch::size;
+    auto i = std::size_t{0};
+    auto acc = Batch::broadcast(0.0F);
+    for (; i < whole; i += Batch::size) {
+        auto const x = Batch::load(src + i);
+        acc = acc + x * x;
+    }
+
+    alignas(32) float lanes[Batch::size];
+    acc.store(lanes);
+    auto result = 0.0F;
+    for (auto lane : lanes) {
+        result += lane;
+    }
+    for (; i < n; ++i) {
+        result += src[i] * src[i];
+    }
+    return result;
+}
+
+// Planar stereo to interleaved frames.
+inline auto interleave(float* dst, float const* left, float const* right, std::size_t n) -> void {
+    for (auto i = std::size_t{0}; i < n; ++i) {
+        dst[2 * i + 0] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+}  // namespace tobi::audio::simd
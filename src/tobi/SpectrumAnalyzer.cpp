@@ -0,0 +1,198 @@
+#include "SpectrumAnalyzer.hpp"
+
+#include <tobi/Simd.hpp>
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+
+namespace tobi::audio {
+
+namespace {
+
+constexpr auto lowestFrequency = 20.0;
+
+auto levelColor(float db) -> ImU32 {
+    auto const t = std::clamp((db - SpectrumAnalyzer::floorDb) / -SpectrumAnalyzer::floorDb,
+                              0.0F, 1.0F);
+    auto const channel = [](float x) {
+        return static_cast<ImU32>(std::clamp(x, 0.0F, 1.0F) * 255.0F);
+    };
+    return IM_COL32(channel(3.0F * t - 1.0F), channel(3.0F * t - 2.0F),
+                    channel(t < 0.5F ? 2.0F * t : 2.0F - 2.0F * t), 255);
+}
+
+}  // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(uint32_t fftSize)
+    : _fft{fftSize}, _spectrogram(std::size_t{spectrogramColumns} * spectrogramRows, floorDb) {
+    _spectrum.fill(floorDb);
+    setFftSize(fftSize);
+}
+
+auto SpectrumAnalyzer::setFftSize(uint32_t size) -> void {
+    if (size < 256 or size > AudioSnapshot::frames or not std::has_single_bit(size)) {
+        throw std::invalid_argument{"FFT size must be a power of two from 256 to 8192"};
+    }
+    if (size != _fft.size()) {
+        _fft = Fft{size};
+    }
+
+    _window.resize(size);
+    for (auto i = uint32_t{0}; i < size; ++i) {
+        auto const phase = 2.0 * std::numbers::pi * i / size;
+        _window[i] = static_cast<float>(0.5 - 0.5 * std::cos(phase));
+    }
+    // Full scale sine at 0 dB: the window's coherent gain, and half the energy in each sideband.
+    _normalization = 2.0F / std::accumulate(_window.begin(), _window.end(), 0.0F);
+    _re.resize(size);
+    _im.resize(size);
+
+    auto const nyquist = AudioDevice::sampleRate * 0.5;
+    auto const binWidth = AudioDevice::sampleRate / static_cast<double>(size);
+    auto const ratio = std::log(nyquist / lowestFrequency);
+    _bands.resize(displayBins);
+    for (auto b = uint32_t{0}; b < displayBins; ++b) {
+        auto const lo = lowestFrequency * std::exp(ratio * b / displayBins) / binWidth;
+        auto const hi = lowestFrequency * std::exp(ratio * (b + 1) / displayBins) / binWidth;
+        auto const first = std::min(std::lround(lo), static_cast<long>(size / 2));
+        auto const last = std::clamp(std::lround(hi) - 1, first, static_cast<long>(size / 2));
+        _bands[b] = {static_cast<uint32_t>(first), static_cast<uint32_t>(last)};
+    }
+    _frame = UINT64_MAX;
+}
+
+auto SpectrumAnalyzer::fftSize() const -> uint32_t {
+    return static_cast<uint32_t>(_fft.size());
+}
+
+auto SpectrumAnalyzer::analyze(AudioSnapshot const& snapshot) -> bool {
+    if (snapshot.frame == _frame) {
+        return false;
+    }
+    _frame = snapshot.frame;
+    analyzeSpectrum(snapshot);
+    analyzeScope(snapshot);
+    return true;
+}
+
+auto SpectrumAnalyzer::spectrum() const -> std::span<float const, displayBins> {
+    return _spectrum;
+}
+
+auto SpectrumAnalyzer::analyzeSpectrum(AudioSnapshot const& snapshot) -> void {
+    using simd::Batch;
+
+    auto const size = static_cast<uint32_t>(_fft.size());
+    auto const start = AudioSnapshot::frames - size;
+    auto const half = Batch::broadcast(0.5F);
+    for (auto i = uint32_t{0}; i < size; i += Batch::size) {
+        auto const left = Batch::load(snapshot.samples[0].data() + start + i);
+        auto const right = Batch::load(snapshot.samples[1].data() + start + i);
+        ((left + right) * half * Batch::load(_window.data() + i)).store(_re.data() + i);
+    }
+    std::fill(_im.begin(), _im.end(), 0.0F);
+
+    _fft.forward(_re.data(), _im.data());
+
+    // Power into _re, only up to Nyquist is used.
+    for (auto i = uint32_t{0}; i < size / 2; i += Batch::size) {
+        auto const re = Batch::load(_re.data() + i);
+        auto const im = Batch::load(_im.data() + i);
+        (re * re + im * im).store(_re.data() + i);
+    }
+    _re[size / 2] = _re[size / 2] * _re[size / 2];
+
+    auto const scale = _normalization * _normalization;
+    for (auto b = uint32_t{0}; b < displayBins; ++b) {
+        auto const [first, last] = _bands[b];
+        auto const power = *std::max_element(_re.begin() + first, _re.begin() + last + 1) * scale;
+        _spectrum[b] = std::max(10.0F * std::log10(power + 1e-30F), floorDb);
+    }
+
+    constexpr auto rowBins = displayBins / spectrogramRows;
+    auto* column = _spectrogram.data() + std::size_t{_column} * spectrogramRows;
+    for (auto r = uint32_t{0}; r < spectrogramRows; ++r) {
+        auto const* bins = _spectrum.data() + r * rowBins;
+        column[r] = *std::max_element(bins, bins + rowBins);
+    }
+    _column = (_column + 1) % spectrogramColumns;
+}
+
+// Starts at a rising zero crossing of the left channel if there is one, so a periodic signal
+// stands still.
+auto SpectrumAnalyzer::analyzeScope(AudioSnapshot const& snapshot) -> void {
+    auto const& left = snapshot.samples[0];
+    auto start = AudioSnapshot::frames - scopeFrames;
+    for (auto i = start; i > start - scopeFrames; --i) {
+        if (left[i - 1] < 0.0F and left[i] >= 0.0F) {
+            start = i;
+            break;
+        }
+    }
+
+    constexpr auto step = scopeFrames / scopePoints;
+    for (auto p = uint32_t{0}; p < scopePoints; ++p) {
+        for (auto ch = 0; ch < 2; ++ch) {
+            auto const* samples = snapshot.samples[ch].data() + start + p * step;
+            auto const [min, max] = std::minmax_element(samples, samples + step);
+            _scope[p].min[ch] = *min;
+            _scope[p].max[ch] = *max;
+        }
+    }
+}
+
+auto SpectrumAnalyzer::draw() -> void {
+    static constexpr auto sizes = std::array{"256", "512", "1024", "2048", "4096", "8192"};
+
+    auto selected = std::countr_zero(fftSize()) - 8;
+    if (ImGui::Combo("FFT size", &selected, sizes.data(), static_cast<int>(sizes.size()))) {
+        setFftSize(256U << selected);
+    }
+
+    auto const width = ImGui::GetContentRegionAvail().x;
+    ImGui::PlotLines("##spectrum", _spectrum.data(), static_cast<int>(_spectrum.size()), 0,
+                     "Spectrum", floorDb, 0.0F, ImVec2{width, 120});
+
+    auto* drawList = ImGui::GetWindowDrawList();
+
+    auto origin = ImGui::GetCursorScreenPos();
+    auto const height = 128.0F;
+    auto const cellWidth = width / spectrogramColumns;
+    auto const cellHeight = height / spectrogramRows;
+    for (auto c = uint32_t{0}; c < spectrogramColumns; ++c) {
+        auto const* column =
+            _spectrogram.data() + std::size_t{(_column + c) % spectrogramColumns} * spectrogramRows;
+        auto const x = origin.x + c * cellWidth;
+        for (auto r = uint32_t{0}; r < spectrogramRows; ++r) {
+            auto const y = origin.y + height - (r + 1) * cellHeight;
+            drawList->AddRectFilled(ImVec2{x, y}, ImVec2{x + cellWidth, y + cellHeight},
+                                    levelColor(column[r]));
+        }
+    }
+    ImGui::Dummy(ImVec2{width, height});
+
+    origin = ImGui::GetCursorScreenPos();
+    auto const colors = std::array{IM_COL32(90, 200, 255, 255), IM_COL32(255, 170, 60, 200)};
+    auto const pointWidth = width / scopePoints;
+    drawList->AddRect(origin, ImVec2{origin.x + width, origin.y + height},
+                      IM_COL32(80, 80, 80, 255));
+    for (auto ch = 0; ch < 2; ++ch) {
+        for (auto p = uint32_t{0}; p < scopePoints; ++p) {
+            auto const x = origin.x + p * pointWidth;
+            auto const top = std::clamp(_scope[p].max[ch], -1.0F, 1.0F);
+            auto const bottom = std::clamp(_scope[p].min[ch], -1.0F, 1.0F);
+            drawList->AddLine(ImVec2{x, origin.y + (1.0F - top) * 0.5F * height},
+                              ImVec2{x, origin.y + (1.0F - bottom) * 0.5F * height + 1.0F},
+                              colors[ch]);
+        }
+    }
+    ImGui::Dummy(ImVec2{width, height});
+}
+
+}  // namespace tobi::audio
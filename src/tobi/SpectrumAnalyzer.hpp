@@ -0,0 +1,73 @@
+#pragma once
+
+#include <tobi/AudioDevice.hpp>
+#include <tobi/Fft.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace tobi::audio {
+
+// Spectrum, spectrogram and oscilloscope of AudioSnapshots, on the UI thread. The FFT output is
+// reduced to a fixed number of log-spaced bins and the scope to a fixed number of min/max
+// columns before anything is drawn, so drawing costs the same at every FFT size.
+struct SpectrumAnalyzer {
+    static constexpr uint32_t displayBins = 256;
+    static constexpr uint32_t spectrogramColumns = 128;
+    static constexpr uint32_t spectrogramRows = 64;
+    static constexpr uint32_t scopeFrames = 2048;
+    static constexpr uint32_t scopePoints = 512;
+    static constexpr float floorDb = -120.0F;
+
+    explicit SpectrumAnalyzer(uint32_t fftSize = 4096);
+
+    SpectrumAnalyzer(SpectrumAnalyzer const& other) = delete;
+    SpectrumAnalyzer(SpectrumAnalyzer&& other) = delete;
+
+    auto operator=(SpectrumAnalyzer const& other) -> SpectrumAnalyzer& = delete;
+    auto operator=(SpectrumAnalyzer&& other) -> SpectrumAnalyzer& = delete;
+
+    // A power of two from 256 to AudioSnapshot::frames, std::invalid_argument otherwise.
+    auto setFftSize(uint32_t size) -> void;
+    [[nodiscard]] auto fftSize() const -> uint32_t;
+
+    // False if the snapshot was analyzed already.
+    auto analyze(AudioSnapshot const& snapshot) -> bool;
+
+    // Level of the mono mix in dBFS, from 20 Hz to Nyquist.
+    [[nodiscard]] auto spectrum() const -> std::span<float const, displayBins>;
+
+    // Contents of the current ImGui window.
+    auto draw() -> void;
+
+  private:
+    struct Band {
+        uint32_t first{0};
+        uint32_t last{0};  // inclusive
+    };
+
+    struct ScopeColumn {
+        std::array<float, 2> min{};
+        std::array<float, 2> max{};
+    };
+
+    auto analyzeSpectrum(AudioSnapshot const& snapshot) -> void;
+    auto analyzeScope(AudioSnapshot const& snapshot) -> void;
+
+    Fft _fft;
+    std::vector<float> _window{};
+    std::vector<float> _re{};
+    std::vector<float> _im{};
+    std::vector<Band> _bands{};
+    float _normalization{1.0F};
+
+    uint64_t _frame{UINT64_MAX};
+    std::array<float, displayBins> _spectrum{};
+    std::vector<float> _spectrogram{};  // spectrogramColumns x spectrogramRows, column major
+    uint32_t _column{0};                // oldest column of the spectrogram
+    std::array<ScopeColumn, scopePoints> _scope{};
+};
+
+}  // namespace tobi::audio
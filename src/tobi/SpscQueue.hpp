@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+
+namespace tobi {
+
+// Bounded single-producer single-consumer ring buffer. Both ends are wait-free: a push or pop is
+// a fixed number of loads and stores, it never takes a lock, allocates or retries. One slot is
+// kept empty to tell full from empty, so Capacity - 1 elements fit.
+//
+// Exactly one thread may push and exactly one thread may pop at any time. Typical use is the
+// UI thread talking to the audio callback and back.
+template <typename T, std::size_t Capacity>
+struct SpscQueue {
+    static_assert(Capacity >= 2 and (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "elements are copied without constructors");
+    static_assert(std::atomic<std::size_t>::is_always_lock_free);
+
+    SpscQueue() = default;
+
+    SpscQueue(SpscQueue const& other) = delete;
+    SpscQueue(SpscQueue&& other) = delete;
+
+    auto operator=(SpscQueue const& other) -> SpscQueue& = delete;
+    auto operator=(SpscQueue&& other) -> SpscQueue& = delete;
+
+    // Producer side. False if the queue is full, the element is not stored.
+    [[nodiscard]] auto push(T const& value) -> bool {
+        auto const tail = _tail.load(std::memory_order_relaxed);
+        auto const next = (tail + 1) & mask;
+        if (next == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _slots[tail] = value;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    [[nodiscard]] auto pop() -> std::optional<T> {
+        auto const head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        auto value = _slots[head];
+        _head.store((head + 1) & mask, std::memory_order_release);
+        return value;
+    }
+
+    // Consumer side. Drops everything but the newest element, for state snapshots.
+    [[nodiscard]] auto popLatest() -> std::optional<T> {
+        auto latest = std::optional<T>{};
+        while (auto value = pop()) {
+            latest = value;
+        }
+        return latest;
+    }
+
+    [[nodiscard]] static constexpr auto capacity() -> std::size_t { return Capacity - 1; }
+
+  private:
+    static constexpr auto mask = Capacity - 1;
+
+    // Separate cache lines, so producer and consumer do not invalidate each other's index.
+    alignas(64) std::atomic<std::size_t> _head{0};
+    alignas(64) std::atomic<std::size_t> _tail{0};
+    alignas(64) std::array<T, Capacity> _slots{};
+};
+
+}  // namespace tobi
@@ -0,0 +1,344 @@
+#include "StreamExecutor.hpp"
+
+#include <tobi/Capabilities.hpp>
+#include <tobi/MappedFile.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace tobi::gpu {
+
+namespace {
+
+using Seconds = std::chrono::duration<double>;
+
+auto createBuffer(wgpu::Device const& device,
+                  uint64_t size,
+                  wgpu::BufferUsage usage,
+                  bool mappedAtCreation = false) -> wgpu::Buffer {
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = size;
+    descriptor.usage = usage;
+    descriptor.mappedAtCreation = mappedAtCreation;
+    return device.CreateBuffer(&descriptor);
+}
+
+}  // namespace
+
+auto StreamStage::rate() const -> double {
+    return seconds > 0.0 ? static_cast<double>(bytes) / seconds * 1e-9 : 0.0;
+}
+
+auto StreamStats::throughput() const -> double {
+    return wallSeconds > 0.0 ? static_cast<double>(hostWrite.bytes) / wallSeconds * 1e-9 : 0.0;
+}
+
+StreamExecutor::StreamExecutor(EventPump& pump, std::string const& source, StreamOptions options)
+    : _pump{pump},
+      _device{pump.device()},
+      _options{options},
+      _kernel{_device, source},
+      _bindGroups{_device} {
+    if (not isThreadSafe(_device)) {
+        throw std::runtime_error{"streaming needs a thread-safe device to tick from the pump"};
+    }
+    if (options.inputStride == 0 or options.inputStride % 4 != 0 or options.outputStride == 0 or
+        options.outputStride % 4 != 0 or options.depth == 0) {
+        throw std::invalid_argument{"stream strides must be multiples of 4 and depth at least 1"};
+    }
+
+    auto const limits = capabilities(_device).limits;
+    auto const bindingLimit = std::min(limits.maxStorageBufferBindingSize, limits.maxBufferSize);
+    auto const stride = std::max(options.inputStride, options.outputStride);
+    _chunkElements = std::min({options.maxChunkBytes / options.inputStride, bindingLimit / stride,
+                               uint64_t{UINT32_MAX}});
+    if (_chunkElements == 0) {
+        throw std::invalid_argument{"stream chunks must hold at least one element"};
+    }
+
+    auto const inputBytes = _chunkElements * options.inputStride;
+    auto const outputBytes = _chunkElements * options.outputStride;
+    _slots.resize(options.depth);
+    for (auto& slot : _slots) {
+        slot.owner = this;
+        slot.staging = createBuffer(_device, inputBytes,
+                                    wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc, true);
+        slot.input = createBuffer(_device, inputBytes,
+                                  wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst);
+        slot.output = createBuffer(_device, outputBytes,
+                                   wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc);
+        slot.readback = createBuffer(_device, outputBytes,
+                                     wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst);
+    }
+}
+
+auto StreamExecutor::chunkBytes() const -> uint64_t {
+    return _chunkElements * _options.inputStride;
+}
+
+auto StreamExecutor::outputSize(uint64_t inputSize) const -> uint64_t {
+    return inputSize / _options.inputStride * _options.outputStride;
+}
+
+auto StreamExecutor::run(std::filesystem::path const& input, std::filesystem::path const& output)
+    -> StreamStats {
+    auto const in = MappedFile{input};
+    if (in.size() % _options.inputStride != 0) {
+        throw std::invalid_argument{input.string() + " is not a whole number of elements"};
+    }
+    auto out = MappedFile{output, outputSize(in.size())};
+    return run(in.bytes(), out.writableBytes());
+}
+
+auto StreamExecutor::run(std::span<std::byte const> input, std::span<std::byte> output)
+    -> StreamStats {
+    if (input.size() % _options.inputStride != 0 or output.size() != outputSize(input.size())) {
+        throw std::invalid_argument{"stream output size does not match the input"};
+    }
+
+    reset();
+
+    auto const elements = input.size() / _options.inputStride;
+    auto const chunks = (elements + _chunkElements - 1) / _chunkElements;
+    auto const start = Clock::now();
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stats = StreamStats{};
+        _stats.chunks = chunks;
+        _stats.chunkBytes = chunkBytes();
+        _gpuIdleSince = start;
+    }
+
+    // The download thread has to be joined before anything leaves this frame, including an
+    // exception from the upload loop.
+    auto downloader = std::thread{[&] { download(output, chunks); }};
+    try {
+        upload(input, elements, chunks);
+    } catch (...) {
+        {
+            auto lock = std::scoped_lock{_mutex};
+            _failed = true;
+        }
+        _changed.notify_all();
+        downloader.join();
+        drain();
+        throw;
+    }
+    downloader.join();
+    drain();
+
+    auto lock = std::scoped_lock{_mutex};
+    if (_failed) {
+        throw std::runtime_error{"streaming a chunk through the GPU failed"};
+    }
+    _stats.wallSeconds = Seconds{Clock::now() - start}.count();
+    return _stats;
+}
+
+auto StreamExecutor::upload(std::span<std::byte const> input, uint64_t elements, uint64_t chunks)
+    -> void {
+    for (auto chunk = uint64_t{0}; chunk < chunks; ++chunk) {
+        auto& slot = _slots[chunk % _slots.size()];
+        {
+            auto lock = std::unique_lock{_mutex};
+            _changed.wait(lock, [&] {
+                return _failed or (slot.state == SlotState::Free and slot.stagingMapped);
+            });
+            if (_failed) {
+                return;
+            }
+        }
+
+        auto const first = chunk * _chunkElements;
+        auto const count = std::min(_chunkElements, elements - first);
+        auto const inputBytes = count * _options.inputStride;
+        auto const outputBytes = count * _options.outputStride;
+
+        auto const writeStart = Clock::now();
+        std::memcpy(slot.staging.GetMappedRange(0, inputBytes),
+                    input.data() + first * _options.inputStride, inputBytes);
+        _stats.hostWrite.seconds += Seconds{Clock::now() - writeStart}.count();
+        _stats.hostWrite.bytes += inputBytes;
+        slot.staging.Unmap();
+
+        {
+            auto lock = std::scoped_lock{_mutex};
+            slot.chunk = chunk;
+            slot.outputBytes = outputBytes;
+            slot.state = SlotState::InFlight;
+            slot.stagingMapped = false;
+        }
+
+        auto encoder = _device.CreateCommandEncoder();
+        encoder.CopyBufferToBuffer(slot.staging, 0, slot.input, 0, inputBytes);
+        submit(encoder, _stats.copyIn, inputBytes);
+
+        auto const bindings = _kernel.createBindings(_bindGroups, {
+            {.binding = 0, .buffer = slot.input, .offset = 0, .size = inputBytes},
+            {.binding = 1, .buffer = slot.output, .offset = 0, .size = outputBytes},
+        });
+        encoder = _device.CreateCommandEncoder();
+        auto pass = encoder.BeginComputePass();
+        _kernel.dispatch(pass, bindings, static_cast<uint32_t>(count));
+        pass.End();
+        submit(encoder, _stats.compute, inputBytes);
+
+        encoder = _device.CreateCommandEncoder();
+        encoder.CopyBufferToBuffer(slot.output, 0, slot.readback, 0, outputBytes);
+        submit(encoder, _stats.copyOut, outputBytes);
+
+        map(slot, slot.readback, wgpu::MapMode::Read, outputBytes);
+        map(slot, slot.staging, wgpu::MapMode::Write, chunkBytes());
+    }
+}
+
+auto StreamExecutor::drain() -> void {
+    auto lock = std::unique_lock{_mutex};
+    _changed.wait(lock, [this] { return _callbacks == 0; });
+}
+
+// A failed run leaves readbacks mapped and staging buffers unmapped. Brings every slot back to
+// Free with its staging buffer mapped for writing.
+auto StreamExecutor::reset() -> void {
+    auto unmapped = std::vector<Slot*>{};
+    {
+        auto lock = std::scoped_lock{_mutex};
+        for (auto& slot : _slots) {
+            if (slot.state == SlotState::Ready) {
+                slot.readback.Unmap();
+            }
+            slot.state = SlotState::Free;
+            if (not slot.stagingMapped) {
+                unmapped.push_back(&slot);
+            }
+        }
+        _failed = false;
+    }
+    if (unmapped.empty()) {
+        return;
+    }
+
+    for (auto* slot : unmapped) {
+        map(*slot, slot->staging, wgpu::MapMode::Write, chunkBytes());
+    }
+    drain();
+    auto lock = std::scoped_lock{_mutex};
+    if (_failed) {
+        throw std::runtime_error{"remapping the stream staging buffers failed"};
+    }
+}
+
+auto StreamExecutor::submit(wgpu::CommandEncoder const& encoder, StreamStage& stage, uint64_t bytes)
+    -> void {
+    auto commands = encoder.Finish();
+    {
+        auto lock = std::scoped_lock{_mutex};
+        ++_callbacks;
+    }
+    _pump.addPending();
+
+    auto queue = _device.GetQueue();
+    auto* done = new WorkDone{this, &stage, Clock::now(), bytes};
+    queue.Submit(1, &commands);
+    queue.OnSubmittedWorkDone(
+        [](WGPUQueueWorkDoneStatus status, void* userdata) {
+            // Runs on the pump thread with the pump locked.
+            auto const work = std::unique_ptr<WorkDone>{static_cast<WorkDone*>(userdata)};
+            auto* self = work->self;
+            self->_pump.removePending();
+
+            auto const now = Clock::now();
+            {
+                auto lock = std::scoped_lock{self->_mutex};
+                auto const begin = std::max(work->submitted, self->_gpuIdleSince);
+                work->stage->seconds += Seconds{now - begin}.count();
+                work->stage->bytes += work->bytes;
+                self->_gpuIdleSince = now;
+                self->_failed = self->_failed or status != WGPUQueueWorkDoneStatus_Success;
+                --self->_callbacks;
+            }
+            self->_changed.notify_all();
+        },
+        done);
+}
+
+// The readback becomes Ready for the download thread, the staging buffer free for the next
+// chunk of this slot.
+auto StreamExecutor::map(Slot& slot, wgpu::Buffer const& buffer, wgpu::MapMode mode, uint64_t size)
+    -> void {
+    {
+        auto lock = std::scoped_lock{_mutex};
+        ++_callbacks;
+    }
+    _pump.addPending();
+
+    if (mode == wgpu::MapMode::Read) {
+        buffer.MapAsync(
+            mode, 0, size,
+            [](WGPUBufferMapAsyncStatus status, void* userdata) {
+                mapped(status, *static_cast<Slot*>(userdata), true);
+            },
+            &slot);
+    } else {
+        buffer.MapAsync(
+            mode, 0, size,
+            [](WGPUBufferMapAsyncStatus status, void* userdata) {
+                mapped(status, *static_cast<Slot*>(userdata), false);
+            },
+            &slot);
+    }
+}
+
+// Runs on the pump thread with the pump locked.
+auto StreamExecutor::mapped(WGPUBufferMapAsyncStatus status, Slot& slot, bool readback) -> void {
+    auto* self = slot.owner;
+    self->_pump.removePending();
+    {
+        auto lock = std::scoped_lock{self->_mutex};
+        if (status != WGPUBufferMapAsyncStatus_Success) {
+            self->_failed = true;
+        } else if (readback) {
+            slot.state = SlotState::Ready;
+        } else {
+            slot.stagingMapped = true;
+        }
+        --self->_callbacks;
+    }
+    self->_changed.notify_all();
+}
+
+// Chunks complete in submission order, so the download thread takes them in the same order.
+auto StreamExecutor::download(std::span<std::byte> output, uint64_t chunks) -> void {
+    auto offset = uint64_t{0};
+    for (auto chunk = uint64_t{0}; chunk < chunks; ++chunk) {
+        auto& slot = _slots[chunk % _slots.size()];
+        {
+            auto lock = std::unique_lock{_mutex};
+            _changed.wait(lock, [&] {
+                return _failed or (slot.state == SlotState::Ready and slot.chunk == chunk);
+            });
+            if (_failed) {
+                return;
+            }
+        }
+
+        auto const start = Clock::now();
+        std::memcpy(output.data() + offset, slot.readback.GetConstMappedRange(0, slot.outputBytes),
+                    slot.outputBytes);
+        _stats.hostRead.seconds += Seconds{Clock::now() - start}.count();
+        _stats.hostRead.bytes += slot.outputBytes;
+        offset += slot.outputBytes;
+        slot.readback.Unmap();
+
+        {
+            auto lock = std::scoped_lock{_mutex};
+            slot.state = SlotState::Free;
+        }
+        _changed.notify_all();
+    }
+}
+
+}  // namespace tobi::gpu
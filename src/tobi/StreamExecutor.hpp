@@ -0,0 +1,142 @@
+#pragma once
+
+#include <tobi/BindGroupCache.hpp>
+#include <tobi/GPU.hpp>
+#include <tobi/Readback.hpp>
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tobi::gpu {
+
+struct StreamOptions {
+    // Bytes per element, multiples of 4.
+    uint32_t inputStride{4};
+    uint32_t outputStride{4};
+
+    // Input bytes per chunk, lowered further to fit maxStorageBufferBindingSize and
+    // maxBufferSize. Every chunk in flight holds two input and two output sized buffers.
+    uint64_t maxChunkBytes{64 * 1024 * 1024};
+
+    // Chunks in flight: one being written, one on the GPU, one being read back.
+    uint32_t depth{3};
+};
+
+struct StreamStage {
+    double seconds{0.0};  // busy time
+    uint64_t bytes{0};
+
+    // GB/s while busy.
+    [[nodiscard]] auto rate() const -> double;
+};
+
+struct StreamStats {
+    uint64_t chunks{0};
+    uint64_t chunkBytes{0};
+    StreamStage hostWrite{};  // input into mapped staging memory, includes reading the file
+    StreamStage copyIn{};     // staging to storage buffer on the GPU queue
+    StreamStage compute{};
+    StreamStage copyOut{};    // storage to readback buffer on the GPU queue
+    StreamStage hostRead{};   // mapped readback into the output
+    double wallSeconds{0.0};
+
+    // Input GB/s over the whole run.
+    [[nodiscard]] auto throughput() const -> double;
+};
+
+// Runs an elementwise kernel over data that does not fit on the GPU, chunk by chunk. Each chunk
+// in flight owns a slot of staging, storage and readback buffers: while the GPU works on one
+// chunk, the calling thread copies the next one into staging memory and a download thread
+// copies the previous one out of its mapped readback. Inputs and outputs are usually mapped
+// files, then data moves between the page cache and GPU-visible memory with no copy in between.
+//
+// The kernel is a WGSL template for gpu::Kernel with the input at binding 0 and the output at
+// binding 1, and writes one output element per input element. Stage times come from the work-done
+// callbacks of separate submits; the WebGPU queue runs them one after the other, so the GPU
+// stages add up while the host stages overlap them.
+//
+// The pump must tick a thread-safe device, the constructor throws std::runtime_error otherwise.
+// A failed run leaves the executor usable, the next run resets its slots. Native only.
+struct StreamExecutor {
+    StreamExecutor(EventPump& pump, std::string const& source, StreamOptions options = {});
+
+    StreamExecutor(StreamExecutor const& other) = delete;
+    StreamExecutor(StreamExecutor&& other) = delete;
+
+    auto operator=(StreamExecutor const& other) -> StreamExecutor& = delete;
+    auto operator=(StreamExecutor&& other) -> StreamExecutor& = delete;
+
+    [[nodiscard]] auto chunkBytes() const -> uint64_t;
+
+    // Output bytes for the given input, which must be a multiple of the input stride.
+    [[nodiscard]] auto outputSize(uint64_t inputSize) const -> uint64_t;
+
+    // Throws std::invalid_argument on mismatched sizes and std::runtime_error if the GPU fails.
+    auto run(std::span<std::byte const> input, std::span<std::byte> output) -> StreamStats;
+
+    // Maps input, creates output with outputSize() bytes and maps it as well.
+    auto run(std::filesystem::path const& input, std::filesystem::path const& output)
+        -> StreamStats;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    enum struct SlotState {
+        Free,
+        InFlight,
+        Ready,  // readback mapped
+    };
+
+    struct Slot {
+        StreamExecutor* owner{nullptr};
+        wgpu::Buffer staging{};
+        wgpu::Buffer input{};
+        wgpu::Buffer output{};
+        wgpu::Buffer readback{};
+        uint64_t chunk{0};
+        uint64_t outputBytes{0};
+        SlotState state{SlotState::Free};  // guarded by _mutex
+        bool stagingMapped{true};          // guarded by _mutex, false until a remap succeeded
+    };
+
+    struct WorkDone {
+        StreamExecutor* self{nullptr};
+        StreamStage* stage{nullptr};
+        Clock::time_point submitted{};
+        uint64_t bytes{0};
+    };
+
+    auto upload(std::span<std::byte const> input, uint64_t elements, uint64_t chunks) -> void;
+    auto drain() -> void;
+    auto reset() -> void;
+    auto submit(wgpu::CommandEncoder const& encoder, StreamStage& stage, uint64_t bytes) -> void;
+    auto map(Slot& slot, wgpu::Buffer const& buffer, wgpu::MapMode mode, uint64_t size) -> void;
+    static auto mapped(WGPUBufferMapAsyncStatus status, Slot& slot, bool readback) -> void;
+    auto download(std::span<std::byte> output, uint64_t chunks) -> void;
+
+    EventPump& _pump;
+    wgpu::Device _device;
+    StreamOptions _options;
+    Kernel _kernel;
+    BindGroupCache _bindGroups;
+    uint64_t _chunkElements{0};
+    std::vector<Slot> _slots{};
+
+    std::mutex _mutex{};
+    std::condition_variable _changed{};
+    uint32_t _callbacks{0};  // outstanding map and work-done callbacks, guarded by _mutex
+    bool _failed{false};     // guarded by _mutex
+    StreamStats _stats{};    // GPU stages guarded by _mutex
+    Clock::time_point _gpuIdleSince{};
+};
+
+}  // namespace tobi::gpu
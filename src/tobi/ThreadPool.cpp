@@ -0,0 +1,175 @@
+#include "ThreadPool.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+
+namespace tobi {
+
+namespace {
+
+// A few audio blocks worth at small buffer sizes. Bounded by time, not iterations: a pause
+// takes about 10 cycles on older x86 cores and about 140 on Skylake and later.
+constexpr auto spinDuration = std::chrono::microseconds{50};
+
+// Pauses between clock reads.
+constexpr auto spinsPerCheck = 64U;
+
+thread_local bool isWorker = false;
+thread_local ThreadPool const* workerPool = nullptr;
+thread_local uint32_t workerSlot = 0;
+
+constexpr auto pack(uint32_t begin, uint32_t end) -> uint64_t {
+    return (uint64_t{begin} << 32U) | end;
+}
+
+constexpr auto begin(uint64_t range) -> uint32_t {
+    return static_cast<uint32_t>(range >> 32U);
+}
+
+constexpr auto end(uint64_t range) -> uint32_t {
+    return static_cast<uint32_t>(range);
+}
+
+auto pause() -> void {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t workers)
+    : _slots{std::make_unique<Slot[]>(workers + 1)}, _slotCount{workers + 1} {
+    _threads.reserve(workers);
+    for (auto i = std::size_t{1}; i <= workers; ++i) {
+        _threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    _stop = true;
+    _generation.fetch_add(1, std::memory_order_release);
+    _generation.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+auto ThreadPool::workers() const -> uint32_t {
+    return static_cast<uint32_t>(_threads.size());
+}
+
+auto ThreadPool::onWorkerThread() -> bool {
+    return isWorker;
+}
+
+auto ThreadPool::workerIndex() const -> uint32_t {
+    return workerPool == this ? workerSlot : 0;
+}
+
+auto ThreadPool::defaultWorkers() -> uint32_t {
+    return std::max(std::thread::hardware_concurrency(), 1U) - 1;
+}
+
+auto ThreadPool::run(uint32_t count, Task task) -> void {
+    if (count == 0) {
+        return;
+    }
+
+    if (_threads.empty() or count == 1 or _busy.exchange(true, std::memory_order_acquire)) {
+        for (auto i = uint32_t{0}; i < count; ++i) {
+            task.invoke(task.context, i);
+        }
+        return;
+    }
+
+    // Workers only read the task after a successful pop, which synchronizes with the release
+    // store of the range below.
+    _task = task;
+    _remaining.store(count, std::memory_order_relaxed);
+    _slots[0].range.store(pack(0, count), std::memory_order_release);
+    _generation.fetch_add(1, std::memory_order_release);
+    _generation.notify_all();
+
+    work(0);
+    _busy.store(false, std::memory_order_release);
+}
+
+auto ThreadPool::workerLoop(std::size_t self) -> void {
+    isWorker = true;
+    workerPool = this;
+    workerSlot = static_cast<uint32_t>(self);
+    auto seen = _generation.load(std::memory_order_acquire);
+    while (true) {
+        auto const deadline = std::chrono::steady_clock::now() + spinDuration;
+        for (auto spins = 1U; _generation.load(std::memory_order_acquire) == seen; ++spins) {
+            if (spins % spinsPerCheck == 0 and std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            pause();
+        }
+        _generation.wait(seen, std::memory_order_acquire);
+        seen = _generation.load(std::memory_order_acquire);
+        if (_stop) {
+            return;
+        }
+        work(self);
+    }
+}
+
+auto ThreadPool::work(std::size_t self) -> void {
+    while (_remaining.load(std::memory_order_acquire) > 0) {
+        auto index = uint32_t{0};
+        if (pop(self, index)) {
+            execute(index);
+        } else if (not steal(self)) {
+            pause();
+        }
+    }
+}
+
+auto ThreadPool::pop(std::size_t self, uint32_t& index) -> bool {
+    auto& slot = _slots[self].range;
+    auto range = slot.load(std::memory_order_acquire);
+    while (begin(range) < end(range)) {
+        if (slot.compare_exchange_weak(range, pack(begin(range) + 1, end(range)),
+                                       std::memory_order_acq_rel)) {
+            index = begin(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+auto ThreadPool::steal(std::size_t self) -> bool {
+    for (auto offset = std::size_t{1}; offset < _slotCount; ++offset) {
+        auto& victim = _slots[(self + offset) % _slotCount].range;
+        auto range = victim.load(std::memory_order_acquire);
+        while (begin(range) < end(range)) {
+            // Take the upper half, or the last index if only one is left.
+            auto const mid = begin(range) + (end(range) - begin(range)) / 2;
+            if (victim.compare_exchange_weak(range, pack(begin(range), mid),
+                                             std::memory_order_acq_rel)) {
+                // Only the owner writes its slot while it is empty, other threads only
+                // shrink non-empty slots.
+                _slots[self].range.store(pack(mid + 1, end(range)), std::memory_order_release);
+                execute(mid);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+auto ThreadPool::execute(uint32_t index) -> void {
+    _task.invoke(_task.context, index);
+    _remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+}  // namespace tobi
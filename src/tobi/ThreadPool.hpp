@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tobi {
+
+// Work-stealing pool for the audio thread. Workers are started once and spin for a while after
+// each job before they sleep on an atomic wait, so back-to-back audio blocks find them awake.
+// A job is a range of indices: the caller publishes it in its own slot, then it and the
+// workers split ranges in halves by stealing from each other's slots with a single CAS on a
+// packed [begin, end) pair. Nothing in parallelFor() locks or allocates.
+//
+// The caller always participates and returns once every index ran. parallelFor() from inside
+// a running job (e.g. a plugin fanning out from a parallel chain) executes serially on the
+// calling thread instead of deadlocking.
+struct ThreadPool {
+    explicit ThreadPool(uint32_t workers = defaultWorkers());
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const& other) = delete;
+    ThreadPool(ThreadPool&& other) = delete;
+
+    auto operator=(ThreadPool const& other) -> ThreadPool& = delete;
+    auto operator=(ThreadPool&& other) -> ThreadPool& = delete;
+
+    template <typename Fn>
+    auto parallelFor(uint32_t count, Fn&& fn) -> void {
+        using F = std::remove_reference_t<Fn>;
+        run(count, {const_cast<void*>(static_cast<void const*>(&fn)),
+                    [](void* f, uint32_t index) { (*static_cast<F*>(f))(index); }});
+    }
+
+    [[nodiscard]] auto workers() const -> uint32_t;
+
+    // True on the pool's worker threads.
+    [[nodiscard]] static auto onWorkerThread() -> bool;
+
+    // 1 to workers() on this pool's worker threads, 0 on every other thread, e.g. the caller of
+    // parallelFor(). Indexes per-thread state like scratch arenas.
+    [[nodiscard]] auto workerIndex() const -> uint32_t;
+
+    // One less than the hardware threads, the caller is the remaining one.
+    [[nodiscard]] static auto defaultWorkers() -> uint32_t;
+
+  private:
+    struct Task {
+        void* context{nullptr};
+        void (*invoke)(void*, uint32_t){nullptr};
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};
+    };
+
+    auto run(uint32_t count, Task task) -> void;
+    auto workerLoop(std::size_t self) -> void;
+    auto work(std::size_t self) -> void;
+    auto pop(std::size_t self, uint32_t& index) -> bool;
+    auto steal(std::size_t self) -> bool;
+    auto execute(uint32_t index) -> void;
+
+    Task _task{};
+    std::unique_ptr<Slot[]> _slots;
+    std::size_t _slotCount;
+    alignas(64) std::atomic<uint32_t> _remaining{0};
+    alignas(64) std::atomic<uint64_t> _generation{0};
+    std::atomic<bool> _busy{false};
+    std::atomic<bool> _stop{false};
+    std::vector<std::thread> _threads{};
+};
+
+}  // namespace tobi
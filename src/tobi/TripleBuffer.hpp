@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace tobi {
+
+// Hands the newest value from one writer thread to one reader thread without locks or waiting.
+// Writer and reader each own one buffer, the third sits in the middle; publish() and update()
+// swap their buffer with the middle one in a single atomic exchange. The reader never sees a
+// partial write, and values it did not pick up in time are replaced rather than queued.
+template <typename T>
+struct TripleBuffer {
+    TripleBuffer() = default;
+
+    TripleBuffer(TripleBuffer const& other) = delete;
+    TripleBuffer(TripleBuffer&& other) = delete;
+
+    auto operator=(TripleBuffer const& other) -> TripleBuffer& = delete;
+    auto operator=(TripleBuffer&& other) -> TripleBuffer& = delete;
+
+    // Writer. The buffer to fill before the next publish().
+    [[nodiscard]] auto back() -> T& { return _buffers[_back]; }
+
+    auto publish() -> void {
+        _back = _middle.exchange(_back | dirty, std::memory_order_acq_rel) & index;
+    }
+
+    // Reader. Takes the newest published value, false if there was none since the last call.
+    auto update() -> bool {
+        if ((_middle.load(std::memory_order_relaxed) & dirty) == 0) {
+            return false;
+        }
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & index;
+        return true;
+    }
+
+    [[nodiscard]] auto front() const -> T const& { return _buffers[_front]; }
+
+  private:
+    static constexpr uint32_t dirty = 4;
+    static constexpr uint32_t index = 3;
+
+    std::array<T, 3> _buffers{};
+    alignas(64) std::atomic<uint32_t> _middle{1};
+    alignas(64) uint32_t _back{0};
+    alignas(64) uint32_t _front{2};
+};
+
+}  // namespace tobi
@@ -17,13 +17,48 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_wgpu.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <fstream>
+#include <memory>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 namespace tobi {
 
-Window::Window() {
+namespace {
+
+// Completion callbacks only run while the device is ticked. Sleeping between ticks keeps a wait
+// for the GPU from spinning a core, at the cost of up to this much extra latency.
+constexpr auto tickInterval = std::chrono::microseconds{200};
+
+constexpr auto presentModes = std::array{
+    wgpu::PresentMode::Fifo,
+    wgpu::PresentMode::Mailbox,
+    wgpu::PresentMode::Immediate,
+};
+constexpr auto presentModeNames = std::array{"Fifo", "Mailbox", "Immediate"};
+
+}  // namespace
+
+Window::Window(WindowOptions options)
+    : _options{std::move(options)},
+      _width{_options.width},
+      _height{_options.height},
+      _presentMode{_options.presentMode} {
+    _options.framesInFlight = std::clamp(_options.framesInFlight, 1U, maxFramesInFlight);
+
+    if (_options.headless) {
+#ifdef __EMSCRIPTEN__
+        throw std::invalid_argument{"headless rendering is not supported with emscripten"};
+#else
+        return;
+#endif
+    }
+
     glfwSetErrorCallback([](int error, const char* description) {
         fmt::println("GLFW Error {}: {}\n", error, description);
     });
@@ -43,10 +78,24 @@ Window::Window() {
 }
 
 Window::~Window() {
+#ifndef __EMSCRIPTEN__
+    // Completion callbacks point at this window.
+    while (_framesInFlight > 0) {
+        _gpuDevice.Tick();
+        _gpuInstance.ProcessEvents();
+        std::this_thread::sleep_for(tickInterval);
+    }
+#endif
+
     ImGui_ImplWGPU_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (not _options.headless) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 
+    if (_options.headless) {
+        return;
+    }
     if (_window != nullptr) {
         glfwDestroyWindow(_window);
     }
@@ -58,9 +107,12 @@ auto Window::show() -> void {
     if (not initWebGPU()) {
         // return EXIT_FAILURE;
     }
-    createSwapChain(_width, _height);
-
-    glfwShowWindow(_window);
+    if (_options.headless) {
+        createOffscreenTargets(_width, _height);
+    } else {
+        createSwapChain(_width, _height);
+        glfwShowWindow(_window);
+    }
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -74,14 +126,17 @@ auto Window::show() -> void {
     // Setup Dear ImGui style
     ImGui::StyleColorsDark();
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOther(_window, true);
+    // Setup Platform/Renderer backends, ImGui chains to the callbacks installed before
+    if (not _options.headless) {
+        installInvalidationCallbacks();
+        ImGui_ImplGlfw_InitForOther(_window, true);
+    }
 #ifdef __EMSCRIPTEN__
     ImGui_ImplGlfw_InstallEmscriptenCanvasResizeCallback("#canvas");
 #endif
     ImGui_ImplWGPU_InitInfo init_info;
     init_info.Device = _gpuDevice.Get();
-    init_info.NumFramesInFlight = 3;
+    init_info.NumFramesInFlight = static_cast<int>(maxFramesInFlight);
     init_info.RenderTargetFormat = static_cast<WGPUTextureFormat>(_gpuPreferredFormat);
     init_info.DepthStencilFormat = WGPUTextureFormat_Undefined;
     ImGui_ImplWGPU_Init(&init_info);
@@ -94,12 +149,176 @@ auto Window::show() -> void {
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop_arg([](auto* p) { static_cast<Window*>(p)->loop(); }, this, 0, true);
 #else
+    if (_options.headless) {
+        runHeadless();
+        return;
+    }
     while (not glfwWindowShouldClose(_window)) {
         loop();
     }
 #endif
 }
 
+auto Window::metrics() const -> FrameMetrics const& {
+    return _metrics;
+}
+
+auto Window::onGui(std::function<void()> callback) -> void {
+    _onGui = std::move(callback);
+}
+
+auto Window::invalidate() -> void {
+    _dirty = true;
+    if (not _options.headless) {
+        glfwPostEmptyEvent();
+    }
+}
+
+auto Window::animateFor(std::chrono::milliseconds duration) -> void {
+    _animateUntil = std::max(_animateUntil, std::chrono::steady_clock::now() + duration);
+}
+
+auto Window::skippedFrames() const -> uint64_t {
+    return _skippedFrames;
+}
+
+auto Window::installInvalidationCallbacks() -> void {
+    glfwSetWindowUserPointer(_window, this);
+
+    static constexpr auto dirty = [](GLFWwindow* window) {
+        static_cast<Window*>(glfwGetWindowUserPointer(window))->_dirty = true;
+    };
+
+    // Captureless lambdas only, GLFW takes plain function pointers.
+    glfwSetKeyCallback(_window, [](GLFWwindow* w, int, int, int, int) { dirty(w); });
+    glfwSetCharCallback(_window, [](GLFWwindow* w, unsigned int) { dirty(w); });
+    glfwSetCursorPosCallback(_window, [](GLFWwindow* w, double, double) { dirty(w); });
+    glfwSetCursorEnterCallback(_window, [](GLFWwindow* w, int) { dirty(w); });
+    glfwSetMouseButtonCallback(_window, [](GLFWwindow* w, int, int, int) { dirty(w); });
+    glfwSetScrollCallback(_window, [](GLFWwindow* w, double, double) { dirty(w); });
+    glfwSetWindowFocusCallback(_window, [](GLFWwindow* w, int) { dirty(w); });
+    glfwSetFramebufferSizeCallback(_window, [](GLFWwindow* w, int, int) { dirty(w); });
+    glfwSetWindowRefreshCallback(_window, [](GLFWwindow* w) { dirty(w); });
+}
+
+auto Window::pollEvents() -> bool {
+    auto const now = std::chrono::steady_clock::now();
+    auto const animating = now < _animateUntil;
+    auto const busy = _dirty or _settleFrames > 0 or animating or ImGui::IsAnyItemActive();
+
+    if (not _options.redrawOnDemand or busy) {
+        glfwPollEvents();
+    } else {
+#ifdef __EMSCRIPTEN__
+        // requestAnimationFrame drives the loop, every callback without changes is one skip.
+        glfwPollEvents();
+#else
+        glfwWaitEventsTimeout(_options.idleTimeout);
+#endif
+    }
+
+    if (_dirty.exchange(false)) {
+        _settleFrames = settleFrames;
+    }
+    if (not _options.redrawOnDemand) {
+        return true;
+    }
+    if (_settleFrames > 0) {
+        --_settleFrames;
+        return true;
+    }
+    if (busy) {
+        return true;
+    }
+
+#ifdef __EMSCRIPTEN__
+    ++_skippedFrames;
+#else
+    auto const idle = std::chrono::steady_clock::now() - now;
+    auto const idleMs = std::chrono::duration<double, std::milli>(idle).count();
+    _skippedFrames += std::max<uint64_t>(1, static_cast<uint64_t>(idleMs / _refreshInterval));
+#endif
+    return false;
+}
+
+auto Window::waitForFrameSlot() -> void {
+#ifndef __EMSCRIPTEN__
+    _gpuDevice.Tick();
+    _gpuInstance.ProcessEvents();
+    while (_framesInFlight >= _options.framesInFlight) {
+        std::this_thread::sleep_for(tickInterval);
+        _gpuDevice.Tick();
+        _gpuInstance.ProcessEvents();
+    }
+#endif
+}
+
+auto Window::drawFrameMetrics() -> void {
+    if (not ImGui::CollapsingHeader("Frame pacing")) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    if (not _options.headless) {
+        auto current = static_cast<int>(
+            std::find(presentModes.begin(), presentModes.end(), _presentMode) -
+            presentModes.begin());
+        if (ImGui::Combo("Present mode", &current, presentModeNames.data(),
+                         static_cast<int>(presentModeNames.size()))) {
+            _presentMode = presentModes[static_cast<std::size_t>(current)];
+            _swapChainDirty = true;
+        }
+    }
+
+    auto framesInFlight = static_cast<int>(_options.framesInFlight);
+    if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1,
+                         static_cast<int>(maxFramesInFlight))) {
+        _options.framesInFlight = static_cast<uint32_t>(framesInFlight);
+    }
+#endif
+
+    auto const draw = [](char const* name, Histogram const& histogram) {
+        ImGui::Text("%s: p50 %.2f p95 %.2f p99 %.2f max %.2f ms", name, histogram.percentile(0.5),
+                    histogram.percentile(0.95), histogram.percentile(0.99), histogram.max());
+        auto const counts = histogram.counts();
+        ImGui::PlotHistogram(name, counts.data(), static_cast<int>(counts.size()), 0, nullptr, 0.0F,
+                             3.4e38F, ImVec2{0, 40});
+    };
+    draw("CPU", _metrics.cpuTime);
+    draw("GPU", _metrics.gpuTime);
+    draw("Latency", _metrics.presentLatency);
+
+    if (ImGui::Button("Reset")) {
+        _metrics.cpuTime.reset();
+        _metrics.gpuTime.reset();
+        _metrics.presentLatency.reset();
+    }
+}
+
+auto Window::runHeadless() -> void {
+    auto const start = std::chrono::steady_clock::now();
+    _lastFrame = start;
+    while (_options.frames == 0 or _frame < _options.frames) {
+        loop();
+    }
+    gpu::waitForQueue(_gpuDevice);
+    auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    // Encoding may lag behind, it is not part of the render loop's throughput.
+    if (_frameWriter) {
+        _frameWriter->flush();
+    }
+
+    fmt::println("Rendered {} frames in {:.3f} s ({:.1f} FPS)", _frame, seconds.count(),
+                 static_cast<double>(_frame) / seconds.count());
+    if (_frameWriter) {
+        auto const stats = _frameWriter->stats();
+        fmt::println("Wrote {} frames ({:.1f} MiB) to {}", stats.framesWritten,
+                     static_cast<double>(stats.bytesWritten) / (1024.0 * 1024.0),
+                     _options.captureDirectory.string());
+    }
+}
+
 auto Window::loop() -> void {
     static bool showDemoWindow = true;
     static bool showAnotherWindow = true;
@@ -108,20 +327,37 @@ auto Window::loop() -> void {
 
     ImGuiIO& io = ImGui::GetIO();
 
-    glfwPollEvents();
-
-    // React to changes in screen size
-    int width, height;
-    glfwGetFramebufferSize(_window, &width, &height);
-    if (width != _width or height != _height) {
-        ImGui_ImplWGPU_InvalidateDeviceObjects();
-        createSwapChain(width, height);
-        ImGui_ImplWGPU_CreateDeviceObjects();
+    // Block before input is sampled, so a full queue delays the input instead of aging it.
+    waitForFrameSlot();
+    if (not _options.headless and not pollEvents()) {
+        return;
+    }
+    auto const frameStart = std::chrono::steady_clock::now();
+    auto const frameScope = gpu::Profiler::CpuScope{*_profiler, "Frame"};
+
+    if (_options.headless) {
+        // No platform backend, feed ImGui the display size and frame time ourselves.
+        auto const now = std::chrono::steady_clock::now();
+        auto const delta = std::chrono::duration<float>(now - _lastFrame).count();
+        _lastFrame = now;
+        io.DisplaySize = ImVec2{static_cast<float>(_width), static_cast<float>(_height)};
+        io.DeltaTime = std::max(delta, 1e-6F);
+    } else {
+        // React to changes in screen size
+        int width, height;
+        glfwGetFramebufferSize(_window, &width, &height);
+        if (width != _width or height != _height or _swapChainDirty) {
+            ImGui_ImplWGPU_InvalidateDeviceObjects();
+            createSwapChain(width, height);
+            ImGui_ImplWGPU_CreateDeviceObjects();
+        }
     }
 
     // Start the Dear ImGui frame
     ImGui_ImplWGPU_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (not _options.headless) {
+        ImGui_ImplGlfw_NewFrame();
+    }
     ImGui::NewFrame();
 
     if (showDemoWindow) {
@@ -138,15 +374,20 @@ auto Window::loop() -> void {
         ImGui::SliderFloat("float", &f, 0.0f, 1.0f);
         ImGui::ColorEdit3("clear color", (float*)&clear_color);
 
-        // AUDIO
-        // if (ImGui::Button("Enable Audio")) {
-        //     audioDevice.initialized();
-        // }
-        // ImGui::SameLine();
-        // ImGui::Text("Audio = %s", audioDevice.isInitialized() ? "true" : "false");
-
         // FPS
         ImGui::Text("Average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+        if (_profiler->enabled()) {
+            ImGui::Text("GPU %.3f ms/frame", _profiler->lastGpuTime("ImGui"));
+#ifndef __EMSCRIPTEN__
+            if (ImGui::Button("Save GPU trace")) {
+                auto file = std::ofstream{"trace.json"};
+                file << _profiler->toChromeTrace();
+            }
+#endif
+        }
+        drawFrameMetrics();
+        ImGui::Checkbox("Redraw on demand", &_options.redrawOnDemand);
+        ImGui::Text("Skipped %llu frames", static_cast<unsigned long long>(_skippedFrames));
         ImGui::End();
     }
 
@@ -159,6 +400,10 @@ auto Window::loop() -> void {
         ImGui::End();
     }
 
+    if (_onGui) {
+        _onGui();
+    }
+
     // Rendering
     ImGui::Render();
 
@@ -177,7 +422,8 @@ auto Window::loop() -> void {
         clear_color.z * clear_color.w,
         clear_color.w,
     };
-    colorAttachment.view = _gpuSwapChain.GetCurrentTextureView();
+    auto const& target = _options.headless ? _offscreen[_frame % _offscreen.size()] : nullptr;
+    colorAttachment.view = target ? target.CreateView() : _gpuSwapChain.GetCurrentTextureView();
 
     auto renderPassDesc = wgpu::RenderPassDescriptor{};
     renderPassDesc.colorAttachmentCount = 1;
@@ -187,23 +433,86 @@ auto Window::loop() -> void {
     auto enc_desc = wgpu::CommandEncoderDescriptor{};
     auto encoder = _gpuDevice.CreateCommandEncoder(&enc_desc);
 
-    auto pass = encoder.BeginRenderPass(&renderPassDesc);
+    auto pass = _profiler->beginRenderPass(encoder, renderPassDesc, "ImGui");
     ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), pass.Get());
     pass.End();
+    _profiler->resolve(encoder);
+
+    auto capture = _frameWriter ? captureFrame(encoder, target) : nullptr;
 
     auto cmd_buffer_desc = wgpu::CommandBufferDescriptor{};
     auto cmd_buffer = encoder.Finish(&cmd_buffer_desc);
     auto queue = _gpuDevice.GetQueue();
     queue.Submit(1, &cmd_buffer);
+    _profiler->submitted();
+
+    struct Pending {
+        Window* window;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point submit;
+        double vblankWait;
+    };
+
+    // WebGPU does not report when a frame reaches the display. Fifo and Mailbox wait half a
+    // refresh interval for the next vblank on average, Immediate and headless do not wait.
+    auto const waitsForVblank =
+        not _options.headless and _presentMode != wgpu::PresentMode::Immediate;
+    auto* pending = new Pending{this, frameStart, std::chrono::steady_clock::now(),
+                                waitsForVblank ? _refreshInterval * 0.5 : 0.0};
+    ++_framesInFlight;
+    queue.OnSubmittedWorkDone(
+        [](WGPUQueueWorkDoneStatus, void* userdata) {
+            auto const p = std::unique_ptr<Pending>{static_cast<Pending*>(userdata)};
+            auto const done = std::chrono::steady_clock::now();
+            auto const ms = [](auto d) {
+                return std::chrono::duration<double, std::milli>(d).count();
+            };
+
+            auto& metrics = p->window->_metrics;
+            metrics.cpuTime.record(ms(p->submit - p->start));
+            metrics.gpuTime.record(ms(done - p->submit));
+            metrics.presentLatency.record(ms(done - p->start) + p->vblankWait);
+            --p->window->_framesInFlight;
+        },
+        pending);
+
+    if (capture) {
+        auto const size = capture.GetSize();
+        _frameWriter->write({
+            .index = _frame,
+            .width = static_cast<uint32_t>(_width),
+            .height = static_cast<uint32_t>(_height),
+            .bytesPerRow = static_cast<uint32_t>(size / static_cast<uint64_t>(_height)),
+            .pixels = gpu::readback(*_pump, capture, 0, size),
+        });
+    }
+    ++_frame;
 
 #ifndef __EMSCRIPTEN__
-    _gpuSwapChain.Present();
+    if (not _options.headless) {
+        _gpuSwapChain.Present();
+    }
 #endif
 }
 
 bool Window::initWebGPU() {
     wgpu::Instance instance = wgpu::CreateInstance(nullptr);
     _gpuDevice = tobi::gpu::getDefaultDevice(instance);
+    _gpuInstance = instance;
+    _gpuDevice.SetUncapturedErrorCallback(tobi::gpu::errorCallback, nullptr);
+    _profiler = std::make_unique<gpu::Profiler>(_gpuDevice);
+
+    if (_options.headless) {
+        // Matches the byte order of the PNG and raw frame exports.
+        _gpuPreferredFormat = wgpu::TextureFormat::RGBA8Unorm;
+        if (not _options.captureDirectory.empty()) {
+            _pump = std::make_unique<gpu::EventPump>(_gpuDevice);
+            _frameWriter =
+                std::make_unique<FrameWriter>(_options.captureDirectory, _options.captureFormat);
+        }
+        tobi::gpu::inspectDevice(_gpuDevice);
+        return true;
+    }
 
 #ifdef __EMSCRIPTEN__
     wgpu::SurfaceDescriptorFromCanvasHTMLSelector html_surface_desc = {};
@@ -222,11 +531,8 @@ bool Window::initWebGPU() {
     _gpuPreferredFormat = wgpu::TextureFormat::BGRA8Unorm;
 #endif
 
-    _gpuInstance = instance;
     _gpuSurface = surface;
 
-    _gpuDevice.SetUncapturedErrorCallback(tobi::gpu::errorCallback, nullptr);
-
     // tobi::gpu::inspectAdapter(_gpuDevice.GetAdapter());
     tobi::gpu::inspectDevice(_gpuDevice);
     return true;
@@ -245,9 +551,79 @@ void Window::createSwapChain(int width, int height) {
     descriptor.format = _gpuPreferredFormat;
     descriptor.width = width;
     descriptor.height = height;
-    descriptor.presentMode = wgpu::PresentMode::Fifo;
+    descriptor.presentMode = _presentMode = supportedPresentMode(_presentMode);
 
     _gpuSwapChain = _gpuDevice.CreateSwapChain(_gpuSurface, &descriptor);
+    _swapChainDirty = false;
+
+#ifndef __EMSCRIPTEN__
+    auto* monitor = glfwGetWindowMonitor(_window);
+    if (monitor == nullptr) {
+        monitor = glfwGetPrimaryMonitor();
+    }
+    auto const* mode = monitor != nullptr ? glfwGetVideoMode(monitor) : nullptr;
+    if (mode != nullptr and mode->refreshRate > 0) {
+        _refreshInterval = 1000.0 / mode->refreshRate;
+    }
+#endif
+}
+
+auto Window::supportedPresentMode(wgpu::PresentMode requested) const -> wgpu::PresentMode {
+#ifdef __EMSCRIPTEN__
+    return requested;
+#else
+    // Fifo is the only mode every surface has to support.
+    auto capabilities = wgpu::SurfaceCapabilities{};
+    _gpuSurface.GetCapabilities(_gpuDevice.GetAdapter(), &capabilities);
+    auto const* begin = capabilities.presentModes;
+    auto const* end = begin + capabilities.presentModeCount;
+    if (requested == wgpu::PresentMode::Fifo or std::find(begin, end, requested) != end) {
+        return requested;
+    }
+
+    auto const name = std::find(presentModes.begin(), presentModes.end(), requested);
+    fmt::println("Present mode {} is not supported by the surface, falling back to Fifo",
+                 name != presentModes.end() ? presentModeNames[name - presentModes.begin()]
+                                            : "requested");
+    return wgpu::PresentMode::Fifo;
+#endif
+}
+
+auto Window::createOffscreenTargets(int width, int height) -> void {
+    _width = width;
+    _height = height;
+
+    auto descriptor = wgpu::TextureDescriptor{};
+    descriptor.usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::CopySrc;
+    descriptor.format = _gpuPreferredFormat;
+    descriptor.size = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+
+    // Several targets so the copy out of one frame can overlap rendering the next ones.
+    _offscreen.clear();
+    for (auto i = 0; i < offscreenFrames; ++i) {
+        _offscreen.push_back(_gpuDevice.CreateTexture(&descriptor));
+    }
+}
+
+auto Window::captureFrame(wgpu::CommandEncoder const& encoder, wgpu::Texture const& texture)
+    -> wgpu::Buffer {
+    // Texture copies need rows aligned to 256 bytes, FrameWriter strips the padding.
+    auto const bytesPerRow = (static_cast<uint32_t>(_width) * 4 + 255U) & ~255U;
+
+    auto descriptor = wgpu::BufferDescriptor{};
+    descriptor.size = uint64_t{bytesPerRow} * static_cast<uint64_t>(_height);
+    descriptor.usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead;
+    auto buffer = _gpuDevice.CreateBuffer(&descriptor);
+
+    auto src = wgpu::ImageCopyTexture{};
+    src.texture = texture;
+    auto dst = wgpu::ImageCopyBuffer{};
+    dst.buffer = buffer;
+    dst.layout.bytesPerRow = bytesPerRow;
+    dst.layout.rowsPerImage = static_cast<uint32_t>(_height);
+    auto const extent = wgpu::Extent3D{texture.GetWidth(), texture.GetHeight(), 1};
+    encoder.CopyTextureToBuffer(&src, &dst, &extent);
+    return buffer;
 }
 
 }  // namespace tobi
@@ -1,12 +1,65 @@
 #pragma once
 
+#include <tobi/FrameWriter.hpp>
+#include <tobi/Histogram.hpp>
+#include <tobi/Profiler.hpp>
+#include <tobi/Readback.hpp>
+
 #include <GLFW/glfw3.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
 namespace tobi {
 
+struct WindowOptions {
+    int width{1280};
+    int height{720};
+
+    // Fifo waits for vblank, Mailbox replaces the queued frame, Immediate tears. Can be changed
+    // at runtime from the overlay, modes the surface does not support fall back to Fifo.
+    // Emscripten always presents through requestAnimationFrame.
+    wgpu::PresentMode presentMode{wgpu::PresentMode::Fifo};
+
+    // Upper bound for frames submitted but not completed by the GPU. The loop blocks before
+    // sampling input once the bound is reached, lower values trade throughput for latency.
+    uint32_t framesInFlight{2};
+
+    // Only redraws after input, resize, a running animation or invalidate(). While nothing is
+    // dirty the loop sleeps in glfwWaitEventsTimeout for at most idleTimeout seconds.
+    bool redrawOnDemand{false};
+    double idleTimeout{0.5};
+
+    // Renders into a ring of offscreen textures instead of a window and swap chain. Nothing waits
+    // for vsync or a display, so the loop runs as fast as the CPU and GPU allow. Not available
+    // with Emscripten.
+    bool headless{false};
+
+    // Headless only: show() returns after this many frames, 0 renders until the process ends.
+    uint64_t frames{0};
+
+    // Headless only: if set, every frame is read back and written to this directory.
+    std::filesystem::path captureDirectory{};
+    FrameFormat captureFormat{FrameFormat::Png};
+};
+
+// All values in milliseconds.
+struct FrameMetrics {
+    Histogram cpuTime{};         // frame start until submit
+    Histogram gpuTime{};         // submit until the queue completed the frame
+    Histogram presentLatency{};  // input poll until the frame is expected on screen
+};
+
 struct Window {
-    Window();
+    static constexpr uint32_t maxFramesInFlight = 4;
+
+    explicit Window(WindowOptions options = {});
     ~Window();
 
     Window(Window const& other) = delete;
@@ -17,21 +70,78 @@ struct Window {
 
     auto show() -> void;
 
+    [[nodiscard]] auto metrics() const -> FrameMetrics const&;
+
+    // Called every rendered frame between ImGui::NewFrame() and ImGui::Render(), the place for
+    // application panels.
+    auto onGui(std::function<void()> callback) -> void;
+
+    // Marks the window dirty, e.g. after external data changed. Can be called from any thread.
+    auto invalidate() -> void;
+
+    // Keeps redrawing for the given duration, for animations driven by the application.
+    auto animateFor(std::chrono::milliseconds duration) -> void;
+
+    // Frames the continuous loop would have rendered at the display rate while idle.
+    [[nodiscard]] auto skippedFrames() const -> uint64_t;
+
   private:
+    static constexpr auto offscreenFrames = 3;
+
+    // ImGui needs a few frames after an event to settle hover and focus state.
+    static constexpr uint32_t settleFrames = 3;
+
     auto loop() -> void;
+    auto runHeadless() -> void;
+    auto waitForFrameSlot() -> void;
+    auto installInvalidationCallbacks() -> void;
+
+    // Polls or waits for events, false if nothing needs to be redrawn.
+    [[nodiscard]] auto pollEvents() -> bool;
+    auto drawFrameMetrics() -> void;
 
     auto initWebGPU() -> bool;
     auto createSwapChain(int width, int height) -> void;
 
+    // The requested mode if the surface supports it, Fifo otherwise.
+    [[nodiscard]] auto supportedPresentMode(wgpu::PresentMode requested) const
+        -> wgpu::PresentMode;
+    auto createOffscreenTargets(int width, int height) -> void;
+
+    // Records a copy of the frame's texture into a new MapRead buffer.
+    [[nodiscard]] auto captureFrame(wgpu::CommandEncoder const& encoder,
+                                    wgpu::Texture const& texture) -> wgpu::Buffer;
+
+    WindowOptions _options;
     GLFWwindow* _window{nullptr};
     int _width = 1280;
     int _height = 720;
+    uint64_t _frame{0};
+    std::chrono::steady_clock::time_point _lastFrame{};
+
+    wgpu::PresentMode _presentMode{wgpu::PresentMode::Fifo};
+    bool _swapChainDirty{false};
+    double _refreshInterval{1000.0 / 60.0};
+    std::atomic<uint32_t> _framesInFlight{0};
+    FrameMetrics _metrics{};
+
+    std::atomic<bool> _dirty{true};
+    uint32_t _settleFrames{0};
+    std::chrono::steady_clock::time_point _animateUntil{};
+    uint64_t _skippedFrames{0};
+
+    std::function<void()> _onGui{};
 
     wgpu::Instance _gpuInstance{};
     wgpu::Device _gpuDevice{};
     wgpu::Surface _gpuSurface{};
     wgpu::SwapChain _gpuSwapChain{};
     wgpu::TextureFormat _gpuPreferredFormat{wgpu::TextureFormat::RGBA8Unorm};
+    std::unique_ptr<gpu::Profiler> _profiler{};
+
+    std::vector<wgpu::Texture> _offscreen{};
+    std::unique_ptr<gpu::EventPump> _pump{};
+    std::unique_ptr<FrameWriter> _frameWriter{};
 };
 
 }  // namespace tobi